@@ -0,0 +1,38 @@
+#ifndef GREATEST_STUB_H
+#define GREATEST_STUB_H
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+typedef enum { GREATEST_TEST_RES_PASS = 0, GREATEST_TEST_RES_FAIL = -1, GREATEST_TEST_RES_SKIP = 1 } greatest_test_res;
+struct greatest_info_t { const char *suite_filter; const char *test_filter; int passed, failed, skipped; const char *msg; const char *file; int line; };
+extern struct greatest_info_t greatest_info;
+int greatest_name_match(const char *name, const char *filter);
+#define TEST static greatest_test_res
+#define SUITE(NAME) void NAME(void)
+#define GREATEST_MAIN_DEFS() struct greatest_info_t greatest_info; \
+  int greatest_name_match(const char *name, const char *filter) { return strstr(name, filter) != NULL; }
+#define GREATEST_MAIN_BEGIN() do { memset(&greatest_info,0,sizeof greatest_info); \
+  for (int i_ = 1; i_ < argc; i_++) { if (!strcmp(argv[i_], "-s") && i_+1<argc) greatest_info.suite_filter = argv[++i_]; \
+  else if (!strcmp(argv[i_], "-t") && i_+1<argc) greatest_info.test_filter = argv[++i_]; } } while (0)
+#define GREATEST_MAIN_END() do { printf("\npassed %d failed %d skipped %d\n", greatest_info.passed, greatest_info.failed, greatest_info.skipped); return greatest_info.failed ? 1 : 0; } while (0)
+#define RUN_SUITE(S) do { if (!greatest_info.suite_filter || greatest_name_match(#S, greatest_info.suite_filter)) { printf("* Suite %s\n", #S); fflush(stdout); S(); } } while (0)
+#define GREATEST_REPORT_(NAME, R) do { if (R == GREATEST_TEST_RES_PASS) { greatest_info.passed++; printf("  ok   %s %s\n", NAME, greatest_info.msg ? greatest_info.msg : ""); } \
+  else if (R == GREATEST_TEST_RES_FAIL) { greatest_info.failed++; printf("  FAIL %s: %s (%s:%d)\n", NAME, greatest_info.msg ? greatest_info.msg : "", greatest_info.file, greatest_info.line); } else greatest_info.skipped++; fflush(stdout); } while(0)
+#define RUN_TEST(T) do { if (!greatest_info.test_filter || greatest_name_match(#T, greatest_info.test_filter)) { greatest_info.msg = NULL; greatest_test_res r_ = T(); GREATEST_REPORT_(#T, r_); } } while (0)
+#define RUN_TEST1(T, A) do { if (!greatest_info.test_filter || greatest_name_match(#T, greatest_info.test_filter)) { greatest_info.msg = NULL; greatest_test_res r_ = T(A); GREATEST_REPORT_(#T, r_); } } while (0)
+#define GREATEST_FAIL_(M) do { greatest_info.msg = (M); greatest_info.file = __FILE__; greatest_info.line = __LINE__; return GREATEST_TEST_RES_FAIL; } while (0)
+#define ASSERT(C) do { if (!(C)) GREATEST_FAIL_(#C); } while (0)
+#define ASSERTm(M, C) do { if (!(C)) GREATEST_FAIL_(M); } while (0)
+#define ASSERT_EQ(E, G) do { if ((E) != (G)) GREATEST_FAIL_(#E " != " #G); } while (0)
+#define ASSERT_EQm(M, E, G) do { if ((E) != (G)) GREATEST_FAIL_(M); } while (0)
+#define ASSERT_EQ_FMT(E, G, F) ASSERT_EQ(E, G)
+#define ASSERT_IN_RANGE(E, G, T) do { if (fabs((double)(E) - (double)(G)) > (double)(T)) GREATEST_FAIL_(#E " !~ " #G); } while (0)
+#define ASSERT_IN_RANGEm(M, E, G, T) do { if (fabs((double)(E) - (double)(G)) > (double)(T)) GREATEST_FAIL_(M); } while (0)
+#define FAILm(M) GREATEST_FAIL_(M)
+#define FAIL() GREATEST_FAIL_("fail")
+#define PASS() do { return GREATEST_TEST_RES_PASS; } while (0)
+#define PASSm(M) do { greatest_info.msg = (M); return GREATEST_TEST_RES_PASS; } while (0)
+#define SKIPm(M) do { greatest_info.msg = (M); return GREATEST_TEST_RES_SKIP; } while (0)
+#define SET_SETUP(F, U) (void)0
+#define SET_TEARDOWN(F, U) (void)0
+#endif
@@ -0,0 +1,227 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#ifdef __linux__
+#define _GNU_SOURCE // CPU_SET, pthread_setaffinity_np
+#endif
+
+#include "affinity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Number of NUMA node ids that are looked for.
+#define AFFINITY_MAX_NODES 64
+
+// Policy and flag of mbind from linux/mempolicy.h.
+#define AFFINITY_MPOL_PREFERRED 1
+#define AFFINITY_MPOL_MF_MOVE (1 << 1)
+
+/**
+ * \brief NUMA nodes with CPUs the process is allowed to run on.
+ *
+ * Nodes are numbered from 0 to num_nodes - 1 in the encoder and ids maps
+ * them to the node ids of the system.
+ */
+static struct {
+  int num_nodes;
+  int ids[AFFINITY_MAX_NODES];
+  cpu_set_t cpus[AFFINITY_MAX_NODES];
+  cpu_set_t allowed;
+} topology;
+
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+
+
+/**
+ * \brief Read the CPUs of a NUMA node from sysfs.
+ *
+ * \return 1 if the node exists, 0 otherwise
+ */
+static int read_node_cpus(int node, cpu_set_t *cpus)
+{
+  char path[64];
+  sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+  FILE *file = fopen(path, "r");
+  if (!file) return 0;
+
+  // The list is formatted like "0-3,8-11".
+  CPU_ZERO(cpus);
+  int first;
+  while (fscanf(file, "%d", &first) == 1) {
+    int last = first;
+    int c = fgetc(file);
+    if (c == '-') {
+      if (fscanf(file, "%d", &last) != 1) break;
+      c = fgetc(file);
+    }
+    for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+      CPU_SET(cpu, cpus);
+    }
+    if (c != ',') break;
+  }
+  fclose(file);
+  return 1;
+}
+
+
+static void topology_init(void)
+{
+  if (sched_getaffinity(0, sizeof(topology.allowed), &topology.allowed) != 0) {
+    CPU_ZERO(&topology.allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, &topology.allowed);
+  }
+
+  topology.num_nodes = 0;
+  for (int id = 0; id < AFFINITY_MAX_NODES; id++) {
+    cpu_set_t *cpus = &topology.cpus[topology.num_nodes];
+    if (!read_node_cpus(id, cpus)) continue;
+    CPU_AND(cpus, cpus, &topology.allowed);
+    if (CPU_COUNT(cpus) > 0) {
+      topology.ids[topology.num_nodes++] = id;
+    }
+  }
+
+  if (topology.num_nodes == 0) {
+    // No NUMA information, so all CPUs are on a single node.
+    topology.num_nodes = 1;
+    topology.ids[0] = 0;
+    topology.cpus[0] = topology.allowed;
+  }
+}
+
+
+/**
+ * \brief Get the number of NUMA nodes the process can run on.
+ */
+int uvg_affinity_num_nodes(void)
+{
+  pthread_once(&topology_once, topology_init);
+  return topology.num_nodes;
+}
+
+
+/**
+ * \brief Pin a thread to a CPU or to the CPUs of a NUMA node.
+ *
+ * Threads are spread over the CPUs or the nodes in order by their index.
+ *
+ * \param thread  thread to pin
+ * \param mode    pin to a single CPU or to a node
+ * \param index   index of the thread
+ *
+ * \return node of the thread, or -1 if it was not pinned
+ */
+int uvg_affinity_pin_thread(pthread_t thread, enum uvg_thread_affinity mode, int index)
+{
+  pthread_once(&topology_once, topology_init);
+
+  cpu_set_t cpus;
+  int node = -1;
+
+  if (mode == UVG_THREAD_AFFINITY_CORES) {
+    int cpu = -1;
+    for (int i = index % CPU_COUNT(&topology.allowed); i >= 0; i--) {
+      do {
+        cpu++;
+      } while (!CPU_ISSET(cpu, &topology.allowed));
+    }
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    for (int i = 0; i < topology.num_nodes; i++) {
+      if (CPU_ISSET(cpu, &topology.cpus[i])) node = i;
+    }
+  } else if (mode == UVG_THREAD_AFFINITY_NODES) {
+    node = index % topology.num_nodes;
+    cpus = topology.cpus[node];
+  } else {
+    return -1;
+  }
+
+  if (pthread_setaffinity_np(thread, sizeof(cpus), &cpus) != 0) {
+    return -1;
+  }
+  return node;
+}
+
+
+/**
+ * \brief Move memory to a NUMA node.
+ *
+ * Only the whole pages within the range are moved. Pages that are not yet
+ * used are allocated on the node when first touched. Failures are ignored,
+ * since the memory stays usable where it is.
+ *
+ * \param node  node from 0 to uvg_affinity_num_nodes() - 1
+ */
+void uvg_affinity_bind_memory(void *ptr, size_t size, int node)
+{
+  pthread_once(&topology_once, topology_init);
+  if (node < 0 || node >= topology.num_nodes || topology.num_nodes < 2) return;
+
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  const uintptr_t start = ((uintptr_t)ptr + page_size - 1) & ~(page_size - 1);
+  const uintptr_t end = ((uintptr_t)ptr + size) & ~(page_size - 1);
+  if (end <= start) return;
+
+  unsigned long mask[AFFINITY_MAX_NODES / (8 * sizeof(unsigned long)) + 1];
+  memset(mask, 0, sizeof(mask));
+  const int id = topology.ids[node];
+  mask[id / (8 * sizeof(unsigned long))] |= 1UL << (id % (8 * sizeof(unsigned long)));
+
+  syscall(SYS_mbind, start, end - start, AFFINITY_MPOL_PREFERRED,
+          mask, sizeof(mask) * 8, AFFINITY_MPOL_MF_MOVE);
+}
+
+#else // __linux__
+
+int uvg_affinity_num_nodes(void)
+{
+  return 1;
+}
+
+int uvg_affinity_pin_thread(pthread_t thread, enum uvg_thread_affinity mode, int index)
+{
+  return -1;
+}
+
+void uvg_affinity_bind_memory(void *ptr, size_t size, int node)
+{
+}
+
+#endif // __linux__
@@ -9,6 +9,7 @@
 #include <math.h>
 
 #include "cabac.h"
+#include "hugepages.h"
 #include "rdo.h"
 #include "strategies/strategies-alf.h"
 #include "uvg_math.h"
@@ -3161,12 +3162,12 @@ static void alf_create_frame_buffer(encoder_state_t * const state, alf_info_t *a
     const size_t simd_padding_width = 64;
     int width = state->tile->frame->width;
     int height = state->tile->frame->height;
-    int stride = state->tile->frame->source->stride;
+    int stride = state->tile->frame->rec->stride;
     unsigned int luma_size = (width + 8) * (height + 8);
     unsigned chroma_sizes[] = { 0, luma_size / 4, luma_size / 2, luma_size };
     unsigned chroma_size = chroma_sizes[chroma_format];
 
-    alf_info->alf_fulldata_buf = MALLOC_SIMD_PADDED(uvg_pixel, (luma_size + 2 * chroma_size), simd_padding_width * 2);
+    alf_info->alf_fulldata_buf = uvg_hugepage_alloc(sizeof(uvg_pixel) * (luma_size + 2 * chroma_size) + simd_padding_width * 2);
     alf_info->alf_fulldata = &alf_info->alf_fulldata_buf[4 * (width + 8) + 4] + simd_padding_width / sizeof(uvg_pixel);
     alf_info->alf_tmp_y = &alf_info->alf_fulldata[0];
 
@@ -3507,7 +3508,8 @@ void uvg_alf_destroy(videoframe_t * const frame)
   }
   if (alf_info->alf_fulldata_buf)
   {
-    FREE_POINTER(alf_info->alf_fulldata_buf);
+    uvg_hugepage_free(alf_info->alf_fulldata_buf);
+    alf_info->alf_fulldata_buf = NULL;
   }
 }
 
@@ -33,12 +33,21 @@
 #include "bitstream.h"
 
 #include <math.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "threads.h"
 #include "uvg_math.h"
 
+// Number of free chunks kept for each open encoder.
+#define BITSTREAM_CHUNK_POOL_PER_ENCODER 256
+
+// Number of chunks moved between the shared pool and a thread at a time.
+#define BITSTREAM_CHUNK_BATCH_MIN 8
+#define BITSTREAM_CHUNK_BATCH_MAX 256
+
 
 const uint32_t uvg_bit_set_mask[] =
 {
@@ -93,6 +102,151 @@ uvg_data_chunk * uvg_bitstream_take_chunks(bitstream_t *const stream)
   return chunks;
 }
 
+/**
+ * \brief Chunks shared by all bitstreams.
+ *
+ * Every frame is output as a list of chunks that the application frees
+ * after writing it, so freed chunks are kept on a free list and reused
+ * for the next frames. At most BITSTREAM_CHUNK_POOL_PER_ENCODER chunks
+ * are kept for each open encoder, and none when no encoder is open.
+ *
+ * Each thread keeps a cache of free chunks in front of the shared list so
+ * that the lock is taken once per batch instead of once per chunk.
+ */
+static struct {
+  pthread_mutex_t lock;
+  uvg_data_chunk *free_chunks;
+  int num_free;
+
+  /**
+   * \brief Number of open encoders
+   *
+   * Written with the lock held.
+   */
+  int32_t num_users;
+
+  pthread_key_t cache_key;
+  bool has_cache_key;
+} chunk_pool;
+
+static pthread_once_t chunk_pool_once = PTHREAD_ONCE_INIT;
+
+typedef struct {
+  uvg_data_chunk *free_chunks;
+  int num_free;
+
+  /**
+   * \brief Number of chunks taken from the shared list at a time
+   *
+   * Doubled every time the cache runs out, so threads writing a lot of
+   * data, such as intra frames at high bitrates, take the lock rarely.
+   */
+  int batch;
+} chunk_cache_t;
+
+static void chunk_list_free(uvg_data_chunk *chunk)
+{
+  while (chunk != NULL) {
+    uvg_data_chunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+}
+
+/**
+ * \brief Return a list of chunks to the shared free list.
+ *
+ * Chunks that do not fit are freed.
+ */
+static void chunk_pool_put(uvg_data_chunk *chunk)
+{
+  pthread_mutex_lock(&chunk_pool.lock);
+  const int max_free = chunk_pool.num_users * BITSTREAM_CHUNK_POOL_PER_ENCODER;
+  while (chunk != NULL && chunk_pool.num_free < max_free) {
+    uvg_data_chunk *next = chunk->next;
+    chunk->next = chunk_pool.free_chunks;
+    chunk_pool.free_chunks = chunk;
+    chunk_pool.num_free++;
+    chunk = next;
+  }
+  pthread_mutex_unlock(&chunk_pool.lock);
+
+  chunk_list_free(chunk);
+}
+
+/**
+ * \brief Take up to count chunks from the shared free list.
+ */
+static uvg_data_chunk * chunk_pool_take(int count, int *num_taken)
+{
+  pthread_mutex_lock(&chunk_pool.lock);
+  uvg_data_chunk *first = chunk_pool.free_chunks;
+  uvg_data_chunk *last = NULL;
+  int taken = 0;
+  for (uvg_data_chunk *chunk = first; chunk != NULL && taken < count; chunk = chunk->next) {
+    last = chunk;
+    taken++;
+  }
+  if (last) {
+    chunk_pool.free_chunks = last->next;
+    chunk_pool.num_free -= taken;
+    last->next = NULL;
+  } else {
+    first = NULL;
+  }
+  pthread_mutex_unlock(&chunk_pool.lock);
+
+  *num_taken = taken;
+  return first;
+}
+
+/**
+ * \brief Free the chunks of a thread cache.
+ */
+static void chunk_cache_clear(chunk_cache_t *cache)
+{
+  chunk_list_free(cache->free_chunks);
+  cache->free_chunks = NULL;
+  cache->num_free = 0;
+  cache->batch = BITSTREAM_CHUNK_BATCH_MIN;
+}
+
+static void chunk_cache_destroy(void *data)
+{
+  chunk_cache_t *cache = data;
+  chunk_pool_put(cache->free_chunks);
+  free(cache);
+}
+
+static void chunk_pool_init(void)
+{
+  pthread_mutex_init(&chunk_pool.lock, NULL);
+  chunk_pool.has_cache_key = !pthread_key_create(&chunk_pool.cache_key, chunk_cache_destroy);
+}
+
+/**
+ * \brief Get the chunk cache of the calling thread.
+ *
+ * \return the cache, or NULL if the shared list has to be used directly
+ */
+static chunk_cache_t * chunk_cache_get(void)
+{
+  pthread_once(&chunk_pool_once, chunk_pool_init);
+  if (!chunk_pool.has_cache_key) return NULL;
+
+  chunk_cache_t *cache = pthread_getspecific(chunk_pool.cache_key);
+  if (!cache) {
+    cache = calloc(1, sizeof(chunk_cache_t));
+    if (!cache) return NULL;
+    cache->batch = BITSTREAM_CHUNK_BATCH_MIN;
+    if (pthread_setspecific(chunk_pool.cache_key, cache)) {
+      free(cache);
+      return NULL;
+    }
+  }
+  return cache;
+}
+
 /**
  * \brief Allocates a new bitstream chunk.
  *
@@ -100,7 +254,24 @@ uvg_data_chunk * uvg_bitstream_take_chunks(bitstream_t *const stream)
  */
 uvg_data_chunk * uvg_bitstream_alloc_chunk()
 {
-    uvg_data_chunk *chunk = malloc(sizeof(uvg_data_chunk));
+    chunk_cache_t *cache = chunk_cache_get();
+    uvg_data_chunk *chunk = NULL;
+    if (cache) {
+      if (!cache->free_chunks) {
+        cache->free_chunks = chunk_pool_take(cache->batch, &cache->num_free);
+        cache->batch = MIN(cache->batch * 2, BITSTREAM_CHUNK_BATCH_MAX);
+      }
+      chunk = cache->free_chunks;
+      if (chunk) {
+        cache->free_chunks = chunk->next;
+        cache->num_free--;
+      }
+    } else {
+      int num_taken;
+      chunk = chunk_pool_take(1, &num_taken);
+    }
+
+    if (!chunk) chunk = malloc(sizeof(uvg_data_chunk));
     if (chunk) {
       chunk->len = 0;
       chunk->next = NULL;
@@ -110,14 +281,71 @@ uvg_data_chunk * uvg_bitstream_alloc_chunk()
 
 /**
  * \brief Free a list of chunks.
+ *
+ * While an encoder is open, the chunks are kept in the cache of the calling
+ * thread up to its batch size and the rest are returned to the shared free
+ * list.
  */
 void uvg_bitstream_free_chunks(uvg_data_chunk *chunk)
 {
-  while (chunk != NULL) {
-    uvg_data_chunk *next = chunk->next;
-    free(chunk);
-    chunk = next;
+  if (chunk == NULL) return;
+
+  chunk_cache_t *cache = chunk_cache_get();
+  if (cache && UVG_ATOMIC_LOAD(&chunk_pool.num_users) == 0) {
+    // No encoder is open, so nothing is kept for reuse.
+    chunk_cache_clear(cache);
+    cache = NULL;
   }
+  if (cache) {
+    while (chunk != NULL && cache->num_free < cache->batch) {
+      uvg_data_chunk *next = chunk->next;
+      chunk->next = cache->free_chunks;
+      cache->free_chunks = chunk;
+      cache->num_free++;
+      chunk = next;
+    }
+  }
+
+  if (chunk != NULL) chunk_pool_put(chunk);
+}
+
+/**
+ * \brief Keep freed chunks for reuse while the caller is open.
+ *
+ * Each call must be paired with uvg_bitstream_pool_release.
+ */
+void uvg_bitstream_pool_acquire(void)
+{
+  pthread_once(&chunk_pool_once, chunk_pool_init);
+  pthread_mutex_lock(&chunk_pool.lock);
+  chunk_pool.num_users++;
+  pthread_mutex_unlock(&chunk_pool.lock);
+}
+
+/**
+ * \brief Free the kept chunks when the last user has released the pool.
+ *
+ * The cache of the calling thread is freed as well. Other threads free
+ * their caches when they exit or when they next free chunks.
+ */
+void uvg_bitstream_pool_release(void)
+{
+  uvg_data_chunk *chunks = NULL;
+  pthread_mutex_lock(&chunk_pool.lock);
+  assert(chunk_pool.num_users > 0);
+  chunk_pool.num_users--;
+  const bool last = chunk_pool.num_users == 0;
+  if (last) {
+    chunks = chunk_pool.free_chunks;
+    chunk_pool.free_chunks = NULL;
+    chunk_pool.num_free = 0;
+  }
+  pthread_mutex_unlock(&chunk_pool.lock);
+
+  if (!last) return;
+  chunk_list_free(chunks);
+  chunk_cache_t *cache = chunk_pool.has_cache_key ? pthread_getspecific(chunk_pool.cache_key) : NULL;
+  if (cache) chunk_cache_clear(cache);
 }
 
 /**
@@ -217,6 +445,16 @@ void uvg_bitstream_put_byte(bitstream_t *const stream, const uint32_t data)
   assert(stream->cur_bit == 0);
   const uint8_t emulation_prevention_three_byte = 0x03;
 
+  uvg_data_chunk *const last = stream->last;
+  if (last != NULL && last->len < UVG_DATA_CHUNK_SIZE &&
+      (stream->zerocount < 2 || data >= 4)) {
+    // No emulation prevention and room in the chunk.
+    last->data[last->len++] = (uint8_t)data;
+    stream->len += 1;
+    stream->zerocount = data == 0 ? stream->zerocount + 1 : 0;
+    return;
+  }
+
   if ((stream->zerocount == 2) && (data < 4)) {
     uvg_bitstream_writebyte(stream, emulation_prevention_three_byte);
     stream->zerocount = 0;
@@ -225,28 +463,64 @@ void uvg_bitstream_put_byte(bitstream_t *const stream, const uint32_t data)
   uvg_bitstream_writebyte(stream, data);
 }
 
+/**
+ * \brief Write up to four bytes to a byte aligned bitstream
+ *
+ * Emulation prevention is only needed after two zero bytes, so bytes that
+ * contain no zeros are copied to the chunk at once.
+ *
+ * \param stream  stream the data is to be appended to
+ * \param bytes   bytes to write, the first byte in the most significant
+ *                byte of the lowest num_bytes bytes
+ * \param num_bytes  number of bytes to write
+ */
+static void put_bytes(bitstream_t *const stream, const uint32_t bytes, const int num_bytes)
+{
+  // Set the unused bytes so they are not counted as zeros.
+  const uint32_t word = num_bytes == 4 ? bytes : bytes | (0xffffffffu << (8 * num_bytes));
+  const bool has_zero = (word - 0x01010101u) & ~word & 0x80808080u;
+  const uint32_t first = bytes >> (8 * (num_bytes - 1));
+  uvg_data_chunk *const last = stream->last;
+
+  if (has_zero || (stream->zerocount == 2 && first < 4) ||
+      last == NULL || last->len + num_bytes > UVG_DATA_CHUNK_SIZE) {
+    for (int i = num_bytes - 1; i >= 0; i--) {
+      uvg_bitstream_put_byte(stream, (bytes >> (8 * i)) & 0xff);
+    }
+    return;
+  }
+
+  for (int i = 0; i < num_bytes; i++) {
+    last->data[last->len + i] = (uint8_t)(bytes >> (8 * (num_bytes - 1 - i)));
+  }
+  last->len += num_bytes;
+  stream->len += num_bytes;
+  stream->zerocount = 0;
+}
+
 /**
  * \brief Write bits to bitstream
- *        Buffers individual bits untill they make a full byte.
+ *        Buffers bits until they make full bytes.
  * \param stream  stream the data is to be appended to
  * \param data  input data
- * \param bits  number of bits to write from data to stream
+ * \param bits  number of bits to write from data to stream, at most 32
  */
 void uvg_bitstream_put(bitstream_t *const stream, const uint32_t data, uint8_t bits)
 {
-  while (bits--) {
-    stream->data <<= 1;
-
-    if (data & uvg_bit_set_mask[bits]) {
-      stream->data |= 1;
-    }
-    stream->cur_bit++;
-
-    // write byte to output
-    if (stream->cur_bit == 8) {
-      stream->cur_bit = 0;
-      uvg_bitstream_put_byte(stream, stream->data);
-    }
+  assert(bits <= 32);
+
+  const uint64_t mask = (UINT64_C(1) << bits) - 1;
+  stream->data = (stream->data << bits) | (data & mask);
+  stream->cur_bit += bits;
+
+  if (stream->cur_bit >= 8) {
+    // At most 39 bits are buffered, so there are at most four full bytes.
+    const int leftover = stream->cur_bit & 7;
+    const int num_bytes = stream->cur_bit >> 3;
+    stream->cur_bit = 0;
+    put_bytes(stream, (uint32_t)(stream->data >> leftover), num_bytes);
+    stream->data &= (1u << leftover) - 1;
+    stream->cur_bit = leftover;
   }
 }
 
@@ -57,12 +57,13 @@ typedef struct bitstream_t
   /// \brief Pointer to the last chunk, or NULL.
   uvg_data_chunk *last;
 
-  /// \brief The incomplete byte.
-  uint8_t data;
+  /// \brief Bits of the incomplete byte in the cur_bit lowest bits.
+  uint64_t data;
 
   /// \brief Number of bits in the incomplete byte.
   uint8_t cur_bit;
 
+  /// \brief Number of consecutive zero bytes at the end of the stream.
   uint8_t zerocount;
 
 } bitstream_t;
@@ -77,6 +78,8 @@ void uvg_bitstream_init(bitstream_t *const stream);
 uvg_data_chunk * uvg_bitstream_alloc_chunk();
 uvg_data_chunk * uvg_bitstream_take_chunks(bitstream_t *const stream);
 void uvg_bitstream_free_chunks(uvg_data_chunk * chunk);
+void uvg_bitstream_pool_acquire(void);
+void uvg_bitstream_pool_release(void);
 void uvg_bitstream_finalize(bitstream_t *const stream);
 
 uint64_t uvg_bitstream_tell(const bitstream_t *const stream);
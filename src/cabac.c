@@ -32,6 +32,9 @@
 
 #include "cabac.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "encoder.h"
 #include "encoderstate.h"
 #include "uvg266.h"
@@ -71,6 +74,166 @@ void uvg_cabac_start(cabac_data_t * const data)
   data->buffered_byte = 0xff;
   data->only_count = 0; // By default, write bits out
   data->update = 0; 
+  data->journal = NULL;
+}
+
+
+// Initial number of entries in a context journal.
+#define CABAC_JOURNAL_INITIAL_SIZE 4096
+
+cabac_journal_t * uvg_cabac_journal_alloc(void)
+{
+  cabac_journal_t *journal = calloc(1, sizeof(cabac_journal_t));
+  if (!journal) return NULL;
+
+  journal->entries = malloc(CABAC_JOURNAL_INITIAL_SIZE * sizeof(cabac_journal_entry_t));
+  if (!journal->entries) {
+    free(journal);
+    return NULL;
+  }
+  journal->capacity = CABAC_JOURNAL_INITIAL_SIZE;
+  return journal;
+}
+
+void uvg_cabac_journal_free(cabac_journal_t *journal)
+{
+  if (!journal) return;
+  free(journal->entries);
+  free(journal);
+}
+
+static INLINE void journal_push(cabac_journal_t *journal, uint16_t idx, const cabac_ctx_t *ctx)
+{
+  if (journal->size == journal->capacity) {
+    journal->capacity *= 2;
+    journal->entries = realloc(journal->entries, journal->capacity * sizeof(cabac_journal_entry_t));
+    assert(journal->entries);
+  }
+  cabac_journal_entry_t *entry = &journal->entries[journal->size++];
+  entry->idx = idx;
+  entry->state[0] = ctx->state[0];
+  entry->state[1] = ctx->state[1];
+}
+
+/**
+ * \brief Record the state of ctx before it is updated.
+ */
+static INLINE void journal_record(cabac_journal_t *journal, const struct cabac_contexts_t *contexts, const cabac_ctx_t *ctx)
+{
+  const uintptr_t offset = (uintptr_t)ctx - (uintptr_t)contexts;
+  // Contexts of another cabac_data_t can not be rolled back through this one.
+  if (offset >= sizeof(*contexts)) return;
+
+  journal_push(journal, (uint16_t)(offset / sizeof(cabac_ctx_t)), ctx);
+}
+
+/**
+ * \brief Record the state of ctx before it is updated outside of
+ * uvg_cabac_encode_bin.
+ */
+void uvg_cabac_journal_record(cabac_journal_t *journal, const struct cabac_contexts_t *contexts, const cabac_ctx_t *ctx)
+{
+  journal_record(journal, contexts, ctx);
+}
+
+static void set_coder_state(cabac_data_t * const data, const cabac_mark_t *mark)
+{
+  data->cur_ctx = mark->cur_ctx;
+  data->low = mark->low;
+  data->range = mark->range;
+  data->buffered_byte = mark->buffered_byte;
+  data->num_buffered_bytes = mark->num_buffered_bytes;
+  data->bits_left = mark->bits_left;
+  data->only_count = mark->only_count;
+  data->update = mark->update;
+}
+
+/**
+ * \brief Remember the current position of the journal.
+ */
+void uvg_cabac_journal_mark(const cabac_data_t * const data, cabac_mark_t *mark)
+{
+  mark->pos = data->journal->size;
+  mark->cur_ctx = data->cur_ctx;
+  mark->low = data->low;
+  mark->range = data->range;
+  mark->buffered_byte = data->buffered_byte;
+  mark->num_buffered_bytes = data->num_buffered_bytes;
+  mark->bits_left = data->bits_left;
+  mark->only_count = data->only_count;
+  mark->update = data->update;
+}
+
+/**
+ * \brief Undo all context updates made after the mark.
+ *
+ * Marks taken after this one become invalid.
+ */
+void uvg_cabac_journal_rollback(cabac_data_t * const data, const cabac_mark_t *mark)
+{
+  cabac_journal_t *journal = data->journal;
+  cabac_ctx_t *ctx = (cabac_ctx_t *)&data->ctx;
+  assert(mark->pos <= journal->size);
+
+  for (uint32_t i = journal->size; i > mark->pos; --i) {
+    const cabac_journal_entry_t *entry = &journal->entries[i - 1];
+    ctx[entry->idx].state[0] = entry->state[0];
+    ctx[entry->idx].state[1] = entry->state[1];
+  }
+  journal->size = mark->pos;
+  set_coder_state(data, mark);
+}
+
+/**
+ * \brief Store the contexts that have been updated after the base mark.
+ *
+ * The snapshot can be restored with uvg_cabac_journal_restore as long as
+ * the journal has not been rolled back past the base mark.
+ */
+void uvg_cabac_journal_save(cabac_data_t * const data, const cabac_mark_t *base, cabac_snapshot_t *snapshot)
+{
+  cabac_journal_t *journal = data->journal;
+  const cabac_ctx_t *ctx = (const cabac_ctx_t *)&data->ctx;
+  assert(base->pos <= journal->size);
+
+  if (++journal->stamp == 0) {
+    memset(journal->seen, 0, sizeof(journal->seen));
+    journal->stamp = 1;
+  }
+
+  uint32_t num_ctx = 0;
+  for (uint32_t i = base->pos; i < journal->size; ++i) {
+    const uint16_t idx = journal->entries[i].idx;
+    if (journal->seen[idx] == journal->stamp) continue;
+    journal->seen[idx] = journal->stamp;
+
+    snapshot->ctx[num_ctx].idx = idx;
+    snapshot->ctx[num_ctx].state[0] = ctx[idx].state[0];
+    snapshot->ctx[num_ctx].state[1] = ctx[idx].state[1];
+    num_ctx++;
+  }
+  snapshot->num_ctx = num_ctx;
+  uvg_cabac_journal_mark(data, &snapshot->coder);
+}
+
+/**
+ * \brief Return to the state stored in a snapshot taken relative to base.
+ *
+ * The restored contexts are recorded in the journal so that marks taken
+ * before base can still be rolled back to.
+ */
+void uvg_cabac_journal_restore(cabac_data_t * const data, const cabac_mark_t *base, const cabac_snapshot_t *snapshot)
+{
+  cabac_ctx_t *ctx = (cabac_ctx_t *)&data->ctx;
+
+  uvg_cabac_journal_rollback(data, base);
+  for (uint32_t i = 0; i < snapshot->num_ctx; ++i) {
+    const cabac_journal_entry_t *entry = &snapshot->ctx[i];
+    journal_push(data->journal, entry->idx, &ctx[entry->idx]);
+    ctx[entry->idx].state[0] = entry->state[0];
+    ctx[entry->idx].state[1] = entry->state[1];
+  }
+  set_coder_state(data, &snapshot->coder);
 }
 
 /**
@@ -103,6 +266,9 @@ void uvg_cabac_encode_bin(cabac_data_t * const data, const uint32_t bin_value)
       }
     }
   }
+  if (data->journal) {
+    journal_record(data->journal, &data->ctx, data->cur_ctx);
+  }
   CTX_UPDATE(data->cur_ctx, bin_value);
 }
 
@@ -310,6 +476,26 @@ void uvg_cabac_encode_bins_ep(cabac_data_t * const data, uint32_t bin_values, in
   }
 }
 
+/**
+ * \brief Lengths of the escape coded prefix and suffix of a remainder.
+ */
+static INLINE unsigned coeff_remain_escape_length(const unsigned code_value, const uint32_t rice_param,
+                                                  const unsigned int cutoff, unsigned *suffix_length)
+{
+  const unsigned max_prefix_length = 32 - cutoff - 15/*max_log2_tr_dynamic_range*/;
+  unsigned prefix_length = 0;
+  if ((int32_t)code_value >= ((1 << max_prefix_length) - 1)) {
+    prefix_length = max_prefix_length;
+    *suffix_length = 15 /*max_log2_tr_dynamic_range*/;
+  } else {
+    while ((int32_t)code_value > ((2 << prefix_length) - 2)) {
+      prefix_length++;
+    }
+    *suffix_length = prefix_length + rice_param + 1;
+  }
+  return prefix_length;
+}
+
 /**
  * \brief Coding of remainder abs coeff value.
  * \param remainder Value of remaining abs coeff
@@ -327,19 +513,9 @@ int uvg_cabac_write_coeff_remain(cabac_data_t * const cabac, const uint32_t rema
     bits += length;
     bits += rice_param;
   } else {
-    const unsigned max_prefix_length = 32 - cutoff - 15/*max_log2_tr_dynamic_range*/;
-    unsigned prefix_length = 0;
     unsigned code_value = (bins >> rice_param) - cutoff;
     unsigned suffix_length;
-    if ((int32_t)code_value >= ((1 << max_prefix_length) - 1)) {
-      prefix_length = max_prefix_length;
-      suffix_length = 15 /*max_log2_tr_dynamic_range*/;
-    } else {
-      while ((int32_t)code_value > ((2 << prefix_length) - 2)) {
-        prefix_length++;
-      }
-      suffix_length = prefix_length + rice_param + 1;
-    }
+    const unsigned prefix_length = coeff_remain_escape_length(code_value, rice_param, cutoff, &suffix_length);
     const unsigned total_prefix_length = prefix_length + cutoff;
     const unsigned bit_mask = (1 << rice_param) - 1;
     const unsigned prefix = (1 << total_prefix_length) - 1;
@@ -351,6 +527,20 @@ int uvg_cabac_write_coeff_remain(cabac_data_t * const cabac, const uint32_t rema
   return bits;
 }
 
+/**
+ * \brief Number of bins uvg_cabac_write_coeff_remain would write.
+ */
+uint32_t uvg_cabac_count_coeff_remain(const uint32_t remainder, const uint32_t rice_param, const unsigned int cutoff)
+{
+  const unsigned threshold = cutoff << rice_param;
+  if (remainder < threshold) {
+    return (remainder >> rice_param) + 1 + rice_param;
+  }
+  unsigned suffix_length;
+  const unsigned prefix_length = coeff_remain_escape_length((remainder >> rice_param) - cutoff, rice_param, cutoff, &suffix_length);
+  return prefix_length + cutoff + suffix_length;
+}
+
 
 /**
  * \brief
@@ -62,9 +62,11 @@ typedef struct
   int8_t     only_count : 4;
   int8_t     update : 4;
   bitstream_t *stream;
+  //! Context update journal, NULL if updates are not recorded.
+  struct cabac_journal_t *journal;
 
   // CONTEXTS
-  struct {
+  struct cabac_contexts_t {
     cabac_ctx_t alf_ctb_flag_model[9];
     cabac_ctx_t alf_latest_filt;
     cabac_ctx_t alf_temporal_filt;
@@ -130,6 +132,76 @@ typedef struct
   } ctx;
 } cabac_data_t;
 
+//! Number of context models in cabac_data_t.
+#define CABAC_NUM_CTX (sizeof(((cabac_data_t *)0)->ctx) / sizeof(cabac_ctx_t))
+
+typedef struct
+{
+  uint16_t idx;       //!< index of the context in cabac_data_t::ctx
+  uint16_t state[2];
+} cabac_journal_entry_t;
+
+/**
+ * \brief Undo log of context updates.
+ *
+ * Every context update made through a cabac_data_t with a journal records
+ * the previous state of the context. This allows taking snapshots of the
+ * search CABAC during CU search at the cost of the contexts that were
+ * actually touched instead of copying the whole cabac_data_t.
+ */
+typedef struct cabac_journal_t
+{
+  cabac_journal_entry_t *entries;
+  uint32_t size;
+  uint32_t capacity;
+
+  //! Used for finding the distinct contexts touched since a mark.
+  uint32_t stamp;
+  uint32_t seen[CABAC_NUM_CTX];
+} cabac_journal_t;
+
+/**
+ * \brief Position in the journal and the arithmetic coder state at that
+ * point.
+ */
+typedef struct
+{
+  uint32_t pos;
+  cabac_ctx_t *cur_ctx;
+  uint32_t low;
+  uint32_t range;
+  uint32_t buffered_byte;
+  int32_t  num_buffered_bytes;
+  int32_t  bits_left;
+  int8_t   only_count;
+  int8_t   update;
+} cabac_mark_t;
+
+/**
+ * \brief Contexts touched since a mark and their values when the snapshot
+ * was taken.
+ */
+typedef struct
+{
+  cabac_mark_t coder;
+  uint32_t num_ctx;
+  cabac_journal_entry_t ctx[CABAC_NUM_CTX];
+} cabac_snapshot_t;
+
+/**
+ * \brief Bin counter for rate estimation.
+ *
+ * Only refers to the contexts and the journal of a cabac_data_t, so the
+ * bits can be counted on the search CABAC without touching its arithmetic
+ * coder or taking a copy of it.
+ */
+typedef struct
+{
+  struct cabac_contexts_t *ctx;
+  //! Journal of the CABAC the contexts belong to, NULL if not recorded.
+  cabac_journal_t *journal;
+} cabac_estimator_t;
+
 
 // Globals
 extern const uint8_t uvg_g_auc_renorm_table[32];
@@ -146,6 +218,7 @@ void uvg_cabac_write(cabac_data_t *const data);
 void uvg_cabac_finish(cabac_data_t *const data);
 int uvg_cabac_write_coeff_remain(cabac_data_t *const cabac, const uint32_t symbol,
                               const uint32_t r_param, const unsigned int cutoff);
+uint32_t uvg_cabac_count_coeff_remain(const uint32_t symbol, const uint32_t r_param, const unsigned int cutoff);
 uint32_t uvg_cabac_write_ep_ex_golomb(struct encoder_state_t * const state, cabac_data_t *const data,
                 uint32_t symbol, uint32_t count);
 void uvg_cabac_write_unary_max_symbol(cabac_data_t *const data, cabac_ctx_t *const ctx,
@@ -153,6 +226,14 @@ void uvg_cabac_write_unary_max_symbol(cabac_data_t *const data, cabac_ctx_t *con
                                       const uint32_t max_symbol, double* bits_out);
 void uvg_cabac_write_unary_max_symbol_ep(cabac_data_t *const data, unsigned int symbol, const unsigned int max_symbol);
 
+cabac_journal_t * uvg_cabac_journal_alloc(void);
+void uvg_cabac_journal_free(cabac_journal_t *journal);
+void uvg_cabac_journal_mark(const cabac_data_t *const data, cabac_mark_t *mark);
+void uvg_cabac_journal_rollback(cabac_data_t *const data, const cabac_mark_t *mark);
+void uvg_cabac_journal_save(cabac_data_t *const data, const cabac_mark_t *base, cabac_snapshot_t *snapshot);
+void uvg_cabac_journal_restore(cabac_data_t *const data, const cabac_mark_t *base, const cabac_snapshot_t *snapshot);
+void uvg_cabac_journal_record(cabac_journal_t *journal, const struct cabac_contexts_t *contexts, const cabac_ctx_t *ctx);
+
 #define CTX_PROB_BITS 15
 #define CTX_PROB_BITS_0 10
 #define CTX_PROB_BITS_1 14
@@ -171,6 +252,17 @@ extern const float uvg_f_entropy_bits[512];
   } \
 } while(0)
 
+/**
+ * \brief Count the bits of a bin with a cabac_estimator_t and update its
+ * context.
+ */
+#define CABAC_COUNT_BIN(est, model, val, bits) do { \
+  cabac_ctx_t * const cabac_count_ctx = (model); \
+  (bits) += uvg_f_entropy_bits[(CTX_STATE(cabac_count_ctx)<<1) ^ (val)]; \
+  if((est)->journal) uvg_cabac_journal_record((est)->journal, (est)->ctx, cabac_count_ctx); \
+  CTX_UPDATE(cabac_count_ctx, (val)); \
+} while(0)
+
 // Macros
 #define CTX_GET_STATE(ctx) ( (ctx)->state[0]+(ctx)->state[1] )
 #define CTX_STATE(ctx) ( CTX_GET_STATE(ctx)>>8 )
@@ -246,6 +246,18 @@ int uvg_config_init(uvg_config *cfg)
 
   cfg->ref_wraparound = 0;
 
+  cfg->mtt_split_pruning = 0;
+
+  cfg->fastrd_online = 0;
+
+  cfg->split_jobs = 0;
+  cfg->ref_jobs = 0;
+  cfg->adaptive_owf = 0;
+  cfg->trace_file_name = NULL;
+  cfg->thread_spin = 0;
+  cfg->thread_affinity = UVG_THREAD_AFFINITY_NONE;
+  cfg->hugepages = 0;
+
   return 1;
 }
 
@@ -259,6 +271,7 @@ int uvg_config_destroy(uvg_config *cfg)
     FREE_POINTER(cfg->tiles_height_split);
     FREE_POINTER(cfg->slice_addresses_in_ts);
     FREE_POINTER(cfg->fastrd_learning_outdir_fn);
+    FREE_POINTER(cfg->trace_file_name);
   }
   free(cfg);
 
@@ -599,6 +612,8 @@ int uvg_config_parse(uvg_config *cfg, const char *name, const char *value)
 
   static const char * const file_format_names[] = {"auto", "y4m", "yuv", NULL};
 
+  static const char * const thread_affinity_names[] = { "none", "cores", "nodes", NULL };
+
   static const char * const preset_values[11][32*2] = {
       {
         "ultrafast",
@@ -1078,6 +1093,9 @@ int uvg_config_parse(uvg_config *cfg, const char *name, const char *value)
   else if OPT("fastrd-accuracy-check") {
     cfg->fastrd_accuracy_check_on = 1;
   }
+  else if OPT("fastrd-online") {
+    cfg->fastrd_online = atobool(value);
+  }
   else if OPT("fastrd-outdir") {
     char *fastrd_learning_outdir_fn = strdup(value);
     if (!fastrd_learning_outdir_fn) {
@@ -1346,8 +1364,10 @@ int uvg_config_parse(uvg_config *cfg, const char *name, const char *value)
     cfg->rdoq_skip = atobool(value);
   }
   else if OPT("input-format") {
-    static enum uvg_input_format const formats[] = { UVG_FORMAT_P400, UVG_FORMAT_P420 };
-    static const char * const format_names[] = { "P400", "P420", NULL };
+    static enum uvg_input_format const formats[] = {
+      UVG_FORMAT_P400, UVG_FORMAT_P420, UVG_FORMAT_NV12, UVG_FORMAT_NV21, UVG_FORMAT_P010
+    };
+    static const char * const format_names[] = { "P400", "P420", "NV12", "NV21", "P010", NULL };
 
     int8_t format = 0;
     if (!parse_enum(value, format_names, &format)) {
@@ -1364,8 +1384,8 @@ int uvg_config_parse(uvg_config *cfg, const char *name, const char *value)
       return 0;
     }
     if (cfg->input_bitdepth > 8 && UVG_BIT_DEPTH == 8) {
-      // Because the image is read straight into the reference buffers,
-      // reading >8 bit samples doesn't work when sizeof(uvg_pixel)==1.
+      // The chroma QP mapping is derived from input_bitdepth, so it must
+      // not be larger than the bit depth that is encoded.
       fprintf(stderr, "input-bitdepth can't be set to larger than 8 because"
                       " uvg266 is compiled with UVG_BIT_DEPTH=8.\n");
       return 0;
@@ -1580,6 +1600,48 @@ int uvg_config_parse(uvg_config *cfg, const char *name, const char *value)
   else if OPT("mtt-depth-inter") {
     cfg->max_btt_depth[1]  = atoi(value);
   }
+  else if OPT("mtt-split-pruning") {
+    cfg->mtt_split_pruning = atobool(value);
+  }
+  else if OPT("split-jobs") {
+    int split_jobs = atoi(value);
+    if (split_jobs < 0 || split_jobs > 3) {
+      fprintf(stderr, "split-jobs needs to be between 0 and 3\n");
+      return 0;
+    }
+    cfg->split_jobs = (uint8_t)split_jobs;
+  }
+  else if OPT("ref-jobs")
+    cfg->ref_jobs = atobool(value);
+  else if OPT("adaptive-owf")
+    cfg->adaptive_owf = atobool(value);
+  else if OPT("thread-spin") {
+    int thread_spin = atoi(value);
+    if (thread_spin < 0 || thread_spin > 1000000) {
+      fprintf(stderr, "thread-spin needs to be between 0 and 1000000\n");
+      return 0;
+    }
+    cfg->thread_spin = thread_spin;
+  }
+  else if OPT("thread-affinity") {
+    int8_t affinity = UVG_THREAD_AFFINITY_NONE;
+    if (!parse_enum(value, thread_affinity_names, &affinity)) {
+      fprintf(stderr, "Invalid thread-affinity. Valid values are none, cores and nodes.\n");
+      return 0;
+    }
+    cfg->thread_affinity = affinity;
+  }
+  else if OPT("hugepages")
+    cfg->hugepages = atobool(value);
+  else if OPT("trace-file") {
+    char *trace_file_name = strdup(value);
+    if (!trace_file_name) {
+      fprintf(stderr, "Failed to allocate memory for trace file name.\n");
+      return 0;
+    }
+    FREE_POINTER(cfg->trace_file_name);
+    cfg->trace_file_name = trace_file_name;
+  }
   else if OPT("max-bt-size") {
   uint8_t sizes[3];
   const int got = parse_array(value, sizes, 3, 0, 128);
@@ -1757,6 +1819,12 @@ int uvg_config_validate(const uvg_config *const cfg)
     error = 1;
   }
 
+  if ((cfg->input_format == UVG_FORMAT_NV12 || cfg->input_format == UVG_FORMAT_NV21) &&
+      cfg->input_bitdepth != 8) {
+    fprintf(stderr, "Input error: NV12 and NV21 input must have an input-bitdepth of 8\n");
+    error = 1;
+  }
+
   if (cfg->width % 2 != 0) {
     fprintf(stderr, "Input error: width must be a multiple of two\n");
     error = 1;
@@ -97,10 +97,19 @@ static const struct option long_options[] = {
   { "wpp",                      no_argument, NULL, 0 },
   { "no-wpp",                   no_argument, NULL, 0 },
   { "owf",                required_argument, NULL, 0 },
+  { "adaptive-owf",             no_argument, NULL, 0 },
+  { "no-adaptive-owf",          no_argument, NULL, 0 },
+  { "split-jobs",         required_argument, NULL, 0 },
+  { "ref-jobs",                 no_argument, NULL, 0 },
+  { "no-ref-jobs",              no_argument, NULL, 0 },
   { "slices",             required_argument, NULL, 0 },
   { "threads",            required_argument, NULL, 0 },
+  { "thread-spin",        required_argument, NULL, 0 },
+  { "thread-affinity",    required_argument, NULL, 0 },
   { "cpuid",              optional_argument, NULL, 0 },
   { "no-cpuid",                 no_argument, NULL, 0 },
+  { "hugepages",                no_argument, NULL, 0 },
+  { "no-hugepages",             no_argument, NULL, 0 },
   { "pu-depth-inter",     required_argument, NULL, 0 },
   { "pu-depth-intra",     required_argument, NULL, 0 },
   { "info",                     no_argument, NULL, 0 },
@@ -117,6 +126,7 @@ static const struct option long_options[] = {
   { "version",                  no_argument, NULL, 0 },
   { "help",                     no_argument, NULL, 0 },
   { "loop-input",               no_argument, NULL, 0 },
+  { "read-ahead",         required_argument, NULL, 0 },
   { "mv-constraint",      required_argument, NULL, 0 },
   { "hash",               required_argument, NULL, 0 },
   {"cu-split-termination",required_argument, NULL, 0 },
@@ -169,6 +179,8 @@ static const struct option long_options[] = {
   { "fastrd-sampling",          no_argument, NULL, 0 },
   { "fastrd-accuracy-check",    no_argument, NULL, 0 },
   { "fastrd-outdir",      required_argument, NULL, 0 },
+  { "fastrd-online",            no_argument, NULL, 0 },
+  { "no-fastrd-online",         no_argument, NULL, 0 },
   { "chroma-qp-in",       required_argument, NULL, 0 },
   { "chroma-qp-out",      required_argument, NULL, 0 },
   { "mrl",                      no_argument, NULL, 0 },
@@ -192,9 +204,12 @@ static const struct option long_options[] = {
   { "dual-tree",                no_argument, NULL, 0 },
   { "no-dual-tree",             no_argument, NULL, 0 },
   { "cabac-debug-file",   required_argument, NULL, 0 },
+  { "trace-file",         required_argument, NULL, 0 },
   { "mtt-depth-intra",    required_argument, NULL, 0 },
   { "mtt-depth-inter",    required_argument, NULL, 0 },
   { "mtt-depth-intra-chroma", required_argument, NULL, 0 },
+  { "mtt-split-pruning",        no_argument, NULL, 0 },
+  { "no-mtt-split-pruning",     no_argument, NULL, 0 },
   { "max-bt-size",        required_argument, NULL, 0 },
   { "max-tt-size",        required_argument, NULL, 0 },
   { "intra-rough-granularity",required_argument, NULL, 0 },
@@ -279,6 +294,8 @@ cmdline_opts_t* cmdline_opts_parse(const uvg_api *const api, int argc, char *arg
     goto done;
   }
 
+  opts->read_ahead = 2;
+
   opts->config = api->config_alloc();
   if (!opts->config || !api->config_init(opts->config)) {
     ok = 0;
@@ -341,6 +358,13 @@ cmdline_opts_t* cmdline_opts_parse(const uvg_api *const api, int argc, char *arg
       goto done;
     } else if (!strcmp(name, "loop-input")) {
       opts->loop_input = true;
+    } else if (!strcmp(name, "read-ahead")) {
+      opts->read_ahead = atoi(optarg);
+      if (opts->read_ahead < 1) {
+        fprintf(stderr, "Input error: read-ahead must be at least 1.\n");
+        ok = 0;
+        goto done;
+      }
     } else if (!api->config_parse(opts->config, name, optarg)) {
       fprintf(stderr, "invalid argument: %s=%s\n", name, optarg);
       ok = 0;
@@ -452,9 +476,14 @@ void print_help(void)
     "                                   - progressive: Progressive scan\n"
     "                                   - tff: Top field first\n"
     "                                   - bff: Bottom field first\n"
-    "      --input-format <string> : P420 or P400 [P420]\n"
+    "      --input-format <string> : Input pixel format [P420]\n"
+    "                                   - P420, P400: Planar\n"
+    "                                   - NV12, NV21: Interleaved chroma\n"
+    "                                   - P010: NV12 with 16-bit samples,\n"
+    "                                     input-bitdepth MSBs used\n"
     "      --input-bitdepth <int> : 8-16 [8]\n"
     "      --loop-input           : Re-read input file forever.\n"
+    "      --read-ahead <integer> : Frames to read ahead of the encoder [2]\n"
     "      --input-file-format <string> : Input file format [auto]\n"
     "                                    - auto: Check the file ending for format\n"
     "                                    - y4m (skips frame headers)\n"
@@ -467,6 +496,11 @@ void print_help(void)
     "      --(no-)aud             : Use access unit delimiters. [disabled]\n"
     "      --debug <filename>     : Output internal reconstruction.\n"
     "      --(no-)cpuid           : Enable runtime CPU optimizations. [enabled]\n"
+    "      --(no-)hugepages       : Back frame sized buffers with 2 MB pages.\n"
+    "                               Uses reserved huge pages if available and\n"
+    "                               transparent huge pages otherwise. Reduces\n"
+    "                               TLB misses in motion search. Only\n"
+    "                               supported on Linux. [disabled]\n"
     "      --hash <string>        : Decoded picture hash [checksum]\n"
     "                                   - none: 0 bytes\n"
     "                                   - checksum: 18 bytes\n"
@@ -479,6 +513,10 @@ void print_help(void)
     "                               written unless the prefix is defined.\n"
     "      --cabac-debug-file     : A debug file for cabac context.\n"
     "                               Ignore this, it is only for tests.\n"
+    "      --trace-file <file>    : Write the start and end times of the\n"
+    "                               threadqueue jobs to a file as a Chrome\n"
+    "                               trace. Open it in Perfetto or\n"
+    "                               chrome://tracing.\n"
     "\n"
     /* Word wrap to this width to stay under 80 characters (including ") *************/
     "Video structure:\n"
@@ -634,6 +672,9 @@ void print_help(void)
     "      --mtt-depth-inter      : Depth of mtt for inter slices 0..3.[0]\n"
     "                              All MTTs are currently experimental and\n"
     "                              require disabling some avx2 optimizations.\n"
+    "      --(no-)mtt-split-pruning : Skip MTT split directions that the\n"
+    "                                 gradients and sub-block variances of\n"
+    "                                 the source block rule out. [disabled]\n"
     "      --max-bt-size          : maximum size for a CU resulting from\n"
     "                                   a bt split. A singular value shared for all\n"
     "                                   or a list of three values for the different\n"
@@ -681,6 +722,9 @@ void print_help(void)
     "      --fastrd-outdir : Directory to which to output sampled data or accuracy\n"
     "                        data, into <fastrd-outdir>/0.txt to 50.txt, one file\n"
     "                        for each QP that blocks were estimated on\n"
+    "      --(no-)fastrd-online : Refit the fast coefficient weights during\n"
+    "                             encoding against sampled CABAC costs.\n"
+    "                             Used with --fast-residual-cost. [disabled]\n"
     "      --(no-)intra-rdo-et    : Check intra modes in rdo stage only until\n"
     "                               a zero coefficient CU is found. [disabled]\n"
     "      --(no-)early-skip      : Try to find skip cu from merge candidates.\n"
@@ -726,9 +770,32 @@ void print_help(void)
     "                                   - 0: Process everything with main thread.\n"
     "                                   - N: Use N threads for encoding.\n"
     "                                   - auto: Select automatically.\n"
+    "      --thread-spin <int>    : Number of times an idle worker thread\n"
+    "                               checks for new jobs before it sleeps.\n"
+    "                               Lowers the latency of short jobs but keeps\n"
+    "                               the CPU busy. Adapted at runtime to how\n"
+    "                               often spinning finds a job. [0]\n"
+    "      --thread-affinity <string> : Pin the worker threads [none]\n"
+    "                                   - none: Let the OS place the threads.\n"
+    "                                   - cores: Pin each worker to one CPU.\n"
+    "                                   - nodes: Pin each worker to the CPUs of\n"
+    "                                     a NUMA node.\n"
+    "                               With several nodes, the jobs and the\n"
+    "                               reconstruction of each frame are kept on\n"
+    "                               one node. Only supported on Linux.\n"
     "      --owf <integer>        : Frame-level parallelism [auto]\n"
     "                                   - N: Process N+1 frames at a time.\n"
     "                                   - auto: Select automatically.\n"
+    "      --(no-)adaptive-owf    : Adapt the number of frames encoded at the\n"
+    "                               same time between 1 and OWF+1 to the idle\n"
+    "                               time of the worker threads. Does not change\n"
+    "                               the bitstream. [disabled]\n"
+    "      --split-jobs <integer> : Search the split types of the CUs on the\n"
+    "                               top N depths of a CTU in separate jobs.\n"
+    "                               Does not change the bitstream. Not used\n"
+    "                               with CCLM, IBC or --fastrd-online. [0]\n"
+    "      --(no-)ref-jobs        : Search the reference pictures of PUs of\n"
+    "                               at least 16x16 in separate jobs. [disabled]\n"
     "      --(no-)wpp             : Wavefront parallel processing. [enabled]\n"
     "                               Enabling tiles automatically disables WPP.\n"
     "                               To enable WPP with tiles, re-enable it after\n"
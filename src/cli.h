@@ -59,6 +59,8 @@ typedef struct cmdline_opts_t {
   bool version;
   /** \brief Whether to loop input */
   bool loop_input;
+  /** \brief Number of input frames read ahead of the encoder */
+  int32_t read_ahead;
 } cmdline_opts_t;
 
 cmdline_opts_t* cmdline_opts_parse(const uvg_api *const api, int argc, char *argv[]);
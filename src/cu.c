@@ -37,6 +37,7 @@
 
 #include "alf.h"
 #include "encoderstate.h"
+#include "hugepages.h"
 #include "threads.h"
 
 
@@ -161,7 +162,7 @@ cu_array_t * uvg_cu_array_alloc(const int width, const int height)
   const unsigned cu_array_size = width_scu * height_scu;
 
   cua->base     = NULL;
-  cua->data     = calloc(cu_array_size, sizeof(cu_info_t));
+  cua->data     = uvg_hugepage_calloc(cu_array_size * sizeof(cu_info_t));
   cua->width    = width_scu  * SCU_WIDTH;
   cua->height   = height_scu * SCU_WIDTH;
   cua->stride   = cua->width;
@@ -181,7 +182,7 @@ cu_array_t * uvg_cu_array_chroma_alloc(const int width, const int height, enum u
   const unsigned cu_array_size = width_scu * height_scu;
 
   cua->base     = NULL;
-  cua->data     = calloc(cu_array_size, sizeof(cu_info_t));
+  cua->data     = uvg_hugepage_calloc(cu_array_size * sizeof(cu_info_t));
   cua->width    = width_scu  * SCU_WIDTH;
   cua->height   = height_scu * SCU_WIDTH;
   cua->stride   = cua->width;
@@ -241,7 +242,8 @@ void uvg_cu_array_free(cu_array_t **cua_ptr)
   assert(new_refcount == 0);
 
   if (!cua->base) {
-    FREE_POINTER(cua->data);
+    uvg_hugepage_free(cua->data);
+    cua->data = NULL;
   } else {
     uvg_cu_array_free(&cua->base);
     cua->data = NULL;
@@ -53,6 +53,12 @@
 #include <string.h>
 #include <time.h> // IWYU pragma: keep for CLOCKS_PER_SEC
 
+#ifndef _WIN32
+#include <errno.h>
+#include <sys/uio.h> // writev
+#include <unistd.h>
+#endif
+
 #include "checkpoint.h"
 #include "cli.h"
 #include "debug.h"
@@ -154,6 +160,11 @@ static void compute_psnr(const uvg_picture *const src,
   }
 }
 
+typedef struct {
+  uvg_picture *img_in;
+  int retval;
+} input_slot_t;
+
 typedef struct {
   // Semaphores for synchronization.
   uvg_sem_t* available_input_slots;
@@ -161,21 +172,106 @@ typedef struct {
 
   // Parameters passed from main thread to input thread.
   FILE* input;
+  yuv_io_map_t *map;
   const uvg_api *api;
   const cmdline_opts_t *opts;
   const encoder_control_t *encoder;
+  uvg_encoder *enc;
   const uint8_t padding_x;
   const uint8_t padding_y;
+  uvg_picture_pool *picture_pool;
 
-  // Picture and thread status passed from input thread to main thread.
-  uvg_picture *img_in;
+  // Ring of pictures and thread status passed from input thread to main
+  // thread. The input thread fills the slots in order and the main thread
+  // takes them in the same order.
+  input_slot_t *slots;
+  int num_slots;
+
+  // Status of the last slot taken by the main thread.
   int retval;
+
+  // Set by main thread to stop reading.
+  volatile bool stop;
 } input_handler_args;
 
 #define RETVAL_RUNNING 0
 #define RETVAL_FAILURE 1
 #define RETVAL_EOF 2
 
+/**
+* \brief Load a frame of raw input data to a picture
+*
+* \return 1 on success, 0 on failure
+*/
+static int load_input_frame(input_handler_args *args, uvg_picture *frame_in,
+                            const uint8_t *data)
+{
+  const uvg_config *const cfg = args->opts->config;
+  const int32_t in_bitdepth = args->encoder->cfg.input_bitdepth;
+
+  if (UVG_FORMAT_IS_SEMIPLANAR(cfg->input_format)) {
+    const int32_t stride = cfg->width * (cfg->input_format == UVG_FORMAT_P010 ? 2 : 1);
+    return args->api->picture_load_semiplanar(args->enc, frame_in,
+                                              data, stride,
+                                              data + stride * cfg->height, stride,
+                                              cfg->width, cfg->height);
+  }
+
+  const int32_t stride = cfg->width * (in_bitdepth > 8 ? 2 : 1);
+  const uint8_t *u = NULL;
+  const uint8_t *v = NULL;
+  if (cfg->input_format != UVG_FORMAT_P400) {
+    u = data + stride * cfg->height;
+    v = u + stride / 2 * cfg->height / 2;
+  }
+  return args->api->picture_load_planar(args->enc, frame_in,
+                                        data, u, v, stride, stride / 2,
+                                        cfg->width, cfg->height);
+}
+
+
+/**
+* \brief Read a frame to a picture in the input format of the encoder
+*
+* Mapped frames are loaded straight from the mapping. Other frames that
+* need conversion are read to frame_buf and converted by the encoder.
+*
+* \return 1 on success, 0 on failure
+*/
+static int read_input_frame(input_handler_args *args, uvg_picture *frame_in,
+                            uint8_t *frame_buf)
+{
+  const uvg_config *const cfg = args->opts->config;
+  const int32_t in_bitdepth = args->encoder->cfg.input_bitdepth;
+
+  if (args->map) {
+    const uint8_t *data = yuv_io_map_frame(args->map);
+    return data && load_input_frame(args, frame_in, data);
+  }
+
+  if (!frame_buf) {
+    return yuv_io_read(args->input,
+                       cfg->width,
+                       cfg->height,
+                       in_bitdepth,
+                       args->encoder->bitdepth,
+                       frame_in, cfg->file_format);
+  }
+
+  if (!yuv_io_read_raw(args->input, cfg->width, cfg->height, in_bitdepth,
+                       cfg->input_format, frame_buf, cfg->file_format)) {
+    return 0;
+  }
+  return load_input_frame(args, frame_in, frame_buf);
+}
+
+
+static bool input_at_end(const input_handler_args *args)
+{
+  return args->map ? yuv_io_map_eof(args->map) : feof(args->input);
+}
+
+
 /**
 * \brief Handles input reading in a thread
 *
@@ -193,24 +289,40 @@ static void* input_read_thread(void* in_args)
 
   input_handler_args* args = (input_handler_args*)in_args;
   uvg_picture *frame_in = NULL;
+  uint8_t *frame_buf = NULL;
   int retval = RETVAL_RUNNING;
   int frames_read = 0;
+  int slot = 0;
+
+  if (!args->map && yuv_io_needs_conversion(args->encoder->cfg.input_bitdepth,
+                              args->encoder->bitdepth,
+                              args->opts->config->input_format)) {
+    frame_buf = malloc(yuv_io_frame_bytes(args->opts->config->width,
+                                          args->opts->config->height,
+                                          args->opts->config->input_bitdepth,
+                                          args->opts->config->input_format));
+    if (!frame_buf) {
+      fprintf(stderr, "Failed to allocate input buffer.\n");
+      retval = RETVAL_FAILURE;
+      goto done;
+    }
+  }
 
   for (;;) {
     // Each iteration of this loop puts either a single frame or a field into
-    // args->img_in for main thread to process.
+    // the next slot for main thread to process.
 
     bool input_empty = !(args->opts->frames == 0 // number of frames to read is unknown
                          || frames_read < args->opts->frames); // not all frames have been read
-    if (feof(args->input) || input_empty) {
+    if (input_at_end(args) || input_empty || args->stop) {
       retval = RETVAL_EOF;
       goto done;
     }
 
     enum uvg_chroma_format csp = UVG_FORMAT2CSP(args->opts->config->input_format);
-    frame_in = args->api->picture_alloc_csp(csp,
-                                            args->opts->config->width  + args->padding_x,
-                                            args->opts->config->height + args->padding_y);
+    frame_in = args->api->picture_pool_get(args->picture_pool, csp,
+                                           args->opts->config->width  + args->padding_x,
+                                           args->opts->config->height + args->padding_y);
 
     if (!frame_in) {
       fprintf(stderr, "Failed to allocate image.\n");
@@ -221,17 +333,19 @@ static void* input_read_thread(void* in_args)
     // Set PTS to make sure we pass it on correctly.
     frame_in->pts = frames_read;
 
-    bool read_success = yuv_io_read(args->input,
-                                    args->opts->config->width,
-                                    args->opts->config->height,
-                                    args->encoder->cfg.input_bitdepth,
-                                    args->encoder->bitdepth,
-                                    frame_in, args->opts->config->file_format);
+    bool read_success = read_input_frame(args, frame_in, frame_buf);
     if (!read_success) {
       // reading failed
-      if (feof(args->input)) {
+      if (input_at_end(args)) {
         // When looping input, re-open the file and re-read data.
-        if (args->opts->loop_input && args->input != stdin) {
+        if (args->opts->loop_input && args->map) {
+          yuv_io_map_rewind(args->map);
+          if (!read_input_frame(args, frame_in, frame_buf)) {
+            fprintf(stderr, "Could not re-read input file, shutting down!\n");
+            retval = RETVAL_FAILURE;
+            goto done;
+          }
+        } else if (args->opts->loop_input && args->input != stdin) {
           fclose(args->input);
           args->input = fopen(args->opts->input, "rb");
           if (args->input == NULL)
@@ -240,12 +354,7 @@ static void* input_read_thread(void* in_args)
             retval = RETVAL_FAILURE;
             goto done;
           }
-          bool read_success = yuv_io_read(args->input,
-                                          args->opts->config->width,
-                                          args->opts->config->height,
-                                          args->encoder->cfg.input_bitdepth,
-                                          args->encoder->bitdepth,
-                                          frame_in, args->opts->config->file_format);
+          bool read_success = read_input_frame(args, frame_in, frame_buf);
           if (!read_success) {
             fprintf(stderr, "Could not re-open input file, shutting down!\n");
             retval = RETVAL_FAILURE;
@@ -269,28 +378,30 @@ static void* input_read_thread(void* in_args)
       frame_in->interlacing = args->encoder->cfg.source_scan_type;
     }
 
-    // Wait until main thread is ready to receive the next frame.
+    // Wait until there is a free slot in the ring.
     uvg_sem_wait(args->available_input_slots);
-    args->img_in = frame_in;
-    args->retval = retval;
-    // Unlock main_thread_mutex to notify main thread that the new img_in
-    // and retval have been placed to args.
+    args->slots[slot].img_in = frame_in;
+    args->slots[slot].retval = retval;
+    slot = (slot + 1) % args->num_slots;
+    // Notify main thread that the new img_in and retval have been placed
+    // to the slot.
     uvg_sem_post(args->filled_input_slots);
 
     frame_in = NULL;
   }
 
 done:
-  // Wait until main thread is ready to receive the next frame.
+  // Wait until there is a free slot in the ring.
   uvg_sem_wait(args->available_input_slots);
-  args->img_in = NULL;
-  args->retval = retval;
-  // Unlock main_thread_mutex to notify main thread that the new img_in
-  // and retval have been placed to args.
+  args->slots[slot].img_in = NULL;
+  args->slots[slot].retval = retval;
+  // Notify main thread that the new img_in and retval have been placed
+  // to the slot.
   uvg_sem_post(args->filled_input_slots);
 
   // Do some cleaning up.
   args->api->picture_free(frame_in);
+  free(frame_buf);
 
   // This thread exit call causes problems with media auto-build suite
   // The environment compiles with MINGW using a different pthreads lib
@@ -301,6 +412,218 @@ done:
 }
 
 
+/**
+* \brief Stop the input thread after a failure in the main thread
+*
+* Pictures the thread has already read are freed.
+*
+* \param args       arguments of the input thread
+* \param thread     the input thread
+* \param next_slot  slot the main thread would take next
+*/
+static void input_thread_stop(input_handler_args *args, pthread_t thread,
+                              int next_slot)
+{
+  args->stop = true;
+  while (args->retval == RETVAL_RUNNING) {
+    uvg_sem_wait(args->filled_input_slots);
+    args->api->picture_free(args->slots[next_slot].img_in);
+    args->slots[next_slot].img_in = NULL;
+    args->retval = args->slots[next_slot].retval;
+    next_slot = (next_slot + 1) % args->num_slots;
+    uvg_sem_post(args->available_input_slots);
+  }
+  pthread_join(thread, NULL);
+}
+
+
+/**
+ * \brief Writes the output bitstream in a thread
+ *
+ * The main thread queues the chunks of each frame and the writer thread
+ * writes everything queued so far with as few system calls as possible,
+ * so encoding does not wait for slow disks or pipes.
+ */
+typedef struct {
+  FILE *output;
+  const uvg_api *api;
+
+  pthread_mutex_t lock;
+  // Signalled when chunks are queued or written, or when finishing.
+  pthread_cond_t cond;
+
+  // Chunks waiting to be written. The chunk lists of the frames are
+  // linked together.
+  uvg_data_chunk *first;
+  uvg_data_chunk *last;
+  uint64_t queued_bytes;
+
+  bool finished;
+  bool failed;
+  pthread_t thread;
+} output_writer_t;
+
+// The main thread waits if this many bytes are waiting to be written.
+#define OUTPUT_QUEUE_MAX_BYTES (64 << 20)
+
+// Maximum number of chunks written with a single system call.
+#define OUTPUT_WRITE_BATCH 256
+
+
+/**
+ * \brief Write a list of chunks to a file
+ *
+ * \return true on success, false on failure
+ */
+static bool write_chunks(FILE *output, const uvg_data_chunk *chunk)
+{
+#ifdef _WIN32
+  for (; chunk != NULL; chunk = chunk->next) {
+    if (fwrite(chunk->data, sizeof(uint8_t), chunk->len, output) != chunk->len) {
+      return false;
+    }
+  }
+  return !fflush(output);
+#else
+  const int fd = fileno(output);
+  struct iovec iov[OUTPUT_WRITE_BATCH];
+
+  while (chunk != NULL) {
+    int count = 0;
+    for (; chunk != NULL && count < OUTPUT_WRITE_BATCH; chunk = chunk->next) {
+      if (chunk->len == 0) continue;
+      iov[count].iov_base = (void*)chunk->data;
+      iov[count].iov_len = chunk->len;
+      count++;
+    }
+
+    struct iovec *vec = iov;
+    while (count > 0) {
+      ssize_t written = writev(fd, vec, count);
+      if (written < 0) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+      // Skip the fully written chunks and continue from the first one
+      // that was written partially.
+      while (count > 0 && (size_t)written >= vec->iov_len) {
+        written -= vec->iov_len;
+        vec++;
+        count--;
+      }
+      if (count > 0) {
+        vec->iov_base = (uint8_t*)vec->iov_base + written;
+        vec->iov_len -= written;
+      }
+    }
+  }
+  return true;
+#endif
+}
+
+
+static void* output_write_thread(void *arg)
+{
+  output_writer_t *writer = (output_writer_t*)arg;
+
+  pthread_mutex_lock(&writer->lock);
+  for (;;) {
+    while (!writer->first && !writer->finished) {
+      pthread_cond_wait(&writer->cond, &writer->lock);
+    }
+    if (!writer->first) break;
+
+    // Take everything queued so far.
+    uvg_data_chunk *chunks = writer->first;
+    writer->first = NULL;
+    writer->last = NULL;
+    writer->queued_bytes = 0;
+    pthread_cond_signal(&writer->cond);
+    const bool failed = writer->failed;
+    pthread_mutex_unlock(&writer->lock);
+
+    const bool success = failed || write_chunks(writer->output, chunks);
+    // Written chunks go back to the chunk pool of the encoder.
+    writer->api->chunk_free(chunks);
+
+    pthread_mutex_lock(&writer->lock);
+    if (!success) writer->failed = true;
+  }
+  pthread_mutex_unlock(&writer->lock);
+
+  return NULL;
+}
+
+
+static bool output_writer_start(output_writer_t *writer, FILE *output,
+                                const uvg_api *api)
+{
+  memset(writer, 0, sizeof(output_writer_t));
+  writer->output = output;
+  writer->api = api;
+  pthread_mutex_init(&writer->lock, NULL);
+  pthread_cond_init(&writer->cond, NULL);
+  if (pthread_create(&writer->thread, NULL, output_write_thread, writer) != 0) {
+    pthread_cond_destroy(&writer->cond);
+    pthread_mutex_destroy(&writer->lock);
+    return false;
+  }
+  return true;
+}
+
+
+/**
+ * \brief Queue the chunks of a frame for writing
+ *
+ * Takes ownership of the chunks.
+ *
+ * \return false if writing has failed
+ */
+static bool output_writer_push(output_writer_t *writer, uvg_data_chunk *chunks,
+                               uint64_t len)
+{
+  uvg_data_chunk *last = chunks;
+  while (last->next) last = last->next;
+
+  pthread_mutex_lock(&writer->lock);
+  while (writer->queued_bytes > OUTPUT_QUEUE_MAX_BYTES && !writer->failed) {
+    pthread_cond_wait(&writer->cond, &writer->lock);
+  }
+  if (writer->last) {
+    writer->last->next = chunks;
+  } else {
+    writer->first = chunks;
+  }
+  writer->last = last;
+  writer->queued_bytes += len;
+  const bool failed = writer->failed;
+  pthread_cond_signal(&writer->cond);
+  pthread_mutex_unlock(&writer->lock);
+
+  return !failed;
+}
+
+
+/**
+ * \brief Write the remaining chunks and stop the writer thread
+ *
+ * \return false if writing has failed
+ */
+static bool output_writer_finish(output_writer_t *writer)
+{
+  pthread_mutex_lock(&writer->lock);
+  writer->finished = true;
+  pthread_cond_signal(&writer->cond);
+  pthread_mutex_unlock(&writer->lock);
+
+  pthread_join(writer->thread, NULL);
+  pthread_cond_destroy(&writer->cond);
+  pthread_mutex_destroy(&writer->lock);
+
+  return !writer->failed;
+}
+
+
 void output_recon_pictures(const uvg_api *const api,
                            FILE *recout,
                            uvg_picture *buffer[UVG_MAX_GOP_LENGTH],
@@ -455,15 +778,22 @@ int main(int argc, char *argv[])
   // Semaphores for synchronizing the input reader thread and the main
   // thread.
   //
-  // available_input_slots tells whether the main thread is currently using
-  // input_handler_args.img_in. (0 = in use, 1 = not in use)
+  // available_input_slots counts the slots of input_handler_args.slots
+  // that the input reader thread can fill.
   //
-  // filled_input_slots tells whether there is a new input picture (or NULL
-  // if the input has ended) in input_handler_args.img_in placed by the
-  // input reader thread. (0 = no new image, 1 = one new image)
+  // filled_input_slots counts the slots holding a new input picture (or
+  // NULL if the input has ended) placed by the input reader thread.
   //
   uvg_sem_t *available_input_slots = NULL;
   uvg_sem_t *filled_input_slots = NULL;
+  input_slot_t *input_slots = NULL;
+  // Regular input files are read through a memory mapping.
+  yuv_io_map_t *input_map = NULL;
+  // Bitstream is written by a separate thread.
+  output_writer_t output_writer;
+  bool output_writer_running = false;
+  // Input pictures are returned here when the encoder is done with them.
+  uvg_picture_pool *picture_pool = NULL;
 
 #ifdef _WIN32
   // Stderr needs to be text mode to convert \n to \r\n in Windows.
@@ -543,9 +873,21 @@ int main(int argc, char *argv[])
          encoder->in.width, encoder->in.height,
          encoder->in.real_width, encoder->in.real_height);
 
-  if (opts->seek > 0 && !yuv_io_seek(input, opts->seek, opts->config->width, opts->config->height, opts->config->input_bitdepth, opts->config->file_format)) {
-    fprintf(stderr, "Failed to seek %d frames.\n", opts->seek);
-    goto exit_failure;
+  input_map = yuv_io_map_open(input,
+                              yuv_io_frame_bytes(opts->config->width,
+                                                 opts->config->height,
+                                                 opts->config->input_bitdepth,
+                                                 opts->config->input_format),
+                              opts->config->file_format);
+
+  if (opts->seek > 0) {
+    const int seek_ok = input_map
+      ? yuv_io_map_seek(input_map, opts->seek)
+      : yuv_io_seek(input, opts->seek, opts->config->width, opts->config->height, opts->config->input_bitdepth, opts->config->input_format, opts->config->file_format);
+    if (!seek_ok) {
+      fprintf(stderr, "Failed to seek %d frames.\n", opts->seek);
+      goto exit_failure;
+    }
   }
 
 #ifdef UVG_DEBUG_PRINT_YUVIEW_CSV
@@ -576,52 +918,79 @@ int main(int argc, char *argv[])
 
     available_input_slots = calloc(1, sizeof(uvg_sem_t));
     filled_input_slots    = calloc(1, sizeof(uvg_sem_t));
-    uvg_sem_init(available_input_slots, 0);
+    uvg_sem_init(available_input_slots, opts->read_ahead);
     uvg_sem_init(filled_input_slots,    0);
 
+    input_slots = calloc(opts->read_ahead, sizeof(input_slot_t));
+    if (!input_slots) {
+      fprintf(stderr, "Failed to allocate input slots.\n");
+      goto exit_failure;
+    }
+
+    picture_pool = api->picture_pool_alloc();
+    if (!picture_pool) {
+      fprintf(stderr, "Failed to allocate picture pool.\n");
+      goto exit_failure;
+    }
+
     // Give arguments via struct to the input thread
     input_handler_args in_args = {
       .available_input_slots = available_input_slots,
       .filled_input_slots = filled_input_slots,
 
       .input = input,
+      .map = input_map,
       .api = api,
       .opts = opts,
       .encoder = encoder,
+      .enc = enc,
       .padding_x = padding_x,
       .padding_y = padding_y,
+      .picture_pool = picture_pool,
 
-      .img_in = NULL,
+      .slots = input_slots,
+      .num_slots = opts->read_ahead,
       .retval = RETVAL_RUNNING,
     };
     in_args.available_input_slots = available_input_slots;
     in_args.filled_input_slots    = filled_input_slots;
 
+    if (!output_writer_start(&output_writer, output, api)) {
+      fprintf(stderr, "Failed to start output writer.\n");
+      goto exit_failure;
+    }
+    output_writer_running = true;
+
     if (pthread_create(&input_thread, NULL, input_read_thread, (void*)&in_args) != 0) {
       fprintf(stderr, "pthread_create failed!\n");
       assert(0);
       return 0;
     }
     uvg_picture *cur_in_img;
+    int cur_slot = 0;
     for (;;) {
 
       // Skip mutex locking if the input thread does not exist.
       if (in_args.retval == RETVAL_RUNNING) {
-        // Increase available_input_slots so that the input thread can
-        // write the new img_in and retval to in_args.
-        uvg_sem_post(available_input_slots);
-        // Wait until the input thread has updated in_args and then
+        // Wait until the input thread has filled the next slot and then
         // decrease filled_input_slots.
         uvg_sem_wait(filled_input_slots);
 
-        cur_in_img = in_args.img_in;
-        in_args.img_in = NULL;
+        cur_in_img = input_slots[cur_slot].img_in;
+        in_args.retval = input_slots[cur_slot].retval;
+        input_slots[cur_slot].img_in = NULL;
+        cur_slot = (cur_slot + 1) % opts->read_ahead;
+
+        // Increase available_input_slots so that the input thread can
+        // fill the slot again.
+        uvg_sem_post(available_input_slots);
 
       } else {
         cur_in_img = NULL;
       }
 
       if (in_args.retval == EXIT_FAILURE) {
+        input_thread_stop(&in_args, input_thread, cur_slot);
         goto exit_failure;
       }
 
@@ -639,6 +1008,7 @@ int main(int argc, char *argv[])
                                &info_out)) {
         fprintf(stderr, "Failed to encode image.\n");
         api->picture_free(cur_in_img);
+        input_thread_stop(&in_args, input_thread, cur_slot);
         goto exit_failure;
       }
 
@@ -648,21 +1018,17 @@ int main(int argc, char *argv[])
       }
 
       if (chunks_out != NULL) {
-        uint64_t written = 0;
-        // Write data into the output file.
-        for (uvg_data_chunk *chunk = chunks_out;
-             chunk != NULL;
-             chunk = chunk->next) {
-          assert(written + chunk->len <= len_out);
-          if (fwrite(chunk->data, sizeof(uint8_t), chunk->len, output) != chunk->len) {
-            fprintf(stderr, "Failed to write data to file.\n");
-            api->picture_free(cur_in_img);
-            api->chunk_free(chunks_out);
-            goto exit_failure;
-          }
-          written += chunk->len;
+        // Queue data for writing into the output file. The writer takes
+        // the chunks.
+        if (!output_writer_push(&output_writer, chunks_out, len_out)) {
+          fprintf(stderr, "Failed to write data to file.\n");
+          api->picture_free(cur_in_img);
+          api->picture_free(img_rec);
+          api->picture_free(img_src);
+          input_thread_stop(&in_args, input_thread, cur_slot);
+          goto exit_failure;
         }
-        fflush(output);
+        chunks_out = NULL;
 
         bitstream_length += len_out;
         
@@ -741,11 +1107,16 @@ int main(int argc, char *argv[])
       }
 
       api->picture_free(cur_in_img);
-      api->chunk_free(chunks_out);
       api->picture_free(img_rec);
       api->picture_free(img_src);
     }
 
+    output_writer_running = false;
+    if (!output_writer_finish(&output_writer)) {
+      fprintf(stderr, "Failed to write data to file.\n");
+      goto exit_failure;
+    }
+
     UVG_GET_TIME(&encoding_end_real_time);
     encoding_end_cpu_time = clock();
     // Coding finished
@@ -814,12 +1185,17 @@ done:
   if (filled_input_slots)    uvg_sem_destroy(filled_input_slots);
   FREE_POINTER(available_input_slots);
   FREE_POINTER(filled_input_slots);
+  FREE_POINTER(input_slots);
+
+  if (output_writer_running) output_writer_finish(&output_writer);
 
   // deallocate structures
   if (enc) api->encoder_close(enc);
+  if (picture_pool) api->picture_pool_free(picture_pool);
   if (opts) cmdline_opts_free(api, opts);
 
   // close files
+  yuv_io_map_close(input_map);
   if (input)  fclose(input);
   if (output) fclose(output);
   if (recout) fclose(recout);
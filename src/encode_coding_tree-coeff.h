@@ -0,0 +1,412 @@
+#pragma once
+
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+/**
+ * \file
+ * Walk over the syntax of regular residual coefficients, shared by the
+ * writer and the bit estimator.
+ *
+ * The functions take either a CABAC to write to or an estimator to count
+ * with. The callers pass NULL for the other one, so the branches between
+ * the two fold away when the functions are inlined.
+ */
+
+#include "cabac.h"
+#include "context.h"
+#include "encoderstate.h"
+#include "global.h"
+#include "tables.h"
+#include "uvg_math.h"
+
+
+/**
+ * \brief Write or count a context coded bin.
+ */
+#define COEFF_BIN(cabac, est, ctx, val, bits, name) do { \
+  if (est) CABAC_COUNT_BIN((est), (ctx), (val), (bits)); \
+  else CABAC_FBITS_UPDATE((cabac), (ctx), (val), (bits), (name)); \
+} while(0)
+
+/**
+ * \brief Write or count bypass bins.
+ */
+#define COEFF_BINS_EP(cabac, est, value, num_bins, bits, name) do { \
+  if (est) { \
+    (bits) += (num_bins); \
+  } else { \
+    CABAC_BINS_EP((cabac), (value), (num_bins), (name)); \
+    if ((cabac)->only_count) (bits) += (num_bins); \
+  } \
+} while(0)
+
+
+/**
+ * \brief Write or count the position of the last significant coefficient.
+ *
+ * \return bits of the position, 0 when writing without only_count
+ */
+static INLINE double uvg_coeff_walk_last_xy(cabac_data_t * const cabac,
+                                            cabac_estimator_t * const est,
+                                            uint8_t lastpos_x, uint8_t lastpos_y,
+                                            uint8_t width, uint8_t height,
+                                            uint8_t type)
+{
+  struct cabac_contexts_t * const contexts = est ? est->ctx : &cabac->ctx;
+  const int index_x = uvg_math_floor_log2(width);
+  const int index_y = uvg_math_floor_log2(height);
+  const int prefix_ctx[8] = { 0, 0, 0, 3, 6, 10, 15, 21 };
+  //ToDo: own ctx_offset and shift for X and Y 
+  uint8_t ctx_offset_x = type ? 0 : prefix_ctx[index_x];
+  uint8_t ctx_offset_y = type ? 0 : prefix_ctx[index_y];
+  uint8_t shift_x = type ? CLIP(0, 2, width >> 3) : (index_x + 1) >> 2;
+  uint8_t shift_y = type ? CLIP(0, 2, height >> 3) : (index_y + 1) >> 2;
+  double bits = 0;
+
+  cabac_ctx_t *base_ctx_x = (type ? contexts->cu_ctx_last_x_chroma : contexts->cu_ctx_last_x_luma);
+  cabac_ctx_t *base_ctx_y = (type ? contexts->cu_ctx_last_y_chroma : contexts->cu_ctx_last_y_luma);
+
+  const int group_idx_x = g_group_idx[lastpos_x];
+  const int group_idx_y = g_group_idx[lastpos_y];
+
+  // x prefix
+  int last_x = 0;
+  for (; last_x < group_idx_x; last_x++) {
+    COEFF_BIN(cabac, est, &base_ctx_x[ctx_offset_x + (last_x >> shift_x)], 1, bits, "last_sig_coeff_x_prefix");
+  }
+  if (group_idx_x < ( /*width == 32 ? g_group_idx[15] : */g_group_idx[MIN(32, (int32_t)width) - 1])) {
+    COEFF_BIN(cabac, est, &base_ctx_x[ctx_offset_x + (last_x >> shift_x)], 0, bits, "last_sig_coeff_x_prefix");
+  }
+
+  // y prefix
+  int last_y = 0;
+  for (; last_y < group_idx_y; last_y++) {
+    COEFF_BIN(cabac, est, &base_ctx_y[ctx_offset_y + (last_y >> shift_y)], 1, bits, "last_sig_coeff_y_prefix");
+  }
+  if (group_idx_y < (/* height == 32 ? g_group_idx[15] : */g_group_idx[MIN(32, (int32_t)height) - 1])) {
+    COEFF_BIN(cabac, est, &base_ctx_y[ctx_offset_y + (last_y >> shift_y)], 0, bits, "last_sig_coeff_y_prefix");
+  }
+
+  // last_sig_coeff_x_suffix
+  if (group_idx_x > 3) {
+    const int suffix = lastpos_x - g_min_in_group[group_idx_x];
+    const int write_bits = (group_idx_x - 2) / 2;
+    COEFF_BINS_EP(cabac, est, suffix, write_bits, bits, "last_sig_coeff_x_suffix");
+  }
+
+  // last_sig_coeff_y_suffix
+  if (group_idx_y > 3) {
+    const int suffix = lastpos_y - g_min_in_group[group_idx_y];
+    const int write_bits = (group_idx_y - 2) / 2;
+    COEFF_BINS_EP(cabac, est, suffix, write_bits, bits, "last_sig_coeff_y_suffix");
+  }
+  return bits;
+}
+
+
+/**
+ * \brief Write or count block coefficients.
+ *
+ * \param state     current encoder state
+ * \param cabac     cabac state to write to, NULL when counting
+ * \param est       estimator to count with, NULL when writing
+ * \param coeff     Input coefficients
+ * \param cu_loc    location of the block
+ * \param color     plane type / luminance or chrominance
+ * \param scan_mode    scan type (diag, hor, ver)
+ * \param cur_cu    CU to update the LFNST and MTS constraints of, or NULL
+ * \param last_bits Returns the bits of the last significant position.
+ *
+ * \return bits of the coefficients excluding the last position, 0 when
+ *         writing without only_count
+ */
+static INLINE double uvg_coeff_walk_nxn(const encoder_state_t * const state,
+                                        cabac_data_t * const cabac,
+                                        cabac_estimator_t * const est,
+                                        const coeff_t *coeff,
+                                        const cu_loc_t * const cu_loc,
+                                        uint8_t color,
+                                        int8_t scan_mode,
+                                        cu_info_t* cur_cu,
+                                        double *last_bits)
+{
+  struct cabac_contexts_t * const contexts = est ? est->ctx : &cabac->ctx;
+  const int width  = color == COLOR_Y ? cu_loc->width  : cu_loc->chroma_width;
+  const int height = color == COLOR_Y ? cu_loc->height : cu_loc->chroma_height;
+
+  int32_t i;
+  // ToDo: large block support in VVC?
+  uint32_t sig_coeffgroup_flag[32 * 32] = { 0 };
+
+  int32_t scan_pos;
+  uint32_t blk_pos, pos_y, pos_x, sig, ctx_sig;
+  double bits = 0;
+
+  // CONSTANTS
+
+  const uint8_t log2_block_width =  uvg_g_convert_to_log2[width];
+  const uint8_t log2_block_height = uvg_g_convert_to_log2[height];
+
+  const uint32_t log2_cg_width = uvg_g_log2_sbb_size[log2_block_width][log2_block_height][0];
+  const uint32_t log2_cg_height = uvg_g_log2_sbb_size[log2_block_width][log2_block_height][1];
+  const uint32_t log2_cg_size = log2_cg_width + log2_cg_height;
+  const uint32_t* const scan = uvg_get_scan_order_table(SCAN_GROUP_4X4, scan_mode, log2_block_width, log2_block_height, 0);
+  const uint32_t* const scan_cg = uvg_get_scan_order_table(SCAN_GROUP_UNGROUPED, scan_mode, log2_block_width, log2_block_height, 0);
+
+
+  // Init base contexts according to block type
+  cabac_ctx_t *base_coeff_group_ctx = &(contexts->sig_coeff_group_model[(color == 0 ? 0 : 1) * 2]);
+
+
+  unsigned scan_cg_last = (unsigned)-1;
+  unsigned scan_pos_last = (unsigned)-1;
+
+  for (int i = 0; i < (width * height); ++i) {
+    if (coeff[scan[i]]) {
+      scan_pos_last = i;
+      sig_coeffgroup_flag[scan_cg[i >> log2_cg_size]] = 1;
+    }
+  }
+
+  scan_cg_last = scan_pos_last >> log2_cg_size;
+
+  int pos_last = scan[scan_pos_last];
+
+  const uint8_t last_coeff_y = (uint8_t)(pos_last / width);
+  const uint8_t last_coeff_x = (uint8_t)(pos_last - (last_coeff_y * width));
+  bool is_chroma = color != COLOR_Y;
+
+  if (cur_cu != NULL && /*cur_cu->tr_idx != MTS_SKIP &&*/ height >= 4 && width >= 4) {
+    const unsigned max_lfnst_pos = ((height == 4 && width == 4) || (height == 8 && width == 8)) ? 7 : 15;
+    if(!is_chroma) {
+      cur_cu->violates_lfnst_constrained_luma |= scan_pos_last > max_lfnst_pos;
+    }
+    else {
+      cur_cu->violates_lfnst_constrained_chroma |= scan_pos_last > max_lfnst_pos;
+    }
+    cur_cu->lfnst_last_scan_pos |= scan_pos_last >= 1;
+  }
+
+  // Code last_coeff_x and last_coeff_y
+  *last_bits = uvg_coeff_walk_last_xy(cabac, est,
+    last_coeff_x,
+    last_coeff_y,
+    width,
+    height,
+    color);
+
+  const uint32_t quant_state_transition_table = state->encoder_control->cfg.dep_quant ? 32040 : 0;
+  const bool sign_hiding = state->encoder_control->cfg.signhide_enable && !state->encoder_control->cfg.dep_quant;
+  int32_t quant_state = 0;
+  int32_t temp_diag = -1;
+  int32_t temp_sum = -1;
+
+  int32_t reg_bins = (width * height * 28) >> 4; //8 for 2x2
+
+  const uint32_t cg_width = (MIN((uint8_t)TR_MAX_WIDTH, width) >> log2_cg_width);
+  const uint32_t cg_height = (MIN((uint8_t)TR_MAX_WIDTH, height) >> log2_cg_height);
+
+  // significant_coeff_flag
+  for (i = scan_cg_last; i >= 0; i--) {
+    int32_t cg_blk_pos = scan_cg[i];
+    int32_t cg_pos_y = cg_blk_pos / (MIN((uint8_t)32, width) >> log2_cg_width);
+    int32_t cg_pos_x = cg_blk_pos - (cg_pos_y * (MIN((uint8_t)32, width) >> log2_cg_width));
+
+
+    // !!! residual_coding_subblock() !!!
+
+    // Encode significant coeff group flag when not the last or the first
+    if (i == scan_cg_last || i == 0) {
+      sig_coeffgroup_flag[cg_blk_pos] = 1;
+    } else {
+      uint32_t sig_coeff_group = (sig_coeffgroup_flag[cg_blk_pos] != 0);
+      uint32_t ctx_sig_cg = uvg_context_get_sig_coeff_group(sig_coeffgroup_flag, cg_pos_x,
+        cg_pos_y, cg_width, cg_height);
+      COEFF_BIN(cabac, est, &base_coeff_group_ctx[ctx_sig_cg], sig_coeff_group, bits, "significant_coeffgroup_flag");
+    }
+
+
+    if (sig_coeffgroup_flag[cg_blk_pos]) {
+
+      int32_t min_sub_pos = i << log2_cg_size; // LOG2_SCAN_SET_SIZE;
+      int32_t first_sig_pos = (i == scan_cg_last) ? scan_pos_last : (min_sub_pos + (1 << log2_cg_size) - 1);
+      int32_t next_sig_pos = first_sig_pos;
+
+      int32_t infer_sig_pos = (next_sig_pos != scan_pos_last) ? ((i != 0) ? min_sub_pos : -1) : next_sig_pos;
+      int32_t num_non_zero = 0;
+      int32_t last_nz_pos_in_cg = -1;
+      int32_t first_nz_pos_in_cg = next_sig_pos;
+      int32_t remainder_abs_coeff = -1;
+      uint32_t coeff_signs = 0;
+
+
+      /*
+         ****  FIRST PASS ****
+      */
+      for (next_sig_pos = first_sig_pos; next_sig_pos >= min_sub_pos && reg_bins >= 4; next_sig_pos--) {
+
+
+        blk_pos = scan[next_sig_pos];
+        pos_y = blk_pos / width;
+        pos_x = blk_pos - (pos_y * width);
+
+        sig = (coeff[blk_pos] != 0) ? 1 : 0;
+        if (num_non_zero || next_sig_pos != infer_sig_pos) {
+          ctx_sig = uvg_context_get_sig_ctx_idx_abs(coeff, pos_x, pos_y, width, height, color, &temp_diag, &temp_sum);
+          cabac_ctx_t* sig_ctx = color == 0
+            ? &(contexts->cu_sig_model_luma[MAX(0, (quant_state - 1))][ctx_sig])
+            : &(contexts->cu_sig_model_chroma[MAX(0, (quant_state - 1))][MIN(ctx_sig, 7)]);
+
+          COEFF_BIN(cabac, est, sig_ctx, sig, bits, "sig_coeff_flag");
+          reg_bins--;
+
+        } else if (next_sig_pos != scan_pos_last) {
+          ctx_sig = uvg_context_get_sig_ctx_idx_abs(coeff, pos_x, pos_y, width, height, color, &temp_diag, &temp_sum);
+        }
+
+
+        if (sig) {
+          assert(next_sig_pos - min_sub_pos >= 0 && next_sig_pos - min_sub_pos < 16);
+          num_non_zero++;
+          // ctxOffsetAbs()
+          uint8_t offset = 0;
+          if (temp_diag != -1) {
+            offset = MIN(temp_sum, 4) + 1;
+            offset += (!temp_diag ? (color == COLOR_Y ? 15 : 5) : color == COLOR_Y ? temp_diag < 3 ? 10 : (temp_diag < 10 ? 5 : 0) : 0);
+          }
+
+
+          last_nz_pos_in_cg = MAX(last_nz_pos_in_cg, next_sig_pos);
+          first_nz_pos_in_cg = next_sig_pos;
+
+          remainder_abs_coeff = abs(coeff[blk_pos]) - 1;
+
+          // If shift sign pattern and add current sign
+          coeff_signs = (next_sig_pos != scan_pos_last ? 2 * coeff_signs : coeff_signs) + (coeff[blk_pos] < 0);
+
+
+
+          // Code "greater than 1" flag
+          uint8_t gt1 = remainder_abs_coeff ? 1 : 0;
+          COEFF_BIN(cabac, est, (color == 0) ? &(contexts->cu_gtx_flag_model_luma[1][offset]) :
+            &(contexts->cu_gtx_flag_model_chroma[1][offset]),
+            gt1, bits, "abs_level_gtx_flag");
+          reg_bins--;
+
+          if (gt1) {
+            remainder_abs_coeff -= 1;
+
+            // Code coeff parity
+            COEFF_BIN(cabac, est, (color == 0) ? &(contexts->cu_parity_flag_model_luma[offset]) :
+              &(contexts->cu_parity_flag_model_chroma[offset]),
+              remainder_abs_coeff & 1, bits, "par_flag");
+            remainder_abs_coeff >>= 1;
+
+            reg_bins--;
+            uint8_t gt2 = remainder_abs_coeff ? 1 : 0;
+            COEFF_BIN(cabac, est, (color == 0) ? &(contexts->cu_gtx_flag_model_luma[0][offset]) :
+              &(contexts->cu_gtx_flag_model_chroma[0][offset]),
+              gt2, bits, "gt2_flag");
+            reg_bins--;
+          }
+        }
+
+        quant_state = (quant_state_transition_table >> ((quant_state << 2) + ((coeff[blk_pos] & 1) << 1))) & 3;
+      }
+
+
+      /*
+      ****  SECOND PASS: Go-rice  ****
+      */
+      uint32_t rice_param = 0;
+      uint32_t pos0 = 0;
+      for (scan_pos = first_sig_pos; scan_pos > next_sig_pos; scan_pos--) {
+        blk_pos = scan[scan_pos];
+        uint32_t second_pass_abs_coeff = abs(coeff[blk_pos]);
+        if (second_pass_abs_coeff >= 4) {
+          pos_y = blk_pos / width;
+          pos_x = blk_pos - (pos_y * width);
+          int32_t abs_sum = uvg_abs_sum(coeff, pos_x, pos_y, width, height, 4);
+          rice_param = g_go_rice_pars[abs_sum];
+          uint32_t remainder = (second_pass_abs_coeff - 4) >> 1;
+          bits += est ? uvg_cabac_count_coeff_remain(remainder, rice_param, 5)
+                      : uvg_cabac_write_coeff_remain(cabac, remainder, rice_param, 5);
+        }
+      }
+
+      /*
+      ****  coeff bypass  ****
+      */
+      for (scan_pos = next_sig_pos; scan_pos >= min_sub_pos; scan_pos--) {
+        blk_pos = scan[scan_pos];
+        pos_y = blk_pos / width;
+        pos_x = blk_pos - (pos_y * width);
+        uint32_t coeff_abs = abs(coeff[blk_pos]);
+        int32_t abs_sum = uvg_abs_sum(coeff, pos_x, pos_y, width, height, 0);
+        rice_param = g_go_rice_pars[abs_sum];
+        pos0 = ((quant_state<2)?1:2) << rice_param;
+        uint32_t remainder = (coeff_abs == 0 ? pos0 : coeff_abs <= pos0 ? coeff_abs - 1 : coeff_abs);
+        bits += est ? uvg_cabac_count_coeff_remain(remainder, rice_param, 5)
+                    : uvg_cabac_write_coeff_remain(cabac, remainder, rice_param, 5);
+        quant_state = (quant_state_transition_table >> ((quant_state << 2) + ((coeff_abs & 1) << 1))) & 3;
+        if (coeff_abs) {
+          num_non_zero++;
+          first_nz_pos_in_cg = scan_pos;
+          last_nz_pos_in_cg = MAX(last_nz_pos_in_cg, scan_pos);
+          coeff_signs <<= 1;
+          if (coeff[blk_pos] < 0) coeff_signs++;
+        }
+      }
+
+      uint32_t num_signs = num_non_zero;
+
+      if (sign_hiding && (last_nz_pos_in_cg - first_nz_pos_in_cg >= 4)) {
+        num_signs--;
+        coeff_signs >>= 1;
+      }
+
+      if (color == COLOR_Y && cur_cu != NULL && cur_cu->tr_idx != MTS_SKIP)
+      {
+        cur_cu->mts_last_scan_pos |= first_sig_pos > 0;
+      }
+
+      COEFF_BINS_EP(cabac, est, coeff_signs, num_signs, bits, "coeff_signs");
+    }
+
+    if (color == COLOR_Y && cur_cu != NULL && (cg_pos_y > 3 || cg_pos_x > 3) && sig_coeffgroup_flag[cg_blk_pos] != 0)
+    {
+      cur_cu->violates_mts_coeff_constraint = true;
+    }
+  }
+  return bits;
+}
@@ -31,6 +31,7 @@
  ****************************************************************************/
 
 #include "encode_coding_tree.h"
+#include "encode_coding_tree-coeff.h"
 
 #include "cabac.h"
 #include "context.h"
@@ -417,55 +418,7 @@ void uvg_encode_last_significant_xy(cabac_data_t * const cabac,
                                     uint8_t width, uint8_t height,
                                     uint8_t type, uint8_t scan, double* bits_out)
 {
-  const int index_x = uvg_math_floor_log2(width);
-  const int index_y = uvg_math_floor_log2(height);
-  const int prefix_ctx[8] = { 0, 0, 0, 3, 6, 10, 15, 21 };
-  //ToDo: own ctx_offset and shift for X and Y 
-  uint8_t ctx_offset_x = type ? 0 : prefix_ctx[index_x];
-  uint8_t ctx_offset_y = type ? 0 : prefix_ctx[index_y];
-  uint8_t shift_x = type ? CLIP(0, 2, width >> 3) : (index_x + 1) >> 2;
-  uint8_t shift_y = type ? CLIP(0, 2, height >> 3) : (index_y + 1) >> 2;
-  double bits = 0;
-
-  cabac_ctx_t *base_ctx_x = (type ? cabac->ctx.cu_ctx_last_x_chroma : cabac->ctx.cu_ctx_last_x_luma);
-  cabac_ctx_t *base_ctx_y = (type ? cabac->ctx.cu_ctx_last_y_chroma : cabac->ctx.cu_ctx_last_y_luma);
-
-  const int group_idx_x = g_group_idx[lastpos_x];
-  const int group_idx_y = g_group_idx[lastpos_y];
-
-  // x prefix
-  int last_x = 0;
-  for (; last_x < group_idx_x; last_x++) {
-    CABAC_FBITS_UPDATE(cabac, &base_ctx_x[ctx_offset_x + (last_x >> shift_x)], 1, bits, "last_sig_coeff_x_prefix");
-  }
-  if (group_idx_x < ( /*width == 32 ? g_group_idx[15] : */g_group_idx[MIN(32, (int32_t)width) - 1])) {
-    CABAC_FBITS_UPDATE(cabac, &base_ctx_x[ctx_offset_x + (last_x >> shift_x)], 0, bits, "last_sig_coeff_x_prefix");
-  }
-
-  // y prefix
-  int last_y = 0;
-  for (; last_y < group_idx_y; last_y++) {
-    CABAC_FBITS_UPDATE(cabac, &base_ctx_y[ctx_offset_y + (last_y >> shift_y)], 1, bits, "last_sig_coeff_y_prefix");
-  }
-  if (group_idx_y < (/* height == 32 ? g_group_idx[15] : */g_group_idx[MIN(32, (int32_t)height) - 1])) {
-    CABAC_FBITS_UPDATE(cabac, &base_ctx_y[ctx_offset_y + (last_y >> shift_y)], 0, bits, "last_sig_coeff_y_prefix");
-  }
-
-  // last_sig_coeff_x_suffix
-  if (group_idx_x > 3) {
-    const int suffix = lastpos_x - g_min_in_group[group_idx_x];
-    const int write_bits = (group_idx_x - 2) / 2;
-    CABAC_BINS_EP(cabac, suffix, write_bits, "last_sig_coeff_x_suffix");
-    if (cabac->only_count) bits += write_bits;
-  }
-
-  // last_sig_coeff_y_suffix
-  if (group_idx_y > 3) {
-    const int suffix = lastpos_y - g_min_in_group[group_idx_y];
-    const int write_bits = (group_idx_y - 2) / 2;
-    CABAC_BINS_EP(cabac, suffix, write_bits, "last_sig_coeff_y_suffix");
-    if (cabac->only_count) bits += write_bits;
-  }
+  const double bits = uvg_coeff_walk_last_xy(cabac, NULL, lastpos_x, lastpos_y, width, height, type);
   if (cabac->only_count && bits_out) *bits_out += bits;
 }
 
@@ -37,9 +37,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "bitstream.h"
 #include "cfg.h"
 #include "gop.h"
+#include "hugepages.h"
+#include "image.h"
 #include "rdo.h"
+#include "search.h"
 #include "strategyselector.h"
 #include "uvg_math.h"
 #include "fast_coeff_cost.h"
@@ -209,8 +213,18 @@ encoder_control_t* uvg_encoder_control_init(const uvg_config *const cfg)
     goto init_failed;
   }
 
+  // Freed bitstream chunks are kept for reuse while any encoder is open.
+  // uvg_encoder_control_free releases the reference.
+  uvg_bitstream_pool_acquire();
+
   // Take a copy of the config.
   memcpy(&encoder->cfg, cfg, sizeof(encoder->cfg));
+
+  // Huge pages are used while any encoder that asked for them is open.
+  // uvg_encoder_control_free releases the reference.
+  if (encoder->cfg.hugepages) {
+    uvg_hugepages_acquire();
+  }
   // Set fields that are not copied to NULL.
   encoder->cfg.cqmfile = NULL;
   encoder->cfg.tiles_width_split = NULL;
@@ -292,12 +306,57 @@ encoder_control_t* uvg_encoder_control_init(const uvg_config *const cfg)
     }
   }
 
+  if (encoder->cfg.threads == 0) {
+    // Frames are encoded one at a time anyway.
+    encoder->cfg.adaptive_owf = 0;
+  }
+
   encoder->threadqueue = uvg_threadqueue_init(encoder->cfg.threads);
   if (!encoder->threadqueue) {
     fprintf(stderr, "Could not initialize threadqueue.\n");
     goto init_failed;
   }
 
+  if (!uvg_threadqueue_set_spin(encoder->threadqueue, encoder->cfg.thread_spin)) {
+    goto init_failed;
+  }
+
+  encoder->num_nodes = 1;
+  if (encoder->cfg.thread_affinity != UVG_THREAD_AFFINITY_NONE) {
+    encoder->num_nodes = uvg_threadqueue_pin_workers(encoder->threadqueue,
+                                                     encoder->cfg.thread_affinity);
+    if (encoder->num_nodes == 0) {
+      fprintf(stderr, "Could not pin the worker threads.\n");
+      goto init_failed;
+    }
+  }
+
+  if (cfg->trace_file_name) {
+    encoder->trace_file = fopen(cfg->trace_file_name, "wb");
+    if (!encoder->trace_file) {
+      fprintf(stderr, "Could not open trace file.\n");
+      goto init_failed;
+    }
+    if (!uvg_threadqueue_trace_start(encoder->threadqueue, encoder->trace_file)) {
+      fprintf(stderr, "Could not start threadqueue trace.\n");
+      goto init_failed;
+    }
+  }
+
+  encoder->picture_pool = uvg_image_pool_alloc();
+  if (!encoder->picture_pool) {
+    fprintf(stderr, "Could not allocate picture pool.\n");
+    goto init_failed;
+  }
+
+  if (encoder->cfg.split_jobs > 0) {
+    encoder->split_job_pool = uvg_split_job_pool_alloc();
+    if (!encoder->split_job_pool) {
+      fprintf(stderr, "Could not allocate split job pool.\n");
+      goto init_failed;
+    }
+  }
+
   encoder->bitdepth = UVG_BIT_DEPTH;
 
   encoder->chroma_format = UVG_FORMAT2CSP(encoder->cfg.input_format);
@@ -701,6 +760,8 @@ void uvg_encoder_control_free(encoder_control_t *const encoder)
 
   uvg_threadqueue_free(encoder->threadqueue);
   encoder->threadqueue = NULL;
+  // No split job can be running after the threadqueue has stopped.
+  uvg_split_job_pool_free(encoder->split_job_pool);
   for (int i = 0; i < encoder->cfg.num_used_table; i++) {
     int8_t *temp = encoder->qp_map[i] - qpBdOffsetC;
     if (encoder->qp_map[i] - qpBdOffsetC) FREE_POINTER(temp);
@@ -720,6 +781,17 @@ void uvg_encoder_control_free(encoder_control_t *const encoder)
     fclose(encoder->cabac_debug_file);
   }
 
+  if (encoder->trace_file) {
+    fclose(encoder->trace_file);
+  }
+
+  uvg_image_pool_free(encoder->picture_pool);
+
+  if (encoder->cfg.hugepages) {
+    uvg_hugepages_release();
+  }
+  uvg_bitstream_pool_release();
+
   free(encoder);
 }
 
@@ -156,6 +156,18 @@ typedef struct encoder_control_t
 
   FILE* cabac_debug_file;
 
+  //! Chrome trace of the threadqueue jobs
+  FILE* trace_file;
+
+  //! Number of NUMA nodes the frames are spread over, 1 for no NUMA placement
+  int num_nodes;
+
+  //! Reconstructed pictures returned for reuse
+  uvg_picture_pool *picture_pool;
+
+  //! Buffers of the split type searches in jobs, NULL if they are not used
+  struct split_job_pool_t *split_job_pool;
+
 } encoder_control_t;
 
 encoder_control_t* uvg_encoder_control_init(const uvg_config *const cfg);
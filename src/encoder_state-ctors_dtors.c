@@ -42,6 +42,7 @@
 #include "encoder.h"
 #include "encoder_state-geometry.h"
 #include "encoderstate.h"
+#include "fast_coeff_cost.h"
 #include "image.h"
 #include "imagelist.h"
 #include "uvg266.h"
@@ -50,6 +51,8 @@
 #include "rate_control.h"
 #include "alf.h"
 #include "reshape.h"
+#include "search_intra.h"
+#include "transform.h"
 
 
 static int encoder_state_config_frame_init(encoder_state_t * const state) {
@@ -66,6 +69,7 @@ static int encoder_state_config_frame_init(encoder_state_t * const state) {
   state->frame->cur_gop_bits_coded = 0;
   state->frame->prepared = 0;
   state->frame->done = 1;
+  state->frame->numa_node = -1;
 
   state->frame->rc_alpha = 3.2003;
   state->frame->rc_beta = -1.367;
@@ -291,7 +295,7 @@ static int encoder_state_main_init(encoder_state_t* const state) {
   if (state->encoder_control->cfg.alf_type) {
     state->slice->alf = malloc(sizeof(*state->slice->alf));
 
-    state->slice->alf->apss = malloc(sizeof(alf_aps) * ALF_CTB_MAX_NUM_APS);
+    state->slice->alf->apss = calloc(ALF_CTB_MAX_NUM_APS, sizeof(alf_aps));
     state->slice->alf->tile_group_luma_aps_id = malloc(ALF_CTB_MAX_NUM_APS * sizeof(int8_t));
     state->slice->alf->cc_filter_param = malloc(sizeof(*state->slice->alf->cc_filter_param));
     for (int aps_idx = 0; aps_idx < ALF_CTB_MAX_NUM_APS; aps_idx++) {
@@ -360,6 +364,12 @@ int uvg_encoder_state_init(encoder_state_t * const child_state, encoder_state_t
   child_state->tqj_bitstream_written = NULL;
   child_state->tqj_recon_done = NULL;
   child_state->tqj_alf_process = NULL;
+  child_state->intra_cost_cache = NULL;
+  child_state->transform_cache = NULL;
+  child_state->fast_coeff_online = NULL;
+  child_state->cabac_journal = NULL;
+  child_state->cabac.journal = NULL;
+  child_state->search_cabac.journal = NULL;
   
   if (!parent_state) {
     const encoder_control_t * const encoder = child_state->encoder_control;
@@ -640,6 +650,39 @@ int uvg_encoder_state_init(encoder_state_t * const child_state, encoder_state_t
       child_state->lcu_order_count = lcu_end - lcu_start;
       child_state->lcu_order = MALLOC(lcu_order_element_t, child_state->lcu_order_count);
       assert(child_state->lcu_order);
+
+      // Same blocks are searched several times only when MTT is in use.
+      const uint8_t *max_btt_depth = encoder->cfg.max_btt_depth;
+      if (max_btt_depth[0] || max_btt_depth[1] || max_btt_depth[2]) {
+        child_state->intra_cost_cache = uvg_intra_cost_cache_alloc();
+        if (!child_state->intra_cost_cache) {
+          fprintf(stderr, "Could not allocate intra cost cache!\n");
+          return 0;
+        }
+      }
+
+      // LFNST and JCCR searches transform the same residuals again.
+      if (encoder->cfg.lfnst || encoder->cfg.jccr) {
+        child_state->transform_cache = uvg_transform_cache_alloc();
+        if (!child_state->transform_cache) {
+          fprintf(stderr, "Could not allocate transform cache!\n");
+          return 0;
+        }
+      }
+
+      if (encoder->cfg.fastrd_online && encoder->cfg.fast_residual_cost_limit > 0) {
+        child_state->fast_coeff_online = uvg_fast_coeff_online_alloc(&encoder->fast_coeff_table);
+        if (!child_state->fast_coeff_online) {
+          fprintf(stderr, "Could not allocate fast coefficient cost weights!\n");
+          return 0;
+        }
+      }
+
+      child_state->cabac_journal = uvg_cabac_journal_alloc();
+      if (!child_state->cabac_journal) {
+        fprintf(stderr, "Could not allocate CABAC context journal!\n");
+        return 0;
+      }
       
       for (uint32_t i = 0; i < child_state->lcu_order_count; ++i) {
         lcu_id = lcu_start + i;
@@ -741,6 +784,15 @@ void uvg_encoder_state_finalize(encoder_state_t * const state) {
   
   FREE_POINTER(state->lcu_order);
   state->lcu_order_count = 0;
+
+  uvg_intra_cost_cache_free(state->intra_cost_cache);
+  state->intra_cost_cache = NULL;
+  uvg_transform_cache_free(state->transform_cache);
+  state->transform_cache = NULL;
+  uvg_fast_coeff_online_free(state->fast_coeff_online);
+  state->fast_coeff_online = NULL;
+  uvg_cabac_journal_free(state->cabac_journal);
+  state->cabac_journal = NULL;
   
   if (!state->parent || (state->parent->wfrow != state->wfrow)) {
     FREE_POINTER(state->wfrow);
@@ -40,6 +40,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "affinity.h"
 #include "cabac.h"
 #include "context.h"
 #include "encode_coding_tree.h"
@@ -1001,6 +1002,22 @@ void uvg_alf_enc_process_job(void* opaque) {
   encoder_state_init_children_after_simulation(parent);
 }
 
+/**
+ * \brief Priority of the jobs of a CTU in the threadqueue.
+ *
+ * The critical path goes through the oldest frame and, with WPP, through
+ * the CTU that is furthest behind on its wavefront. A CTU can start two
+ * CTUs after the CTU above it, so x + 2 * y is its position on the
+ * wavefront. The priorities are negative so that jobs without a priority,
+ * such as the search jobs a CTU waits for, are run before the CTU jobs.
+ */
+static int64_t lcu_job_priority(const encoder_state_t * const state,
+                                const lcu_order_element_t * const lcu)
+{
+  const int64_t wavefront_pos = lcu->position.x + 2 * lcu->position.y;
+  return -(((int64_t)state->frame->num << 32) + wavefront_pos) - 1;
+}
+
 static void encoder_state_encode_leaf(encoder_state_t * const state)
 {
   const encoder_control_t * const encoder = state->encoder_control;
@@ -1096,6 +1113,16 @@ static void encoder_state_encode_leaf(encoder_state_t * const state)
 
       // If job object was returned, add dependancies and allow it to run.
       if (job[0]) {
+        const int64_t priority = lcu_job_priority(state, lcu);
+        uvg_threadqueue_job_set_priority(job[0], priority);
+        uvg_threadqueue_job_set_priority(bitstream_job[0], priority);
+        uvg_threadqueue_job_set_label(job[0], "search", state->frame->poc, state->tile->id,
+                                      lcu->position.x, lcu->position.y);
+        uvg_threadqueue_job_set_label(bitstream_job[0], "bitstream", state->frame->poc, state->tile->id,
+                                      lcu->position.x, lcu->position.y);
+        uvg_threadqueue_job_set_node(job[0], state->frame->numa_node);
+        uvg_threadqueue_job_set_node(bitstream_job[0], state->frame->numa_node);
+
         // Add inter frame dependancies when ecoding more than one frame at
         // once. The added dependancy is for the first LCU of each wavefront
         // row to depend on the reconstruction status of the row below in the
@@ -1328,6 +1355,9 @@ static void encoder_state_encode(encoder_state_t * const main_state) {
           uvg_threadqueue_free_job(&main_state->children[i].tqj_recon_done);
           main_state->children[i].tqj_recon_done =
             uvg_threadqueue_job_create(encoder_state_worker_encode_children, &main_state->children[i]);
+          uvg_threadqueue_job_set_label(main_state->children[i].tqj_recon_done, "encode",
+                                        main_state->frame->poc, main_state->children[i].tile->id, -1, -1);
+          uvg_threadqueue_job_set_node(main_state->children[i].tqj_recon_done, main_state->frame->numa_node);
           if (main_state->children[i].previous_encoder_state != &main_state->children[i] &&
               main_state->children[i].previous_encoder_state->tqj_recon_done &&
               !main_state->children[i].frame->is_irap)
@@ -1544,15 +1574,18 @@ static void encoder_set_source_picture(encoder_state_t * const state, uvg_pictur
     // In lossless mode, the reconstruction is equal to the source frame.
     state->tile->frame->rec = uvg_image_copy_ref(frame);
   } else {
-    state->tile->frame->rec = uvg_image_alloc(state->encoder_control->chroma_format, frame->width, frame->height);
+    state->tile->frame->rec = uvg_image_pool_get(state->encoder_control->picture_pool,
+                                                 state->encoder_control->chroma_format, frame->width, frame->height);
     state->tile->frame->rec->dts = frame->dts;
     state->tile->frame->rec->pts = frame->pts;
   }
   state->tile->frame->rec_lmcs = state->tile->frame->rec;
 
   if (state->encoder_control->cfg.lmcs_enable) {
-    state->tile->frame->rec_lmcs = uvg_image_alloc(state->encoder_control->chroma_format, frame->width, frame->height);
-    state->tile->frame->source_lmcs = uvg_image_alloc(state->encoder_control->chroma_format, frame->width, frame->height);
+    state->tile->frame->rec_lmcs = uvg_image_pool_get(state->encoder_control->picture_pool,
+                                                      state->encoder_control->chroma_format, frame->width, frame->height);
+    state->tile->frame->source_lmcs = uvg_image_pool_get(state->encoder_control->picture_pool,
+                                                         state->encoder_control->chroma_format, frame->width, frame->height);
   }
   uvg_videoframe_set_poc(state->tile->frame, state->frame->poc);
 }
@@ -1612,6 +1645,29 @@ static bool edge_lcu(int id, int lcus_x, int lcus_y, bool xdiv64, bool ydiv64)
   }
 }
 
+// Variance of a plane whose rows may be longer than the width. The sums
+// are accumulated row by row, so no contiguous copy of the plane is needed.
+static double plane_var(const uvg_pixel *plane, int width, int height, int stride)
+{
+  uint64_t sum = 0;
+  uint64_t sum_sq = 0;
+  for (int y = 0; y < height; ++y) {
+    const uvg_pixel *row = &plane[y * stride];
+    uint32_t row_sum = 0;
+    uint64_t row_sum_sq = 0;
+    for (int x = 0; x < width; ++x) {
+      row_sum += row[x];
+      row_sum_sq += (uint32_t)row[x] * row[x];
+    }
+    sum += row_sum;
+    sum_sq += row_sum_sq;
+  }
+
+  const double len = (double)width * height;
+  const double mean = sum / len;
+  return sum_sq / len - mean * mean;
+}
+
 
 /**
  * \brief Return weight for 360 degree ERP video
@@ -1773,6 +1829,17 @@ static void encoder_state_init_new_frame(encoder_state_t * const state, uvg_pict
       state->tile->frame->height
   );
 
+  if (state->frame->numa_node >= 0) {
+    // Keep the pictures of the frame on the node of the workers encoding it.
+    // The reconstruction is read from there when used as a reference.
+    const cu_array_t *cua = state->tile->frame->cu_array;
+    uvg_image_bind_to_node(state->tile->frame->source, state->frame->numa_node);
+    uvg_image_bind_to_node(state->tile->frame->rec, state->frame->numa_node);
+    uvg_affinity_bind_memory(cua->data,
+                             (size_t)cua->width * cua->height / (SCU_WIDTH * SCU_WIDTH) * sizeof(cu_info_t),
+                             state->frame->numa_node);
+  }
+
   if (!state->encoder_control->tiles_enable) {
     memset(state->tile->frame->hmvp_size, 0, sizeof(uint8_t) * state->tile->frame->height_in_lcu);
     memset(state->tile->frame->hmvp_size_ibc, 0, sizeof(uint8_t) * state->tile->frame->height_in_lcu);
@@ -1799,12 +1866,13 @@ static void encoder_state_init_new_frame(encoder_state_t * const state, uvg_pict
     double d = cfg->vaq * 0.1; // Empirically decided constant. Affects delta-QP strength
     
     // Calculate frame pixel variance
-    uint32_t len = state->tile->frame->width * state->tile->frame->height;
-    uint32_t c_len = len / 4;
-    double frame_var = uvg_pixel_var(state->tile->frame->source->y, len);
+    const uvg_picture *const source = state->tile->frame->source;
+    const int width = state->tile->frame->width;
+    const int height = state->tile->frame->height;
+    double frame_var = plane_var(source->y, width, height, source->stride);
     if (has_chroma) {
-      frame_var += uvg_pixel_var(state->tile->frame->source->u, c_len);
-      frame_var += uvg_pixel_var(state->tile->frame->source->v, c_len);
+      frame_var += plane_var(source->u, width / 2, height / 2, source->chroma_stride);
+      frame_var += plane_var(source->v, width / 2, height / 2, source->chroma_stride);
     }
 
     // Loop through LCUs
@@ -1845,7 +1913,7 @@ static void encoder_state_init_new_frame(encoder_state_t * const state, uvg_pict
 
         if (has_chroma) {
           // Add chroma variance if not monochrome
-          int32_t c_stride = state->tile->frame->source->stride >> 1;
+          int32_t c_stride = state->tile->frame->source->chroma_stride;
           uvg_pixel chromau_tmp[LCU_CHROMA_SIZE];
           uvg_pixel chromav_tmp[LCU_CHROMA_SIZE];
           int lcu_chroma_width = LCU_WIDTH >> 1;
@@ -2022,7 +2090,7 @@ static void encoder_state_init_new_frame(encoder_state_t * const state, uvg_pict
           luma_lmcs[x] = state->tile->frame->lmcs_aps->m_fwdLUT[luma[x]];
         }
         luma += state->tile->frame->source->stride;
-        luma_lmcs += state->tile->frame->source->stride;
+        luma_lmcs += state->tile->frame->source_lmcs->stride;
       }
       state->tile->frame->source_lmcs_mapped = true;
       state->tile->frame->lmcs_top_level = true;
@@ -2066,12 +2134,16 @@ void uvg_encode_one_frame(encoder_state_t * const state, uvg_picture* frame)
     encoder_state_t* child_state = state;
     while (child_state->lcu_order == NULL) child_state = &child_state->children[0];
     state->tqj_alf_process = uvg_threadqueue_job_create(uvg_alf_enc_process_job, child_state);
+    uvg_threadqueue_job_set_label(state->tqj_alf_process, "alf", state->frame->poc, -1, -1, -1);
+    uvg_threadqueue_job_set_node(state->tqj_alf_process, state->frame->numa_node);
   }
 
   encoder_state_encode(state);
 
   threadqueue_job_t *job =
     uvg_threadqueue_job_create(uvg_encoder_state_worker_write_bitstream, state);
+  uvg_threadqueue_job_set_label(job, "write", state->frame->poc, -1, -1, -1);
+  uvg_threadqueue_job_set_node(job, state->frame->numa_node);
 
 
   if (state->encoder_control->cfg.alf_type && state->encoder_control->cfg.wpp) {
@@ -194,6 +194,9 @@ typedef struct encoder_state_config_frame_t {
 
   bool jccr_sign; 
 
+  //! NUMA node whose workers encode the frame, -1 for any
+  int numa_node;
+
 } encoder_state_config_frame_t;
 
 typedef struct encoder_state_config_tile_t {
@@ -360,6 +363,17 @@ typedef struct encoder_state_t {
   //Constraint structure  
   void * constraint;
 
+  //! Rough intra cost cache of the current CTU, NULL if not in use.
+  struct intra_cost_cache_t *intra_cost_cache;
+  //! Forward transform cache of the current CTU, NULL if not in use.
+  struct transform_cache_t *transform_cache;
+
+  //! Fast coefficient cost weights adapted online, NULL if not in use.
+  struct fast_coeff_online_t *fast_coeff_online;
+
+  //! Context update journal of search_cabac.
+  cabac_journal_t *cabac_journal;
+
   // Since lfnst needs the collocated luma intra mode for
   // dual tree if the chroma mode is cclm mode and getting all of
   // the information that would be necessary to get the collocated
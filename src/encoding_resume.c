@@ -96,6 +96,7 @@ static void hash_cfg(const encoder_state_t * const state, char id_out[33]) {
   cfg.fast_coeff_table_fn = NULL;
   cfg.fastrd_learning_outdir_fn = NULL;
   cfg.cabac_debug_file_name = NULL;
+  cfg.trace_file_name = NULL;
 
   //Create hash
   context_md5_t ctx;
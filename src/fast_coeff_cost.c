@@ -31,6 +31,11 @@
  ****************************************************************************/
  
 #include "fast_coeff_cost.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "uvg266.h"
 #include "encoderstate.h"
 
@@ -83,6 +88,135 @@ void uvg_fast_coeff_use_default_table(fast_coeff_table_t *fast_coeff_table)
 
 uint64_t uvg_fast_coeff_get_weights(const encoder_state_t *state)
 {
+  if (state->fast_coeff_online) {
+    return state->fast_coeff_online->wts_by_qp[state->qp];
+  }
   const fast_coeff_table_t *table = &(state->encoder_control->fast_coeff_table);
   return table->wts_by_qp[state->qp];
 }
+
+fast_coeff_online_t * uvg_fast_coeff_online_alloc(const fast_coeff_table_t *initial)
+{
+  fast_coeff_online_t *online = calloc(1, sizeof(fast_coeff_online_t));
+  if (!online) return NULL;
+
+  memcpy(online->wts_by_qp, initial->wts_by_qp, sizeof(online->wts_by_qp));
+  return online;
+}
+
+void uvg_fast_coeff_online_free(fast_coeff_online_t *online)
+{
+  free(online);
+}
+
+/**
+ * \brief Whether the current block should be sampled for the online fit.
+ */
+int uvg_fast_coeff_online_sample(fast_coeff_online_t *online)
+{
+  return online->sample_counter++ % FASTRD_ONLINE_SAMPLE_INTERVAL == 0;
+}
+
+/**
+ * \brief Refit the weights of a QP from the collected samples.
+ *
+ * Solves the normal equations with a ridge term that pulls the result
+ * towards the current weights, so that buckets with few samples keep
+ * their old values.
+ */
+static void fit_weights(fast_coeff_online_t *online, int qp)
+{
+  fast_coeff_regression_t *reg = &online->regression[qp];
+  uint64_t packed = online->wts_by_qp[qp];
+  double a[4][5];
+  double trace = 0;
+
+  for (int i = 0; i < 4; i++) {
+    trace += reg->xtx[i][i];
+  }
+  const double ridge = 0.01 * trace / 4 + 1.0;
+
+  for (int i = 0; i < 4; i++) {
+    const double prev = (double)((packed >> (16 * i)) & 0xffff) / 256.0;
+    for (int j = 0; j < 4; j++) {
+      a[i][j] = reg->xtx[i][j] + (i == j ? ridge : 0);
+    }
+    a[i][4] = reg->xty[i] + ridge * prev;
+  }
+
+  // Gaussian elimination with partial pivoting
+  for (int col = 0; col < 4; col++) {
+    int pivot = col;
+    for (int row = col + 1; row < 4; row++) {
+      if (fabs(a[row][col]) > fabs(a[pivot][col])) pivot = row;
+    }
+    if (fabs(a[pivot][col]) < 1e-9) return;
+    if (pivot != col) {
+      for (int k = 0; k < 5; k++) {
+        double tmp = a[col][k];
+        a[col][k] = a[pivot][k];
+        a[pivot][k] = tmp;
+      }
+    }
+    for (int row = col + 1; row < 4; row++) {
+      const double f = a[row][col] / a[col][col];
+      for (int k = col; k < 5; k++) {
+        a[row][k] -= f * a[col][k];
+      }
+    }
+  }
+
+  double wts[4];
+  for (int i = 3; i >= 0; i--) {
+    double sum = a[i][4];
+    for (int k = i + 1; k < 4; k++) {
+      sum -= a[i][k] * wts[k];
+    }
+    // The packed weights are unsigned Q8.8.
+    wts[i] = CLIP(0.0, 255.0, sum / a[i][i]);
+  }
+  online->wts_by_qp[qp] = to_4xq88(wts);
+
+  // Decay the statistics so that the fit follows changes in the content.
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      reg->xtx[i][j] *= 0.5;
+    }
+    reg->xty[i] *= 0.5;
+  }
+  reg->num_samples = 0;
+}
+
+/**
+ * \brief Add a block with a known CABAC cost to the online fit.
+ *
+ * \param qp      QP of the block
+ * \param coeff   coefficients of the block
+ * \param bits    CABAC cost of the coefficients
+ */
+void uvg_fast_coeff_online_update(fast_coeff_online_t *online,
+                                  int qp,
+                                  const coeff_t *coeff,
+                                  int width,
+                                  int height,
+                                  double bits)
+{
+  if (qp < 0 || qp >= MAX_FAST_COEFF_COST_QP) return;
+
+  double counts[4] = { 0 };
+  for (int i = 0; i < width * height; i++) {
+    counts[MIN(abs(coeff[i]), 3)] += 1;
+  }
+
+  fast_coeff_regression_t *reg = &online->regression[qp];
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      reg->xtx[i][j] += counts[i] * counts[j];
+    }
+    reg->xty[i] += counts[i] * bits;
+  }
+
+  if (++reg->num_samples >= FASTRD_ONLINE_UPDATE_SAMPLES) {
+    fit_weights(online, qp);
+  }
+}
@@ -34,6 +34,7 @@
 #define FAST_COEFF_COST_H_
 
 #include <stdio.h>
+#include "global.h" // IWYU pragma: keep
 #include "uvg266.h"
 // #include "encoderstate.h"
 
@@ -101,10 +102,45 @@ static const double default_fast_coeff_cost_wts[][4] = {
   {0.000019f, 5.811260f, 4.399110f, 7.336310f},
 };
 
+// Online adaptation: one block in FASTRD_ONLINE_SAMPLE_INTERVAL estimated
+// with the fast cost is also coded with CABAC, and the weights of a QP are
+// refitted every FASTRD_ONLINE_UPDATE_SAMPLES samples of that QP.
+#define FASTRD_ONLINE_SAMPLE_INTERVAL 16
+#define FASTRD_ONLINE_UPDATE_SAMPLES 128
+
+typedef struct {
+  // Normal equations of the least squares fit of CABAC bits to the number
+  // of coefficients in each of the 4 buckets.
+  double xtx[4][4];
+  double xty[4];
+  uint32_t num_samples;
+} fast_coeff_regression_t;
+
+/**
+ * \brief Fast coefficient cost weights adapted to the encoded content.
+ *
+ * Owned by a single encoder state, so no locking is needed.
+ */
+typedef struct fast_coeff_online_t {
+  uint64_t wts_by_qp[MAX_FAST_COEFF_COST_QP];
+  fast_coeff_regression_t regression[MAX_FAST_COEFF_COST_QP];
+  uint32_t sample_counter;
+} fast_coeff_online_t;
+
 typedef struct encoder_state_t encoder_state_t;
 
 int uvg_fast_coeff_table_parse(fast_coeff_table_t *fast_coeff_table, FILE *fast_coeff_table_f);
 void uvg_fast_coeff_use_default_table(fast_coeff_table_t *fast_coeff_table);
 uint64_t uvg_fast_coeff_get_weights(const encoder_state_t *state);
 
+fast_coeff_online_t * uvg_fast_coeff_online_alloc(const fast_coeff_table_t *initial);
+void uvg_fast_coeff_online_free(fast_coeff_online_t *online);
+int uvg_fast_coeff_online_sample(fast_coeff_online_t *online);
+void uvg_fast_coeff_online_update(fast_coeff_online_t *online,
+                                  int qp,
+                                  const coeff_t *coeff,
+                                  int width,
+                                  int height,
+                                  double bits);
+
 #endif // FAST_COEFF_COST_H_
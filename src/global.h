@@ -134,6 +134,8 @@ typedef int32_t mv_t;
 
 //#define UVG_DEBUG_PRINT_YUVIEW_CSV 1
 //#define UVG_DEBUG_PRINT_MV_INFO 1
+//#define UVG_DEBUG_PRINT_INTRA_CACHE 1
+//#define UVG_DEBUG_PRINT_TRANSFORM_CACHE 1
 
 //#define UVG_ENCODING_RESUME 1
 
@@ -0,0 +1,184 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "hugepages.h"
+
+#include "threads.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Space before each buffer for the header. Keeps the buffers aligned to
+// cache lines.
+#define HUGEPAGE_HEADER_SIZE 64
+
+enum hugepage_kind {
+  HUGEPAGE_KIND_MALLOC = 0,
+  HUGEPAGE_KIND_HUGETLB = 1,
+  HUGEPAGE_KIND_THP = 2,
+};
+
+typedef struct {
+  size_t map_size;
+  enum hugepage_kind kind;
+} hugepage_header_t;
+
+// Number of users that have enabled huge pages. Huge pages are used while
+// it is not zero.
+static volatile int32_t hugepages_users = 0;
+
+// Set when a MAP_HUGETLB mapping fails, which usually means that no huge
+// pages have been reserved. Transparent huge pages are used after that.
+static volatile bool hugetlb_failed = false;
+
+
+/**
+ * \brief Use huge pages for buffers allocated after the call.
+ *
+ * Each call must be paired with uvg_hugepages_release. Buffers are always
+ * freed correctly regardless of the setting at the time of the free.
+ */
+void uvg_hugepages_acquire(void)
+{
+  UVG_ATOMIC_INC(&hugepages_users);
+}
+
+/**
+ * \brief Stop using huge pages when the last user has released them.
+ */
+void uvg_hugepages_release(void)
+{
+  const int32_t users = UVG_ATOMIC_DEC(&hugepages_users);
+  assert(users >= 0);
+  (void)users;
+}
+
+bool uvg_hugepages_enabled(void)
+{
+  return hugepages_users > 0;
+}
+
+/**
+ * \brief Allocate a buffer and store how it was allocated in its header.
+ *
+ * \param zero  set if the buffer has to be zeroed
+ * \return buffer or NULL on failure
+ */
+static void *hugepage_alloc(size_t size, bool zero)
+{
+  size_t map_size = size + HUGEPAGE_HEADER_SIZE;
+  hugepage_header_t *header = NULL;
+  enum hugepage_kind kind = HUGEPAGE_KIND_MALLOC;
+
+#ifdef __linux__
+  if (uvg_hugepages_enabled() && map_size >= HUGEPAGE_SIZE / 2) {
+    map_size = (map_size + HUGEPAGE_SIZE - 1) & ~(size_t)(HUGEPAGE_SIZE - 1);
+
+    if (!hugetlb_failed) {
+      void *ptr = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (ptr != MAP_FAILED) {
+        // Anonymous mappings are already zeroed.
+        header = ptr;
+        kind = HUGEPAGE_KIND_HUGETLB;
+        zero = false;
+      } else {
+        hugetlb_failed = true;
+      }
+    }
+
+    if (!header) {
+      void *ptr = NULL;
+      if (posix_memalign(&ptr, HUGEPAGE_SIZE, map_size) == 0) {
+#ifdef MADV_HUGEPAGE
+        madvise(ptr, map_size, MADV_HUGEPAGE);
+#endif
+        header = ptr;
+        kind = HUGEPAGE_KIND_THP;
+      }
+    }
+  }
+#endif
+
+  if (!header) {
+    map_size = size + HUGEPAGE_HEADER_SIZE;
+    header = malloc(map_size);
+    if (!header) return NULL;
+    kind = HUGEPAGE_KIND_MALLOC;
+  }
+
+  header->map_size = map_size;
+  header->kind = kind;
+
+  void *const buf = (uint8_t*)header + HUGEPAGE_HEADER_SIZE;
+  if (zero) memset(buf, 0, size);
+  return buf;
+}
+
+/**
+ * \brief Allocate a buffer, with huge pages if enabled and it is large enough.
+ *
+ * The buffer must be freed with uvg_hugepage_free.
+ *
+ * \return buffer or NULL on failure
+ */
+void *uvg_hugepage_alloc(size_t size)
+{
+  return hugepage_alloc(size, false);
+}
+
+/**
+ * \brief Allocate a zeroed buffer like uvg_hugepage_alloc.
+ */
+void *uvg_hugepage_calloc(size_t size)
+{
+  return hugepage_alloc(size, true);
+}
+
+void uvg_hugepage_free(void *ptr)
+{
+  if (!ptr) return;
+
+  hugepage_header_t *header = (hugepage_header_t*)((uint8_t*)ptr - HUGEPAGE_HEADER_SIZE);
+#ifdef __linux__
+  if (header->kind == HUGEPAGE_KIND_HUGETLB) {
+    munmap(header, header->map_size);
+    return;
+  }
+#endif
+  free(header);
+}
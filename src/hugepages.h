@@ -0,0 +1,63 @@
+#ifndef HUGEPAGES_H_
+#define HUGEPAGES_H_
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+/**
+ * \ingroup DataStructures
+ * \file
+ * Allocation of large buffers backed by huge pages.
+ *
+ * Frame sized buffers are accessed with large strides, which causes many
+ * TLB misses with 4 KB pages. When enabled, buffers of at least half a huge
+ * page are mapped with MAP_HUGETLB. If no huge pages are reserved, they are
+ * aligned to huge pages and the kernel is asked to back them with
+ * transparent huge pages. Only implemented on Linux.
+ */
+
+#include "global.h" // IWYU pragma: keep
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Size of the huge pages that are requested.
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+void uvg_hugepages_acquire(void);
+void uvg_hugepages_release(void);
+bool uvg_hugepages_enabled(void);
+
+void *uvg_hugepage_alloc(size_t size);
+void *uvg_hugepage_calloc(size_t size);
+void uvg_hugepage_free(void *ptr);
+
+#endif // HUGEPAGES_H_
@@ -32,13 +32,40 @@
 
 #include "image.h"
 
+#include "affinity.h"
+#include "hugepages.h"
+
 #include <limits.h>
 #include <stdlib.h>
 
+#include "strategies/strategies-input.h"
 #include "strategies/strategies-ipol.h"
 #include "strategies/strategies-picture.h"
 #include "threads.h"
 
+// Maximum number of returned pictures a pool keeps for reuse.
+#define IMAGE_POOL_MAX_FREE 64
+
+// Rows of a frame of input converted by one job.
+#define IMAGE_LOAD_STRIPE_ROWS 64
+
+struct uvg_picture_pool {
+  pthread_mutex_t lock;
+
+  /**
+   * \brief One reference for the owner and one for each picture in use
+   */
+  int32_t refcount;
+
+  /**
+   * \brief Set when the owner has freed the pool
+   */
+  bool closed;
+
+  uvg_picture *free_pictures[IMAGE_POOL_MAX_FREE];
+  int num_free;
+};
+
 /**
 * \brief Allocate a new image with 420.
 * This function signature is part of the libkvz API.
@@ -74,7 +101,7 @@ uvg_picture * uvg_image_alloc(enum uvg_chroma_format chroma_format, const int32_
   im->chroma_format = chroma_format;
 
   //Allocate memory, pad the full data buffer from both ends
-  im->fulldata_buf = MALLOC_SIMD_PADDED(uvg_pixel, (luma_size + 2 * chroma_size), simd_padding_width * 2);
+  im->fulldata_buf = uvg_hugepage_alloc(sizeof(uvg_pixel) * (luma_size + 2 * chroma_size) + simd_padding_width * 2);
   if (!im->fulldata_buf) {
     free(im);
     return NULL;
@@ -110,9 +137,565 @@ uvg_picture * uvg_image_alloc(enum uvg_chroma_format chroma_format, const int32_
   im->roi.width = 0;
   im->roi.height = 0;
 
+  im->pool = NULL;
+
+  im->chroma_stride = im->stride / 2;
+  im->release = NULL;
+  im->release_opaque = NULL;
+
   return im;
 }
 
+/**
+ * \brief Make a picture of pixel planes owned by the caller.
+ *
+ * The picture has no buffer of its own. When its last reference is freed,
+ * release is called with opaque.
+ *
+ * \return picture or NULL on failure
+ */
+uvg_picture *uvg_image_wrap(enum uvg_chroma_format chroma_format,
+                            int32_t width, int32_t height,
+                            uvg_pixel *y, uvg_pixel *u, uvg_pixel *v,
+                            int32_t luma_stride, int32_t chroma_stride,
+                            void (*release)(void *opaque), void *opaque)
+{
+  // The encoder only takes 4:0:0 and 4:2:0 input.
+  if (chroma_format != UVG_CSP_400 && chroma_format != UVG_CSP_420) return NULL;
+  if (width <= 0 || height <= 0 || width % 2 || height % 2 || !y || luma_stride < width) {
+    return NULL;
+  }
+  if (chroma_format == UVG_CSP_420 && (!u || !v || chroma_stride < width / 2)) {
+    return NULL;
+  }
+
+  uvg_picture *im = MALLOC(uvg_picture, 1);
+  if (!im) return NULL;
+
+  im->fulldata_buf = NULL;
+  im->fulldata = y;
+  im->refcount = 1; //We give a reference to caller
+  im->width = width;
+  im->height = height;
+  im->stride = luma_stride;
+  im->chroma_stride = chroma_format == UVG_CSP_400 ? 0 : chroma_stride;
+  im->chroma_format = chroma_format;
+  im->base_image = im;
+
+  im->y = im->data[COLOR_Y] = y;
+  if (chroma_format == UVG_CSP_400) {
+    im->u = im->data[COLOR_U] = NULL;
+    im->v = im->data[COLOR_V] = NULL;
+  } else {
+    im->u = im->data[COLOR_U] = u;
+    im->v = im->data[COLOR_V] = v;
+  }
+
+  im->pts = 0;
+  im->dts = 0;
+
+  im->interlacing = UVG_INTERLACING_NONE;
+
+  im->roi.roi_array = NULL;
+  im->roi.width = 0;
+  im->roi.height = 0;
+
+  im->pool = NULL;
+
+  im->release = release;
+  im->release_opaque = opaque;
+
+  return im;
+}
+
+/**
+ * \brief Check whether the encoder can read a picture directly.
+ *
+ * Pictures made with uvg_image_wrap can have any strides and size. The
+ * encoder needs the frame size padded to a multiple of 8 and the chroma
+ * stride to be half of the luma stride.
+ */
+bool uvg_image_is_encodable(const uvg_picture *im, int32_t width, int32_t height)
+{
+  return im->width == width &&
+         im->height == height &&
+         (im->chroma_format == UVG_CSP_400 || im->chroma_stride == im->stride / 2);
+}
+
+/**
+ * \brief Extend the last column of rows of a plane to the stride.
+ */
+static void pad_rows(uvg_pixel *dst, int32_t dst_stride, int32_t width,
+                     int32_t first_row, int32_t last_row)
+{
+  for (int32_t y = first_row; y < last_row; y++) {
+    uvg_pixel *const row = &dst[y * dst_stride];
+    for (int32_t x = width; x < dst_stride; x++) {
+      row[x] = row[width - 1];
+    }
+  }
+}
+
+/**
+ * \brief Extend the last row of a plane to the height.
+ */
+static void pad_bottom(uvg_pixel *dst, int32_t dst_stride, int32_t dst_height,
+                       int32_t height)
+{
+  for (int32_t y = height; y < dst_height; y++) {
+    memcpy(&dst[y * dst_stride], &dst[(height - 1) * dst_stride], dst_stride * sizeof(uvg_pixel));
+  }
+}
+
+/**
+ * \brief Extend the last column and row of a plane to the stride and height.
+ */
+static void pad_plane(uvg_pixel *dst, int32_t dst_stride, int32_t dst_height,
+                      int32_t width, int32_t height)
+{
+  pad_rows(dst, dst_stride, width, 0, height);
+  pad_bottom(dst, dst_stride, dst_height, height);
+}
+
+/**
+ * \brief Copy a plane and extend its last column and row.
+ */
+static void copy_plane_padded(const uvg_pixel *src, int32_t src_stride,
+                              int32_t src_width, int32_t src_height,
+                              uvg_pixel *dst, int32_t dst_stride, int32_t dst_height)
+{
+  for (int32_t y = 0; y < src_height; y++) {
+    memcpy(&dst[y * dst_stride], &src[y * src_stride], src_width * sizeof(uvg_pixel));
+  }
+  pad_plane(dst, dst_stride, dst_height, src_width, src_height);
+}
+
+/**
+ * \brief Copy a picture to a picture of the given size from a pool.
+ *
+ * Pixels past the right and bottom edges are filled with the last column
+ * and row, like when reading a frame of an unpadded size from a file.
+ * The region of interest is moved to the copy.
+ *
+ * \return picture or NULL on failure
+ */
+uvg_picture *uvg_image_copy_padded(uvg_picture_pool *pool, uvg_picture *im,
+                                   int32_t width, int32_t height)
+{
+  assert(width >= im->width && height >= im->height);
+
+  uvg_picture *copy = uvg_image_pool_get(pool, im->chroma_format, width, height);
+  if (!copy) return NULL;
+
+  copy_plane_padded(im->y, im->stride, im->width, im->height,
+                    copy->y, copy->stride, copy->height);
+  if (im->chroma_format != UVG_CSP_400) {
+    for (int c = COLOR_U; c <= COLOR_V; c++) {
+      copy_plane_padded(im->data[c], im->chroma_stride, im->width / 2, im->height / 2,
+                        copy->data[c], copy->chroma_stride, copy->height / 2);
+    }
+  }
+
+  copy->pts = im->pts;
+  copy->dts = im->dts;
+  copy->interlacing = im->interlacing;
+  copy->roi = im->roi;
+  im->roi.roi_array = NULL;
+
+  return copy;
+}
+
+/**
+ * \brief Rows of a frame of input to convert to a picture.
+ */
+typedef struct {
+  uvg_picture *im;
+  enum uvg_input_format format;
+  //! Y, U and V planes, or Y and interleaved chroma planes
+  const uint8_t *planes[3];
+  //! Distances between rows of the planes in bytes
+  int32_t strides[3];
+  int32_t width;
+  int bytes_per_sample;
+  //! Conversion of 16-bit samples, see convert_16bit
+  uint16_t mask;
+  int shift_right;
+  int shift_left;
+  //! Luma rows to convert, first_row is even
+  int32_t first_row;
+  int32_t last_row;
+} image_load_t;
+
+static bool machine_is_big_endian(void)
+{
+  uint16_t number = 1;
+  return *(uint8_t *)&number == 0;
+}
+
+/**
+ * \brief Convert a row of samples of a plane.
+ *
+ * \param swap_buf  buffer for count byte swapped samples, or NULL if the
+ *                  samples are in host byte order
+ */
+static void load_row(const image_load_t *load, const uint8_t *src,
+                     uvg_pixel *dst, int32_t count, uint16_t *swap_buf)
+{
+  if (load->bytes_per_sample == 1) {
+    uvg_convert_8bit(src, dst, count, load->shift_left);
+  } else {
+    const uint16_t *samples = (const uint16_t *)src;
+    if (swap_buf) {
+      uvg_swap_16bit(samples, swap_buf, count);
+      samples = swap_buf;
+    }
+    uvg_convert_16bit(samples, dst, count, load->mask, load->shift_right, load->shift_left);
+  }
+}
+
+/**
+ * \brief Split a row of interleaved chroma samples.
+ */
+static void load_interleaved_row(const image_load_t *load, const uint8_t *src,
+                                 uvg_pixel *dst_a, uvg_pixel *dst_b,
+                                 int32_t count, uint16_t *swap_buf)
+{
+  if (load->bytes_per_sample == 1) {
+    uvg_deinterleave_8bit(src, dst_a, dst_b, count, load->shift_left);
+  } else {
+    const uint16_t *samples = (const uint16_t *)src;
+    if (swap_buf) {
+      uvg_swap_16bit(samples, swap_buf, 2 * count);
+      samples = swap_buf;
+    }
+    uvg_deinterleave_16bit(samples, dst_a, dst_b, count, load->shift_right, load->shift_left);
+  }
+}
+
+/**
+ * \brief Convert the rows of a frame of input and extend their last column.
+ */
+static void image_load_rows(void *arg)
+{
+  const image_load_t *const load = arg;
+  uvg_picture *const im = load->im;
+  const int32_t width = load->width;
+
+  // Input samples are little endian.
+  uint16_t *swap_buf = NULL;
+  if (load->bytes_per_sample == 2 && machine_is_big_endian()) {
+    swap_buf = MALLOC(uint16_t, width);
+    assert(swap_buf);
+  }
+
+  for (int32_t y = load->first_row; y < load->last_row; y++) {
+    load_row(load, &load->planes[0][y * load->strides[0]], &im->y[y * im->stride],
+             width, swap_buf);
+  }
+  pad_rows(im->y, im->stride, width, load->first_row, load->last_row);
+
+  if (im->chroma_format != UVG_CSP_400) {
+    const int32_t first = load->first_row / 2;
+    const int32_t last = load->last_row / 2;
+
+    if (UVG_FORMAT_IS_SEMIPLANAR(load->format)) {
+      // NV21 has V before U.
+      uvg_pixel *const dst_a = load->format == UVG_FORMAT_NV21 ? im->v : im->u;
+      uvg_pixel *const dst_b = load->format == UVG_FORMAT_NV21 ? im->u : im->v;
+      for (int32_t y = first; y < last; y++) {
+        load_interleaved_row(load, &load->planes[1][y * load->strides[1]],
+                             &dst_a[y * im->chroma_stride], &dst_b[y * im->chroma_stride],
+                             width / 2, swap_buf);
+      }
+    } else {
+      for (int c = COLOR_U; c <= COLOR_V; c++) {
+        for (int32_t y = first; y < last; y++) {
+          load_row(load, &load->planes[c][y * load->strides[c]],
+                   &im->data[c][y * im->chroma_stride], width / 2, swap_buf);
+        }
+      }
+    }
+    pad_rows(im->u, im->chroma_stride, width / 2, first, last);
+    pad_rows(im->v, im->chroma_stride, width / 2, first, last);
+  }
+
+  FREE_POINTER(swap_buf);
+}
+
+/**
+ * \brief Convert a frame of input to a picture.
+ *
+ * Large frames are converted in stripes of IMAGE_LOAD_STRIPE_ROWS rows by
+ * the worker threads, with a priority over encoding so that reading the
+ * input does not wait behind it. The threadqueue must have worker threads,
+ * or be NULL to convert the frame on the calling thread.
+ */
+static void image_load(threadqueue_queue_t *threadqueue, image_load_t *load,
+                       int32_t height)
+{
+  uvg_picture *const im = load->im;
+  const int32_t num_stripes = (height + IMAGE_LOAD_STRIPE_ROWS - 1) / IMAGE_LOAD_STRIPE_ROWS;
+
+  image_load_t *stripes = NULL;
+  threadqueue_job_t **jobs = NULL;
+  if (threadqueue && num_stripes > 1) {
+    stripes = MALLOC(image_load_t, num_stripes);
+    jobs = calloc(num_stripes, sizeof(threadqueue_job_t *));
+  }
+
+  if (!stripes || !jobs) {
+    load->first_row = 0;
+    load->last_row = height;
+    image_load_rows(load);
+  } else {
+    for (int32_t i = 0; i < num_stripes; i++) {
+      stripes[i] = *load;
+      stripes[i].first_row = i * IMAGE_LOAD_STRIPE_ROWS;
+      stripes[i].last_row = MIN(height, (i + 1) * IMAGE_LOAD_STRIPE_ROWS);
+    }
+    // The first stripe is converted by this thread.
+    for (int32_t i = 1; i < num_stripes; i++) {
+      jobs[i] = uvg_threadqueue_job_create(image_load_rows, &stripes[i]);
+      if (!jobs[i]) {
+        image_load_rows(&stripes[i]);
+        continue;
+      }
+      uvg_threadqueue_job_set_priority(jobs[i], INT64_MAX);
+      uvg_threadqueue_job_set_label(jobs[i], "input", -1, -1, -1, i);
+      uvg_threadqueue_submit(threadqueue, jobs[i]);
+    }
+    image_load_rows(&stripes[0]);
+    for (int32_t i = 1; i < num_stripes; i++) {
+      if (!jobs[i]) continue;
+      uvg_threadqueue_waitfor(threadqueue, jobs[i]);
+      uvg_threadqueue_free_job(&jobs[i]);
+    }
+  }
+  FREE_POINTER(stripes);
+  FREE_POINTER(jobs);
+
+  pad_bottom(im->y, im->stride, im->height, height);
+  if (im->chroma_format != UVG_CSP_400) {
+    pad_bottom(im->u, im->chroma_stride, im->height / 2, height / 2);
+    pad_bottom(im->v, im->chroma_stride, im->height / 2, height / 2);
+  }
+}
+
+/**
+ * \brief Check the size and strides of a frame of input for a picture.
+ */
+static bool image_load_fits(const uvg_picture *im, int bytes_per_sample,
+                            int32_t luma_stride, int32_t chroma_stride,
+                            int32_t chroma_width, int32_t width, int32_t height)
+{
+  return width > 0 && height > 0 && width % 2 == 0 && height % 2 == 0 &&
+         width <= im->width && height <= im->height &&
+         luma_stride >= width * bytes_per_sample &&
+         (im->chroma_format == UVG_CSP_400 ||
+          chroma_stride >= chroma_width * bytes_per_sample) &&
+         (bytes_per_sample == 1 || (luma_stride % 2 == 0 && chroma_stride % 2 == 0));
+}
+
+/**
+ * \brief Convert a frame of planar input to a picture.
+ *
+ * Samples of input_bitdepth 8 are bytes, and samples of higher bit depths
+ * are little endian 16-bit words with the sample in the low bits. Pixels
+ * past the frame are filled like in uvg_image_copy_padded.
+ *
+ * \param threadqueue  queue to convert large frames on, or NULL
+ *
+ * \return 1 on success, 0 if the arguments are not valid
+ */
+int uvg_image_load_planar(threadqueue_queue_t *threadqueue, uvg_picture *im,
+                          int input_bitdepth,
+                          const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                          int32_t luma_stride, int32_t chroma_stride,
+                          int32_t width, int32_t height)
+{
+  const int bytes_per_sample = input_bitdepth > 8 ? 2 : 1;
+
+  if ((im->chroma_format != UVG_CSP_400 && im->chroma_format != UVG_CSP_420) ||
+      (im->chroma_format == UVG_CSP_420 && (!u || !v)) ||
+      input_bitdepth < 8 || input_bitdepth > 16 ||
+      !image_load_fits(im, bytes_per_sample, luma_stride, chroma_stride,
+                       width / 2, width, height)) {
+    return 0;
+  }
+
+  image_load_t load = {
+    .im = im,
+    .format = im->chroma_format == UVG_CSP_400 ? UVG_FORMAT_P400 : UVG_FORMAT_P420,
+    .planes = { y, u, v },
+    .strides = { luma_stride, chroma_stride, chroma_stride },
+    .width = width,
+    .bytes_per_sample = bytes_per_sample,
+    .mask = (uint16_t)((1 << input_bitdepth) - 1),
+    .shift_right = MAX(input_bitdepth - UVG_BIT_DEPTH, 0),
+    .shift_left = MAX(UVG_BIT_DEPTH - input_bitdepth, 0),
+  };
+  image_load(threadqueue, &load, height);
+
+  return 1;
+}
+
+/**
+ * \brief Convert a frame of semi-planar input to a planar picture.
+ *
+ * NV12 and NV21 have 8-bit samples. P010 has little endian 16-bit samples
+ * with the input_bitdepth significant bits in the most significant end.
+ * Pixels past the frame are filled like in uvg_image_copy_padded.
+ *
+ * \param threadqueue  queue to convert large frames on, or NULL
+ *
+ * \return 1 on success, 0 if the arguments are not valid
+ */
+int uvg_image_load_semiplanar(threadqueue_queue_t *threadqueue, uvg_picture *im,
+                              enum uvg_input_format format, int input_bitdepth,
+                              const uint8_t *luma, int32_t luma_stride,
+                              const uint8_t *chroma, int32_t chroma_stride,
+                              int32_t width, int32_t height)
+{
+  const int bytes_per_sample = format == UVG_FORMAT_P010 ? 2 : 1;
+
+  if (!UVG_FORMAT_IS_SEMIPLANAR(format) || im->chroma_format != UVG_CSP_420 ||
+      !image_load_fits(im, bytes_per_sample, luma_stride, chroma_stride,
+                       width, width, height)) {
+    return 0;
+  }
+
+  image_load_t load = {
+    .im = im,
+    .format = format,
+    .planes = { luma, chroma, NULL },
+    .strides = { luma_stride, chroma_stride, 0 },
+    .width = width,
+    .bytes_per_sample = bytes_per_sample,
+    .mask = 0xffff,
+    .shift_left = UVG_BIT_DEPTH - 8,
+  };
+  if (format == UVG_FORMAT_P010) {
+    // Take the significant bits from the top of the word to the output
+    // bit depth, dropping the lowest bits if there are too many.
+    load.shift_right = 16 - MIN(input_bitdepth, UVG_BIT_DEPTH);
+    load.shift_left = MAX(UVG_BIT_DEPTH - input_bitdepth, 0);
+  }
+  image_load(threadqueue, &load, height);
+
+  return 1;
+}
+
+/**
+ * \brief Drop a reference to a pool and free it if it was the last one.
+ *
+ * The caller must have locked the pool.
+ */
+static void image_pool_unref(uvg_picture_pool *pool)
+{
+  if (--pool->refcount > 0) {
+    pthread_mutex_unlock(&pool->lock);
+    return;
+  }
+  pthread_mutex_unlock(&pool->lock);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool);
+}
+
+/**
+ * \brief Return a picture whose last reference was freed to its pool.
+ */
+static void image_pool_return(uvg_picture *im)
+{
+  uvg_picture_pool *pool = im->pool;
+  pthread_mutex_lock(&pool->lock);
+  if (!pool->closed && pool->num_free < IMAGE_POOL_MAX_FREE) {
+    pool->free_pictures[pool->num_free++] = im;
+  } else {
+    uvg_hugepage_free(im->fulldata_buf);
+    free(im);
+  }
+  image_pool_unref(pool);
+}
+
+/**
+ * \brief Allocate a pool of reusable pictures.
+ * \return pool or NULL on failure
+ */
+uvg_picture_pool *uvg_image_pool_alloc(void)
+{
+  uvg_picture_pool *pool = MALLOC(uvg_picture_pool, 1);
+  if (!pool) return NULL;
+  pthread_mutex_init(&pool->lock, NULL);
+  pool->refcount = 1;
+  pool->closed = false;
+  pool->num_free = 0;
+  return pool;
+}
+
+/**
+ * \brief Get a picture from a pool.
+ *
+ * Reuses a returned picture with the same format and size, or allocates a
+ * new one. If pool is NULL, the picture is always allocated.
+ *
+ * \return picture or NULL on failure
+ */
+uvg_picture *uvg_image_pool_get(uvg_picture_pool *pool, enum uvg_chroma_format chroma_format,
+                                int32_t width, int32_t height)
+{
+  if (!pool) return uvg_image_alloc(chroma_format, width, height);
+
+  uvg_picture *im = NULL;
+  pthread_mutex_lock(&pool->lock);
+  for (int i = pool->num_free - 1; i >= 0; i--) {
+    uvg_picture *const pic = pool->free_pictures[i];
+    if (pic->chroma_format == chroma_format && pic->width == width && pic->height == height) {
+      im = pic;
+      pool->free_pictures[i] = pool->free_pictures[--pool->num_free];
+      break;
+    }
+  }
+  pool->refcount++;
+  pthread_mutex_unlock(&pool->lock);
+
+  if (im) {
+    im->refcount = 1;
+    im->pts = 0;
+    im->dts = 0;
+    im->interlacing = UVG_INTERLACING_NONE;
+    return im;
+  }
+
+  im = uvg_image_alloc(chroma_format, width, height);
+  if (!im) {
+    pthread_mutex_lock(&pool->lock);
+    image_pool_unref(pool);
+    return NULL;
+  }
+  im->pool = pool;
+  return im;
+}
+
+/**
+ * \brief Free a pool.
+ *
+ * Pictures of the pool still in use are freed when their last reference is
+ * freed.
+ */
+void uvg_image_pool_free(uvg_picture_pool *pool)
+{
+  if (!pool) return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->closed = true;
+  for (int i = 0; i < pool->num_free; i++) {
+    uvg_hugepage_free(pool->free_pictures[i]->fulldata_buf);
+    free(pool->free_pictures[i]);
+  }
+  pool->num_free = 0;
+  image_pool_unref(pool);
+}
+
 /**
  * \brief Free an image.
  *
@@ -135,8 +718,18 @@ void uvg_image_free(uvg_picture *const im)
     // Free our reference to the base image.
     uvg_image_free(im->base_image);
   } else {
-    free(im->fulldata_buf);
     if (im->roi.roi_array) FREE_POINTER(im->roi.roi_array);
+    if (im->pool) {
+      // Keep the pixels for the next picture of the same size.
+      im->roi.width = 0;
+      im->roi.height = 0;
+      image_pool_return(im);
+      return;
+    }
+    if (im->release) {
+      im->release(im->release_opaque);
+    }
+    uvg_hugepage_free(im->fulldata_buf);
   }
 
   // Make sure freed data won't be used.
@@ -162,6 +755,24 @@ uvg_picture *uvg_image_copy_ref(uvg_picture *im)
   return im;
 }
 
+/**
+ * \brief Move the pixels of an image to a NUMA node.
+ *
+ * \param im    image allocated with uvg_image_alloc, or a subimage of one
+ * \param node  node from 0 to uvg_affinity_num_nodes() - 1
+ */
+void uvg_image_bind_to_node(const uvg_picture *im, int node)
+{
+  const uvg_picture *base = im->base_image;
+  if (!base->fulldata_buf) return;
+
+  const size_t luma_size = (size_t)base->stride * (base->height + FRAME_PADDING_LUMA);
+  const size_t chroma_sizes[] = { 0, luma_size / 4, luma_size / 2, luma_size };
+  const size_t num_pixels = luma_size + 2 * chroma_sizes[base->chroma_format];
+
+  uvg_affinity_bind_memory(base->fulldata_buf, num_pixels * sizeof(uvg_pixel), node);
+}
+
 uvg_picture *uvg_image_make_subimage(uvg_picture *const orig_image,
                              const unsigned x_offset,
                              const unsigned y_offset,
@@ -198,6 +809,11 @@ uvg_picture *uvg_image_make_subimage(uvg_picture *const orig_image,
   im->dts = 0;
 
   im->roi = orig_image->roi;
+  im->pool = NULL;
+
+  im->chroma_stride = orig_image->chroma_stride;
+  im->release = NULL;
+  im->release_opaque = NULL;
 
   return im;
 }
@@ -42,6 +42,7 @@
 
 #include "uvg266.h"
 #include "strategies/optimized_sad_func_ptr_t.h"
+#include "threadqueue.h"
 
 
 typedef struct {
@@ -79,10 +80,36 @@ typedef struct {
 uvg_picture *uvg_image_alloc_420(const int32_t width, const int32_t height);
 uvg_picture *uvg_image_alloc(enum uvg_chroma_format chroma_format, const int32_t width, const int32_t height);
 
+uvg_picture *uvg_image_wrap(enum uvg_chroma_format chroma_format,
+                            int32_t width, int32_t height,
+                            uvg_pixel *y, uvg_pixel *u, uvg_pixel *v,
+                            int32_t luma_stride, int32_t chroma_stride,
+                            void (*release)(void *opaque), void *opaque);
+bool uvg_image_is_encodable(const uvg_picture *im, int32_t width, int32_t height);
+uvg_picture *uvg_image_copy_padded(uvg_picture_pool *pool, uvg_picture *im,
+                                   int32_t width, int32_t height);
+int uvg_image_load_planar(threadqueue_queue_t *threadqueue, uvg_picture *im,
+                          int input_bitdepth,
+                          const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                          int32_t luma_stride, int32_t chroma_stride,
+                          int32_t width, int32_t height);
+int uvg_image_load_semiplanar(threadqueue_queue_t *threadqueue, uvg_picture *im,
+                              enum uvg_input_format format, int input_bitdepth,
+                              const uint8_t *luma, int32_t luma_stride,
+                              const uint8_t *chroma, int32_t chroma_stride,
+                              int32_t width, int32_t height);
+
 void uvg_image_free(uvg_picture *const im);
 
 uvg_picture *uvg_image_copy_ref(uvg_picture *im);
 
+void uvg_image_bind_to_node(const uvg_picture *im, int node);
+
+uvg_picture_pool *uvg_image_pool_alloc(void);
+uvg_picture *uvg_image_pool_get(uvg_picture_pool *pool, enum uvg_chroma_format chroma_format,
+                                int32_t width, int32_t height);
+void uvg_image_pool_free(uvg_picture_pool *pool);
+
 uvg_picture *uvg_image_make_subimage(uvg_picture *const orig_image,
                              const unsigned x_offset,
                              const unsigned y_offset,
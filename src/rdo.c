@@ -41,6 +41,7 @@
 #include "cabac.h"
 #include "context.h"
 #include "encode_coding_tree.h"
+#include "encode_coding_tree-coeff.h"
 #include "encoder.h"
 #include "imagelist.h"
 #include "inter.h"
@@ -318,6 +319,19 @@ static INLINE double get_coeff_cabac_cost(
   }
   if (!found) return 0;
 
+  if (!tr_skip && state->search_cabac.journal) {
+    // Count directly on the search CABAC and undo the context updates
+    // through the journal unless they are meant to be kept.
+    cabac_data_t * const cabac = (cabac_data_t *)&state->search_cabac;
+    cabac_estimator_t est = { &cabac->ctx, cabac->journal };
+    cabac_mark_t mark;
+    uvg_cabac_journal_mark(cabac, &mark);
+    double last_bits;
+    const double bits = uvg_coeff_walk_nxn(state, NULL, &est, coeff, cu_loc, color, scan_mode, cur_tu, &last_bits);
+    if (!cabac->update) uvg_cabac_journal_rollback(cabac, &mark);
+    return last_bits + bits;
+  }
+
   // Take a copy of the CABAC so that we don't overwrite the contexts when
   // counting the bits.
   cabac_data_t cabac_copy;
@@ -326,6 +340,8 @@ static INLINE double get_coeff_cabac_cost(
   // Clear bytes and bits and set mode to "count"
   cabac_copy.only_count = 1;
   cabac_copy.update = 1;
+  // Updates only need to be journaled if the copy is written back.
+  if (!state->search_cabac.update) cabac_copy.journal = NULL;
   double bits = 0;
 
   // Execute the coding function.
@@ -441,6 +457,9 @@ double uvg_get_coeff_cost(
       if (check_accuracy) {
         double ccc = get_coeff_cabac_cost(state, coeff_ptr, cu_loc, color, scan_mode, tr_skip, cur_tu);
         save_accuracy(state->qp, ccc, fast_cost);
+      } else if (state->fast_coeff_online && uvg_fast_coeff_online_sample(state->fast_coeff_online)) {
+        double ccc = get_coeff_cabac_cost(state, coeff_ptr, cu_loc, color, scan_mode, tr_skip, cur_tu);
+        uvg_fast_coeff_online_update(state->fast_coeff_online, state->qp, coeff_ptr, width, height, ccc);
       }
       return fast_cost;
     }
@@ -1878,6 +1897,7 @@ double uvg_get_mvd_coding_cost_cabac(const encoder_state_t* state,
 {
   cabac_data_t cabac_copy = *cabac;
   cabac_copy.only_count = 1;
+  cabac_copy.journal = NULL;
   double bits = 0;
   // It is safe to drop const here because cabac->only_count is set.
   uvg_encode_mvd((encoder_state_t*) state, &cabac_copy, mvd_hor, mvd_ver, &bits);
@@ -1925,6 +1945,7 @@ double uvg_calc_ibc_mvd_cost_cabac(const encoder_state_t * state,
 
   // Clear bytes and bits and set mode to "count"
   state_cabac_copy.only_count = 1;
+  state_cabac_copy.journal = NULL;
 
   cabac = &state_cabac_copy;
   double bits = 0;
@@ -2031,6 +2052,7 @@ double uvg_calc_mvd_cost_cabac(const encoder_state_t * state,
 
   // Clear bytes and bits and set mode to "count"
   state_cabac_copy.only_count = 1;
+  state_cabac_copy.journal = NULL;
 
   cabac = &state_cabac_copy;
   double bits = 0;
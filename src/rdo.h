@@ -105,5 +105,40 @@ double uvg_get_mvd_coding_cost_cabac(const encoder_state_t* state,
 extern const uint32_t uvg_entropy_bits[512];
 #define CTX_ENTROPY_BITS(ctx, val) uvg_entropy_bits[(CTX_STATE(ctx)<<1) ^ (val)]
 
+// Number of fractional bits in fixed point RD costs.
+#define RD_COST_FRAC_BITS CTX_FRAC_BITS
+
+/**
+ * \brief RD cost in fixed point with RD_COST_FRAC_BITS fractional bits.
+ *
+ * Used in search loops where the distortion is an integer SAD or SATD and
+ * the rate comes from CTX_ENTROPY_BITS, so that no floating point is
+ * needed until the final cost is handed out.
+ */
+typedef int64_t rd_cost_fx_t;
+
+static INLINE int64_t uvg_lambda_to_fx(double lambda)
+{
+  return (int64_t)(lambda * (1 << RD_COST_FRAC_BITS) + 0.5);
+}
+
+/**
+ * \brief Calculate dist + lambda * bits in fixed point.
+ *
+ * \param dist       distortion, non-negative
+ * \param bits       rate in CTX_FRAC_BITS fixed point
+ * \param lambda_fx  lambda from uvg_lambda_to_fx
+ */
+static INLINE rd_cost_fx_t uvg_rd_cost_fx(int64_t dist, uint32_t bits, int64_t lambda_fx)
+{
+  return dist * (1 << RD_COST_FRAC_BITS) +
+         (((int64_t)bits * lambda_fx + CTX_FRAC_HALF_BIT) >> CTX_FRAC_BITS);
+}
+
+static INLINE double uvg_rd_cost_fx_to_double(rd_cost_fx_t cost)
+{
+  return cost / (double)(1 << RD_COST_FRAC_BITS);
+}
+
 
 #endif
@@ -39,6 +39,7 @@
 #include "cu.h"
 #include "encoder.h"
 #include "encode_coding_tree.h"
+#include "fast_coeff_cost.h"
 #include "filter.h"
 #include "imagelist.h"
 #include "inter.h"
@@ -50,6 +51,7 @@
 #include "search_intra.h"
 #include "search_ibc.h"
 #include "threadqueue.h"
+#include "threads.h"
 #include "transform.h"
 #include "videoframe.h"
 #include "strategies/strategies-picture.h"
@@ -1200,6 +1202,77 @@ static bool check_for_early_termission(const int cu_width, const int cu_height,
   return false;
 }
 
+// Sum of squared deviations from the mean of a part consisting of n pixels.
+static INLINE double part_sse(uint64_t sum, uint64_t sum_sq, uint32_t n)
+{
+  return (double)sum_sq - (double)sum * sum / n;
+}
+
+/**
+ * \brief Rule out MTT splits that are unlikely to win based on the source
+ *        pixels of the CU.
+ *
+ * If the texture changes mostly along one axis, splits whose boundaries run
+ * along that axis do not separate the content and are skipped. Ternary splits
+ * are skipped when their parts do not have less variance than the parts of the
+ * binary split in the same direction. A flat block is not split with MTT at all.
+ */
+static void prune_mtt_splits(const lcu_t* const lcu, const cu_loc_t* const cu_loc, bool can_split[6])
+{
+  // Gradient ratio, in eighths, at which the weaker direction gets pruned.
+  const uint64_t GRADIENT_RATIO = 12;
+
+  const int width = cu_loc->width;
+  const int height = cu_loc->height;
+  const uvg_pixel* src = &lcu->ref.y[cu_loc->local_x + cu_loc->local_y * LCU_WIDTH];
+
+  uint32_t grad_hor, grad_ver;
+  uvg_directional_gradients(src, LCU_WIDTH, width, height, &grad_hor, &grad_ver);
+
+  if (grad_hor == 0 && grad_ver == 0) {
+    can_split[BT_HOR_SPLIT] = can_split[BT_VER_SPLIT] = false;
+    can_split[TT_HOR_SPLIT] = can_split[TT_VER_SPLIT] = false;
+    return;
+  }
+
+  // Compare the mean absolute differences of both directions.
+  const uint64_t hor = (uint64_t)grad_hor * width * (height - 1);
+  const uint64_t ver = (uint64_t)grad_ver * (width - 1) * height;
+  if (hor * 8 > ver * GRADIENT_RATIO) {
+    // Pixels change from column to column, horizontal split lines don't help.
+    can_split[BT_HOR_SPLIT] = can_split[TT_HOR_SPLIT] = false;
+  }
+  else if (ver * 8 > hor * GRADIENT_RATIO) {
+    can_split[BT_VER_SPLIT] = can_split[TT_VER_SPLIT] = false;
+  }
+
+  for (int dir = 0; dir < 2; ++dir) {
+    const int bt = dir == 0 ? BT_HOR_SPLIT : BT_VER_SPLIT;
+    const int tt = dir == 0 ? TT_HOR_SPLIT : TT_VER_SPLIT;
+    if (!can_split[bt] || !can_split[tt]) continue;
+
+    // Statistics of the four quarters of the block in the split direction,
+    // the BT and TT parts are unions of these.
+    uint32_t sum[4];
+    uint64_t sum_sq[4];
+    const int q_width = dir == 0 ? width : width / 4;
+    const int q_height = dir == 0 ? height / 4 : height;
+    for (int i = 0; i < 4; ++i) {
+      const uvg_pixel* q = dir == 0 ? &src[i * q_height * LCU_WIDTH] : &src[i * q_width];
+      uvg_block_sum_sq(q, LCU_WIDTH, q_width, q_height, &sum[i], &sum_sq[i]);
+    }
+    const uint32_t n = q_width * q_height;
+    const double bt_sse = part_sse(sum[0] + sum[1], sum_sq[0] + sum_sq[1], 2 * n) +
+                          part_sse(sum[2] + sum[3], sum_sq[2] + sum_sq[3], 2 * n);
+    const double tt_sse = part_sse(sum[0], sum_sq[0], n) +
+                          part_sse(sum[1] + sum[2], sum_sq[1] + sum_sq[2], 2 * n) +
+                          part_sse(sum[3], sum_sq[3], n);
+    if (tt_sse >= bt_sse) {
+      can_split[tt] = false;
+    }
+  }
+}
+
 static bool check_can_use_inter(const encoder_state_t* const state,
                                 const cu_loc_t* const cu_loc,
                                 const split_tree_t split_tree,
@@ -1276,6 +1349,736 @@ static bool check_can_use_intra(const encoder_state_t* const state,
   return true;
 }
 
+/**
+ * \brief Parameters of a CU shared by the searches of its split types.
+ */
+typedef struct {
+  const cu_loc_t *cu_loc;
+  const cu_loc_t *chroma_loc;
+  lcu_t *lcu;
+  enum uvg_tree_type tree_type;
+  split_tree_t split_tree;
+  bool has_chroma;
+  bool completely_inside;
+  enum mode_type mode_type_parent;
+  int32_t pu_depth_inter_min;
+  int32_t pu_depth_inter_max;
+  //! Cost of not splitting the CU.
+  double cost;
+  //! HMVP tables at the start of the search of the CU.
+  const cu_info_t *hmvp_lut;
+  uint8_t hmvp_lut_size;
+  const cu_info_t *hmvp_lut_ibc;
+  uint8_t hmvp_lut_size_ibc;
+} split_search_t;
+
+static double search_cu(
+  encoder_state_t* const state,
+  const cu_loc_t* const cu_loc,
+  const cu_loc_t* const chroma_loc,
+  lcu_t* lcu,
+  enum uvg_tree_type tree_type,
+  const split_tree_t split_tree,
+  bool has_chroma);
+
+/**
+ * \brief Search one split type of a CU.
+ *
+ * The contexts of search_cabac and the HMVP tables are left to the state
+ * of the best mode type of the split.
+ *
+ * \param best_split_cost  cost of the best split type so far, used for
+ *                         terminating the search early
+ * \param split_lcu        work tree for the split
+ * \param can_split        set to false if the split was terminated early
+ * \param unpruned_cost    Returns the largest cost that was compared
+ *                         against best_split_cost without terminating the
+ *                         search. The search runs the same way with any
+ *                         best_split_cost at least this large. May be NULL.
+ *
+ * \return false if no mode type of the split could be searched
+ */
+static bool search_split_type(
+  encoder_state_t * const state,
+  const split_search_t * const s,
+  const cabac_mark_t * const pre_search_cabac,
+  const enum split_type split_type,
+  bool * const is_implicit,
+  const double best_split_cost,
+  lcu_t * const split_lcu,
+  bool * const can_split,
+  double * const split_cost_out,
+  bool * const stop_to_qt_out,
+  double * const unpruned_cost)
+{
+  const cu_loc_t * const cu_loc = s->cu_loc;
+  const cu_loc_t * const chroma_loc = s->chroma_loc;
+  lcu_t * const lcu = s->lcu;
+  const enum uvg_tree_type tree_type = s->tree_type;
+  const split_tree_t split_tree = s->split_tree;
+  const bool has_chroma = s->has_chroma;
+  const int depth = split_tree.current_depth;
+  const int x = cu_loc->x;
+  const int y = cu_loc->y;
+  const int x_local = SUB_SCU(x);
+  const int y_local = SUB_SCU(y);
+  const cu_info_t * const cur_cu = LCU_GET_CU_AT_PX(lcu, x_local, y_local);
+  const uint32_t ctu_row = (cu_loc->y >> LOG2_LCU_WIDTH);
+  const uint32_t ctu_row_mul_five = ctu_row * MAX_NUM_HMVP_CANDS;
+
+  // 3.7
+  bool stop_to_qt = false;
+  if (unpruned_cost) *unpruned_cost = 0.0;
+
+  double split_cost = 0.0;
+  double split_bits = 0;
+
+
+  //Determine what mode types should be searched
+  const enum mode_type_condition mode_type_cond = uvg_derive_mode_type_cond(cu_loc, state->frame->slicetype, tree_type, state->encoder_control->chroma_format, split_type, s->mode_type_parent);
+
+  double best_mode_type_cost = MAX_DOUBLE;
+  bool best_mode_type_stop_to_qt = false;
+  bool best_mode_type_can_split = true;
+  lcu_t * best_mode_type_lcu = NULL;
+  cabac_snapshot_t best_mode_type_cabac;
+  cu_info_t best_mode_type_hmvp_lut[MAX_NUM_HMVP_CANDS];
+  uint8_t best_mode_type_hmvp_lut_size = state->tile->frame->hmvp_size[ctu_row];
+  cu_info_t best_mode_type_hmvp_lut_ibc[MAX_NUM_HMVP_CANDS];
+  uint8_t best_mode_type_hmvp_lut_size_ibc = state->tile->frame->hmvp_size_ibc[ctu_row];
+
+  enum mode_type start_mode_type, end_mode_type;
+  switch (mode_type_cond)
+  {
+  case MODE_TYPE_INHERIT:
+    start_mode_type = end_mode_type = s->mode_type_parent;
+    break;
+
+  case MODE_TYPE_INFER:
+    start_mode_type = end_mode_type = MODE_TYPE_INTRA;
+    break;
+
+  case MODE_TYPE_SIGNAL:
+    start_mode_type = MODE_TYPE_INTER;
+    end_mode_type = MODE_TYPE_INTRA;
+    break;
+  }
+  for( enum mode_type mode_type = start_mode_type; mode_type <= end_mode_type; mode_type++) {
+    if (start_mode_type != end_mode_type) {
+      //If we do multiple rounds, reset relevant things
+      *can_split = true;
+      stop_to_qt = false;
+      split_cost = split_bits = 0.0;
+      //memset(split_lcu, 0, sizeof(lcu_t)); //Necessary?
+    }
+
+    uvg_cabac_journal_rollback(&state->search_cabac, pre_search_cabac);
+
+    split_tree_t new_split = {
+      split_tree.split_tree | split_type << (split_tree.current_depth * 3),
+      split_tree.mode_type_tree | mode_type << (split_tree.current_depth * 2),
+      split_tree.current_depth + 1,
+      split_tree.mtt_depth + (split_type != QT_SPLIT),
+      split_tree.implicit_mtt_depth + (split_type != QT_SPLIT && *is_implicit),
+      0,
+    };
+
+    if (cur_cu->log2_height + cur_cu->log2_width > 4) {
+
+      state->search_cabac.update = 1;
+      // Add cost of cu_split_flag.
+      const cu_info_t* left_cu = NULL, * above_cu = NULL;
+      if (x) {
+        if (x_local || tree_type != UVG_CHROMA_T) {
+          left_cu = LCU_GET_CU_AT_PX(lcu, x_local - 1, y_local);
+        }
+        else {
+          left_cu = uvg_cu_array_at_const(state->tile->frame->chroma_cu_array, x - 1, y);
+        }
+      }
+      if (y) {
+        if (y_local || tree_type != UVG_CHROMA_T) {
+          above_cu = LCU_GET_CU_AT_PX(lcu, x_local, y_local - 1);
+        }
+        else {
+          above_cu = uvg_cu_array_at_const(state->tile->frame->chroma_cu_array, x, y - 1);
+        }
+      }
+      split_tree_t count_tree = split_tree;
+      count_tree.split_tree = split_tree.split_tree | split_type << (split_tree.current_depth * 3);
+      count_tree.mode_type_tree = split_tree.mode_type_tree | mode_type << (split_tree.current_depth * 2);
+
+      uvg_write_split_flag(
+        state,
+        &state->search_cabac,
+        left_cu,
+        above_cu, 
+        cu_loc,
+        count_tree,
+        tree_type,
+        is_implicit,
+        &split_bits
+        );
+    }
+
+    // 3.9
+    const double factor    = state->qp > 30 ? 1.1 : 1.075;
+    if (split_bits * state->lambda + s->cost / factor > s->cost) {
+      *can_split = false;
+      continue;
+    }
+
+    state->search_cabac.update = 0;
+    split_cost += split_bits * state->lambda;
+
+    cu_loc_t new_cu_loc[4];
+    uint8_t separate_chroma = 0;
+    const int splits = uvg_get_split_locs(cu_loc, split_type, new_cu_loc, &separate_chroma);
+
+    //Limit split when forced inter. Don't allow split if inter can't be used. TODO: Maybe there is a bette way to do this
+    if (mode_type == MODE_TYPE_INTER && !check_can_use_inter(state, new_cu_loc, new_split, s->pu_depth_inter_min, s->pu_depth_inter_max)) {
+      *can_split = false;
+      continue;
+    }
+
+    //Reset HMVP in case it has been modified while checking previous split types
+    if (state->frame->slicetype != UVG_SLICE_I) {
+      memcpy(&state->tile->frame->hmvp_lut[ctu_row_mul_five], s->hmvp_lut, sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
+      state->tile->frame->hmvp_size[ctu_row] = s->hmvp_lut_size;
+    }
+    if (state->encoder_control->cfg.ibc) {
+      memcpy(&state->tile->frame->hmvp_lut_ibc[ctu_row_mul_five], s->hmvp_lut_ibc, sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
+      state->tile->frame->hmvp_size_ibc[ctu_row] = s->hmvp_lut_size_ibc;
+    }
+
+    separate_chroma |= !has_chroma;
+    separate_chroma &= mode_type != MODE_TYPE_INTER; //Separate chroma should only be used with non-inter blocks
+    initialize_partial_work_tree(state, lcu, split_lcu, cu_loc , separate_chroma ? chroma_loc : cu_loc, tree_type);
+    for (int split = 0; split < splits; ++split) {
+
+      new_split.part_index = split;
+      split_cost += search_cu(state, 
+        &new_cu_loc[split], separate_chroma ? chroma_loc : &new_cu_loc[split],
+        split_lcu, 
+        tree_type, new_split,
+        !separate_chroma || (split == splits - 1 && has_chroma));
+      // If there is no separate chroma the block will always have chroma, otherwise it is the last block of the split that has the chroma
+
+      if (split_type == QT_SPLIT && s->completely_inside) {
+        const cu_info_t * const t = LCU_GET_CU_AT_PX(
+          split_lcu,
+          new_cu_loc[split].local_x,
+          new_cu_loc[split].local_y);
+        stop_to_qt |= GET_SPLITDATA(t, depth + 1) == QT_SPLIT;
+      }
+
+      if (split_cost > s->cost || split_cost > best_split_cost || split_cost > best_mode_type_cost) {
+        *can_split = false;
+        break;
+      }
+      if (unpruned_cost) *unpruned_cost = MAX(*unpruned_cost, split_cost);
+    }
+
+    // If multiple mode types are searched, save previous/best results and prepare for next round
+    if (split_cost < best_mode_type_cost) {
+      best_mode_type_cost = split_cost;
+      if (mode_type != end_mode_type) {
+        best_mode_type_can_split = *can_split;
+        best_mode_type_stop_to_qt = stop_to_qt;
+        if (!best_mode_type_lcu) best_mode_type_lcu = MALLOC(lcu_t, 1);
+        memcpy(best_mode_type_lcu, split_lcu, sizeof(lcu_t));
+        uvg_cabac_journal_save(&state->search_cabac, pre_search_cabac, &best_mode_type_cabac);
+
+        //Store HMVP lut of best mode type split
+        if (state->frame->slicetype != UVG_SLICE_I) {
+          memcpy(best_mode_type_hmvp_lut, &state->tile->frame->hmvp_lut[ctu_row_mul_five], sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
+          best_mode_type_hmvp_lut_size = state->tile->frame->hmvp_size[ctu_row];
+        }
+        if (state->encoder_control->cfg.ibc) {
+          best_mode_type_hmvp_lut_size_ibc = state->tile->frame->hmvp_size_ibc[ctu_row];
+          memcpy(best_mode_type_hmvp_lut_ibc, &state->tile->frame->hmvp_lut_ibc[ctu_row_mul_five], sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
+        }
+      }
+    }       
+  }
+
+  // If best mode type was not the latest round of search, restore the best mode type results
+  if (best_mode_type_cost == MAX_DOUBLE) {
+    // No valid split for any mode found
+    return false;
+  }
+  if (split_cost != best_mode_type_cost) {
+    // Last round of search was not the best cost so restore best mode type split
+    split_cost = best_mode_type_cost;
+    stop_to_qt = best_mode_type_stop_to_qt;
+    *can_split = best_mode_type_can_split;
+    memcpy(split_lcu, best_mode_type_lcu, sizeof(lcu_t));
+    uvg_cabac_journal_restore(&state->search_cabac, pre_search_cabac, &best_mode_type_cabac);
+
+    //Need to restore best mode type split HMVP
+    if (state->frame->slicetype != UVG_SLICE_I) {
+      memcpy(&state->tile->frame->hmvp_lut[ctu_row_mul_five], best_mode_type_hmvp_lut, sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
+      state->tile->frame->hmvp_size[ctu_row] = best_mode_type_hmvp_lut_size;
+    }
+    if (state->encoder_control->cfg.ibc) {
+      memcpy(&state->tile->frame->hmvp_lut_ibc[ctu_row_mul_five], best_mode_type_hmvp_lut_ibc, sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
+      state->tile->frame->hmvp_size_ibc[ctu_row] = best_mode_type_hmvp_lut_size_ibc;
+    }
+  }
+  if (best_mode_type_lcu) FREE_POINTER(best_mode_type_lcu);
+
+  *split_cost_out = split_cost;
+  *stop_to_qt_out = stop_to_qt;
+  return true;
+}
+
+// Maximum number of split types searched in jobs, all but NO_SPLIT.
+#define MAX_SPLIT_JOBS 5
+// Maximum number of CU depths searched in jobs.
+#define MAX_SPLIT_JOB_DEPTH 3
+
+/**
+ * \brief Search of one split type of a CU in a separate job.
+ */
+typedef struct {
+  struct split_job_group_t *group;
+  enum split_type split_type;
+  //! Set to 1 by the thread that runs the search.
+  int32_t claimed;
+  //! Set when a worker thread has finished the search.
+  bool done;
+  //! Set if the search could not be run, the split type is then searched
+  //! serially.
+  bool failed;
+
+  bool is_implicit;
+  lcu_t *split_lcu;
+
+  // Results of search_split_type.
+  bool valid;
+  bool can_split;
+  bool stop_to_qt;
+  double cost;
+  //! MAX_DOUBLE if the search was not run.
+  double unpruned_cost;
+  //! Contexts of the search CABAC relative to the start of the search.
+  cabac_snapshot_t cabac;
+  cu_info_t hmvp_lut[MAX_NUM_HMVP_CANDS];
+  uint8_t hmvp_lut_size;
+} split_job_t;
+
+/**
+ * \brief Split types of a CU searched at the same time.
+ *
+ * Each job works on a copy of the encoder state with its own search CABAC,
+ * HMVP table and work tree, and prunes only against the cost of not
+ * splitting. The results are merged in the order of the split types. A
+ * result is used only if the serial search would have run the same way
+ * with the best cost of the earlier split types, otherwise the split type
+ * is searched again serially. This keeps the result the same as without
+ * jobs.
+ */
+typedef struct split_job_group_t {
+  encoder_state_t *state;
+  const split_search_t *search;
+
+  //! References from the CU search and from the submitted jobs.
+  int32_t refcount;
+  pthread_mutex_t lock;
+  pthread_cond_t job_done;
+
+  int num_jobs;
+  split_job_t jobs[MAX_SPLIT_JOBS];
+} split_job_group_t;
+
+/**
+ * \brief Buffers for searching a split type in a job.
+ *
+ * The buffers are taken from the split job pool of the encoder for the
+ * duration of one job and then returned for the next one.
+ */
+typedef struct split_job_buffers_t {
+  encoder_state_t state;
+  encoder_state_config_tile_t tile;
+  videoframe_t frame;
+
+  //! HMVP tables of the CTU rows up to hmvp_rows.
+  cu_info_t *hmvp_lut;
+  uint8_t *hmvp_size;
+  uint32_t hmvp_rows;
+
+  cabac_journal_t *cabac_journal;
+  intra_cost_cache_t *intra_cost_cache;
+  transform_cache_t *transform_cache;
+
+  //! Next buffers in the pool.
+  struct split_job_buffers_t *next;
+} split_job_buffers_t;
+
+/**
+ * \brief Buffers returned by finished split jobs.
+ *
+ * Jobs of every depth share the pool, so it holds as many buffers as
+ * there have been jobs running at the same time.
+ */
+struct split_job_pool_t {
+  pthread_mutex_t lock;
+  split_job_buffers_t *free_buffers;
+};
+
+static void split_job_buffers_free(split_job_buffers_t *buf)
+{
+  FREE_POINTER(buf->hmvp_lut);
+  FREE_POINTER(buf->hmvp_size);
+  uvg_cabac_journal_free(buf->cabac_journal);
+  uvg_intra_cost_cache_free(buf->intra_cost_cache);
+  uvg_transform_cache_free(buf->transform_cache);
+  free(buf);
+}
+
+/**
+ * \brief Allocate a pool of buffers for split jobs.
+ * \return pool or NULL on failure
+ */
+split_job_pool_t * uvg_split_job_pool_alloc(void)
+{
+  split_job_pool_t *pool = MALLOC(split_job_pool_t, 1);
+  if (!pool) return NULL;
+  pthread_mutex_init(&pool->lock, NULL);
+  pool->free_buffers = NULL;
+  return pool;
+}
+
+/**
+ * \brief Free a pool of buffers for split jobs.
+ *
+ * No split job may be running.
+ */
+void uvg_split_job_pool_free(split_job_pool_t *pool)
+{
+  if (!pool) return;
+  while (pool->free_buffers) {
+    split_job_buffers_t *buf = pool->free_buffers;
+    pool->free_buffers = buf->next;
+    split_job_buffers_free(buf);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  free(pool);
+}
+
+/**
+ * \brief Take buffers for a job from the pool.
+ * \return buffers or NULL on failure
+ */
+static split_job_buffers_t * split_job_buffers_get(split_job_pool_t *pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  split_job_buffers_t *buf = pool->free_buffers;
+  if (buf) pool->free_buffers = buf->next;
+  pthread_mutex_unlock(&pool->lock);
+  if (buf) return buf;
+
+  buf = calloc(1, sizeof(split_job_buffers_t));
+  if (!buf) return NULL;
+  buf->cabac_journal = uvg_cabac_journal_alloc();
+  if (!buf->cabac_journal) {
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+static void split_job_buffers_put(split_job_pool_t *pool, split_job_buffers_t *buf)
+{
+  pthread_mutex_lock(&pool->lock);
+  buf->next = pool->free_buffers;
+  pool->free_buffers = buf;
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static void split_job_group_release(split_job_group_t *group)
+{
+  if (UVG_ATOMIC_DEC(&group->refcount) == 0) {
+    pthread_mutex_destroy(&group->lock);
+    pthread_cond_destroy(&group->job_done);
+    FREE_POINTER(group);
+  }
+}
+
+static void split_job_search(split_job_t *job)
+{
+  const encoder_state_t * const parent = job->group->state;
+  const split_search_t * const s = job->group->search;
+  const uint32_t ctu_row = (s->cu_loc->y >> LOG2_LCU_WIDTH);
+  const uint32_t ctu_row_mul_five = ctu_row * MAX_NUM_HMVP_CANDS;
+  const bool uses_hmvp = parent->frame->slicetype != UVG_SLICE_I;
+
+  split_job_pool_t * const pool = parent->encoder_control->split_job_pool;
+  split_job_buffers_t * const buf = split_job_buffers_get(pool);
+  if (!buf) {
+    job->failed = true;
+    return;
+  }
+  encoder_state_t * const state = &buf->state;
+  *state = *parent;
+  buf->tile = *parent->tile;
+  buf->frame = *parent->tile->frame;
+  buf->tile.frame = &buf->frame;
+  state->tile = &buf->tile;
+
+  // The HMVP table of the CTU row is modified by the search.
+  if (uses_hmvp) {
+    if (buf->hmvp_rows < ctu_row + 1) {
+      FREE_POINTER(buf->hmvp_lut);
+      FREE_POINTER(buf->hmvp_size);
+      buf->hmvp_lut = MALLOC(cu_info_t, (ctu_row + 1) * MAX_NUM_HMVP_CANDS);
+      buf->hmvp_size = MALLOC(uint8_t, ctu_row + 1);
+      if (!buf->hmvp_lut || !buf->hmvp_size) {
+        FREE_POINTER(buf->hmvp_lut);
+        FREE_POINTER(buf->hmvp_size);
+        buf->hmvp_rows = 0;
+        goto failed;
+      }
+      buf->hmvp_rows = ctu_row + 1;
+    }
+    memcpy(&buf->hmvp_lut[ctu_row_mul_five], &parent->tile->frame->hmvp_lut[ctu_row_mul_five], sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
+    buf->hmvp_size[ctu_row] = parent->tile->frame->hmvp_size[ctu_row];
+    buf->frame.hmvp_lut = buf->hmvp_lut;
+    buf->frame.hmvp_size = buf->hmvp_size;
+  }
+
+  // The caches are not thread safe so each job has its own.
+  if (parent->intra_cost_cache && !buf->intra_cost_cache) {
+    buf->intra_cost_cache = uvg_intra_cost_cache_alloc();
+    if (!buf->intra_cost_cache) goto failed;
+  }
+  state->intra_cost_cache = parent->intra_cost_cache ? buf->intra_cost_cache : NULL;
+  if (state->intra_cost_cache) uvg_intra_cost_cache_start_ctu(state->intra_cost_cache);
+  if (parent->transform_cache && !buf->transform_cache) {
+    buf->transform_cache = uvg_transform_cache_alloc();
+    if (!buf->transform_cache) goto failed;
+  }
+  state->transform_cache = parent->transform_cache ? buf->transform_cache : NULL;
+  if (state->transform_cache) uvg_transform_cache_start_ctu(state->transform_cache);
+
+  state->cabac_journal = buf->cabac_journal;
+  state->cabac_journal->size = 0;
+  state->search_cabac.journal = state->cabac_journal;
+
+  cabac_mark_t pre_search_cabac;
+  uvg_cabac_journal_mark(&state->search_cabac, &pre_search_cabac);
+
+  job->can_split = true;
+  job->valid = search_split_type(state, s, &pre_search_cabac, job->split_type,
+                                 &job->is_implicit, MAX_DOUBLE, job->split_lcu,
+                                 &job->can_split, &job->cost, &job->stop_to_qt,
+                                 &job->unpruned_cost);
+  if (job->valid) {
+    uvg_cabac_journal_save(&state->search_cabac, &pre_search_cabac, &job->cabac);
+    // The context pointer must not point to the copy of the state.
+    job->cabac.coder.cur_ctx = parent->search_cabac.cur_ctx;
+    if (uses_hmvp) {
+      memcpy(job->hmvp_lut, &buf->hmvp_lut[ctu_row_mul_five], sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
+      job->hmvp_lut_size = buf->hmvp_size[ctu_row];
+    }
+  }
+  split_job_buffers_put(pool, buf);
+  return;
+
+failed:
+  job->failed = true;
+  split_job_buffers_put(pool, buf);
+}
+
+/**
+ * \brief Run the search of a split type unless another thread has already
+ * started it.
+ *
+ * \return true if the search was run
+ */
+static bool split_job_try_run(split_job_t *job)
+{
+  if (UVG_ATOMIC_INC(&job->claimed) != 1) return false;
+  split_job_search(job);
+  return true;
+}
+
+static void split_job_worker(void *opaque)
+{
+  split_job_t * const job = opaque;
+  split_job_group_t * const group = job->group;
+  if (split_job_try_run(job)) {
+    pthread_mutex_lock(&group->lock);
+    job->done = true;
+    pthread_cond_broadcast(&group->job_done);
+    pthread_mutex_unlock(&group->lock);
+  }
+  split_job_group_release(group);
+}
+
+/**
+ * \brief Whether the split types of a CU are searched in jobs.
+ */
+static bool use_split_jobs(const encoder_state_t * const state, int depth, const bool *can_split)
+{
+  const uvg_config * const cfg = &state->encoder_control->cfg;
+  if (depth >= MIN(cfg->split_jobs, MAX_SPLIT_JOB_DEPTH)) return false;
+  // CCLM and IBC keep state in the frame that is not copied for the jobs.
+  if (cfg->cclm || cfg->ibc || state->encoder_control->cabac_debug_file) return false;
+  // The weights adapt during the search, so the jobs would see different
+  // weights than the serial search.
+  if (state->fast_coeff_online) return false;
+
+  if (!state->encoder_control->split_job_pool) return false;
+
+  int num_splits = 0;
+  for (int split_type = QT_SPLIT; split_type <= TT_VER_SPLIT; ++split_type) {
+    num_splits += can_split[split_type];
+  }
+  return num_splits > 1;
+}
+
+/**
+ * \brief Search all possible split types of a CU in jobs.
+ *
+ * The search CABAC of the state has to be at the start of the search of
+ * the CU. Returns when all the searches have finished. The calling thread
+ * runs the searches that no worker has started yet, so it never waits for
+ * a job that is still in the queue.
+ *
+ * \return the searches, or NULL if they could not be started
+ */
+static split_job_group_t * split_jobs_run(
+  encoder_state_t * const state,
+  const split_search_t * const s,
+  const bool is_implicit,
+  const bool *can_split,
+  lcu_t *split_lcu)
+{
+  threadqueue_queue_t * const threadqueue = state->encoder_control->threadqueue;
+  split_job_group_t *group = MALLOC(split_job_group_t, 1);
+  if (!group) return NULL;
+  group->state = state;
+  group->search = s;
+  group->refcount = 1;
+  pthread_mutex_init(&group->lock, NULL);
+  pthread_cond_init(&group->job_done, NULL);
+
+  int num_jobs = 0;
+  for (int split_type = QT_SPLIT; split_type <= TT_VER_SPLIT; ++split_type) {
+    if (!can_split[split_type]) continue;
+    split_job_t *job = &group->jobs[num_jobs++];
+    job->group = group;
+    job->split_type = split_type;
+    job->claimed = 0;
+    job->done = false;
+    job->failed = false;
+    job->is_implicit = is_implicit;
+    job->split_lcu = &split_lcu[split_type - 1];
+    job->valid = false;
+    job->unpruned_cost = MAX_DOUBLE;
+  }
+  assert(num_jobs <= MAX_SPLIT_JOBS);
+  group->num_jobs = num_jobs;
+
+  // The first split type is searched by this thread in any case.
+  if (threadqueue && state->encoder_control->cfg.threads > 0) {
+    // Split types whose job could not be queued are searched by this
+    // thread below.
+    for (int i = 1; i < num_jobs; ++i) {
+      UVG_ATOMIC_INC(&group->refcount);
+      threadqueue_job_t *tq_job = uvg_threadqueue_job_create(split_job_worker, &group->jobs[i]);
+      if (!tq_job) {
+        split_job_group_release(group);
+        break;
+      }
+      uvg_threadqueue_job_set_label(tq_job, "split", state->frame->poc, state->tile->id,
+                                    s->cu_loc->x >> LOG2_LCU_WIDTH, s->cu_loc->y >> LOG2_LCU_WIDTH);
+      uvg_threadqueue_job_set_node(tq_job, state->frame->numa_node);
+      // A failed submit may have queued the job already, so the worker
+      // keeps its reference.
+      const int submitted = uvg_threadqueue_submit(threadqueue, tq_job);
+      uvg_threadqueue_free_job(&tq_job);
+      if (!submitted) break;
+    }
+  }
+
+  for (int i = 0; i < num_jobs; ++i) {
+    split_job_t * const job = &group->jobs[i];
+    if (split_job_try_run(job)) {
+      job->done = true;
+      if (job->split_type == QT_SPLIT && job->valid && job->stop_to_qt) {
+        // The other split types are not used, so skip the ones that have
+        // not been started yet.
+        for (int j = i + 1; j < num_jobs; ++j) {
+          if (UVG_ATOMIC_INC(&group->jobs[j].claimed) == 1) {
+            group->jobs[j].done = true;
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  pthread_mutex_lock(&group->lock);
+  for (int i = 0; i < num_jobs; ++i) {
+    while (!group->jobs[i].done) {
+      pthread_cond_wait(&group->job_done, &group->lock);
+    }
+  }
+  pthread_mutex_unlock(&group->lock);
+
+  return group;
+}
+
+/**
+ * \brief Find the result of a split type searched in a job.
+ *
+ * \return the job, or NULL if the job could not run the search or the
+ *         serial search with best_split_cost would not have run the same
+ *         way, and the split type has to be searched again
+ */
+static const split_job_t * split_jobs_find(
+  const split_job_group_t * const group,
+  const enum split_type split_type,
+  const double best_split_cost)
+{
+  for (int i = 0; i < group->num_jobs; ++i) {
+    const split_job_t * const job = &group->jobs[i];
+    if (job->split_type == split_type) {
+      return !job->failed && job->unpruned_cost <= best_split_cost ? job : NULL;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * \brief Take the result of a split type searched in a job into use.
+ *
+ * \return false if no mode type of the split could be searched
+ */
+static bool split_jobs_merge(
+  encoder_state_t * const state,
+  const split_job_t * const job,
+  const cabac_mark_t * const pre_search_cabac,
+  bool * const can_split,
+  double * const split_cost,
+  bool * const stop_to_qt)
+{
+  *can_split = job->can_split;
+  if (!job->valid) return false;
+
+  *split_cost = job->cost;
+  *stop_to_qt = job->stop_to_qt;
+  uvg_cabac_journal_restore(&state->search_cabac, pre_search_cabac, &job->cabac);
+  if (state->frame->slicetype != UVG_SLICE_I) {
+    const uint32_t ctu_row = (job->group->search->cu_loc->y >> LOG2_LCU_WIDTH);
+    memcpy(&state->tile->frame->hmvp_lut[ctu_row * MAX_NUM_HMVP_CANDS], job->hmvp_lut, sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
+    state->tile->frame->hmvp_size[ctu_row] = job->hmvp_lut_size;
+  }
+  return true;
+}
+
 /**
  * Search every mode from 0 to MAX_PU_DEPTH and return cost of best mode.
  * - The recursion is started at depth 0 and goes in Z-order to MAX_PU_DEPTH.
@@ -1311,8 +2114,8 @@ static double search_cu(
   double inter_zero_coeff_cost = MAX_DOUBLE;
   double inter_bitcost = MAX_INT;
   cu_info_t *cur_cu;
-  cabac_data_t pre_search_cabac;
-  memcpy(&pre_search_cabac, &state->search_cabac, sizeof(pre_search_cabac));
+  cabac_mark_t pre_search_cabac;
+  uvg_cabac_journal_mark(&state->search_cabac, &pre_search_cabac);
 
   const uint32_t ctu_row = (cu_loc->y >> LOG2_LCU_WIDTH);
   const uint32_t ctu_row_mul_five = ctu_row * MAX_NUM_HMVP_CANDS;
@@ -1436,8 +2239,8 @@ static double search_cu(
                              false);
         }
         else {
-          cabac_data_t temp_cabac;
-          memcpy(&temp_cabac, &state->search_cabac, sizeof(cabac_data_t));
+          cabac_mark_t temp_cabac;
+          uvg_cabac_journal_mark(&state->search_cabac, &temp_cabac);
           state->search_cabac.update = 1;
           uvg_recon_and_estimate_cost_isp(
             state,
@@ -1447,7 +2250,7 @@ static double search_cu(
             lcu,
             NULL
           );
-          memcpy(&state->search_cabac, &temp_cabac, sizeof(cabac_data_t));
+          uvg_cabac_journal_rollback(&state->search_cabac, &temp_cabac);
         }
 
         downsample_cclm_rec(
@@ -1776,6 +2579,13 @@ static double search_cu(
     can_split[2] = can_split[3] = can_split[4] = can_split[5] = false;
   }
 
+  // Pruning is only done when a mode has been searched at this depth, since
+  // otherwise the CU has to be split.
+  if (ctrl->cfg.mtt_split_pruning && completely_inside && !is_implicit
+      && cur_cu->type != CU_NOTSET && tree_type != UVG_CHROMA_T) {
+    prune_mtt_splits(lcu, cu_loc, can_split);
+  }
+
   can_split_cu &= can_split[1] || can_split[2] || can_split[3] || can_split[4] || can_split[5];
 
   bool improved[6] = {false};
@@ -1796,15 +2606,29 @@ static double search_cu(
     lcu_t * split_lcu = MALLOC(lcu_t, 5);
     enum split_type best_split = 0;
     double best_split_cost = MAX_DOUBLE;
-    cabac_data_t post_search_cabac;
-    cabac_data_t best_split_cabac;
-    memcpy(&post_search_cabac, &state->search_cabac, sizeof(post_search_cabac));
+    cabac_snapshot_t post_search_cabac;
+    cabac_snapshot_t best_split_cabac;
+    uvg_cabac_journal_save(&state->search_cabac, &pre_search_cabac, &post_search_cabac);
     
     cu_info_t best_split_hmvp_lut[MAX_NUM_HMVP_CANDS];
     uint8_t best_split_hmvp_lut_size = state->tile->frame->hmvp_size[ctu_row];
     cu_info_t best_split_hmvp_lut_ibc[MAX_NUM_HMVP_CANDS];
     uint8_t best_split_hmvp_lut_size_ibc = state->tile->frame->hmvp_size_ibc[ctu_row];
 
+    const split_search_t split_search = {
+      cu_loc, chroma_loc, lcu, tree_type, split_tree, has_chroma,
+      completely_inside, mode_type_parent,
+      pu_depth_inter.min, pu_depth_inter.max,
+      cost,
+      hmvp_lut, hmvp_lut_size, hmvp_lut_ibc, hmvp_lut_size_ibc,
+    };
+
+    split_job_group_t *split_jobs = NULL;
+    if (use_split_jobs(state, depth, can_split)) {
+      uvg_cabac_journal_rollback(&state->search_cabac, &pre_search_cabac);
+      split_jobs = split_jobs_run(state, &split_search, is_implicit, can_split, split_lcu);
+    }
+
     // Recursively split all the way to max search depth.
     for (int split_type = QT_SPLIT; split_type <= TT_VER_SPLIT; ++split_type) {
       if (!can_split[split_type])
@@ -1825,211 +2649,26 @@ static double search_cu(
         continue;
       }
 
-      // 3.7
-      bool stop_to_qt = false;
-
-      double split_cost = 0.0;
-      double split_bits = 0;
-
-
-      //Determine what mode types should be searched
-      const enum mode_type_condition mode_type_cond = uvg_derive_mode_type_cond(cu_loc, state->frame->slicetype, tree_type, state->encoder_control->chroma_format, split_type, mode_type_parent);
-
-      double best_mode_type_cost = MAX_DOUBLE;
-      bool best_mode_type_stop_to_qt = false;
-      bool best_mode_type_can_split = true;
-      lcu_t * best_mode_type_lcu = NULL;
-      cabac_data_t best_mode_type_cabac;
-      cu_info_t best_mode_type_hmvp_lut[MAX_NUM_HMVP_CANDS];
-      uint8_t best_mode_type_hmvp_lut_size = state->tile->frame->hmvp_size[ctu_row];
-      cu_info_t best_mode_type_hmvp_lut_ibc[MAX_NUM_HMVP_CANDS];
-      uint8_t best_mode_type_hmvp_lut_size_ibc = state->tile->frame->hmvp_size_ibc[ctu_row];
-
-      enum mode_type start_mode_type, end_mode_type;
-      switch (mode_type_cond)
-      {
-      case MODE_TYPE_INHERIT:
-        start_mode_type = end_mode_type = mode_type_parent;
-        break;
-
-      case MODE_TYPE_INFER:
-        start_mode_type = end_mode_type = MODE_TYPE_INTRA;
-        break;
-
-      case MODE_TYPE_SIGNAL:
-        start_mode_type = MODE_TYPE_INTER;
-        end_mode_type = MODE_TYPE_INTRA;
-        break;
-      }
-      for( enum mode_type mode_type = start_mode_type; mode_type <= end_mode_type; mode_type++) {
-        if (start_mode_type != end_mode_type) {
-          //If we do multiple rounds, reset relevant things
-          can_split[split_type] = true;
-          stop_to_qt = false;
-          split_cost = split_bits = 0.0;
-          //memset(&split_lcu[split_type - 1], 0, sizeof(lcu_t)); //Necessary?
-        }
-
-        memcpy(&state->search_cabac, &pre_search_cabac, sizeof(pre_search_cabac));
-
-        split_tree_t new_split = {
-          split_tree.split_tree | split_type << (split_tree.current_depth * 3),
-          split_tree.mode_type_tree | mode_type << (split_tree.current_depth * 2),
-          split_tree.current_depth + 1,
-          split_tree.mtt_depth + (split_type != QT_SPLIT),
-          split_tree.implicit_mtt_depth + (split_type != QT_SPLIT && is_implicit),
-          0,
-        };
-
-        if (cur_cu->log2_height + cur_cu->log2_width > 4) {
-
-          state->search_cabac.update = 1;
-          // Add cost of cu_split_flag.
-          const cu_info_t* left_cu = NULL, * above_cu = NULL;
-          if (x) {
-            if (x_local || tree_type != UVG_CHROMA_T) {
-              left_cu = LCU_GET_CU_AT_PX(lcu, x_local - 1, y_local);
-            }
-            else {
-              left_cu = uvg_cu_array_at_const(state->tile->frame->chroma_cu_array, x - 1, y);
-            }
-          }
-          if (y) {
-            if (y_local || tree_type != UVG_CHROMA_T) {
-              above_cu = LCU_GET_CU_AT_PX(lcu, x_local, y_local - 1);
-            }
-            else {
-              above_cu = uvg_cu_array_at_const(state->tile->frame->chroma_cu_array, x, y - 1);
-            }
-          }
-          split_tree_t count_tree = split_tree;
-          count_tree.split_tree = split_tree.split_tree | split_type << (split_tree.current_depth * 3);
-          count_tree.mode_type_tree = split_tree.mode_type_tree | mode_type << (split_tree.current_depth * 2);
-
-          uvg_write_split_flag(
-            state,
-            &state->search_cabac,
-            left_cu,
-            above_cu, 
-            cu_loc,
-            count_tree,
-            tree_type,
-            &is_implicit,
-            &split_bits
-            );
-        }
-
-        // 3.9
-        const double factor    = state->qp > 30 ? 1.1 : 1.075;
-        if (split_bits * state->lambda + cost / factor > cost) {
-          can_split[split_type] = false;
-          continue;
-        }
-
-        state->search_cabac.update = 0;
-        split_cost += split_bits * state->lambda;
-
-        cu_loc_t new_cu_loc[4];
-        uint8_t separate_chroma = 0;
-        const int splits = uvg_get_split_locs(cu_loc, split_type, new_cu_loc, &separate_chroma);
-
-        //Limit split when forced inter. Don't allow split if inter can't be used. TODO: Maybe there is a bette way to do this
-        if (mode_type == MODE_TYPE_INTER && !check_can_use_inter(state, new_cu_loc, new_split, pu_depth_inter.min, pu_depth_inter.max)) {
-          can_split[split_type] = false;
+      double split_cost;
+      bool stop_to_qt;
+      const split_job_t * const split_job = split_jobs ? split_jobs_find(split_jobs, split_type, best_split_cost) : NULL;
+      if (split_job) {
+        if (!split_jobs_merge(state, split_job, &pre_search_cabac,
+                              &can_split[split_type], &split_cost, &stop_to_qt)) {
           continue;
         }
-
-        //Reset HMVP in case it has been modified while checking previous split types
-        if (state->frame->slicetype != UVG_SLICE_I) {
-          memcpy(&state->tile->frame->hmvp_lut[ctu_row_mul_five], hmvp_lut, sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
-          state->tile->frame->hmvp_size[ctu_row] = hmvp_lut_size;
-        }
-        if (state->encoder_control->cfg.ibc) {
-          memcpy(&state->tile->frame->hmvp_lut_ibc[ctu_row_mul_five], hmvp_lut_ibc, sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
-          state->tile->frame->hmvp_size_ibc[ctu_row] = hmvp_lut_size_ibc;
-        }
-
-        separate_chroma |= !has_chroma;
-        separate_chroma &= mode_type != MODE_TYPE_INTER; //Separate chroma should only be used with non-inter blocks
-        initialize_partial_work_tree(state, lcu, &split_lcu[split_type - 1], cu_loc , separate_chroma ? chroma_loc : cu_loc, tree_type);
-        for (int split = 0; split < splits; ++split) {
-
-          new_split.part_index = split;
-          split_cost += search_cu(state, 
-            &new_cu_loc[split], separate_chroma ? chroma_loc : &new_cu_loc[split],
-            &split_lcu[split_type -1], 
-            tree_type, new_split,
-            !separate_chroma || (split == splits - 1 && has_chroma));
-          // If there is no separate chroma the block will always have chroma, otherwise it is the last block of the split that has the chroma
-
-          if (split_type == QT_SPLIT && completely_inside) {
-            const cu_info_t * const t = LCU_GET_CU_AT_PX(
-              &split_lcu[0],
-              new_cu_loc[split].local_x,
-              new_cu_loc[split].local_y);
-            stop_to_qt |= GET_SPLITDATA(t, depth + 1) == QT_SPLIT;
-          }
-
-          if (split_cost > cost || split_cost > best_split_cost || split_cost > best_mode_type_cost) {
-            can_split[split_type] = false;
-            break;
-          }
-        }
-
-        // If multiple mode types are searched, save previous/best results and prepare for next round
-        if (split_cost < best_mode_type_cost) {
-          best_mode_type_cost = split_cost;
-          if (mode_type != end_mode_type) {
-            best_mode_type_can_split = can_split[split_type];
-            best_mode_type_stop_to_qt = stop_to_qt;
-            if (!best_mode_type_lcu) best_mode_type_lcu = MALLOC(lcu_t, 1);
-            memcpy(best_mode_type_lcu, &split_lcu[split_type - 1], sizeof(lcu_t));
-            memcpy(&best_mode_type_cabac, &state->search_cabac, sizeof(best_mode_type_cabac));
-
-            //Store HMVP lut of best mode type split
-            if (state->frame->slicetype != UVG_SLICE_I) {
-              memcpy(best_mode_type_hmvp_lut, &state->tile->frame->hmvp_lut[ctu_row_mul_five], sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
-              best_mode_type_hmvp_lut_size = state->tile->frame->hmvp_size[ctu_row];
-            }
-            if (state->encoder_control->cfg.ibc) {
-              best_mode_type_hmvp_lut_size_ibc = state->tile->frame->hmvp_size_ibc[ctu_row];
-              memcpy(best_mode_type_hmvp_lut_ibc, &state->tile->frame->hmvp_lut_ibc[ctu_row_mul_five], sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
-            }
-          }
-        }       
-      }
-    
-      // If best mode type was not the latest round of search, restore the best mode type results
-      if (best_mode_type_cost == MAX_DOUBLE) {
-        // No valid split for any mode found so continue
+      } else if (!search_split_type(state, &split_search, &pre_search_cabac, split_type,
+                                    &is_implicit, best_split_cost, &split_lcu[split_type - 1],
+                                    &can_split[split_type], &split_cost, &stop_to_qt, NULL)) {
         continue;
       }
-      if (split_cost != best_mode_type_cost) {
-        // Last round of search was not the best cost so restore best mode type split
-        split_cost = best_mode_type_cost;
-        stop_to_qt = best_mode_type_stop_to_qt;
-        can_split[split_type] = best_mode_type_can_split;
-        memcpy(&split_lcu[split_type - 1], best_mode_type_lcu, sizeof(lcu_t));
-        memcpy(&state->search_cabac, &best_mode_type_cabac, sizeof(best_mode_type_cabac));
-
-        //Need to restore best mode type split HMVP
-        if (state->frame->slicetype != UVG_SLICE_I) {
-          memcpy(&state->tile->frame->hmvp_lut[ctu_row_mul_five], best_mode_type_hmvp_lut, sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
-          state->tile->frame->hmvp_size[ctu_row] = best_mode_type_hmvp_lut_size;
-        }
-        if (state->encoder_control->cfg.ibc) {
-          memcpy(&state->tile->frame->hmvp_lut_ibc[ctu_row_mul_five], best_mode_type_hmvp_lut_ibc, sizeof(cu_info_t) * MAX_NUM_HMVP_CANDS);
-          state->tile->frame->hmvp_size_ibc[ctu_row] = best_mode_type_hmvp_lut_size_ibc;
-        }
-      }
-      if (best_mode_type_lcu) FREE_POINTER(best_mode_type_lcu);
 
       improved[split_type] = cost > split_cost;
       
       if (split_cost < best_split_cost) {
         best_split_cost = split_cost;
         best_split = split_type;
-        memcpy(&best_split_cabac, &state->search_cabac, sizeof(cabac_data_t));
+        uvg_cabac_journal_save(&state->search_cabac, &pre_search_cabac, &best_split_cabac);
 
         //Store HMVP lut of best split
         if (state->frame->slicetype != UVG_SLICE_I) {
@@ -2043,6 +2682,7 @@ static double search_cu(
       }
       if (stop_to_qt) break;
     }
+    if (split_jobs) split_job_group_release(split_jobs);
 
     // If no search is not performed for this depth, try just the best mode
     // of the top left CU from the next depth. This should ensure that 64x64
@@ -2060,9 +2700,9 @@ static double search_cu(
 
       // If the best CU in depth+1 is intra and the biggest it can be, try it.
       if (cu_d1->type == CU_INTRA && (cu_d1->log2_height + 1 == cur_cu->log2_height || cu_d1->log2_width + 1 == cur_cu->log2_width)) {
-        cabac_data_t temp_cabac;
-        memcpy(&temp_cabac, &state->search_cabac, sizeof(temp_cabac));
-        memcpy(&state->search_cabac, &pre_search_cabac, sizeof(pre_search_cabac));
+        cabac_snapshot_t temp_cabac;
+        uvg_cabac_journal_save(&state->search_cabac, &pre_search_cabac, &temp_cabac);
+        uvg_cabac_journal_rollback(&state->search_cabac, &pre_search_cabac);
         cost = 0;
         double bits = 0;
         bool   is_implicit = false;
@@ -2108,15 +2748,15 @@ static double search_cu(
 
         mark_deblocking(cu_loc, chroma_loc, lcu, tree_type, has_chroma, is_separate_tree, x_local, y_local);
 
-        memcpy(&post_search_cabac, &state->search_cabac, sizeof(post_search_cabac));
-        memcpy(&state->search_cabac, &temp_cabac, sizeof(temp_cabac));
+        uvg_cabac_journal_save(&state->search_cabac, &pre_search_cabac, &post_search_cabac);
+        uvg_cabac_journal_restore(&state->search_cabac, &pre_search_cabac, &temp_cabac);
       }
     }
 
     if (best_split_cost < cost) {
       // Copy split modes to this depth.
       cost = best_split_cost;
-      memcpy(&state->search_cabac, &best_split_cabac, sizeof(best_split_cabac));
+      uvg_cabac_journal_restore(&state->search_cabac, &pre_search_cabac, &best_split_cabac);
       work_tree_copy_up(&split_lcu[best_split -1], lcu, state->encoder_control->cfg.jccr, tree_type, cu_loc, is_separate_tree && !has_chroma ? NULL : chroma_loc);
       downsample_cclm_rec(
         state, x, y, cu_width / 2, cu_height / 2, lcu->rec.y, lcu->left_ref.y[64]
@@ -2137,7 +2777,7 @@ static double search_cu(
     } else if (depth > 0) {
       // Copy this CU's mode all the way down for use in adjacent CUs mode
       // search.
-      memcpy(&state->search_cabac, &post_search_cabac, sizeof(post_search_cabac));
+      uvg_cabac_journal_restore(&state->search_cabac, &pre_search_cabac, &post_search_cabac);
       downsample_cclm_rec(
         state, x, y, cu_width / 2, cu_height / 2, lcu->rec.y, lcu->left_ref.y[64]
       );
@@ -2288,16 +2928,16 @@ static void init_lcu_t(const encoder_state_t * const state, const int x, const i
     int x_max_c = x_max / 2;
     int y_max_c = y_max / 2;
 
-    uvg_pixel* source = NULL;
+    const uvg_picture *source = NULL;
     if (state->tile->frame->lmcs_aps->m_sliceReshapeInfo.sliceReshaperEnableFlag) {
-      source = frame->source_lmcs->y;
+      source = frame->source_lmcs;
     } else {
-      source = frame->source->y;
+      source = frame->source;
     }
 
     // Use LMCS pixels for luma if they are available, otherwise source_lmcs is mapped to normal source
-    uvg_pixels_blit(&source[x + y * frame->source->stride], lcu->ref.y,
-                        x_max, y_max, frame->source->stride, LCU_WIDTH);
+    uvg_pixels_blit(&source->y[x + y * source->stride], lcu->ref.y,
+                        x_max, y_max, source->stride, LCU_WIDTH);
     if (state->encoder_control->chroma_format != UVG_CSP_400) {
       uvg_pixels_blit(&frame->source->u[x_c + y_c * frame->source->stride / 2], lcu->ref.u,
                       x_max_c, y_max_c, frame->source->stride / 2, LCU_WIDTH / 2);
@@ -2356,6 +2996,14 @@ void uvg_search_lcu(encoder_state_t * const state, const int x, const int y, con
 {
   memcpy(&state->search_cabac, &state->cabac, sizeof(cabac_data_t));
   state->search_cabac.only_count = 1;
+  state->search_cabac.journal = state->cabac_journal;
+  state->cabac_journal->size = 0;
+  if (state->intra_cost_cache) {
+    uvg_intra_cost_cache_start_ctu(state->intra_cost_cache);
+  }
+  if (state->transform_cache) {
+    uvg_transform_cache_start_ctu(state->transform_cache);
+  }
   assert(x % LCU_WIDTH == 0);
   assert(y % LCU_WIDTH == 0);
 
@@ -84,6 +84,11 @@ void uvg_sort_keys_by_cost(unit_stats_map_t *__restrict map);
 
 void uvg_search_lcu(encoder_state_t *const state, const int x, const int y, const yuv_t *const hor_buf, const yuv_t *const ver_buf, lcu_coeff_t *coeff);
 
+typedef struct split_job_pool_t split_job_pool_t;
+
+split_job_pool_t * uvg_split_job_pool_alloc(void);
+void uvg_split_job_pool_free(split_job_pool_t *pool);
+
 double uvg_cu_rd_cost_luma(
   const encoder_state_t *const state,
   const cu_loc_t* const cu_loc,
@@ -46,6 +46,8 @@
 #include "search.h"
 #include "strategies/strategies-ipol.h"
 #include "strategies/strategies-picture.h"
+#include "threadqueue.h"
+#include "threads.h"
 #include "transform.h"
 #include "videoframe.h"
 
@@ -1295,20 +1297,40 @@ static void apply_mv_scaling(int32_t current_poc,
 
 
 /**
- * \brief Perform inter search for a single reference frame.
+ * \brief Result of the integer motion search for one reference frame.
+ */
+typedef struct {
+  uint32_t ref_idx;
+  // Reference picture might be in both lists
+  bool ref_list_active[2];
+  // Reference picture indices in L0 and L1 lists
+  int8_t ref_list_idx[2];
+  mv_t mv_cand[2][2];
+  vector2d_t best_mv;
+  double best_cost;
+  double best_bits;
+} inter_ref_search_t;
+
+/**
+ * \brief Perform integer motion search for a single reference frame.
+ *
+ * Only reads the state and the LCU, so the searches of different
+ * reference frames can be run at the same time with copies of info and
+ * cur_cu.
  */
 static void search_pu_inter_ref(
   inter_search_info_t *info,
   lcu_t *lcu,
   cu_info_t *cur_cu,
-  unit_stats_map_t *amvp)
+  inter_ref_search_t *result)
 {
   const uvg_config *cfg = &info->state->encoder_control->cfg;
 
-  // Reference picture might be in both lists
-  bool ref_list_active[2] = { false, false };
-  // Reference picture indices in L0 and L1 lists
-  int8_t ref_list_idx[2] = { -1, -1 };
+  bool *ref_list_active = result->ref_list_active;
+  int8_t *ref_list_idx = result->ref_list_idx;
+  result->ref_idx = info->ref_idx;
+  ref_list_active[0] = ref_list_active[1] = false;
+  ref_list_idx[0] = ref_list_idx[1] = -1;
 
   // Check if ref picture is present in the lists
   for (int ref_list = 0; ref_list < 2; ++ref_list) {
@@ -1460,13 +1482,44 @@ static void search_pu_inter_ref(
     best_cost += best_bits * info->state->lambda_sqrt;
   }
 
+  memcpy(result->mv_cand, info->mv_cand, sizeof(result->mv_cand));
+  result->best_mv = best_mv;
+  result->best_cost = best_cost;
+  result->best_bits = best_bits;
+}
+
+
+/**
+ * \brief Add the result of the search of a reference frame to the AMVP
+ * candidates.
+ *
+ * The results have to be added in the order of the reference frames.
+ */
+static void add_inter_ref_result(
+  inter_search_info_t *info,
+  cu_info_t *cur_cu,
+  const inter_ref_search_t *result,
+  unit_stats_map_t *amvp)
+{
+  const bool *ref_list_active = result->ref_list_active;
+  const int8_t *ref_list_idx = result->ref_list_idx;
+  const vector2d_t best_mv = result->best_mv;
+  const double best_cost = result->best_cost;
+  const double best_bits = result->best_bits;
+
+  int ref_list = ref_list_active[0] ? 0 : 1;
+  cur_cu->inter.mv_ref[ref_list] = ref_list_idx[ref_list];
+  info->ref_idx = result->ref_idx;
+  info->ref = info->state->frame->ref->images[result->ref_idx];
+  memcpy(info->mv_cand, result->mv_cand, sizeof(info->mv_cand));
+
   double LX_cost[2] = { best_cost, best_cost };
   double LX_bits[2] = { best_bits, best_bits };
 
   // Compute costs and add entries for both lists, if necessary
   for (; ref_list < 2 && ref_list_active[ref_list]; ++ref_list) {
 
-    LX_idx = ref_list_idx[ref_list];
+    int LX_idx = ref_list_idx[ref_list];
     uint8_t mv_ref_coded = LX_idx;
     int cu_mv_cand = select_mv_cand(info->state, info->mv_cand, best_mv.x, best_mv.y, NULL);
     const int extra_bits = ref_list + mv_ref_coded; // TODO: check if mv_dir bits are missing
@@ -1657,6 +1710,153 @@ static bool merge_candidate_in_list(inter_merge_cand_t *all_cands,
   return found;
 }
 
+// Smallest PU, in luma samples, whose reference frames are searched in jobs.
+#define REF_JOB_MIN_SAMPLES (16 * 16)
+
+/**
+ * \brief Search of one reference frame of a PU in a separate job.
+ */
+typedef struct {
+  struct ref_job_group_t *group;
+  //! Set to 1 by the thread that runs the search.
+  int32_t claimed;
+  //! Set when a worker thread has finished the search.
+  bool done;
+
+  inter_search_info_t info;
+  cu_info_t cur_cu;
+  inter_ref_search_t result;
+} ref_job_t;
+
+/**
+ * \brief Reference frames of a PU searched at the same time.
+ */
+typedef struct ref_job_group_t {
+  lcu_t *lcu;
+
+  //! References from the PU search and from the submitted jobs.
+  int32_t refcount;
+  pthread_mutex_t lock;
+  pthread_cond_t job_done;
+
+  int num_jobs;
+  ref_job_t jobs[MAX_REF_PIC_COUNT];
+} ref_job_group_t;
+
+static void ref_job_group_release(ref_job_group_t *group)
+{
+  if (UVG_ATOMIC_DEC(&group->refcount) == 0) {
+    pthread_mutex_destroy(&group->lock);
+    pthread_cond_destroy(&group->job_done);
+    FREE_POINTER(group);
+  }
+}
+
+/**
+ * \brief Run the search of a reference frame unless another thread has
+ * already started it.
+ *
+ * \return true if the search was run
+ */
+static bool ref_job_try_run(ref_job_t *job)
+{
+  if (UVG_ATOMIC_INC(&job->claimed) != 1) return false;
+  search_pu_inter_ref(&job->info, job->group->lcu, &job->cur_cu, &job->result);
+  return true;
+}
+
+static void ref_job_worker(void *opaque)
+{
+  ref_job_t * const job = opaque;
+  ref_job_group_t * const group = job->group;
+  if (ref_job_try_run(job)) {
+    pthread_mutex_lock(&group->lock);
+    job->done = true;
+    pthread_cond_broadcast(&group->job_done);
+    pthread_mutex_unlock(&group->lock);
+  }
+  ref_job_group_release(group);
+}
+
+/**
+ * \brief Integer motion search of all reference frames of a PU in jobs.
+ *
+ * The results are added to the AMVP candidates in the order of the
+ * reference frames, so they are the same as when searching the frames one
+ * after another. The calling thread runs the searches that no worker has
+ * started yet, so it never waits for a job that is still in the queue.
+ *
+ * \return false if the searches could not be started
+ */
+static bool search_pu_inter_refs_in_jobs(
+  inter_search_info_t *info,
+  lcu_t *lcu,
+  cu_info_t *cur_cu,
+  unit_stats_map_t *amvp)
+{
+  encoder_state_t * const state = info->state;
+  threadqueue_queue_t * const threadqueue = state->encoder_control->threadqueue;
+  ref_job_group_t *group = MALLOC(ref_job_group_t, 1);
+  if (!group) return false;
+  group->lcu = lcu;
+  group->refcount = 1;
+  group->num_jobs = state->frame->ref->used_size;
+  pthread_mutex_init(&group->lock, NULL);
+  pthread_cond_init(&group->job_done, NULL);
+
+  for (int i = 0; i < group->num_jobs; ++i) {
+    ref_job_t *job = &group->jobs[i];
+    job->group = group;
+    job->claimed = 0;
+    job->done = false;
+    job->info = *info;
+    job->info.ref_idx = i;
+    job->info.ref = state->frame->ref->images[i];
+    job->cur_cu = *cur_cu;
+  }
+
+  // The first reference frame is searched by this thread in any case.
+  // Reference frames whose job could not be queued are searched by this
+  // thread below.
+  for (int i = 1; i < group->num_jobs; ++i) {
+    UVG_ATOMIC_INC(&group->refcount);
+    threadqueue_job_t *tq_job = uvg_threadqueue_job_create(ref_job_worker, &group->jobs[i]);
+    if (!tq_job) {
+      ref_job_group_release(group);
+      break;
+    }
+    uvg_threadqueue_job_set_label(tq_job, "ref", state->frame->poc, state->tile->id,
+                                  info->origin.x >> LOG2_LCU_WIDTH, info->origin.y >> LOG2_LCU_WIDTH);
+    uvg_threadqueue_job_set_node(tq_job, state->frame->numa_node);
+    // A failed submit may have queued the job already, so the worker
+    // keeps its reference.
+    const int submitted = uvg_threadqueue_submit(threadqueue, tq_job);
+    uvg_threadqueue_free_job(&tq_job);
+    if (!submitted) break;
+  }
+
+  for (int i = 0; i < group->num_jobs; ++i) {
+    if (ref_job_try_run(&group->jobs[i])) {
+      group->jobs[i].done = true;
+    }
+  }
+
+  pthread_mutex_lock(&group->lock);
+  for (int i = 0; i < group->num_jobs; ++i) {
+    while (!group->jobs[i].done) {
+      pthread_cond_wait(&group->job_done, &group->lock);
+    }
+  }
+  pthread_mutex_unlock(&group->lock);
+
+  for (int i = 0; i < group->num_jobs; ++i) {
+    add_inter_ref_result(info, cur_cu, &group->jobs[i].result, amvp);
+  }
+
+  ref_job_group_release(group);
+  return true;
+}
+
 /**
  * \brief Collect PU parameters and costs at this depth.
  *
@@ -1856,11 +2056,21 @@ static void search_pu_inter(
     }
   }
 
-  for (uint32_t ref_idx = 0; ref_idx < state->frame->ref->used_size; ref_idx++) {
-    info->ref_idx = ref_idx;
-    info->ref = state->frame->ref->images[ref_idx];
+  const bool use_ref_jobs = cfg->ref_jobs &&
+    cfg->threads > 0 &&
+    state->encoder_control->threadqueue &&
+    state->frame->ref->used_size > 1 &&
+    cu_loc->width * cu_loc->height >= REF_JOB_MIN_SAMPLES;
 
-    search_pu_inter_ref(info, lcu, cur_pu, amvp);
+  if (!use_ref_jobs || !search_pu_inter_refs_in_jobs(info, lcu, cur_pu, amvp)) {
+    for (uint32_t ref_idx = 0; ref_idx < state->frame->ref->used_size; ref_idx++) {
+      info->ref_idx = ref_idx;
+      info->ref = state->frame->ref->images[ref_idx];
+
+      inter_ref_search_t result;
+      search_pu_inter_ref(info, lcu, cur_pu, &result);
+      add_inter_ref_result(info, cur_pu, &result, amvp);
+    }
   }
 
   assert(amvp[0].size <= MAX_UNIT_STATS_MAP_SIZE);
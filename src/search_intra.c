@@ -32,8 +32,11 @@
 
 #include "search_intra.h"
 
+#include <inttypes.h>
 #include <limits.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 
 #include "cabac.h"
@@ -138,7 +141,7 @@ static void get_cost_dual(
   cost_pixel_nxn_multi_func *sad_twin_func,
   int width,
   int height,
-  double *costs_out)
+  unsigned *costs_out)
 {
   #define PARALLEL_BLKS 2
   unsigned satd_costs[PARALLEL_BLKS] = { 0 };
@@ -155,8 +158,8 @@ static void get_cost_dual(
     unsigned_sad_costs[0] = uvg_reg_sad(preds[0], orig_block, width, height, width, width);
     unsigned_sad_costs[1] = uvg_reg_sad(preds[1], orig_block, width, height, width, width);
   }
-  costs_out[0] = (double)MIN(satd_costs[0], unsigned_sad_costs[0] * 2);
-  costs_out[1] = (double)MIN(satd_costs[1], unsigned_sad_costs[1] * 2);
+  costs_out[0] = MIN(satd_costs[0], unsigned_sad_costs[0] * 2);
+  costs_out[1] = MIN(satd_costs[1], unsigned_sad_costs[1] * 2);
 
   // TODO: width and height
   //if (TRSKIP_RATIO != 0 && width <= (1 << state->encoder_control->cfg.trskip_max_size) && state->encoder_control->cfg.trskip_enable) {
@@ -192,6 +195,182 @@ static void get_cost_dual(
 }
 
 
+intra_cost_cache_t * uvg_intra_cost_cache_alloc(void)
+{
+  intra_cost_cache_t *cache = calloc(1, sizeof(intra_cost_cache_t));
+  if (cache) cache->next_ref_id = 1;
+  return cache;
+}
+
+
+void uvg_intra_cost_cache_free(intra_cost_cache_t *cache)
+{
+  if (!cache) return;
+#ifdef UVG_DEBUG_PRINT_INTRA_CACHE
+  fprintf(stderr, "Intra cost cache: %" PRIu64 " lookups, %" PRIu64 " hits (%.1f %%)\n",
+          cache->lookups, cache->hits,
+          cache->lookups ? 100.0 * cache->hits / cache->lookups : 0.0);
+#endif //UVG_DEBUG_PRINT_INTRA_CACHE
+  free(cache);
+}
+
+
+/**
+ * \brief Invalidate all entries of the cache for a new CTU.
+ */
+void uvg_intra_cost_cache_start_ctu(intra_cost_cache_t *cache)
+{
+  cache->generation++;
+  if (cache->generation == 0) {
+    // Wrapped around, old entries could match the new generation.
+    memset(cache->entries, 0, sizeof(cache->entries));
+    cache->generation = 1;
+  }
+}
+
+
+/**
+ * \brief Get the id of the reference samples a luma prediction of the block
+ *        may use.
+ *
+ * The samples are looked up by a hash and compared with the stored ones,
+ * so equal ids always mean equal samples. Samples that are not found are
+ * stored with a new id.
+ *
+ * The references must have been cleared before they were built, since
+ * the compared range can extend past the samples that were written.
+ */
+static uint32_t intra_cost_cache_ref_id(
+  intra_cost_cache_t *cache,
+  const uvg_intra_references *refs,
+  const cu_loc_t *const cu_loc,
+  int multi_ref_idx)
+{
+  const int log2_ratio = abs(uvg_g_convert_to_log2[cu_loc->width] - uvg_g_convert_to_log2[cu_loc->height]);
+  const int left_len = MIN(2 * cu_loc->height + ((multi_ref_idx + cu_loc->height) << log2_ratio) + multi_ref_idx + 7, INTRA_REF_LENGTH);
+  const int top_len = MIN(2 * cu_loc->width + ((multi_ref_idx + cu_loc->width) << log2_ratio) + multi_ref_idx + 7, INTRA_REF_LENGTH);
+
+  // 64-bit FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < left_len; ++i) {
+    hash = (hash ^ refs->ref.left[i]) * 0x100000001b3ULL;
+  }
+  for (int i = 0; i < top_len; ++i) {
+    hash = (hash ^ refs->ref.top[i]) * 0x100000001b3ULL;
+  }
+
+  intra_cost_cache_refs_t *stored = &cache->refs[(hash >> 32) & (INTRA_COST_CACHE_REFS - 1)];
+  if (stored->id != 0 && stored->hash == hash &&
+      stored->left_len == left_len && stored->top_len == top_len &&
+      memcmp(stored->left, refs->ref.left, left_len * sizeof(uvg_pixel)) == 0 &&
+      memcmp(stored->top, refs->ref.top, top_len * sizeof(uvg_pixel)) == 0)
+  {
+    return stored->id;
+  }
+
+  if (cache->next_ref_id == 0) {
+    // Wrapped around, old entries could refer to the new ids.
+    memset(cache->entries, 0, sizeof(cache->entries));
+    memset(cache->refs, 0, sizeof(cache->refs));
+    cache->next_ref_id = 1;
+  }
+  stored->hash = hash;
+  stored->id = cache->next_ref_id++;
+  stored->left_len = left_len;
+  stored->top_len = top_len;
+  memcpy(stored->left, refs->ref.left, left_len * sizeof(uvg_pixel));
+  memcpy(stored->top, refs->ref.top, top_len * sizeof(uvg_pixel));
+  return stored->id;
+}
+
+
+static INLINE uint32_t intra_cost_cache_key(const cu_loc_t *const cu_loc, const cu_info_t *const pred_cu)
+{
+  return (uint32_t)cu_loc->local_x
+    | (uint32_t)cu_loc->local_y << 7
+    | (uint32_t)uvg_g_convert_to_log2[cu_loc->width] << 14
+    | (uint32_t)uvg_g_convert_to_log2[cu_loc->height] << 17
+    | (uint32_t)pred_cu->intra.mode << 20
+    | (uint32_t)pred_cu->intra.multi_ref_idx << 27
+    | (uint32_t)pred_cu->intra.mip_flag << 29
+    | (uint32_t)pred_cu->intra.mip_is_transposed << 30;
+}
+
+
+/**
+ * \brief Calculate rough costs for two luma predictions.
+ *
+ * Costs found in the intra cost cache are reused and only the remaining
+ * modes are predicted.
+ *
+ * \param refs        Reference lines indexed by multi_ref_idx.
+ * \param ref_ids     Ids of the reference lines or NULL to bypass the cache.
+ * \param data        Modes to evaluate. NULL entries are skipped.
+ * \param costs_out   Costs without the mode signaling bits.
+ */
+static void get_rough_cost_pair(
+  encoder_state_t * const state,
+  uvg_intra_references *refs,
+  const uint32_t *ref_ids,
+  const cu_loc_t *const cu_loc,
+  intra_search_data_t *const data[2],
+  pred_buffer preds,
+  const uvg_pixel *orig_block,
+  cost_pixel_nxn_multi_func *satd_dual_func,
+  cost_pixel_nxn_multi_func *sad_dual_func,
+  unsigned *costs_out)
+{
+  intra_cost_cache_t *cache = ref_ids ? state->intra_cost_cache : NULL;
+  intra_cost_cache_entry_t *entries[2] = { NULL, NULL };
+  uint32_t ids[2] = { 0, 0 };
+  uint32_t keys[2] = { 0, 0 };
+  int num_predicted = 0;
+  int predicted = 0;
+
+  for (int i = 0; i < 2; ++i) {
+    if (data[i] == NULL) continue;
+    const cu_info_t *const pred_cu = &data[i]->pred_cu;
+
+    if (cache) {
+      ids[i] = ref_ids[pred_cu->intra.multi_ref_idx];
+      keys[i] = intra_cost_cache_key(cu_loc, pred_cu);
+      const uint64_t slot = (((uint64_t)ids[i] << 32 ^ keys[i]) * 0x9e3779b97f4a7c15ULL) >> 32;
+      entries[i] = &cache->entries[slot & (INTRA_COST_CACHE_SIZE - 1)];
+      cache->lookups++;
+      if (entries[i]->generation == cache->generation && entries[i]->key == keys[i] && entries[i]->ref_id == ids[i]) {
+        cache->hits++;
+        costs_out[i] = entries[i]->cost;
+        entries[i] = NULL;
+        continue;
+      }
+    }
+
+    uvg_intra_predict(state, &refs[pred_cu->intra.multi_ref_idx], cu_loc, cu_loc, COLOR_Y, preds[i], data[i], NULL);
+    predicted = i;
+    num_predicted++;
+  }
+
+  if (num_predicted == 0) return;
+  if (num_predicted == 1) {
+    // The dual cost functions always process both blocks.
+    memcpy(preds[!predicted], preds[predicted], cu_loc->width * cu_loc->height * sizeof(uvg_pixel));
+  }
+
+  unsigned costs[2];
+  get_cost_dual(state, preds, orig_block, satd_dual_func, sad_dual_func, cu_loc->width, cu_loc->height, costs);
+  for (int i = 0; i < 2; ++i) {
+    if (data[i] == NULL || (cache && entries[i] == NULL)) continue;
+    costs_out[i] = costs[i];
+    if (entries[i]) {
+      entries[i]->ref_id = ids[i];
+      entries[i]->key = keys[i];
+      entries[i]->generation = cache->generation;
+      entries[i]->cost = costs[i];
+    }
+  }
+}
+
+
 /**
 * \brief Derives mts_last_scan_pos and violates_mts_coeff_constraint for pred_cu.
 *
@@ -946,22 +1125,27 @@ static int16_t search_intra_rough(
 }*/
 
 
-static INLINE double count_bits(
+/**
+ * \brief Estimate the luma mode signaling bits of a mode.
+ *
+ * The flag costs and the result are in CTX_FRAC_BITS fixed point.
+ */
+static INLINE uint32_t count_bits(
   encoder_state_t* const state,
   int8_t* intra_preds,
-  const double not_mrl,
-  const double not_mip,
-  const double mpm_mode_bit,
-  const double not_mpm_mode_bit,
-  const double planar_mode_flag,
-  const double not_planar_mode_flag,
-  const double not_isp_flag,
+  const uint32_t not_mrl,
+  const uint32_t not_mip,
+  const uint32_t mpm_mode_bit,
+  const uint32_t not_mpm_mode_bit,
+  const uint32_t planar_mode_flag,
+  const uint32_t not_planar_mode_flag,
+  const uint32_t not_isp_flag,
   int8_t mode
 )
 {
   int i = 0;
   int smaller_than_pred = 0;
-  double bits;
+  uint32_t bits;
   for (; i < INTRA_MPM_COUNT; i++) {
     if (intra_preds[i] == mode) {
       break;
@@ -974,21 +1158,34 @@ static INLINE double count_bits(
     bits = planar_mode_flag + mpm_mode_bit;
   }
   else if (i < INTRA_MPM_COUNT) {
-    bits = not_planar_mode_flag + mpm_mode_bit + MIN(i, 4);
+    bits = not_planar_mode_flag + mpm_mode_bit + (MIN(i, 4) << CTX_FRAC_BITS);
   }
   else {
-    bits = not_mpm_mode_bit + 5 + (mode - smaller_than_pred > 2);
+    bits = not_mpm_mode_bit + ((5 + (mode - smaller_than_pred > 2)) << CTX_FRAC_BITS);
   }
   bits += not_mrl + not_mip + not_isp_flag;
   return bits;
 }
 
-static uint8_t search_intra_rough(
+/**
+ * \brief Select the luma modes to search further by their rough costs.
+ *
+ * Evenly spaced modes are tested first, and the search is then refined
+ * around the best ones. The costs are in fixed point.
+ *
+ * \param ref_ids      Ids of the reference lines or NULL to bypass the cache.
+ * \param intra_preds  Most probable modes.
+ * \param[out] modes_out  The selected modes from best to worst.
+ *
+ * \return  Number of modes in modes_out.
+ */
+uint8_t uvg_search_intra_rough(
   encoder_state_t * const state,
   const cu_loc_t* const cu_loc,
   uvg_pixel *orig,
   int32_t origstride,
   uvg_intra_references *refs,
+  const uint32_t *ref_ids,
   int width,
   int height,
   int8_t *intra_preds,
@@ -1003,7 +1200,8 @@ static uint8_t search_intra_rough(
   cost_pixel_nxn_multi_func *satd_dual_func = uvg_pixels_get_satd_dual_func(width, height);
   cost_pixel_nxn_multi_func *sad_dual_func = uvg_pixels_get_sad_dual_func(width, height);
   bool mode_checked[UVG_NUM_INTRA_MODES] = {0};
-  double costs[UVG_NUM_INTRA_MODES];
+  rd_cost_fx_t costs[UVG_NUM_INTRA_MODES];
+  const int64_t lambda_fx = uvg_lambda_to_fx(state->lambda_sqrt);
 
   // const kvz_config *cfg = &state->encoder_control->cfg;
   // const bool filter_boundary = !(cfg->lossless && cfg->implicit_rdpcm);
@@ -1019,22 +1217,21 @@ static uint8_t search_intra_rough(
   uvg_pixels_blit(orig, orig_block, width, height, origstride, width);
 
   int8_t modes_selected = 0;
-  // Note: get_cost and get_cost_dual may return negative costs.
-  double min_cost;
-  double max_cost;
+  rd_cost_fx_t min_cost;
+  rd_cost_fx_t max_cost;
 
   struct mode_cost {
     int8_t mode;
-    double cost;
+    rd_cost_fx_t cost;
   };
   
-  const double not_mrl = state->encoder_control->cfg.mrl && (cu_loc->y % LCU_WIDTH) ? CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.multi_ref_line[0]), 0) : 0;
-  const double not_mip = state->encoder_control->cfg.mip ? CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.mip_flag[mip_ctx]), 0) : 0;
-  const double mpm_mode_bit = CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.intra_luma_mpm_flag_model), 1);
-  const double not_mpm_mode_bit = CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.intra_luma_mpm_flag_model), 0);
-  const double planar_mode_flag = CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.luma_planar_model[1]), 0);
-  const double not_planar_mode_flag = CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.luma_planar_model[1]), 1);
-  const double not_isp_flag = state->encoder_control->cfg.isp && uvg_can_use_isp(width, height) ? CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.intra_subpart_model[0]), 0) : 0;
+  const uint32_t not_mrl = state->encoder_control->cfg.mrl && (cu_loc->y % LCU_WIDTH) ? CTX_ENTROPY_BITS(&(state->search_cabac.ctx.multi_ref_line[0]), 0) : 0;
+  const uint32_t not_mip = state->encoder_control->cfg.mip ? CTX_ENTROPY_BITS(&(state->search_cabac.ctx.mip_flag[mip_ctx]), 0) : 0;
+  const uint32_t mpm_mode_bit = CTX_ENTROPY_BITS(&(state->search_cabac.ctx.intra_luma_mpm_flag_model), 1);
+  const uint32_t not_mpm_mode_bit = CTX_ENTROPY_BITS(&(state->search_cabac.ctx.intra_luma_mpm_flag_model), 0);
+  const uint32_t planar_mode_flag = CTX_ENTROPY_BITS(&(state->search_cabac.ctx.luma_planar_model[1]), 0);
+  const uint32_t not_planar_mode_flag = CTX_ENTROPY_BITS(&(state->search_cabac.ctx.luma_planar_model[1]), 1);
+  const uint32_t not_isp_flag = state->encoder_control->cfg.isp && uvg_can_use_isp(width, height) ? CTX_ENTROPY_BITS(&(state->search_cabac.ctx.intra_subpart_model[0]), 0) : 0;
 
   const uint8_t mode_list_size = state->encoder_control->cfg.mip ? 6 : 3;
   struct mode_cost best_six_modes[6];
@@ -1043,19 +1240,22 @@ static uint8_t search_intra_rough(
 
   // Calculate SAD for evenly spaced modes to select the starting point for 
   // the recursive search.
-  intra_search_data_t search_proxy;
-  FILL(search_proxy, 0);
-  search_proxy.pred_cu = *pred_cu;
+  intra_search_data_t search_proxy[PARALLEL_BLKS];
+  intra_search_data_t *proxy_ptrs[PARALLEL_BLKS];
+  for (int i = 0; i < PARALLEL_BLKS; ++i) {
+    FILL(search_proxy[i], 0);
+    search_proxy[i].pred_cu = *pred_cu;
+    proxy_ptrs[i] = &search_proxy[i];
+  }
 
   int offset = 1 << state->encoder_control->cfg.intra_rough_search_levels;
-  search_proxy.pred_cu.intra.mode = 0;
-  uvg_intra_predict(state, refs, cu_loc, cu_loc, COLOR_Y, preds[0], &search_proxy, NULL);
-  search_proxy.pred_cu.intra.mode = 1;
-  uvg_intra_predict(state, refs, cu_loc, cu_loc, COLOR_Y, preds[1], &search_proxy, NULL);
-  get_cost_dual(state, preds, orig_block, satd_dual_func, sad_dual_func, width, height, costs);
+  search_proxy[0].pred_cu.intra.mode = 0;
+  search_proxy[1].pred_cu.intra.mode = 1;
+  unsigned dists[PARALLEL_BLKS] = { 0 };
+  get_rough_cost_pair(state, refs, ref_ids, cu_loc, proxy_ptrs, preds, orig_block, satd_dual_func, sad_dual_func, dists);
   mode_checked[0] = true;
   mode_checked[1] = true;
-  costs[0] += count_bits(
+  costs[0] = uvg_rd_cost_fx(dists[0], count_bits(
     state,
     intra_preds,
     not_mrl,
@@ -1064,8 +1264,8 @@ static uint8_t search_intra_rough(
     not_mpm_mode_bit,
     planar_mode_flag,
     not_planar_mode_flag,
-    not_isp_flag, 0) * state->lambda_sqrt;
-  costs[1] += count_bits(
+    not_isp_flag, 0), lambda_fx);
+  costs[1] = uvg_rd_cost_fx(dists[1], count_bits(
     state,
     intra_preds,
     not_mrl,
@@ -1074,7 +1274,7 @@ static uint8_t search_intra_rough(
     not_mpm_mode_bit,
     planar_mode_flag,
     not_planar_mode_flag,
-    not_isp_flag, 1) * state->lambda_sqrt;
+    not_isp_flag, 1), lambda_fx);
   if(costs[0] < costs[1]) {
     min_cost = costs[0];
     max_cost = costs[1];
@@ -1091,25 +1291,24 @@ static uint8_t search_intra_rough(
     best_six_modes[0].mode = 1;
     best_six_modes[0].cost = costs[1];    
   }
-  best_six_modes[2].cost = MAX_DOUBLE;
-  best_six_modes[3].cost = MAX_DOUBLE;
-  best_six_modes[4].cost = MAX_DOUBLE;
-  best_six_modes[5].cost = MAX_DOUBLE;
+  best_six_modes[2].cost = INT64_MAX;
+  best_six_modes[3].cost = INT64_MAX;
+  best_six_modes[4].cost = INT64_MAX;
+  best_six_modes[5].cost = INT64_MAX;
   for (int mode = 2 + offset / 2; mode <= 66; mode += PARALLEL_BLKS * offset) {
     
-    double costs_out[PARALLEL_BLKS] = { 0 };
+    unsigned dists_out[PARALLEL_BLKS] = { 0 };
+    rd_cost_fx_t costs_out[PARALLEL_BLKS] = { 0 };
     for (int i = 0; i < PARALLEL_BLKS; ++i) {
-      if (mode + i * offset <= 66) {
-        search_proxy.pred_cu.intra.mode = mode + i*offset;
-        uvg_intra_predict(state, refs, cu_loc, cu_loc, COLOR_Y, preds[i], &search_proxy, NULL);
-      }
+      search_proxy[i].pred_cu.intra.mode = mode + i * offset;
+      proxy_ptrs[i] = mode + i * offset <= 66 ? &search_proxy[i] : NULL;
     }
     
     //TODO: add generic version of get cost  multi
-    get_cost_dual(state, preds, orig_block, satd_dual_func, sad_dual_func, width, height, costs_out);
+    get_rough_cost_pair(state, refs, ref_ids, cu_loc, proxy_ptrs, preds, orig_block, satd_dual_func, sad_dual_func, dists_out);
     for (int i = 0; i < PARALLEL_BLKS; ++i) {
       if (mode + i * offset <= 66) {
-        costs_out[i] += count_bits(
+        costs_out[i] = uvg_rd_cost_fx(dists_out[i], count_bits(
           state,
           intra_preds,
           not_mrl,
@@ -1118,7 +1317,7 @@ static uint8_t search_intra_rough(
           not_mpm_mode_bit,
           planar_mode_flag,
           not_planar_mode_flag,
-          not_isp_flag, mode + i * offset) * state->lambda_sqrt;
+          not_isp_flag, mode + i * offset), lambda_fx);
       }
     }
 
@@ -1169,18 +1368,18 @@ static uint8_t search_intra_rough(
         modes_to_check[num_modes_to_check++] = 1;
       } 
       for (int i = 0; i < num_modes_to_check; i += PARALLEL_BLKS) {
-        double costs_out[PARALLEL_BLKS] = { 0 };        
+        unsigned dists_out[PARALLEL_BLKS] = { 0 };
+        rd_cost_fx_t costs_out[PARALLEL_BLKS] = { 0 };
       
         for (int block = 0; block < PARALLEL_BLKS; ++block) {
-          search_proxy.pred_cu.intra.mode = modes_to_check[block + i];
-          uvg_intra_predict(state, refs, cu_loc, cu_loc, COLOR_Y, preds[block], &search_proxy, NULL);
-        
+          search_proxy[block].pred_cu.intra.mode = modes_to_check[block + i];
+          proxy_ptrs[block] = &search_proxy[block];
         }
 
         //TODO: add generic version of get cost multi
-        get_cost_dual(state, preds, orig_block, satd_dual_func, sad_dual_func, width, height, costs_out);
+        get_rough_cost_pair(state, refs, ref_ids, cu_loc, proxy_ptrs, preds, orig_block, satd_dual_func, sad_dual_func, dists_out);
         for (int block = 0; block < PARALLEL_BLKS; ++block) {
-            costs_out[block] += count_bits(
+            costs_out[block] = uvg_rd_cost_fx(dists_out[block], count_bits(
               state,
               intra_preds,
               not_mrl,
@@ -1189,7 +1388,7 @@ static uint8_t search_intra_rough(
               not_mpm_mode_bit,
               planar_mode_flag,
               not_planar_mode_flag,
-              not_isp_flag, modes_to_check[block + i]) * state->lambda_sqrt;
+              not_isp_flag, modes_to_check[block + i]), lambda_fx);
           
         }
 
@@ -1217,7 +1416,7 @@ static uint8_t search_intra_rough(
   // affecting the halving search.
   for(int i=0; i < mode_list_size; i++) {
     const int8_t mode = best_six_modes[i].mode;
-    modes_out[i].cost = costs[mode];
+    modes_out[i].cost = uvg_rd_cost_fx_to_double(costs[mode]);
     modes_out[i].pred_cu = *pred_cu;
     modes_out[i].pred_cu.intra.mode = mode;
     modes_out[i].pred_cu.intra.mode_chroma = mode;
@@ -1232,6 +1431,7 @@ static uint8_t search_intra_rough(
 static void get_rough_cost_for_2n_modes(
   encoder_state_t* const state,
   uvg_intra_references* refs,
+  const uint32_t* ref_ids,
   const cu_loc_t* const cu_loc,
   uvg_pixel *orig,
   int orig_stride,
@@ -1257,37 +1457,33 @@ static void get_rough_cost_for_2n_modes(
 
   uvg_pixels_blit(orig, orig_block, width, height, orig_stride, width);
   
-  const double mrl = state->encoder_control->cfg.mrl && (cu_loc->y % LCU_WIDTH) ? CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.multi_ref_line[0]), 1) : 0;
-  const double not_mip = state->encoder_control->cfg.mip ? CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.mip_flag[mip_ctx]), 0) : 0;
-  const double mip = state->encoder_control->cfg.mip ? CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.mip_flag[mip_ctx]), 1) : 0;
-  double costs_out[PARALLEL_BLKS] = { 0 };
-  double bits[PARALLEL_BLKS] = { 0 };
+  const uint32_t mrl = state->encoder_control->cfg.mrl && (cu_loc->y % LCU_WIDTH) ? CTX_ENTROPY_BITS(&(state->search_cabac.ctx.multi_ref_line[0]), 1) : 0;
+  const uint32_t not_mip = state->encoder_control->cfg.mip ? CTX_ENTROPY_BITS(&(state->search_cabac.ctx.mip_flag[mip_ctx]), 0) : 0;
+  const uint32_t mip = state->encoder_control->cfg.mip ? CTX_ENTROPY_BITS(&(state->search_cabac.ctx.mip_flag[mip_ctx]), 1) : 0;
+  const int64_t lambda_fx = uvg_lambda_to_fx(state->lambda_sqrt);
+  unsigned costs_out[PARALLEL_BLKS] = { 0 };
+  uint32_t bits[PARALLEL_BLKS] = { 0 };
   for(int mode = 0; mode < num_modes; mode += PARALLEL_BLKS) {
-    for (int i = 0; i < PARALLEL_BLKS; ++i) {
-      uvg_intra_predict(state, &refs[search_data[mode + i].pred_cu.intra.multi_ref_idx], cu_loc, cu_loc, COLOR_Y, preds[i], &search_data[mode + i], NULL);
-    }
-    get_cost_dual(state, preds, orig_block, satd_dual_func, sad_dual_func, width, height, costs_out);
+    intra_search_data_t *const pair[PARALLEL_BLKS] = { &search_data[mode], &search_data[mode + 1] };
+    get_rough_cost_pair(state, refs, ref_ids, cu_loc, pair, preds, orig_block, satd_dual_func, sad_dual_func, costs_out);
 
     for(int i = 0; i < PARALLEL_BLKS; ++i) {
       uint8_t multi_ref_idx = search_data[mode + i].pred_cu.intra.multi_ref_idx;
       if(multi_ref_idx) {
         bits[i] = mrl + not_mip;
-        bits[i] += CTX_ENTROPY_FBITS(&(state->search_cabac.ctx.multi_ref_line[1]), multi_ref_idx != 1);
-        bits[i] += MIN(((mode + i) % 5) + 1, 4);
+        bits[i] += CTX_ENTROPY_BITS(&(state->search_cabac.ctx.multi_ref_line[1]), multi_ref_idx != 1);
+        bits[i] += MIN(((mode + i) % 5) + 1, 4) << CTX_FRAC_BITS;
       }
       else if(search_data[mode + i].pred_cu.intra.mip_flag) {
-        bits[i] = mip + 1;
-        bits[i] += num_modes == 32 ? 4 : (num_modes == 16 ? 3 : (((mode + i) % 6) < 2 ? 2 : 3));
+        bits[i] = mip + CTX_FRAC_ONE_BIT;
+        bits[i] += (num_modes == 32 ? 4 : (num_modes == 16 ? 3 : (((mode + i) % 6) < 2 ? 2 : 3))) << CTX_FRAC_BITS;
       }
       else {
         assert(0 && "get_rough_cost_for_2n_modes supports only mrl and mip mode cost calculation");
       }
     }
-    search_data[mode].cost = costs_out[0];
-    search_data[mode + 1].cost = costs_out[1];
-
-    search_data[mode].cost += bits[0] * state->lambda_sqrt;
-    search_data[mode + 1].cost += bits[1] * state->lambda_sqrt;
+    search_data[mode].cost = uvg_rd_cost_fx_to_double(uvg_rd_cost_fx(costs_out[0], bits[0], lambda_fx));
+    search_data[mode + 1].cost = uvg_rd_cost_fx_to_double(uvg_rd_cost_fx(costs_out[1], bits[1], lambda_fx));
   }
 #undef PARALLEL_BLKS
 }
@@ -1396,6 +1592,19 @@ double uvg_luma_mode_bits(const encoder_state_t *state, const cu_info_t* const c
 {
   cabac_data_t* cabac = (cabac_data_t *)&state->search_cabac;
   double mode_bits = 0;
+  if (cabac->journal) {
+    // Count on the search CABAC and undo the updates through the journal.
+    cabac_mark_t mark;
+    uvg_cabac_journal_mark(cabac, &mark);
+    uvg_encode_intra_luma_coding_unit(
+      state,
+      cabac, cur_cu,
+      cu_loc, lcu, &mode_bits
+      );
+    uvg_cabac_journal_rollback(cabac, &mark);
+    return mode_bits;
+  }
+
   cabac_data_t cabac_copy;
   memcpy(&cabac_copy, cabac, sizeof cabac_copy);
   uvg_encode_intra_luma_coding_unit(
@@ -1803,8 +2012,14 @@ void uvg_search_cu_intra(
   int8_t num_cand = uvg_intra_get_dir_luma_predictor(cu_loc->x, cu_loc->y, candidate_modes, cur_cu, left_cu, above_cu);
 
   bool is_large = cu_loc->width > TR_MAX_WIDTH || cu_loc->height > TR_MAX_WIDTH;
+  // Rough costs are cached by the references, so clear them to make the
+  // samples past the built range deterministic.
+  const bool use_cost_cache = state->intra_cost_cache != NULL && !is_large;
+  uint32_t ref_ids[MAX_REF_LINE_IDX];
   if (!is_large) {
+    if (use_cost_cache) memset(&refs[0].ref, 0, sizeof(refs[0].ref));
     uvg_intra_build_reference(state, cu_loc, cu_loc, COLOR_Y, &luma_px, &pic_px, lcu, refs, state->encoder_control->cfg.wpp, NULL, 0, 0);
+    if (use_cost_cache) ref_ids[0] = intra_cost_cache_ref_id(state->intra_cost_cache, &refs[0], cu_loc, 0);
   }
   
   // This is needed for bit cost calculation and requires too many parameters to be
@@ -1826,12 +2041,13 @@ void uvg_search_cu_intra(
   uint8_t num_regular_modes;
   bool skip_rough_search = (is_large || state->encoder_control->cfg.rdo >= 4);
   if (!skip_rough_search) {
-    num_regular_modes = number_of_modes = search_intra_rough(
+    num_regular_modes = number_of_modes = uvg_search_intra_rough(
                           state,
                           cu_loc,
                           ref_pixels,
                           LCU_WIDTH,
                           refs,
+                          use_cost_cache ? ref_ids : NULL,
                           cu_loc->width,
                           cu_loc->height,
                           candidate_modes,
@@ -1869,7 +2085,9 @@ void uvg_search_cu_intra(
           frame->rec->stride, 1);
       }
     }
+    if (use_cost_cache) memset(&refs[line].ref, 0, sizeof(refs[line].ref));
     uvg_intra_build_reference(state, cu_loc, cu_loc, COLOR_Y, &luma_px, &pic_px, lcu, &refs[line], state->encoder_control->cfg.wpp, extra_refs, line, 0);
+    if (use_cost_cache) ref_ids[line] = intra_cost_cache_ref_id(state->intra_cost_cache, &refs[line], cu_loc, line);
     for(int i = 1; i < INTRA_MPM_COUNT; i++) {
       num_mrl_modes++;
       const int index = (i - 1) + (INTRA_MPM_COUNT -1)*(line-1) + number_of_modes;
@@ -1881,7 +2099,7 @@ void uvg_search_cu_intra(
     }
   }
   if (!skip_rough_search && lines != 1) {
-    get_rough_cost_for_2n_modes(state, refs, cu_loc,
+    get_rough_cost_for_2n_modes(state, refs, use_cost_cache ? ref_ids : NULL, cu_loc,
                                 ref_pixels,
                                 LCU_WIDTH, search_data + number_of_modes, num_mrl_modes,
                                 mip_ctx);
@@ -1910,7 +2128,7 @@ void uvg_search_cu_intra(
         }
       }
       if (!skip_rough_search) {
-        get_rough_cost_for_2n_modes(state, refs, cu_loc,
+        get_rough_cost_for_2n_modes(state, refs, use_cost_cache ? ref_ids : NULL, cu_loc,
           ref_pixels,
           LCU_WIDTH, search_data + number_of_modes, num_mip_modes,
           mip_ctx);
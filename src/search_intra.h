@@ -43,6 +43,54 @@
 #include "global.h" // IWYU pragma: keep
 #include "intra.h"
 
+// Number of entries in the rough intra cost cache. Must be a power of two.
+#define INTRA_COST_CACHE_SIZE 4096
+// Number of stored reference lines. Must be a power of two.
+#define INTRA_COST_CACHE_REFS 256
+
+typedef struct {
+  uint32_t ref_id;
+  uint32_t key;
+  uint32_t generation;
+  unsigned cost;
+} intra_cost_cache_entry_t;
+
+/**
+ * \brief Reference samples of a block, stored to compare them exactly.
+ */
+typedef struct {
+  uint64_t hash;
+  uint32_t id;
+  uint16_t left_len;
+  uint16_t top_len;
+  uvg_pixel left[INTRA_REF_LENGTH];
+  uvg_pixel top[INTRA_REF_LENGTH];
+} intra_cost_cache_refs_t;
+
+/**
+ * \brief Cache of rough intra prediction costs within a CTU.
+ *
+ * With MTT the same block position and size is reached through several
+ * split paths. The rough cost of a mode only depends on the block, the
+ * mode and the reference samples, so it is reused whenever these match.
+ * The reference samples are stored and compared, and the costs refer to
+ * them by id. Entries are invalidated by bumping the generation at the
+ * start of a CTU.
+ */
+typedef struct intra_cost_cache_t {
+  intra_cost_cache_entry_t entries[INTRA_COST_CACHE_SIZE];
+  intra_cost_cache_refs_t refs[INTRA_COST_CACHE_REFS];
+  uint32_t generation;
+  //! Id given to the next stored reference lines, never 0.
+  uint32_t next_ref_id;
+  uint64_t lookups;
+  uint64_t hits;
+} intra_cost_cache_t;
+
+intra_cost_cache_t * uvg_intra_cost_cache_alloc(void);
+void uvg_intra_cost_cache_free(intra_cost_cache_t *cache);
+void uvg_intra_cost_cache_start_ctu(intra_cost_cache_t *cache);
+
 double uvg_luma_mode_bits(const encoder_state_t *state, const cu_info_t* const cur_cu, const cu_loc_t*
                           const cu_loc,
                           const lcu_t* lcu);
@@ -59,6 +107,20 @@ int8_t uvg_search_cu_intra_chroma(
   enum uvg_tree_type tree_type,
   bool is_separate);
 
+uint8_t uvg_search_intra_rough(
+  encoder_state_t * const state,
+  const cu_loc_t* const cu_loc,
+  uvg_pixel *orig,
+  int32_t origstride,
+  uvg_intra_references *refs,
+  const uint32_t *ref_ids,
+  int width,
+  int height,
+  int8_t *intra_preds,
+  intra_search_data_t* modes_out,
+  cu_info_t* const pred_cu,
+  uint8_t mip_ctx);
+
 void uvg_search_cu_intra(
   encoder_state_t * const state,
   intra_search_data_t* search_data,
@@ -0,0 +1,234 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "strategies/avx2/input-avx2.h"
+
+#if COMPILE_INTEL_AVX2
+#include "uvg266.h"
+#include <immintrin.h>
+
+#include "strategyselector.h"
+
+#if UVG_BIT_DEPTH == 8
+
+// Split 32 pairs of bytes to the even and odd bytes.
+static INLINE void deinterleave_32x2_avx2(__m256i lo, __m256i hi,
+                                          uint8_t *dst_a, uint8_t *dst_b)
+{
+  const __m256i low_bytes = _mm256_set1_epi16(0x00ff);
+  __m256i a = _mm256_packus_epi16(_mm256_and_si256(lo, low_bytes), _mm256_and_si256(hi, low_bytes));
+  __m256i b = _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8));
+  // Packing works within 128-bit lanes, so put the quadwords back in order.
+  _mm256_storeu_si256((__m256i *)dst_a, _mm256_permute4x64_epi64(a, _MM_SHUFFLE(3, 1, 2, 0)));
+  _mm256_storeu_si256((__m256i *)dst_b, _mm256_permute4x64_epi64(b, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+
+// Mask and shift 32 words to 8 bits and pack them to bytes in order.
+static INLINE __m256i pack_16bit_avx2(const uint16_t *src, __m256i mask, __m128i shift)
+{
+  __m256i s0 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&src[0]), mask);
+  __m256i s1 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&src[16]), mask);
+  s0 = _mm256_srl_epi16(s0, shift);
+  s1 = _mm256_srl_epi16(s1, shift);
+  return _mm256_permute4x64_epi64(_mm256_packus_epi16(s0, s1), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+
+static void convert_16bit_avx2(const uint16_t *src, uint8_t *dst,
+                               int count, uint16_t mask,
+                               int shift_right, int shift_left)
+{
+  // The samples of an 8-bit build are never shifted up.
+  assert(shift_left == 0);
+  const __m256i mask_v = _mm256_set1_epi16(mask);
+  const __m128i shift = _mm_cvtsi32_si128(shift_right);
+
+  int i = 0;
+  for (; i + 32 <= count; i += 32) {
+    _mm256_storeu_si256((__m256i *)&dst[i], pack_16bit_avx2(&src[i], mask_v, shift));
+  }
+  for (; i < count; ++i) {
+    dst[i] = (uint8_t)((src[i] & mask) >> shift_right);
+  }
+}
+
+
+static void deinterleave_8bit_avx2(const uint8_t *src,
+                                   uint8_t *dst_a, uint8_t *dst_b,
+                                   int count, int shift_left)
+{
+  assert(shift_left == 0);
+
+  int i = 0;
+  for (; i + 32 <= count; i += 32) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *)&src[2 * i]);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)&src[2 * i + 32]);
+    deinterleave_32x2_avx2(lo, hi, &dst_a[i], &dst_b[i]);
+  }
+  for (; i < count; ++i) {
+    dst_a[i] = src[2 * i];
+    dst_b[i] = src[2 * i + 1];
+  }
+}
+
+
+static void deinterleave_16bit_avx2(const uint16_t *src,
+                                    uint8_t *dst_a, uint8_t *dst_b,
+                                    int count, int shift_right, int shift_left)
+{
+  assert(shift_left == 0);
+  const __m256i mask = _mm256_set1_epi16(-1);
+  const __m128i shift = _mm_cvtsi32_si128(shift_right);
+
+  int i = 0;
+  for (; i + 32 <= count; i += 32) {
+    // After packing the pairs are interleaved like 8-bit input.
+    __m256i lo = pack_16bit_avx2(&src[2 * i], mask, shift);
+    __m256i hi = pack_16bit_avx2(&src[2 * i + 32], mask, shift);
+    deinterleave_32x2_avx2(lo, hi, &dst_a[i], &dst_b[i]);
+  }
+  for (; i < count; ++i) {
+    dst_a[i] = (uint8_t)(src[2 * i] >> shift_right);
+    dst_b[i] = (uint8_t)(src[2 * i + 1] >> shift_right);
+  }
+}
+
+#else // UVG_BIT_DEPTH == 8
+
+static void convert_8bit_avx2(const uint8_t *src, uint16_t *dst,
+                              int count, int shift_left)
+{
+  const __m128i shift = _mm_cvtsi32_si128(shift_left);
+
+  int i = 0;
+  for (; i + 32 <= count; i += 32) {
+    __m256i s0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)&src[i]));
+    __m256i s1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)&src[i + 16]));
+    _mm256_storeu_si256((__m256i *)&dst[i], _mm256_sll_epi16(s0, shift));
+    _mm256_storeu_si256((__m256i *)&dst[i + 16], _mm256_sll_epi16(s1, shift));
+  }
+  for (; i < count; ++i) {
+    dst[i] = (uint16_t)(src[i] << shift_left);
+  }
+}
+
+
+static void convert_16bit_avx2(const uint16_t *src, uint16_t *dst,
+                               int count, uint16_t mask,
+                               int shift_right, int shift_left)
+{
+  const __m256i mask_v = _mm256_set1_epi16(mask);
+  const __m128i right = _mm_cvtsi32_si128(shift_right);
+  const __m128i left = _mm_cvtsi32_si128(shift_left);
+
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i s = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&src[i]), mask_v);
+    _mm256_storeu_si256((__m256i *)&dst[i], _mm256_sll_epi16(_mm256_srl_epi16(s, right), left));
+  }
+  for (; i < count; ++i) {
+    dst[i] = (uint16_t)(((src[i] & mask) >> shift_right) << shift_left);
+  }
+}
+
+
+static void deinterleave_8bit_avx2(const uint8_t *src,
+                                   uint16_t *dst_a, uint16_t *dst_b,
+                                   int count, int shift_left)
+{
+  const __m256i low_bytes = _mm256_set1_epi16(0x00ff);
+  const __m128i shift = _mm_cvtsi32_si128(shift_left);
+
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    // The even and odd bytes widened to words are the two planes.
+    __m256i s = _mm256_loadu_si256((const __m256i *)&src[2 * i]);
+    _mm256_storeu_si256((__m256i *)&dst_a[i], _mm256_sll_epi16(_mm256_and_si256(s, low_bytes), shift));
+    _mm256_storeu_si256((__m256i *)&dst_b[i], _mm256_sll_epi16(_mm256_srli_epi16(s, 8), shift));
+  }
+  for (; i < count; ++i) {
+    dst_a[i] = (uint16_t)(src[2 * i] << shift_left);
+    dst_b[i] = (uint16_t)(src[2 * i + 1] << shift_left);
+  }
+}
+
+
+static void deinterleave_16bit_avx2(const uint16_t *src,
+                                    uint16_t *dst_a, uint16_t *dst_b,
+                                    int count, int shift_right, int shift_left)
+{
+  const __m256i low_words = _mm256_set1_epi32(0x0000ffff);
+  const __m128i right = _mm_cvtsi32_si128(shift_right);
+  const __m128i left = _mm_cvtsi32_si128(shift_left);
+
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i s0 = _mm256_loadu_si256((const __m256i *)&src[2 * i]);
+    __m256i s1 = _mm256_loadu_si256((const __m256i *)&src[2 * i + 16]);
+    s0 = _mm256_sll_epi16(_mm256_srl_epi16(s0, right), left);
+    s1 = _mm256_sll_epi16(_mm256_srl_epi16(s1, right), left);
+    // Pack the low and high words of each pair, and put the quadwords back
+    // in order after packing within 128-bit lanes.
+    __m256i a = _mm256_packus_epi32(_mm256_and_si256(s0, low_words), _mm256_and_si256(s1, low_words));
+    __m256i b = _mm256_packus_epi32(_mm256_srli_epi32(s0, 16), _mm256_srli_epi32(s1, 16));
+    _mm256_storeu_si256((__m256i *)&dst_a[i], _mm256_permute4x64_epi64(a, _MM_SHUFFLE(3, 1, 2, 0)));
+    _mm256_storeu_si256((__m256i *)&dst_b[i], _mm256_permute4x64_epi64(b, _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  for (; i < count; ++i) {
+    dst_a[i] = (uint16_t)((src[2 * i] >> shift_right) << shift_left);
+    dst_b[i] = (uint16_t)((src[2 * i + 1] >> shift_right) << shift_left);
+  }
+}
+
+#endif // UVG_BIT_DEPTH == 8
+#endif //COMPILE_INTEL_AVX2
+
+int uvg_strategy_register_input_avx2(void* opaque, uint8_t bitdepth)
+{
+  bool success = true;
+#if COMPILE_INTEL_AVX2
+#if UVG_BIT_DEPTH == 8
+  if (bitdepth == 8) {
+    success &= uvg_strategyselector_register(opaque, "convert_16bit", "avx2", 40, &convert_16bit_avx2);
+    success &= uvg_strategyselector_register(opaque, "deinterleave_8bit", "avx2", 40, &deinterleave_8bit_avx2);
+    success &= uvg_strategyselector_register(opaque, "deinterleave_16bit", "avx2", 40, &deinterleave_16bit_avx2);
+  }
+#else
+  success &= uvg_strategyselector_register(opaque, "convert_8bit", "avx2", 40, &convert_8bit_avx2);
+  success &= uvg_strategyselector_register(opaque, "convert_16bit", "avx2", 40, &convert_16bit_avx2);
+  success &= uvg_strategyselector_register(opaque, "deinterleave_8bit", "avx2", 40, &deinterleave_8bit_avx2);
+  success &= uvg_strategyselector_register(opaque, "deinterleave_16bit", "avx2", 40, &deinterleave_16bit_avx2);
+#endif // UVG_BIT_DEPTH == 8
+#endif //COMPILE_INTEL_AVX2
+  return success;
+}
@@ -1730,6 +1730,127 @@ static double pixel_var_avx2(const uint8_t *buf, const uint32_t len)
 #endif // !INACCURATE_VARIANCE_CALCULATION
 
 
+static void directional_gradients_avx2(const uint8_t *buf, int stride, int width, int height,
+                                       uint32_t *grad_hor, uint32_t *grad_ver)
+{
+  // Shuffle masks that shift a row one pixel to the left and repeat the last
+  // pixel of the row, so that the last difference of the row becomes zero.
+  const __m128i shift_last_4  = _mm_setr_epi8(1, 2, 3, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i shift_last_8  = _mm_setr_epi8(1, 2, 3, 4, 5, 6, 7, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i shift_last_16 = _mm_setr_epi8(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 15);
+
+  __m128i hor = _mm_setzero_si128();
+  __m128i ver = _mm_setzero_si128();
+
+  if (width == 4 || width == 8) {
+    const __m128i shift_last = width == 4 ? shift_last_4 : shift_last_8;
+    __m128i cur = width == 4 ? _mm_cvtsi32_si128(*(const int32_t *)buf)
+                             : _mm_loadl_epi64((const __m128i *)buf);
+    for (int y = 0; y < height; ++y) {
+      const __m128i shifted = _mm_shuffle_epi8(cur, shift_last);
+      hor = _mm_add_epi64(hor, _mm_sad_epu8(cur, shifted));
+      if (y < height - 1) {
+        const uint8_t *next_row = &buf[(y + 1) * stride];
+        const __m128i next = width == 4 ? _mm_cvtsi32_si128(*(const int32_t *)next_row)
+                                        : _mm_loadl_epi64((const __m128i *)next_row);
+        ver = _mm_add_epi64(ver, _mm_sad_epu8(cur, next));
+        cur = next;
+      }
+    }
+  } else if (width % 16 == 0) {
+    for (int y = 0; y < height; ++y) {
+      const uint8_t *row = &buf[y * stride];
+      for (int x = 0; x < width; x += 16) {
+        const __m128i cur = _mm_loadu_si128((const __m128i *)&row[x]);
+        const __m128i shifted = x + 16 < width ? _mm_loadu_si128((const __m128i *)&row[x + 1])
+                                               : _mm_shuffle_epi8(cur, shift_last_16);
+        hor = _mm_add_epi64(hor, _mm_sad_epu8(cur, shifted));
+        if (y < height - 1) {
+          const __m128i next = _mm_loadu_si128((const __m128i *)&row[x + stride]);
+          ver = _mm_add_epi64(ver, _mm_sad_epu8(cur, next));
+        }
+      }
+    }
+  } else {
+    uint32_t hor_sum = 0;
+    uint32_t ver_sum = 0;
+    for (int y = 0; y < height; ++y) {
+      const uint8_t *row = &buf[y * stride];
+      for (int x = 0; x < width - 1; ++x) {
+        hor_sum += abs(row[x + 1] - row[x]);
+      }
+      if (y < height - 1) {
+        for (int x = 0; x < width; ++x) {
+          ver_sum += abs(row[x + stride] - row[x]);
+        }
+      }
+    }
+    *grad_hor = hor_sum;
+    *grad_ver = ver_sum;
+    return;
+  }
+
+  hor = _mm_add_epi64(hor, _mm_shuffle_epi32(hor, _MM_SHUFFLE(1, 0, 3, 2)));
+  ver = _mm_add_epi64(ver, _mm_shuffle_epi32(ver, _MM_SHUFFLE(1, 0, 3, 2)));
+  *grad_hor = _mm_cvtsi128_si32(hor);
+  *grad_ver = _mm_cvtsi128_si32(ver);
+}
+
+static void block_sum_sq_avx2(const uint8_t *buf, int stride, int width, int height,
+                              uint32_t *sum, uint64_t *sum_sq)
+{
+  if (width != 4 && width != 8 && width % 16 != 0) {
+    uint32_t s = 0;
+    uint64_t sq = 0;
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        const uint32_t val = buf[x + y * stride];
+        s += val;
+        sq += val * val;
+      }
+    }
+    *sum = s;
+    *sum_sq = sq;
+    return;
+  }
+
+  // The squares of a 64x64 block of 8-bit pixels fit into 32 bits, so the
+  // square sums can be accumulated in 32-bit lanes.
+  __m128i sums = _mm_setzero_si128();
+  __m256i squares = _mm256_setzero_si256();
+
+  for (int y = 0; y < height; ++y) {
+    const uint8_t *row = &buf[y * stride];
+    if (width == 4) {
+      const __m128i cur = _mm_cvtsi32_si128(*(const int32_t *)row);
+      const __m128i cur_16 = _mm_cvtepu8_epi16(cur);
+      sums = _mm_add_epi64(sums, _mm_sad_epu8(cur, _mm_setzero_si128()));
+      squares = _mm256_add_epi32(squares, _mm256_castsi128_si256(_mm_madd_epi16(cur_16, cur_16)));
+    } else if (width == 8) {
+      const __m128i cur = _mm_loadl_epi64((const __m128i *)row);
+      const __m128i cur_16 = _mm_cvtepu8_epi16(cur);
+      sums = _mm_add_epi64(sums, _mm_sad_epu8(cur, _mm_setzero_si128()));
+      squares = _mm256_add_epi32(squares, _mm256_castsi128_si256(_mm_madd_epi16(cur_16, cur_16)));
+    } else {
+      for (int x = 0; x < width; x += 16) {
+        const __m128i cur = _mm_loadu_si128((const __m128i *)&row[x]);
+        const __m256i cur_16 = _mm256_cvtepu8_epi16(cur);
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(cur, _mm_setzero_si128()));
+        squares = _mm256_add_epi32(squares, _mm256_madd_epi16(cur_16, cur_16));
+      }
+    }
+  }
+
+  __m128i sq = _mm_add_epi32(_mm256_castsi256_si128(squares), _mm256_extracti128_si256(squares, 1));
+  sq = _mm_add_epi32(sq, _mm_shuffle_epi32(sq, _MM_SHUFFLE(1, 0, 3, 2)));
+  sq = _mm_add_epi32(sq, _mm_shuffle_epi32(sq, _MM_SHUFFLE(2, 3, 0, 1)));
+  sums = _mm_add_epi64(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+
+  *sum = _mm_cvtsi128_si32(sums);
+  *sum_sq = (uint32_t)_mm_cvtsi128_si32(sq);
+}
+
+
 static INLINE __m128i get_residual_4x1_avx2(const uint8_t* a_in, const uint8_t* b_in) {
   __m128i a = _mm_cvtsi32_si128(*(int32_t*)a_in);
   __m128i b = _mm_cvtsi32_si128(*(int32_t*)b_in);
@@ -1823,6 +1944,8 @@ int uvg_strategy_register_picture_avx2(void* opaque, uint8_t bitdepth)
     success &= uvg_strategyselector_register(opaque, "hor_sad", "avx2", 40, &hor_sad_avx2);
 
     success &= uvg_strategyselector_register(opaque, "pixel_var", "avx2", 40, &pixel_var_avx2);
+    success &= uvg_strategyselector_register(opaque, "directional_gradients", "avx2", 40, &directional_gradients_avx2);
+    success &= uvg_strategyselector_register(opaque, "block_sum_sq", "avx2", 40, &block_sum_sq_avx2);
 
     success &= uvg_strategyselector_register(opaque, "generate_residual", "avx2", 0, &generate_residual_avx2);
 
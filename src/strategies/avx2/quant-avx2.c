@@ -696,7 +696,7 @@ int uvg_quantize_residual_avx2(encoder_state_t *const state,
     uvg_transformskip(state->encoder_control, residual, coeff, width, height);
   }
   else {
-    uvg_transform2d(state->encoder_control, residual, coeff, width, height, color, cur_cu);
+    uvg_transform2d_cached(state, residual, coeff, width, height, color, cur_cu);
   }
 
   const uint16_t lfnst_index = color == COLOR_Y ? cur_cu->lfnst_idx : cur_cu->cr_lfnst_idx;
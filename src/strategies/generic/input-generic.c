@@ -0,0 +1,138 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "strategies/generic/input-generic.h"
+
+#include "strategies/strategies-input.h"
+#include "strategyselector.h"
+
+#include <string.h>
+
+
+/**
+ * \brief Convert 8-bit samples to pixels.
+ *
+ * \param src         count samples
+ * \param dst         destination
+ * \param count       number of samples
+ * \param shift_left  shift from the input to the output bit depth
+ */
+static void convert_8bit_generic(const uint8_t *src, uvg_pixel *dst,
+                                 int count, int shift_left)
+{
+  if (sizeof(uvg_pixel) == 1) {
+    // The samples of an 8-bit build are never shifted up.
+    memcpy(dst, src, count);
+    return;
+  }
+  for (int i = 0; i < count; ++i) {
+    dst[i] = (uvg_pixel)(src[i] << shift_left);
+  }
+}
+
+
+/**
+ * \brief Convert 16-bit samples to pixels.
+ *
+ * Each sample is masked with mask, shifted right by shift_right and then
+ * left by shift_left. This takes both samples in the low bits and
+ * MSB-aligned samples to the output bit depth.
+ */
+static void convert_16bit_generic(const uint16_t *src, uvg_pixel *dst,
+                                  int count, uint16_t mask,
+                                  int shift_right, int shift_left)
+{
+  for (int i = 0; i < count; ++i) {
+    dst[i] = (uvg_pixel)(((src[i] & mask) >> shift_right) << shift_left);
+  }
+}
+
+
+/**
+ * \brief Split interleaved 8-bit samples to two planes.
+ *
+ * \param src         count pairs of samples
+ * \param dst_a       destination of the first sample of each pair
+ * \param dst_b       destination of the second sample of each pair
+ * \param count       number of pairs
+ * \param shift_left  shift from the input to the output bit depth
+ */
+static void deinterleave_8bit_generic(const uint8_t *src,
+                                      uvg_pixel *dst_a, uvg_pixel *dst_b,
+                                      int count, int shift_left)
+{
+  for (int i = 0; i < count; ++i) {
+    dst_a[i] = (uvg_pixel)(src[2 * i] << shift_left);
+    dst_b[i] = (uvg_pixel)(src[2 * i + 1] << shift_left);
+  }
+}
+
+
+/**
+ * \brief Split interleaved MSB-aligned 16-bit samples to two planes.
+ *
+ * Each sample is shifted like in convert_16bit without a mask.
+ */
+static void deinterleave_16bit_generic(const uint16_t *src,
+                                       uvg_pixel *dst_a, uvg_pixel *dst_b,
+                                       int count, int shift_right, int shift_left)
+{
+  for (int i = 0; i < count; ++i) {
+    dst_a[i] = (uvg_pixel)((src[2 * i] >> shift_right) << shift_left);
+    dst_b[i] = (uvg_pixel)((src[2 * i + 1] >> shift_right) << shift_left);
+  }
+}
+
+
+/**
+ * \brief Copy 16-bit words swapping their bytes.
+ */
+static void swap_16bit_generic(const uint16_t *src, uint16_t *dst, int count)
+{
+  for (int i = 0; i < count; ++i) {
+    dst[i] = (uint16_t)((src[i] << 8) | (src[i] >> 8));
+  }
+}
+
+
+int uvg_strategy_register_input_generic(void* opaque, uint8_t bitdepth)
+{
+  bool success = true;
+
+  success &= uvg_strategyselector_register(opaque, "convert_8bit", "generic", 0, &convert_8bit_generic);
+  success &= uvg_strategyselector_register(opaque, "convert_16bit", "generic", 0, &convert_16bit_generic);
+  success &= uvg_strategyselector_register(opaque, "deinterleave_8bit", "generic", 0, &deinterleave_8bit_generic);
+  success &= uvg_strategyselector_register(opaque, "deinterleave_16bit", "generic", 0, &deinterleave_16bit_generic);
+  success &= uvg_strategyselector_register(opaque, "swap_16bit", "generic", 0, &swap_16bit_generic);
+
+  return success;
+}
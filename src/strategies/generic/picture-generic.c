@@ -1353,6 +1353,50 @@ static double pixel_var_generic(const uvg_pixel *arr, const uint32_t len)
   return var;
 }
 
+/**
+ * \brief Calculate the sums of absolute differences between horizontally and
+ *        vertically adjacent pixels of a block.
+ *
+ * \param grad_hor  Returns sum of |p(x+1, y) - p(x, y)|, (width - 1) * height terms.
+ * \param grad_ver  Returns sum of |p(x, y+1) - p(x, y)|, width * (height - 1) terms.
+ */
+static void directional_gradients_generic(const uvg_pixel *buf, int stride, int width, int height,
+                                          uint32_t *grad_hor, uint32_t *grad_ver)
+{
+  uint32_t hor = 0;
+  uint32_t ver = 0;
+  for (int y = 0; y < height; ++y) {
+    const uvg_pixel *row = &buf[y * stride];
+    for (int x = 0; x < width - 1; ++x) {
+      hor += abs(row[x + 1] - row[x]);
+    }
+    if (y < height - 1) {
+      for (int x = 0; x < width; ++x) {
+        ver += abs(row[x + stride] - row[x]);
+      }
+    }
+  }
+  *grad_hor = hor;
+  *grad_ver = ver;
+}
+
+// Calculate the sum and the sum of squares of the pixels of a block.
+static void block_sum_sq_generic(const uvg_pixel *buf, int stride, int width, int height,
+                                 uint32_t *sum, uint64_t *sum_sq)
+{
+  uint32_t s = 0;
+  uint64_t sq = 0;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const uint32_t val = buf[x + y * stride];
+      s += val;
+      sq += val * val;
+    }
+  }
+  *sum = s;
+  *sum_sq = sq;
+}
+
 
 static void generate_residual_generic(const uvg_pixel* ref_in, const uvg_pixel* pred_in, int16_t* residual, 
   int width, int height, int ref_stride, int pred_stride)
@@ -1488,6 +1532,8 @@ int uvg_strategy_register_picture_generic(void* opaque, uint8_t bitdepth)
   success &= uvg_strategyselector_register(opaque, "hor_sad", "generic", 0, &hor_sad_generic);
 
   success &= uvg_strategyselector_register(opaque, "pixel_var", "generic", 0, &pixel_var_generic);
+  success &= uvg_strategyselector_register(opaque, "directional_gradients", "generic", 0, &directional_gradients_generic);
+  success &= uvg_strategyselector_register(opaque, "block_sum_sq", "generic", 0, &block_sum_sq_generic);
 
   success &= uvg_strategyselector_register(opaque, "generate_residual", "generic", 0, &generate_residual_generic);
 
@@ -0,0 +1,234 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "strategies/sse2/input-sse2.h"
+
+#if COMPILE_INTEL_SSE2
+#include "uvg266.h"
+#include <immintrin.h>
+
+#include "strategyselector.h"
+
+#if UVG_BIT_DEPTH == 8
+
+// Split 16 pairs of bytes to the even and odd bytes.
+static INLINE void deinterleave_16x2_sse2(__m128i lo, __m128i hi,
+                                          uint8_t *dst_a, uint8_t *dst_b)
+{
+  const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+  __m128i a = _mm_packus_epi16(_mm_and_si128(lo, low_bytes), _mm_and_si128(hi, low_bytes));
+  __m128i b = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+  _mm_storeu_si128((__m128i *)dst_a, a);
+  _mm_storeu_si128((__m128i *)dst_b, b);
+}
+
+
+static void convert_16bit_sse2(const uint16_t *src, uint8_t *dst,
+                               int count, uint16_t mask,
+                               int shift_right, int shift_left)
+{
+  // The samples of an 8-bit build are never shifted up.
+  assert(shift_left == 0);
+  const __m128i mask_v = _mm_set1_epi16(mask);
+  const __m128i shift = _mm_cvtsi32_si128(shift_right);
+
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i s0 = _mm_and_si128(_mm_loadu_si128((const __m128i *)&src[i]), mask_v);
+    __m128i s1 = _mm_and_si128(_mm_loadu_si128((const __m128i *)&src[i + 8]), mask_v);
+    s0 = _mm_srl_epi16(s0, shift);
+    s1 = _mm_srl_epi16(s1, shift);
+    _mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(s0, s1));
+  }
+  for (; i < count; ++i) {
+    dst[i] = (uint8_t)((src[i] & mask) >> shift_right);
+  }
+}
+
+
+static void deinterleave_8bit_sse2(const uint8_t *src,
+                                   uint8_t *dst_a, uint8_t *dst_b,
+                                   int count, int shift_left)
+{
+  assert(shift_left == 0);
+
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)&src[2 * i]);
+    __m128i hi = _mm_loadu_si128((const __m128i *)&src[2 * i + 16]);
+    deinterleave_16x2_sse2(lo, hi, &dst_a[i], &dst_b[i]);
+  }
+  for (; i < count; ++i) {
+    dst_a[i] = src[2 * i];
+    dst_b[i] = src[2 * i + 1];
+  }
+}
+
+
+static void deinterleave_16bit_sse2(const uint16_t *src,
+                                    uint8_t *dst_a, uint8_t *dst_b,
+                                    int count, int shift_right, int shift_left)
+{
+  assert(shift_left == 0);
+  const __m128i shift = _mm_cvtsi32_si128(shift_right);
+
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    // Shift to 8 bits and pack the words to bytes, which leaves the pairs
+    // interleaved like 8-bit input.
+    __m128i s0 = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)&src[2 * i]), shift);
+    __m128i s1 = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)&src[2 * i + 8]), shift);
+    __m128i s2 = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)&src[2 * i + 16]), shift);
+    __m128i s3 = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)&src[2 * i + 24]), shift);
+    deinterleave_16x2_sse2(_mm_packus_epi16(s0, s1), _mm_packus_epi16(s2, s3),
+                           &dst_a[i], &dst_b[i]);
+  }
+  for (; i < count; ++i) {
+    dst_a[i] = (uint8_t)(src[2 * i] >> shift_right);
+    dst_b[i] = (uint8_t)(src[2 * i + 1] >> shift_right);
+  }
+}
+
+#else // UVG_BIT_DEPTH == 8
+
+static void convert_8bit_sse2(const uint8_t *src, uint16_t *dst,
+                              int count, int shift_left)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i shift = _mm_cvtsi32_si128(shift_left);
+
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+    _mm_storeu_si128((__m128i *)&dst[i], _mm_sll_epi16(_mm_unpacklo_epi8(s, zero), shift));
+    _mm_storeu_si128((__m128i *)&dst[i + 8], _mm_sll_epi16(_mm_unpackhi_epi8(s, zero), shift));
+  }
+  for (; i < count; ++i) {
+    dst[i] = (uint16_t)(src[i] << shift_left);
+  }
+}
+
+
+static void convert_16bit_sse2(const uint16_t *src, uint16_t *dst,
+                               int count, uint16_t mask,
+                               int shift_right, int shift_left)
+{
+  const __m128i mask_v = _mm_set1_epi16(mask);
+  const __m128i right = _mm_cvtsi32_si128(shift_right);
+  const __m128i left = _mm_cvtsi32_si128(shift_left);
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i s = _mm_and_si128(_mm_loadu_si128((const __m128i *)&src[i]), mask_v);
+    _mm_storeu_si128((__m128i *)&dst[i], _mm_sll_epi16(_mm_srl_epi16(s, right), left));
+  }
+  for (; i < count; ++i) {
+    dst[i] = (uint16_t)(((src[i] & mask) >> shift_right) << shift_left);
+  }
+}
+
+
+static void deinterleave_8bit_sse2(const uint8_t *src,
+                                   uint16_t *dst_a, uint16_t *dst_b,
+                                   int count, int shift_left)
+{
+  const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+  const __m128i shift = _mm_cvtsi32_si128(shift_left);
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    // The even and odd bytes widened to words are the two planes.
+    __m128i s = _mm_loadu_si128((const __m128i *)&src[2 * i]);
+    _mm_storeu_si128((__m128i *)&dst_a[i], _mm_sll_epi16(_mm_and_si128(s, low_bytes), shift));
+    _mm_storeu_si128((__m128i *)&dst_b[i], _mm_sll_epi16(_mm_srli_epi16(s, 8), shift));
+  }
+  for (; i < count; ++i) {
+    dst_a[i] = (uint16_t)(src[2 * i] << shift_left);
+    dst_b[i] = (uint16_t)(src[2 * i + 1] << shift_left);
+  }
+}
+
+
+// Order the words of 4 pairs as the 4 first samples and the 4 second samples.
+static INLINE __m128i group_pairs_sse2(__m128i s)
+{
+  s = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 1, 2, 0));
+  s = _mm_shufflehi_epi16(s, _MM_SHUFFLE(3, 1, 2, 0));
+  return _mm_shuffle_epi32(s, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+
+static void deinterleave_16bit_sse2(const uint16_t *src,
+                                    uint16_t *dst_a, uint16_t *dst_b,
+                                    int count, int shift_right, int shift_left)
+{
+  const __m128i right = _mm_cvtsi32_si128(shift_right);
+  const __m128i left = _mm_cvtsi32_si128(shift_left);
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i s0 = _mm_loadu_si128((const __m128i *)&src[2 * i]);
+    __m128i s1 = _mm_loadu_si128((const __m128i *)&src[2 * i + 8]);
+    s0 = group_pairs_sse2(_mm_sll_epi16(_mm_srl_epi16(s0, right), left));
+    s1 = group_pairs_sse2(_mm_sll_epi16(_mm_srl_epi16(s1, right), left));
+    _mm_storeu_si128((__m128i *)&dst_a[i], _mm_unpacklo_epi64(s0, s1));
+    _mm_storeu_si128((__m128i *)&dst_b[i], _mm_unpackhi_epi64(s0, s1));
+  }
+  for (; i < count; ++i) {
+    dst_a[i] = (uint16_t)((src[2 * i] >> shift_right) << shift_left);
+    dst_b[i] = (uint16_t)((src[2 * i + 1] >> shift_right) << shift_left);
+  }
+}
+
+#endif // UVG_BIT_DEPTH == 8
+#endif //COMPILE_INTEL_SSE2
+
+int uvg_strategy_register_input_sse2(void* opaque, uint8_t bitdepth)
+{
+  bool success = true;
+#if COMPILE_INTEL_SSE2
+#if UVG_BIT_DEPTH == 8
+  if (bitdepth == 8) {
+    // Converting 8-bit samples is a copy, which the generic version does.
+    success &= uvg_strategyselector_register(opaque, "convert_16bit", "sse2", 10, &convert_16bit_sse2);
+    success &= uvg_strategyselector_register(opaque, "deinterleave_8bit", "sse2", 10, &deinterleave_8bit_sse2);
+    success &= uvg_strategyselector_register(opaque, "deinterleave_16bit", "sse2", 10, &deinterleave_16bit_sse2);
+  }
+#else
+  success &= uvg_strategyselector_register(opaque, "convert_8bit", "sse2", 10, &convert_8bit_sse2);
+  success &= uvg_strategyselector_register(opaque, "convert_16bit", "sse2", 10, &convert_16bit_sse2);
+  success &= uvg_strategyselector_register(opaque, "deinterleave_8bit", "sse2", 10, &deinterleave_8bit_sse2);
+  success &= uvg_strategyselector_register(opaque, "deinterleave_16bit", "sse2", 10, &deinterleave_16bit_sse2);
+#endif // UVG_BIT_DEPTH == 8
+#endif //COMPILE_INTEL_SSE2
+  return success;
+}
@@ -0,0 +1,82 @@
+#ifndef STRATEGIES_INPUT_H_
+#define STRATEGIES_INPUT_H_
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+/**
+ * \ingroup Optimization
+ * \file
+ * Interface for input conversion functions.
+ */
+
+#include "global.h" // IWYU pragma: keep
+#include "uvg266.h"
+
+
+// Declare function pointers.
+typedef void (convert_8bit_func)(const uint8_t *src, uvg_pixel *dst,
+                                 int count, int shift_left);
+
+typedef void (convert_16bit_func)(const uint16_t *src, uvg_pixel *dst,
+                                  int count, uint16_t mask,
+                                  int shift_right, int shift_left);
+
+typedef void (deinterleave_8bit_func)(const uint8_t *src,
+                                      uvg_pixel *dst_a, uvg_pixel *dst_b,
+                                      int count, int shift_left);
+
+typedef void (deinterleave_16bit_func)(const uint16_t *src,
+                                       uvg_pixel *dst_a, uvg_pixel *dst_b,
+                                       int count, int shift_right, int shift_left);
+
+typedef void (swap_16bit_func)(const uint16_t *src, uint16_t *dst, int count);
+
+// Declare function pointers.
+extern convert_8bit_func * uvg_convert_8bit;
+extern convert_16bit_func * uvg_convert_16bit;
+extern deinterleave_8bit_func * uvg_deinterleave_8bit;
+extern deinterleave_16bit_func * uvg_deinterleave_16bit;
+extern swap_16bit_func * uvg_swap_16bit;
+
+int uvg_strategy_register_input(void* opaque, uint8_t bitdepth);
+
+
+#define STRATEGIES_INPUT_EXPORTS \
+  {"convert_8bit", (void**) &uvg_convert_8bit}, \
+  {"convert_16bit", (void**) &uvg_convert_16bit}, \
+  {"deinterleave_8bit", (void**) &uvg_deinterleave_8bit}, \
+  {"deinterleave_16bit", (void**) &uvg_deinterleave_16bit}, \
+  {"swap_16bit", (void**) &uvg_swap_16bit}, \
+
+
+
+#endif //STRATEGIES_INPUT_H_
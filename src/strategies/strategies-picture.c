@@ -84,6 +84,9 @@ hor_sad_func *uvg_hor_sad = 0;
 
 pixel_var_func *uvg_pixel_var = 0;
 
+directional_gradients_func *uvg_directional_gradients = 0;
+block_sum_sq_func *uvg_block_sum_sq = 0;
+
 generate_residual_func *uvg_generate_residual = 0;
 
 
@@ -149,6 +149,9 @@ typedef void (inter_recon_bipred_func)(lcu_t * const lcu,
 
 typedef double (pixel_var_func)(const uvg_pixel *buf, const uint32_t len);
 
+typedef void (directional_gradients_func)(const uvg_pixel *buf, int stride, int width, int height, uint32_t *grad_hor, uint32_t *grad_ver);
+typedef void (block_sum_sq_func)(const uvg_pixel *buf, int stride, int width, int height, uint32_t *sum, uint64_t *sum_sq);
+
 typedef void (generate_residual_func)(const uvg_pixel* ref_in, const uvg_pixel* pred_in, int16_t* residual, int width, int height, int ref_stride, int pred_stride);
 
 
@@ -201,6 +204,9 @@ extern hor_sad_func *uvg_hor_sad;
 
 extern pixel_var_func *uvg_pixel_var;
 
+extern directional_gradients_func *uvg_directional_gradients;
+extern block_sum_sq_func *uvg_block_sum_sq;
+
 extern generate_residual_func* uvg_generate_residual;
 
 int uvg_strategy_register_picture(void* opaque, uint8_t bitdepth);
@@ -240,6 +246,8 @@ cost_pixel_nxn_multi_func * uvg_pixels_get_sad_dual_func(unsigned width, unsigne
   {"ver_sad", (void**) &uvg_ver_sad}, \
   {"hor_sad", (void**) &uvg_hor_sad}, \
   {"pixel_var", (void**) &uvg_pixel_var}, \
+  {"directional_gradients", (void**) &uvg_directional_gradients}, \
+  {"block_sum_sq", (void**) &uvg_block_sum_sq}, \
   {"generate_residual", (void**) &uvg_generate_residual}, \
 
 
@@ -39,6 +39,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "affinity.h"
 #include "threads.h"
 
 
@@ -47,18 +48,38 @@
  *
  * Lock acquisition order:
  *
- * 1. When locking a job and its dependency, the dependecy must be locked
- * first and then the job depending on it.
+ * 1. When locking the dependency lock of a job and the thread queue, the
+ * thread queue must be locked first. Only one dependency lock is held at a
+ * time.
  *
- * 2. When locking a job and the thread queue, the thread queue must be
- * locked first and then the job.
+ * 2. When accessing threadqueue_job_t.next or threadqueue_job_t.state
+ * after the job has been submitted, the thread queue must be locked.
+ * Setting the state to done also requires the dependency lock of the job.
  *
- * 3. When accessing threadqueue_job_t.next, the thread queue must be
- * locked.
+ * 3. When accessing threadqueue_job_t.rdepends, the dependency lock of the
+ * job must be locked.
  */
 
 #define THREADQUEUE_LIST_REALLOC_SIZE 32
 
+// Number of reverse dependencies stored in the job without allocating.
+#define THREADQUEUE_JOB_INLINE_RDEPENDS 8
+
+// Number of jobs allocated at once by the job pool.
+#define THREADQUEUE_JOB_SLAB_SIZE 256
+
+// Number of locks shared by the jobs for their dependencies.
+#define THREADQUEUE_JOB_LOCKS 64
+
+// Number of ready jobs a worker looks through for a job of its own node.
+#define THREADQUEUE_NODE_SCAN 16
+
+// Number of trace events a thread collects before writing them out.
+#define THREADQUEUE_TRACE_BUFFER_SIZE 4096
+
+// The spin limit of a worker is never reduced below max_spin divided by this.
+#define THREADQUEUE_SPIN_MIN_DIV 16
+
 #define PTHREAD_COND_SIGNAL(c) \
   if (pthread_cond_signal((c)) != 0) { \
     fprintf(stderr, "pthread_cond_signal(%s=%p) failed!\n", #c, c); \
@@ -125,20 +146,21 @@ typedef enum {
 
 
 struct threadqueue_job_t {
-  pthread_mutex_t lock;
-
   threadqueue_job_state state;
 
   /**
    * \brief Number of dependencies that have not been completed yet.
+   *
+   * Modified with atomic operations.
    */
-  int ndepends;
+  int32_t ndepends;
 
   /**
    * \brief Reverse dependencies.
    *
    * Array of pointers to jobs that depend on this one. They have to exist
-   * when the thread finishes, because they cannot be run before.
+   * when the thread finishes, because they cannot be run before. Points to
+   * rdepends_inline until more space is needed.
    */
   struct threadqueue_job_t **rdepends;
 
@@ -152,10 +174,14 @@ struct threadqueue_job_t {
    */
   int rdepends_size;
 
+  struct threadqueue_job_t *rdepends_inline[THREADQUEUE_JOB_INLINE_RDEPENDS];
+
   /**
    * \brief Reference count
+   *
+   * Modified with atomic operations.
    */
-  int refcount;
+  int32_t refcount;
 
   /**
    * \brief Pointer to the function to execute.
@@ -168,13 +194,153 @@ struct threadqueue_job_t {
   void *arg;
 
   /**
-   * \brief Pointer to the next job in the queue.
+   * \brief Jobs with a higher priority are run first.
+   */
+  int64_t priority;
+
+  /**
+   * \brief Kind of the job for the trace, NULL if not set.
+   */
+  const char *kind;
+
+  /**
+   * \brief Picture, tile and CTU of the job for the trace, -1 if not set.
+   */
+  int32_t poc;
+  int32_t tile;
+  int32_t x;
+  int32_t y;
+
+  /**
+   * \brief NUMA node whose workers should run the job, -1 for any
+   */
+  int32_t node;
+
+  /**
+   * \brief Pointer to the next job in the queue, or in the job pool if the
+   * job is free.
    */
   struct threadqueue_job_t *next;
 
 };
 
 
+typedef struct threadqueue_job_slab_t {
+  struct threadqueue_job_slab_t *next;
+  threadqueue_job_t jobs[THREADQUEUE_JOB_SLAB_SIZE];
+} threadqueue_job_slab_t;
+
+
+/**
+ * \brief Jobs shared by all thread queues.
+ *
+ * A job is created for every CTU of every frame several times, so instead
+ * of allocating and initializing a mutex for each of them, the jobs are
+ * taken from slabs and returned to a free list. The slabs are kept while a
+ * thread queue exists, so that the jobs of the next frame reuse them, and
+ * are freed once no queue exists and no job is in use.
+ */
+static struct {
+  pthread_mutex_t lock;
+  threadqueue_job_t *free_jobs;
+  threadqueue_job_slab_t *slabs;
+  int num_used;
+
+  /**
+   * \brief Number of thread queues that have not been freed
+   */
+  int num_queues;
+
+  /**
+   * \brief Locks for adding dependencies to the jobs
+   *
+   * Selected by the address of the job. Protects the reverse dependencies
+   * and the change of the state to done.
+   *
+   * The number of unfinished dependencies is an atomic count, but adding a
+   * reverse dependency cannot be made atomic the same way. It must either
+   * see the dependency done or append to its rdepends before the worker
+   * finishing the dependency reads them, and the append may reallocate
+   * the array. A shared lock keeps this check and append in one step
+   * without a mutex in every job.
+   */
+  pthread_mutex_t dep_locks[THREADQUEUE_JOB_LOCKS];
+} job_pool;
+
+static pthread_once_t job_pool_once = PTHREAD_ONCE_INIT;
+
+
+typedef struct {
+  const char *kind;
+  int32_t poc;
+  int32_t tile;
+  int32_t x;
+  int32_t y;
+  UVG_CLOCK_T start;
+  UVG_CLOCK_T stop;
+} threadqueue_trace_event_t;
+
+
+/**
+ * \brief Trace events recorded by one thread.
+ *
+ * Only the owning thread adds events, so no locking is needed until the
+ * events are written to the file.
+ */
+typedef struct {
+  threadqueue_trace_event_t events[THREADQUEUE_TRACE_BUFFER_SIZE];
+  int count;
+} threadqueue_trace_buffer_t;
+
+
+/**
+ * \brief Chrome trace of the jobs run by the queue.
+ */
+typedef struct {
+  FILE *file;
+
+  /**
+   * \brief Lock for writing to the file
+   */
+  pthread_mutex_t lock;
+
+  /**
+   * \brief Time the trace was started, timestamps are relative to it
+   */
+  UVG_CLOCK_T start;
+
+  /**
+   * \brief Number of events written to the file
+   */
+  uint64_t num_written;
+
+  /**
+   * \brief One buffer for each worker and one for jobs run when submitted
+   */
+  threadqueue_trace_buffer_t *buffers;
+  int num_buffers;
+} threadqueue_trace_t;
+
+
+typedef struct {
+  struct threadqueue_queue_t *threadqueue;
+  int id;
+
+  /**
+   * \brief Number of times to check for a job before sleeping
+   *
+   * Adapted between max_spin / THREADQUEUE_SPIN_MIN_DIV and max_spin by
+   * whether spinning found a job the last time.
+   */
+  int spin_limit;
+
+  /**
+   * \brief NUMA node the worker is pinned to, -1 if not pinned
+   */
+  int node;
+} threadqueue_worker_t;
+
+
 struct threadqueue_queue_t {
   pthread_mutex_t lock;
 
@@ -197,6 +363,11 @@ struct threadqueue_queue_t {
    */
   pthread_t *threads;
 
+  /**
+   * Arguments of the spawned threads
+   */
+  threadqueue_worker_t *workers;
+
   /**
    * \brief Number of threads spawned
    */
@@ -214,6 +385,9 @@ struct threadqueue_queue_t {
 
   /**
    * \brief Pointer to the first ready job
+   *
+   * Ready jobs are kept in the order of decreasing priority. Jobs with the
+   * same priority are in the order they became ready.
    */
   threadqueue_job_t *first;
 
@@ -221,29 +395,202 @@ struct threadqueue_queue_t {
    * \brief Pointer to the last ready job
    */
   threadqueue_job_t *last;
+
+  /**
+   * \brief Number of submitted jobs waiting for dependencies
+   */
+  int waiting_count;
+
+  /**
+   * \brief Number of jobs ready to run
+   */
+  int ready_count;
+
+  /**
+   * \brief Maximum number of times an idle worker checks for a job before
+   * sleeping, 0 to sleep right away
+   */
+  int max_spin;
+
+  /**
+   * \brief Number of workers checking for a job without the lock
+   */
+  int spinning_count;
+
+  /**
+   * \brief Number of workers sleeping on job_available
+   */
+  int sleeping_count;
+
+  /**
+   * \brief Statistics of the worker threads
+   */
+  threadqueue_stats_t stats;
+
+  /**
+   * \brief Trace of the jobs, NULL if not tracing
+   */
+  threadqueue_trace_t *trace;
 };
 
 
+static void job_pool_init(void)
+{
+  pthread_mutex_init(&job_pool.lock, NULL);
+  job_pool.free_jobs = NULL;
+  job_pool.slabs = NULL;
+  job_pool.num_used = 0;
+  job_pool.num_queues = 0;
+  for (int i = 0; i < THREADQUEUE_JOB_LOCKS; i++) {
+    pthread_mutex_init(&job_pool.dep_locks[i], NULL);
+  }
+}
+
+
+/**
+ * \brief Get the lock protecting the dependencies of a job.
+ */
+static pthread_mutex_t * job_dep_lock(const threadqueue_job_t *job)
+{
+  // Consecutive jobs of a slab use different locks.
+  const size_t index = (uintptr_t)job / sizeof(threadqueue_job_t);
+  return &job_pool.dep_locks[index % THREADQUEUE_JOB_LOCKS];
+}
+
+
+/**
+ * \brief Take a job from the pool.
+ *
+ * \return uninitialized job, or NULL on failure
+ */
+static threadqueue_job_t * job_pool_alloc(void)
+{
+  pthread_once(&job_pool_once, job_pool_init);
+  PTHREAD_LOCK(&job_pool.lock);
+
+  if (job_pool.free_jobs == NULL) {
+    threadqueue_job_slab_t *slab = MALLOC(threadqueue_job_slab_t, 1);
+    if (!slab) {
+      PTHREAD_UNLOCK(&job_pool.lock);
+      return NULL;
+    }
+    slab->next = job_pool.slabs;
+    job_pool.slabs = slab;
+    for (int i = THREADQUEUE_JOB_SLAB_SIZE - 1; i >= 0; i--) {
+      slab->jobs[i].next = job_pool.free_jobs;
+      job_pool.free_jobs = &slab->jobs[i];
+    }
+  }
+
+  threadqueue_job_t *job = job_pool.free_jobs;
+  job_pool.free_jobs = job->next;
+  job_pool.num_used++;
+
+  PTHREAD_UNLOCK(&job_pool.lock);
+  return job;
+}
+
+
+/**
+ * \brief Free the slabs if no queue exists and no job is in use.
+ *
+ * The caller must have locked the pool.
+ */
+static void job_pool_trim(void)
+{
+  if (job_pool.num_used > 0 || job_pool.num_queues > 0) return;
+
+  while (job_pool.slabs) {
+    threadqueue_job_slab_t *slab = job_pool.slabs;
+    job_pool.slabs = slab->next;
+    FREE_POINTER(slab);
+  }
+  job_pool.free_jobs = NULL;
+}
+
+
+/**
+ * \brief Return a job to the pool.
+ *
+ * \return 1 on success, 0 on failure
+ */
+static int job_pool_release(threadqueue_job_t *job)
+{
+  PTHREAD_LOCK(&job_pool.lock);
+
+  job->next = job_pool.free_jobs;
+  job_pool.free_jobs = job;
+  job_pool.num_used--;
+  job_pool_trim();
+
+  PTHREAD_UNLOCK(&job_pool.lock);
+  return 1;
+}
+
+
+/**
+ * \brief Register a new thread queue, which keeps the slabs allocated.
+ *
+ * \return 1 on success, 0 on failure
+ */
+static int job_pool_add_queue(void)
+{
+  pthread_once(&job_pool_once, job_pool_init);
+  PTHREAD_LOCK(&job_pool.lock);
+  job_pool.num_queues++;
+  PTHREAD_UNLOCK(&job_pool.lock);
+  return 1;
+}
+
+
+/**
+ * \brief Unregister a freed thread queue.
+ *
+ * \return 1 on success, 0 on failure
+ */
+static int job_pool_remove_queue(void)
+{
+  PTHREAD_LOCK(&job_pool.lock);
+  job_pool.num_queues--;
+  job_pool_trim();
+  PTHREAD_UNLOCK(&job_pool.lock);
+  return 1;
+}
+
+
 /**
  * \brief Add a job to the queue of jobs ready to run.
  *
- * The caller must have locked the thread queue and the job. This function
- * takes the ownership of the job.
+ * The caller must have locked the thread queue. This function takes the
+ * ownership of the job.
  */
 static void threadqueue_push_job(threadqueue_queue_t * threadqueue,
                                  threadqueue_job_t *job)
 {
   assert(job->ndepends == 0);
   job->state = THREADQUEUE_JOB_STATE_READY;
+  threadqueue->ready_count++;
 
   if (threadqueue->first == NULL) {
     threadqueue->first = job;
-  } else {
+    threadqueue->last = job;
+    job->next = NULL;
+  } else if (threadqueue->last->priority >= job->priority) {
     threadqueue->last->next = job;
+    threadqueue->last = job;
+    job->next = NULL;
+  } else if (threadqueue->first->priority < job->priority) {
+    job->next = threadqueue->first;
+    threadqueue->first = job;
+  } else {
+    // Insert after the last job with at least the same priority.
+    threadqueue_job_t *prev = threadqueue->first;
+    while (prev->next->priority >= job->priority) {
+      prev = prev->next;
+    }
+    job->next = prev->next;
+    prev->next = job;
   }
-
-  threadqueue->last = job;
-  job->next = NULL;
 }
 
 
@@ -253,35 +600,201 @@ static void threadqueue_push_job(threadqueue_queue_t * threadqueue,
  * The caller must have locked the thread queue. The calling function
  * receives the ownership of the job.
  */
-static threadqueue_job_t * threadqueue_pop_job(threadqueue_queue_t * threadqueue)
+static threadqueue_job_t * threadqueue_pop_job(threadqueue_queue_t * threadqueue, int node)
 {
   assert(threadqueue->first != NULL);
 
+  threadqueue_job_t *prev = NULL;
   threadqueue_job_t *job = threadqueue->first;
-  threadqueue->first = job->next;
-  job->next = NULL;
 
-  if (threadqueue->first == NULL) {
-    threadqueue->last = NULL;
+  if (node >= 0) {
+    // Prefer the jobs of the node of the worker, but only look at the first
+    // few so that high priority jobs are not delayed much. Otherwise take
+    // the first job so that no worker is left idle.
+    for (int i = 0; job && i < THREADQUEUE_NODE_SCAN; i++) {
+      if (job->node < 0 || job->node == node) break;
+      prev = job;
+      job = job->next;
+    }
+    if (!job || (job->node >= 0 && job->node != node)) {
+      prev = NULL;
+      job = threadqueue->first;
+    }
   }
 
+  if (prev) {
+    prev->next = job->next;
+  } else {
+    threadqueue->first = job->next;
+  }
+  if (threadqueue->last == job) {
+    threadqueue->last = prev;
+  }
+  job->next = NULL;
+  threadqueue->ready_count--;
+
   return job;
 }
 
 
+/**
+ * \brief Write the events of a trace buffer to the trace file.
+ *
+ * \return 1 on success, 0 on failure
+ */
+static int threadqueue_trace_flush(threadqueue_trace_t *trace, int buffer_id)
+{
+  threadqueue_trace_buffer_t * const buffer = &trace->buffers[buffer_id];
+
+  PTHREAD_LOCK(&trace->lock);
+  for (int i = 0; i < buffer->count; ++i) {
+    const threadqueue_trace_event_t * const ev = &buffer->events[i];
+    const double start_us = UVG_CLOCK_T_DIFF(trace->start, ev->start) * 1e6;
+    const double dur_us = UVG_CLOCK_T_DIFF(ev->start, ev->stop) * 1e6;
+
+    fprintf(trace->file,
+            ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+            ev->kind ? ev->kind : "job", buffer_id, start_us, dur_us);
+    const char *sep = "";
+    if (ev->poc >= 0) { fprintf(trace->file, "%s\"poc\":%d", sep, ev->poc); sep = ","; }
+    if (ev->tile >= 0) { fprintf(trace->file, "%s\"tile\":%d", sep, ev->tile); sep = ","; }
+    if (ev->x >= 0) { fprintf(trace->file, "%s\"x\":%d", sep, ev->x); sep = ","; }
+    if (ev->y >= 0) { fprintf(trace->file, "%s\"y\":%d", sep, ev->y); sep = ","; }
+    fprintf(trace->file, "}}");
+  }
+  trace->num_written += buffer->count;
+  PTHREAD_UNLOCK(&trace->lock);
+
+  buffer->count = 0;
+  return 1;
+}
+
+
+/**
+ * \brief Run a job and record it in the trace, if tracing.
+ *
+ * \param buffer_id  trace buffer of the calling thread
+ */
+static void threadqueue_run_job(threadqueue_trace_t *trace, int buffer_id, threadqueue_job_t *job)
+{
+  if (!trace) {
+    job->fptr(job->arg);
+    return;
+  }
+
+  threadqueue_trace_buffer_t * const buffer = &trace->buffers[buffer_id];
+  threadqueue_trace_event_t * const ev = &buffer->events[buffer->count];
+  UVG_GET_TIME(&ev->start);
+  job->fptr(job->arg);
+  UVG_GET_TIME(&ev->stop);
+  ev->kind = job->kind;
+  ev->poc = job->poc;
+  ev->tile = job->tile;
+  ev->x = job->x;
+  ev->y = job->y;
+
+  if (++buffer->count == THREADQUEUE_TRACE_BUFFER_SIZE &&
+      !threadqueue_trace_flush(trace, buffer_id)) {
+    // Drop the events rather than write past the buffer.
+    buffer->count = 0;
+  }
+}
+
+
+/**
+ * \brief Wake up sleeping workers for new ready jobs.
+ *
+ * Spinning workers take jobs without being woken up, so they are not
+ * woken. If all the sleeping workers are needed, they are woken with a
+ * single broadcast. The caller must have locked the thread queue.
+ *
+ * \param num_jobs  number of ready jobs that need a worker
+ *
+ * \return 1 on success, 0 on failure
+ */
+static int threadqueue_wake_workers(threadqueue_queue_t *threadqueue, int num_jobs)
+{
+  const int num_wake = MIN(num_jobs - threadqueue->spinning_count, threadqueue->sleeping_count);
+  if (num_wake <= 0) return 1;
+
+  if (num_wake > 1 && num_wake == threadqueue->sleeping_count) {
+    PTHREAD_COND_BROADCAST(&threadqueue->job_available);
+  } else {
+    for (int i = 0; i < num_wake; i++) {
+      PTHREAD_COND_SIGNAL(&threadqueue->job_available);
+    }
+  }
+  return 1;
+}
+
+
+/**
+ * \brief Check for a job without holding the lock for a while.
+ *
+ * The caller must have locked the thread queue. The lock is released while
+ * spinning and locked again before returning.
+ *
+ * \return 1 on success, 0 on failure
+ */
+static int threadqueue_spin(threadqueue_worker_t *worker)
+{
+  threadqueue_queue_t * const threadqueue = worker->threadqueue;
+  const int limit = worker->spin_limit;
+
+  threadqueue->spinning_count++;
+  PTHREAD_UNLOCK(&threadqueue->lock);
+
+  // The fields are written with the lock held. They are only checked
+  // here, and the job is taken after locking again, so a stale value only
+  // ends the spinning early or late.
+  for (int i = 0; i < limit && UVG_ATOMIC_LOAD(&threadqueue->first) == NULL &&
+                  !UVG_ATOMIC_LOAD(&threadqueue->stop); i++) {
+    UVG_CPU_RELAX();
+  }
+
+  PTHREAD_LOCK(&threadqueue->lock);
+  threadqueue->spinning_count--;
+
+  if (threadqueue->first != NULL) {
+    worker->spin_limit = threadqueue->max_spin;
+  } else {
+    worker->spin_limit = MAX(threadqueue->max_spin / THREADQUEUE_SPIN_MIN_DIV, limit / 2);
+  }
+  return 1;
+}
+
+
 /**
  * \brief Function executed by worker threads.
  */
-static void* threadqueue_worker(void* threadqueue_opaque)
+static void* threadqueue_worker(void* worker_opaque)
 {
-  threadqueue_queue_t * const threadqueue = (threadqueue_queue_t *) threadqueue_opaque;
+  threadqueue_worker_t * const worker = (threadqueue_worker_t *) worker_opaque;
+  threadqueue_queue_t * const threadqueue = worker->threadqueue;
 
   PTHREAD_LOCK(&threadqueue->lock);
 
   for (;;) {
-    while (!threadqueue->stop && threadqueue->first == NULL) {
-      // Wait until there is something to do in the queue.
-      PTHREAD_COND_WAIT(&threadqueue->job_available, &threadqueue->lock);
+    if (!threadqueue->stop && threadqueue->first == NULL) {
+      if (threadqueue->waiting_count > 0) {
+        // Submitted jobs exist but all of them wait for other jobs.
+        threadqueue->stats.stalls++;
+      }
+
+      UVG_CLOCK_T idle_start;
+      UVG_CLOCK_T idle_end;
+      UVG_GET_TIME(&idle_start);
+      if (threadqueue->max_spin > 0 && !threadqueue_spin(worker)) {
+        return NULL;
+      }
+      while (!threadqueue->stop && threadqueue->first == NULL) {
+        // Wait until there is something to do in the queue.
+        threadqueue->sleeping_count++;
+        PTHREAD_COND_WAIT(&threadqueue->job_available, &threadqueue->lock);
+        threadqueue->sleeping_count--;
+      }
+      UVG_GET_TIME(&idle_end);
+      threadqueue->stats.idle_time += UVG_CLOCK_T_DIFF(idle_start, idle_end);
     }
 
     if (threadqueue->stop) {
@@ -289,22 +802,24 @@ static void* threadqueue_worker(void* threadqueue_opaque)
     }
 
     // Get a job and remove it from the queue.
-    threadqueue_job_t *job = threadqueue_pop_job(threadqueue);
+    threadqueue_job_t *job = threadqueue_pop_job(threadqueue, worker->node);
 
-    PTHREAD_LOCK(&job->lock);
     assert(job->state == THREADQUEUE_JOB_STATE_READY);
     job->state = THREADQUEUE_JOB_STATE_RUNNING;
-    PTHREAD_UNLOCK(&job->lock);
+    threadqueue_trace_t * const trace = threadqueue->trace;
     PTHREAD_UNLOCK(&threadqueue->lock);
 
-    job->fptr(job->arg);
+    threadqueue_run_job(trace, worker->id, job);
 
     PTHREAD_LOCK(&threadqueue->lock);
-    PTHREAD_LOCK(&job->lock);
+    // After the state is set to done, no more reverse dependencies are
+    // added so they can be read without the dependency lock.
+    PTHREAD_LOCK(job_dep_lock(job));
     assert(job->state == THREADQUEUE_JOB_STATE_RUNNING);
     job->state = THREADQUEUE_JOB_STATE_DONE;
+    PTHREAD_UNLOCK(job_dep_lock(job));
 
-    PTHREAD_COND_SIGNAL(&threadqueue->job_done);
+    PTHREAD_COND_BROADCAST(&threadqueue->job_done);
 
     // Go through all the jobs that depend on this one, decreasing their
     // ndepends. Count how many jobs can now start executing so we know how
@@ -312,34 +827,30 @@ static void* threadqueue_worker(void* threadqueue_opaque)
     int num_new_jobs = 0;
     for (int i = 0; i < job->rdepends_count; ++i) {
       threadqueue_job_t * const depjob = job->rdepends[i];
-      // The dependency (job) is locked before the job depending on it.
-      // This must be the same order as in uvg_threadqueue_job_dep_add.
-      PTHREAD_LOCK(&depjob->lock);
 
       assert(depjob->state == THREADQUEUE_JOB_STATE_WAITING ||
              depjob->state == THREADQUEUE_JOB_STATE_PAUSED);
-      assert(depjob->ndepends > 0);
-      depjob->ndepends--;
+      const int32_t ndepends = UVG_ATOMIC_DEC(&depjob->ndepends);
+      assert(ndepends >= 0);
 
-      if (depjob->ndepends == 0 && depjob->state == THREADQUEUE_JOB_STATE_WAITING) {
+      if (ndepends == 0 && depjob->state == THREADQUEUE_JOB_STATE_WAITING) {
         // Move the job to ready jobs.
         threadqueue_push_job(threadqueue, uvg_threadqueue_copy_ref(depjob));
+        threadqueue->waiting_count--;
         num_new_jobs++;
       }
 
       // Clear this reference to the job.
-      PTHREAD_UNLOCK(&depjob->lock);
       uvg_threadqueue_free_job(&job->rdepends[i]);
     }
     job->rdepends_count = 0;
 
-    PTHREAD_UNLOCK(&job->lock);
     uvg_threadqueue_free_job(&job);
 
     // The current thread will process one of the new jobs so we wake up
     // one threads less than the the number of new jobs.
-    for (int i = 0; i < num_new_jobs - 1; i++) {
-      pthread_cond_signal(&threadqueue->job_available);
+    if (!threadqueue_wake_workers(threadqueue, num_new_jobs - 1)) {
+      return NULL;
     }
   }
 
@@ -361,6 +872,11 @@ threadqueue_queue_t * uvg_threadqueue_init(int thread_count)
     goto failed;
   }
 
+  if (!job_pool_add_queue()) {
+    FREE_POINTER(threadqueue);
+    return NULL;
+  }
+
   if (pthread_mutex_init(&threadqueue->lock, NULL) != 0) {
     fprintf(stderr, "pthread_mutex_init failed!\n");
     goto failed;
@@ -377,7 +893,8 @@ threadqueue_queue_t * uvg_threadqueue_init(int thread_count)
   }
 
   threadqueue->threads = MALLOC(pthread_t, thread_count);
-  if (!threadqueue->threads) {
+  threadqueue->workers = MALLOC(threadqueue_worker_t, thread_count);
+  if (!threadqueue->threads || !threadqueue->workers) {
     fprintf(stderr, "Could not malloc threadqueue->threads!\n");
     goto failed;
   }
@@ -388,11 +905,24 @@ threadqueue_queue_t * uvg_threadqueue_init(int thread_count)
 
   threadqueue->first              = NULL;
   threadqueue->last               = NULL;
+  threadqueue->waiting_count      = 0;
+  threadqueue->ready_count        = 0;
+  threadqueue->max_spin           = 0;
+  threadqueue->spinning_count     = 0;
+  threadqueue->sleeping_count     = 0;
+
+  threadqueue->stats.idle_time    = 0;
+  threadqueue->stats.stalls       = 0;
+  threadqueue->trace              = NULL;
 
   // Lock the queue before creating threads, to ensure they all have correct information.
   PTHREAD_LOCK(&threadqueue->lock);
   for (int i = 0; i < thread_count; i++) {
-    if (pthread_create(&threadqueue->threads[i], NULL, threadqueue_worker, threadqueue) != 0) {
+    threadqueue->workers[i].threadqueue = threadqueue;
+    threadqueue->workers[i].id = i;
+    threadqueue->workers[i].spin_limit = 0;
+    threadqueue->workers[i].node = -1;
+    if (pthread_create(&threadqueue->threads[i], NULL, threadqueue_worker, &threadqueue->workers[i]) != 0) {
         fprintf(stderr, "pthread_create failed!\n");
         goto failed;
     }
@@ -409,6 +939,51 @@ failed:
 }
 
 
+/**
+ * \brief Set how long idle workers look for new jobs before sleeping.
+ *
+ * Waking up a sleeping thread takes a system call and a context switch,
+ * which adds to the latency of chains of short jobs. A spinning worker
+ * takes a new job right away but uses the CPU while waiting.
+ *
+ * \param max_spin  maximum number of checks, 0 to sleep right away
+ *
+ * \return 1 on success, 0 on failure
+ */
+int uvg_threadqueue_set_spin(threadqueue_queue_t * const threadqueue, int max_spin)
+{
+  PTHREAD_LOCK(&threadqueue->lock);
+  threadqueue->max_spin = MAX(0, max_spin);
+  for (int i = 0; i < threadqueue->thread_count; i++) {
+    threadqueue->workers[i].spin_limit = threadqueue->max_spin;
+  }
+  PTHREAD_UNLOCK(&threadqueue->lock);
+  return 1;
+}
+
+
+/**
+ * \brief Pin the worker threads to CPUs or NUMA nodes.
+ *
+ * Workers prefer the jobs of the node they are pinned to.
+ *
+ * \return number of nodes the workers are on, 1 if they were not pinned,
+ *         0 on failure
+ */
+int uvg_threadqueue_pin_workers(threadqueue_queue_t * const threadqueue, enum uvg_thread_affinity mode)
+{
+  int num_nodes = 1;
+  PTHREAD_LOCK(&threadqueue->lock);
+  for (int i = 0; i < threadqueue->thread_count; i++) {
+    const int node = uvg_affinity_pin_thread(threadqueue->threads[i], mode, i);
+    threadqueue->workers[i].node = node;
+    num_nodes = MAX(num_nodes, node + 1);
+  }
+  PTHREAD_UNLOCK(&threadqueue->lock);
+  return num_nodes;
+}
+
+
 /**
  * \brief Create a job and return a pointer to it.
  *
@@ -419,47 +994,98 @@ failed:
  */
 threadqueue_job_t * uvg_threadqueue_job_create(void (*fptr)(void *arg), void *arg)
 {
-  threadqueue_job_t *job = MALLOC(threadqueue_job_t, 1);
+  threadqueue_job_t *job = job_pool_alloc();
   if (!job) {
     fprintf(stderr, "Could not alloc job!\n");
     return NULL;
   }
 
-  if (pthread_mutex_init(&job->lock, NULL) != 0) {
-    fprintf(stderr, "pthread_mutex_init(job) failed!\n");
-    return NULL;
-  }
-
   job->state = THREADQUEUE_JOB_STATE_PAUSED;
   job->ndepends       = 0;
-  job->rdepends       = NULL;
+  job->rdepends       = job->rdepends_inline;
   job->rdepends_count = 0;
-  job->rdepends_size  = 0;
+  job->rdepends_size  = THREADQUEUE_JOB_INLINE_RDEPENDS;
   job->refcount       = 1;
   job->fptr           = fptr;
   job->arg            = arg;
+  job->priority       = 0;
+  job->kind           = NULL;
+  job->poc            = -1;
+  job->tile           = -1;
+  job->x              = -1;
+  job->y              = -1;
+  job->node           = -1;
+  job->next           = NULL;
 
   return job;
 }
 
 
+/**
+ * \brief Set the priority of a job.
+ *
+ * Of the jobs that are ready to run, the one with the highest priority is
+ * run first. Must be called before the job is submitted. Jobs are created
+ * with priority 0.
+ */
+void uvg_threadqueue_job_set_priority(threadqueue_job_t *job, int64_t priority)
+{
+  assert(job->state == THREADQUEUE_JOB_STATE_PAUSED);
+  job->priority = priority;
+}
+
+
+/**
+ * \brief Set the description of a job shown in the trace.
+ *
+ * \param kind   kind of work, must stay valid until the queue is freed
+ * \param poc    picture of the job, or -1
+ * \param tile   tile of the job, or -1
+ * \param x      CTU column of the job, or -1
+ * \param y      CTU row of the job, stripe of an input conversion job, or -1
+ */
+void uvg_threadqueue_job_set_label(threadqueue_job_t *job, const char *kind,
+                                   int32_t poc, int32_t tile, int32_t x, int32_t y)
+{
+  job->kind = kind;
+  job->poc = poc;
+  job->tile = tile;
+  job->x = x;
+  job->y = y;
+}
+
+
+/**
+ * \brief Set the NUMA node whose workers should run the job.
+ *
+ * Workers of other nodes still run the job if they have nothing else to
+ * do. Jobs are created with node -1, which any worker takes.
+ */
+void uvg_threadqueue_job_set_node(threadqueue_job_t *job, int node)
+{
+  assert(job->state == THREADQUEUE_JOB_STATE_PAUSED);
+  job->node = node;
+}
+
+
 int uvg_threadqueue_submit(threadqueue_queue_t * const threadqueue, threadqueue_job_t *job)
 {
   PTHREAD_LOCK(&threadqueue->lock);
-  PTHREAD_LOCK(&job->lock);
   assert(job->state == THREADQUEUE_JOB_STATE_PAUSED);
 
   if (threadqueue->thread_count == 0) {
     // When not using threads, run the job immediately.
-    job->fptr(job->arg);
+    threadqueue_run_job(threadqueue->trace, 0, job);
     job->state = THREADQUEUE_JOB_STATE_DONE;
   } else if (job->ndepends == 0) {
     threadqueue_push_job(threadqueue, uvg_threadqueue_copy_ref(job));
-    pthread_cond_signal(&threadqueue->job_available);
+    if (!threadqueue_wake_workers(threadqueue, threadqueue->ready_count)) {
+      return 0;
+    }
   } else {
     job->state = THREADQUEUE_JOB_STATE_WAITING;
+    threadqueue->waiting_count++;
   }
-  PTHREAD_UNLOCK(&job->lock);
   PTHREAD_UNLOCK(&threadqueue->lock);
 
   return 1;
@@ -477,29 +1103,34 @@ int uvg_threadqueue_submit(threadqueue_queue_t * const threadqueue, threadqueue_
  */
 int uvg_threadqueue_job_dep_add(threadqueue_job_t *job, threadqueue_job_t *dependency)
 {
-  // Lock the dependency first and then the job depending on it.
-  // This must be the same order as in threadqueue_worker.
-  PTHREAD_LOCK(&dependency->lock);
+  // The job has not been submitted yet, so only the dependency can be
+  // modified by the worker threads.
+  assert(job->state == THREADQUEUE_JOB_STATE_PAUSED);
+  PTHREAD_LOCK(job_dep_lock(dependency));
 
   if (dependency->state == THREADQUEUE_JOB_STATE_DONE) {
     // The dependency has been completed already so there is nothing to do.
-    PTHREAD_UNLOCK(&dependency->lock);
+    PTHREAD_UNLOCK(job_dep_lock(dependency));
     return 1;
   }
 
-  PTHREAD_LOCK(&job->lock);
-  job->ndepends++;
-  PTHREAD_UNLOCK(&job->lock);
+  UVG_ATOMIC_INC(&job->ndepends);
 
   // Add the reverse dependency
   if (dependency->rdepends_count >= dependency->rdepends_size) {
     dependency->rdepends_size += THREADQUEUE_LIST_REALLOC_SIZE;
     size_t bytes = dependency->rdepends_size * sizeof(threadqueue_job_t*);
-    dependency->rdepends = realloc(dependency->rdepends, bytes);
+    if (dependency->rdepends == dependency->rdepends_inline) {
+      dependency->rdepends = malloc(bytes);
+      memcpy(dependency->rdepends, dependency->rdepends_inline,
+             sizeof(dependency->rdepends_inline));
+    } else {
+      dependency->rdepends = realloc(dependency->rdepends, bytes);
+    }
   }
   dependency->rdepends[dependency->rdepends_count++] = uvg_threadqueue_copy_ref(job);
 
-  PTHREAD_UNLOCK(&dependency->lock);
+  PTHREAD_UNLOCK(job_dep_lock(dependency));
 
   return 1;
 }
@@ -524,7 +1155,7 @@ threadqueue_job_t *uvg_threadqueue_copy_ref(threadqueue_job_t *job)
  * \brief Free a job.
  *
  * Decrement reference count of the job. If no references exist any more,
- * deallocate associated memory and destroy mutexes.
+ * deallocate associated memory and return the job to the pool.
  *
  * Sets the job pointer to NULL.
  */
@@ -547,9 +1178,10 @@ void uvg_threadqueue_free_job(threadqueue_job_t **job_ptr)
   }
   job->rdepends_count = 0;
 
-  FREE_POINTER(job->rdepends);
-  pthread_mutex_destroy(&job->lock);
-  FREE_POINTER(job);
+  if (job->rdepends != job->rdepends_inline) {
+    FREE_POINTER(job->rdepends);
+  }
+  job_pool_release(job);
 }
 
 
@@ -560,16 +1192,98 @@ void uvg_threadqueue_free_job(threadqueue_job_t **job_ptr)
  */
 int uvg_threadqueue_waitfor(threadqueue_queue_t * threadqueue, threadqueue_job_t * job)
 {
-  PTHREAD_LOCK(&job->lock);
+  PTHREAD_LOCK(&threadqueue->lock);
   while (job->state != THREADQUEUE_JOB_STATE_DONE) {
-    PTHREAD_COND_WAIT(&threadqueue->job_done, &job->lock);
+    PTHREAD_COND_WAIT(&threadqueue->job_done, &threadqueue->lock);
+  }
+  PTHREAD_UNLOCK(&threadqueue->lock);
+
+  return 1;
+}
+
+
+/**
+ * \brief Get the statistics of the worker threads.
+ *
+ * The time a worker spends waiting is added when it gets a job or stops.
+ *
+ * \return 1 on success, 0 on failure
+ */
+int uvg_threadqueue_get_stats(threadqueue_queue_t * threadqueue, threadqueue_stats_t *stats)
+{
+  PTHREAD_LOCK(&threadqueue->lock);
+  *stats = threadqueue->stats;
+  PTHREAD_UNLOCK(&threadqueue->lock);
+  return 1;
+}
+
+
+/**
+ * \brief Start recording a Chrome trace of the jobs.
+ *
+ * Each job is written as a complete event with the worker thread as the
+ * thread id. Must be called before any jobs are submitted. The trace is
+ * finished when the queue is freed, but the file is not closed.
+ *
+ * \return 1 on success, 0 on failure
+ */
+int uvg_threadqueue_trace_start(threadqueue_queue_t * threadqueue, FILE *file)
+{
+  assert(!threadqueue->trace);
+  threadqueue_trace_t *trace = MALLOC(threadqueue_trace_t, 1);
+  if (!trace) return 0;
+
+  // Jobs run when submitted use the first buffer if there are no workers.
+  trace->num_buffers = MAX(1, threadqueue->thread_count);
+  trace->buffers = MALLOC(threadqueue_trace_buffer_t, trace->num_buffers);
+  if (!trace->buffers) {
+    FREE_POINTER(trace);
+    return 0;
+  }
+  for (int i = 0; i < trace->num_buffers; ++i) {
+    trace->buffers[i].count = 0;
+  }
+  trace->file = file;
+  trace->num_written = 0;
+  pthread_mutex_init(&trace->lock, NULL);
+  UVG_GET_TIME(&trace->start);
+
+  fprintf(file, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"uvg266\"}}");
+  for (int i = 0; i < trace->num_buffers; ++i) {
+    fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+            i, threadqueue->thread_count ? "worker" : "main", i);
   }
-  PTHREAD_UNLOCK(&job->lock);
 
+  PTHREAD_LOCK(&threadqueue->lock);
+  threadqueue->trace = trace;
+  PTHREAD_UNLOCK(&threadqueue->lock);
   return 1;
 }
 
 
+/**
+ * \brief Write the remaining events and finish the trace.
+ *
+ * The threads must have been stopped.
+ */
+static void threadqueue_trace_finish(threadqueue_queue_t * threadqueue)
+{
+  threadqueue_trace_t *trace = threadqueue->trace;
+  if (!trace) return;
+  threadqueue->trace = NULL;
+
+  for (int i = 0; i < trace->num_buffers; ++i) {
+    threadqueue_trace_flush(trace, i);
+  }
+  fprintf(trace->file, "\n]\n");
+  fflush(trace->file);
+
+  pthread_mutex_destroy(&trace->lock);
+  FREE_POINTER(trace->buffers);
+  FREE_POINTER(trace);
+}
+
+
 /**
  * \brief Stop all threads after they finish the current jobs.
  *
@@ -615,6 +1329,7 @@ void uvg_threadqueue_free(threadqueue_queue_t *threadqueue)
   if (threadqueue == NULL) return;
 
   uvg_threadqueue_stop(threadqueue);
+  threadqueue_trace_finish(threadqueue);
 
   // Free all jobs.
   while (threadqueue->first) {
@@ -625,6 +1340,7 @@ void uvg_threadqueue_free(threadqueue_queue_t *threadqueue)
   threadqueue->last = NULL;
 
   FREE_POINTER(threadqueue->threads);
+  FREE_POINTER(threadqueue->workers);
   threadqueue->thread_count = 0;
 
   if (pthread_mutex_destroy(&threadqueue->lock) != 0) {
@@ -640,4 +1356,6 @@ void uvg_threadqueue_free(threadqueue_queue_t *threadqueue)
   }
 
   FREE_POINTER(threadqueue);
+
+  job_pool_remove_queue();
 }
@@ -38,15 +38,33 @@
  */
 
 #include "global.h" // IWYU pragma: keep
+#include "uvg266.h"
 
 #include <pthread.h>
+#include <stdio.h>
 
 typedef struct threadqueue_job_t threadqueue_job_t;
 typedef struct threadqueue_queue_t threadqueue_queue_t;
 
+/**
+ * \brief Statistics of the worker threads of a queue.
+ */
+typedef struct {
+  //! Total time the workers have waited for a job to run, in seconds.
+  double idle_time;
+  //! Number of times a worker started waiting while all submitted jobs were waiting for dependencies.
+  uint64_t stalls;
+} threadqueue_stats_t;
+
 threadqueue_queue_t * uvg_threadqueue_init(int thread_count);
+int uvg_threadqueue_set_spin(threadqueue_queue_t *const threadqueue, int max_spin);
+int uvg_threadqueue_pin_workers(threadqueue_queue_t *const threadqueue, enum uvg_thread_affinity mode);
 
 threadqueue_job_t * uvg_threadqueue_job_create(void (*fptr)(void *arg), void *arg);
+void uvg_threadqueue_job_set_priority(threadqueue_job_t *job, int64_t priority);
+void uvg_threadqueue_job_set_label(threadqueue_job_t *job, const char *kind,
+                                   int32_t poc, int32_t tile, int32_t x, int32_t y);
+void uvg_threadqueue_job_set_node(threadqueue_job_t *job, int node);
 int uvg_threadqueue_submit(threadqueue_queue_t *const threadqueue, threadqueue_job_t *job);
 
 int uvg_threadqueue_job_dep_add(threadqueue_job_t *job, threadqueue_job_t *dependency);
@@ -56,5 +74,7 @@ threadqueue_job_t *uvg_threadqueue_copy_ref(threadqueue_job_t *job);
 void uvg_threadqueue_free_job(threadqueue_job_t **job_ptr);
 
 int uvg_threadqueue_waitfor(threadqueue_queue_t * threadqueue, threadqueue_job_t * job);
+int uvg_threadqueue_get_stats(threadqueue_queue_t * threadqueue, threadqueue_stats_t *stats);
+int uvg_threadqueue_trace_start(threadqueue_queue_t * threadqueue, FILE *file);
 int uvg_threadqueue_stop(threadqueue_queue_t *const threadqueue);
 void uvg_threadqueue_free(threadqueue_queue_t * threadqueue);
@@ -67,6 +67,15 @@
 
 #define UVG_ATOMIC_INC(ptr)                     __sync_add_and_fetch((volatile int32_t*)ptr, 1)
 #define UVG_ATOMIC_DEC(ptr)                     __sync_add_and_fetch((volatile int32_t*)ptr, -1)
+#define UVG_ATOMIC_LOAD(ptr)                    __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+
+#if defined(__i386__) || defined(__x86_64__)
+#define UVG_CPU_RELAX()                         __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define UVG_CPU_RELAX()                         __asm__ __volatile__("yield")
+#else
+#define UVG_CPU_RELAX()                         __sync_synchronize()
+#endif
 
 #else //__GNUC__
 //TODO: we assume !GCC => Windows... this may be bad
@@ -81,6 +90,8 @@
 
 #define UVG_ATOMIC_INC(ptr)                     InterlockedIncrement((volatile LONG*)ptr)
 #define UVG_ATOMIC_DEC(ptr)                     InterlockedDecrement((volatile LONG*)ptr)
+#define UVG_ATOMIC_LOAD(ptr)                    (MemoryBarrier(), *(ptr))
+#define UVG_CPU_RELAX()                         YieldProcessor()
 
 #endif //__GNUC__
 
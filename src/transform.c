@@ -32,6 +32,11 @@
 
 #include "transform.h"
 
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "encode_coding_tree.h"
 #include "image.h"
 #include "intra.h"
@@ -291,6 +296,104 @@ void uvg_itransform2d(const encoder_control_t * const encoder,
   }
 }
 
+transform_cache_t * uvg_transform_cache_alloc(void)
+{
+  return calloc(1, sizeof(transform_cache_t));
+}
+
+void uvg_transform_cache_free(transform_cache_t *cache)
+{
+  if (!cache) return;
+#ifdef UVG_DEBUG_PRINT_TRANSFORM_CACHE
+  fprintf(stderr, "Transform cache: %" PRIu64 " lookups, %" PRIu64 " hits (%.1f %%)\n",
+          cache->lookups, cache->hits,
+          cache->lookups ? 100.0 * cache->hits / cache->lookups : 0.0);
+#endif //UVG_DEBUG_PRINT_TRANSFORM_CACHE
+  free(cache);
+}
+
+/**
+ * \brief Invalidate all entries of the cache for a new CTU.
+ */
+void uvg_transform_cache_start_ctu(transform_cache_t *cache)
+{
+  cache->generation++;
+  if (cache->generation == 0) {
+    // Wrapped around, old entries could match the new generation.
+    for (int i = 0; i < TRANSFORM_CACHE_SIZE; ++i) {
+      cache->entries[i].generation = 0;
+    }
+    cache->generation = 1;
+  }
+}
+
+/**
+ * \brief forward transform (2D) reusing earlier results of the CTU
+ *
+ * Same as uvg_transform2d, but looks the result up from the transform cache
+ * of the state first if there is one.
+ *
+ * Only the transforms that are likely to be repeated are cached: luma
+ * blocks with LFNST, whose primary transform is the same for both LFNST
+ * indices, and chroma blocks, which the JCCR and chroma transform searches
+ * transform again. Blocks smaller than TRANSFORM_CACHE_MIN_SAMPLES are
+ * transformed faster than a miss is handled.
+ *
+ * Luma blocks without LFNST are not cached, and this includes the MTS
+ * search of --mts=intra. The key has the MTS index (tr_idx), but each MTS
+ * type transforms a residual only once, so fewer than 1 % of these lookups
+ * hit.
+ */
+void uvg_transform2d_cached(encoder_state_t * const state,
+                            int16_t *block,
+                            int16_t *coeff,
+                            int8_t block_width,
+                            int8_t block_height,
+                            color_t color,
+                            const cu_info_t *tu)
+{
+  transform_cache_t *const cache = state->transform_cache;
+  const int num_samples = block_width * block_height;
+  if (!cache || num_samples > TR_MAX_WIDTH * TR_MAX_WIDTH ||
+      num_samples < TRANSFORM_CACHE_MIN_SAMPLES ||
+      (color == COLOR_Y && tu->lfnst_idx == 0)) {
+    uvg_transform2d(state->encoder_control, block, coeff, block_width, block_height, color, tu);
+    return;
+  }
+
+  // Everything uvg_transform2d uses from the TU to select the transform.
+  const uint32_t key = (uint32_t)block_width
+    | (uint32_t)block_height << 7
+    | (uint32_t)color << 14
+    | (uint32_t)tu->type << 16
+    | (uint32_t)tu->tr_idx << 19
+    | (uint32_t)(tu->type == CU_INTRA ? tu->intra.isp_mode : 0) << 22
+    | (uint32_t)(tu->lfnst_idx != 0) << 24
+    | (uint32_t)(tu->cr_lfnst_idx != 0) << 25;
+
+  // Residuals that differ usually do so in the first samples, so comparing
+  // them directly is cheaper than hashing every residual.
+  cache->lookups++;
+  for (int i = 0; i < TRANSFORM_CACHE_SIZE; ++i) {
+    const transform_cache_entry_t *const entry = &cache->entries[i];
+    if (entry->generation == cache->generation && entry->key == key &&
+        !memcmp(entry->residual, block, num_samples * sizeof(int16_t))) {
+      cache->hits++;
+      memcpy(coeff, entry->coeff, num_samples * sizeof(coeff_t));
+      return;
+    }
+  }
+
+  uvg_transform2d(state->encoder_control, block, coeff, block_width, block_height, color, tu);
+
+  transform_cache_entry_t *const entry = &cache->entries[cache->next];
+  cache->next = (cache->next + 1) % TRANSFORM_CACHE_SIZE;
+  entry->key = key;
+  entry->generation = cache->generation;
+  memcpy(entry->residual, block, num_samples * sizeof(int16_t));
+  memcpy(entry->coeff, coeff, num_samples * sizeof(coeff_t));
+}
+
 static INLINE int64_t square(int x) {
   return x * (int64_t)x;
 }
@@ -383,8 +486,8 @@ static void generate_jccr_transforms(
   }
   if (cbf_mask1)
   {
-    uvg_transform2d(
-      state->encoder_control,
+    uvg_transform2d_cached(
+      state,
       &temp_resi[(cbf_mask1 - 1) * trans_offset],
       &u_coeff[*num_transforms * trans_offset],
       width,
@@ -397,8 +500,8 @@ static void generate_jccr_transforms(
   }
   if (cbf_mask2 && ((min_dist2 < (9 * min_dist1) / 8) || (!cbf_mask1 && min_dist2 < (3 * min_dist1) / 2)))
   {
-    uvg_transform2d(
-      state->encoder_control,
+    uvg_transform2d_cached(
+      state,
       &temp_resi[(cbf_mask2 - 1) * trans_offset],
       &u_coeff[*num_transforms * trans_offset],
       width,
@@ -578,11 +681,11 @@ void uvg_chroma_transform_search(
 
   const int depth = 6 - uvg_g_convert_to_log2[cu_loc->width];
 
-  uvg_transform2d(
-    state->encoder_control, u_resi, u_coeff, width, height, COLOR_U, pred_cu
+  uvg_transform2d_cached(
+    state, u_resi, u_coeff, width, height, COLOR_U, pred_cu
   );
-  uvg_transform2d(
-    state->encoder_control, v_resi, v_coeff, width, height, COLOR_V, pred_cu
+  uvg_transform2d_cached(
+    state, v_resi, v_coeff, width, height, COLOR_V, pred_cu
   );
   enum uvg_chroma_transforms transforms[5];
   transforms[0] = DCT7_CHROMA;
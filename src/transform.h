@@ -69,6 +69,47 @@ void uvg_itransform2d(const encoder_control_t * const encoder,
                       color_t color,
                       const cu_info_t *tu);
 
+// Number of forward transforms kept in the transform cache.
+#define TRANSFORM_CACHE_SIZE 16
+// Smallest block that is cached. The cache costs more than it saves on
+// smaller blocks unless nearly every lookup hits.
+#define TRANSFORM_CACHE_MIN_SAMPLES 256
+
+typedef struct {
+  uint32_t key;
+  uint32_t generation;
+  int16_t residual[TR_MAX_WIDTH * TR_MAX_WIDTH];
+  coeff_t coeff[TR_MAX_WIDTH * TR_MAX_WIDTH];
+} transform_cache_entry_t;
+
+/**
+ * \brief Cache of forward transforms within a CTU.
+ *
+ * The LFNST and JCCR searches and repeated split evaluations transform
+ * identical residuals with identical primary transforms. Entries are keyed
+ * by the transform parameters, and the residual is compared in full before
+ * an entry is reused.
+ */
+typedef struct transform_cache_t {
+  transform_cache_entry_t entries[TRANSFORM_CACHE_SIZE];
+  uint32_t generation;
+  uint32_t next;
+  uint64_t lookups;
+  uint64_t hits;
+} transform_cache_t;
+
+transform_cache_t * uvg_transform_cache_alloc(void);
+void uvg_transform_cache_free(transform_cache_t *cache);
+void uvg_transform_cache_start_ctu(transform_cache_t *cache);
+
+void uvg_transform2d_cached(encoder_state_t * const state,
+                            int16_t *block,
+                            int16_t *coeff,
+                            int8_t block_width,
+                            int8_t block_height,
+                            color_t color,
+                            const cu_info_t *tu);
+
 
 int32_t uvg_get_scaled_qp(color_t color, int8_t qp, int8_t qp_offset, int8_t const* const chroma_scale);
 
@@ -36,6 +36,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#endif
+
 #include "bitstream.h"
 #include "cfg.h"
 #include "checkpoint.h"
@@ -53,9 +62,139 @@
 #include "rate_control.h"
 
 
+typedef struct async_input_t {
+  uvg_picture *pic;
+  struct async_input_t *next;
+} async_input_t;
+
+typedef struct async_output_t {
+  uvg_data_chunk *data;
+  uint32_t len;
+  uvg_picture *pic;
+  uvg_picture *src;
+  uvg_frame_info info;
+  struct async_output_t *next;
+} async_output_t;
+
+/**
+ * \brief State of the thread that runs encoder_encode for encoder_submit.
+ */
+typedef struct uvg_async_t {
+  pthread_t thread;
+  bool thread_started;
+
+  //! Protects everything below.
+  pthread_mutex_t lock;
+  //! Signaled when an input picture is queued or the thread is stopped.
+  pthread_cond_t input_cond;
+
+  async_input_t *input_first;
+  async_input_t *input_last;
+  //! Set when NULL has been submitted.
+  bool input_end;
+
+  async_output_t *output_first;
+  async_output_t *output_last;
+  //! Set when all frames have been output.
+  bool finished;
+  bool failed;
+  bool stop;
+
+  void (*callback)(void *opaque);
+  void *opaque;
+
+  //! File descriptors for encoder_get_fd. Both are the same eventfd on Linux.
+  int read_fd;
+  int write_fd;
+  //! Whether write_fd has been written to since it was last cleared.
+  bool fd_set;
+} uvg_async_t;
+
+
+/**
+ * \brief Allocate the state of encoder_submit and encoder_poll.
+ *
+ * Allocated when the encoder is opened, so that the functions of the
+ * asynchronous API never race to create it.
+ */
+static uvg_async_t * async_alloc(void)
+{
+  uvg_async_t *async = calloc(1, sizeof(uvg_async_t));
+  if (!async) return NULL;
+
+  pthread_mutex_init(&async->lock, NULL);
+  pthread_cond_init(&async->input_cond, NULL);
+  async->read_fd = -1;
+  async->write_fd = -1;
+
+#if defined(__linux__)
+  async->read_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  async->write_fd = async->read_fd;
+#elif !defined(_WIN32)
+  int fds[2];
+  if (pipe(fds) == 0) {
+    for (int i = 0; i < 2; ++i) {
+      fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+      fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    async->read_fd = fds[0];
+    async->write_fd = fds[1];
+  }
+#endif
+
+  return async;
+}
+
+static void async_free(uvg_async_t *async)
+{
+  if (!async) return;
+
+  if (async->thread_started) {
+    pthread_mutex_lock(&async->lock);
+    async->stop = true;
+    pthread_cond_signal(&async->input_cond);
+    pthread_mutex_unlock(&async->lock);
+    pthread_join(async->thread, NULL);
+  }
+
+  while (async->input_first) {
+    async_input_t *input = async->input_first;
+    async->input_first = input->next;
+    uvg_image_free(input->pic);
+    free(input);
+  }
+  while (async->output_first) {
+    async_output_t *output = async->output_first;
+    async->output_first = output->next;
+    uvg_bitstream_free_chunks(output->data);
+    uvg_image_free(output->pic);
+    uvg_image_free(output->src);
+    free(output);
+  }
+
+#ifndef _WIN32
+  if (async->write_fd >= 0 && async->write_fd != async->read_fd) {
+    close(async->write_fd);
+  }
+  if (async->read_fd >= 0) {
+    close(async->read_fd);
+  }
+#endif
+
+  pthread_cond_destroy(&async->input_cond);
+  pthread_mutex_destroy(&async->lock);
+  free(async);
+}
+
+
 static void uvg266_close(uvg_encoder *encoder)
 {
   if (encoder) {
+    // The asynchronous encoding thread must be stopped before anything else
+    // since it uses the encoder.
+    async_free(encoder->async);
+    encoder->async = NULL;
+
     // The threadqueue must be stopped before freeing states.
     if (encoder->control) {
       uvg_threadqueue_stop(encoder->control->threadqueue);
@@ -113,6 +252,12 @@ static uvg_encoder * uvg266_open(const uvg_config *cfg)
   encoder->out_state_num = 0;
   encoder->frames_started = 0;
   encoder->frames_done = 0;
+  encoder->owf_active = encoder->num_encoder_states;
+  encoder->owf_busy_frames = 0;
+  if (!uvg_threadqueue_get_stats(encoder->control->threadqueue, &encoder->owf_stats)) {
+    goto uvg266_open_failure;
+  }
+  UVG_GET_TIME(&encoder->owf_time);
 
   // Assure that the rc data allocation was successful
   if(!uvg_get_rc_data(encoder->control)) {
@@ -121,6 +266,11 @@ static uvg_encoder * uvg266_open(const uvg_config *cfg)
 
   uvg_init_input_frame_buffer(&encoder->input_buffer);
 
+  encoder->async = async_alloc();
+  if (!encoder->async) {
+    goto uvg266_open_failure;
+  }
+
   encoder->states = calloc(encoder->num_encoder_states, sizeof(encoder_state_t));
   if (!encoder->states) {
     goto uvg266_open_failure;
@@ -133,6 +283,10 @@ static uvg_encoder * uvg266_open(const uvg_config *cfg)
     }
 
     encoder->states[i].frame->QP = (int8_t)cfg->qp;
+
+    // Spread the frames encoded at the same time over the NUMA nodes.
+    const int num_nodes = encoder->control->num_nodes;
+    encoder->states[i].frame->numa_node = num_nodes > 1 ? i % num_nodes : -1;
   }
 
   for (uint32_t i = 0; i < encoder->num_encoder_states; ++i) {
@@ -241,6 +395,66 @@ static int yuv_io_extract_field(const uvg_picture *frame_in, unsigned source_sca
 }
 
 
+// Share of idle worker time above which one more frame is encoded at the
+// same time.
+#define OWF_GROW_IDLE 0.10
+// Share of idle worker time below which the workers are considered busy.
+#define OWF_BUSY_IDLE 0.02
+
+/**
+ * \brief Wait until fewer than owf_active frames are being encoded.
+ *
+ * Frames that have been encoded but not output yet are not counted. The
+ * frames are waited for in coding order since they mostly finish in that
+ * order.
+ */
+static void limit_running_frames(uvg_encoder *enc)
+{
+  const unsigned in_flight = enc->frames_started - enc->frames_done;
+  for (unsigned i = 0; i + enc->owf_active <= in_flight; ++i) {
+    encoder_state_t *state = &enc->states[(enc->out_state_num + i) % enc->num_encoder_states];
+    uvg_threadqueue_waitfor(enc->control->threadqueue, state->tqj_bitstream_written);
+  }
+}
+
+/**
+ * \brief Adapt the number of frames encoded at the same time.
+ *
+ * Called when a frame is output. Idle workers mean that there is not
+ * enough work available, so one more frame is started at the same time.
+ * Idle workers with stalls mean that jobs exist but wait for other frames,
+ * which also calls for more frames. When the workers have been busy for
+ * as many frames as there are encoder states, one frame less is started
+ * to reduce the latency.
+ */
+static void update_owf_active(uvg_encoder *enc)
+{
+  threadqueue_stats_t stats;
+  UVG_CLOCK_T now;
+  if (!uvg_threadqueue_get_stats(enc->control->threadqueue, &stats)) return;
+  UVG_GET_TIME(&now);
+
+  const double worker_time = UVG_CLOCK_T_DIFF(enc->owf_time, now) * enc->control->cfg.threads;
+  const double idle = worker_time > 0 ? (stats.idle_time - enc->owf_stats.idle_time) / worker_time : 0;
+  const bool stalled = stats.stalls > enc->owf_stats.stalls;
+  enc->owf_stats = stats;
+  enc->owf_time = now;
+
+  if (idle > OWF_GROW_IDLE || (stalled && idle > OWF_BUSY_IDLE)) {
+    enc->owf_busy_frames = 0;
+    if (enc->owf_active < enc->num_encoder_states) enc->owf_active++;
+  } else if (idle < OWF_BUSY_IDLE) {
+    enc->owf_busy_frames++;
+    if (enc->owf_busy_frames >= enc->num_encoder_states && enc->owf_active > 1) {
+      enc->owf_busy_frames = 0;
+      enc->owf_active--;
+    }
+  } else {
+    enc->owf_busy_frames = 0;
+  }
+}
+
+
 static int uvg266_encode(uvg_encoder *enc,
                           uvg_picture *pic_in,
                           uvg_data_chunk **data_out,
@@ -271,6 +485,9 @@ static int uvg266_encode(uvg_encoder *enc,
   );
   if (frame) {
     assert(state->frame->num == enc->frames_started);
+    if (enc->control->cfg.adaptive_owf) {
+      limit_running_frames(enc);
+    }
     // Start encoding.
     uvg_encode_one_frame(state, frame);
     enc->frames_started += 1;
@@ -306,6 +523,9 @@ static int uvg266_encode(uvg_encoder *enc,
     output_state->frame->done = 1;
     output_state->frame->prepared = 0;
     enc->frames_done += 1;
+    if (enc->control->cfg.adaptive_owf) {
+      update_owf_active(enc);
+    }
 
     enc->out_state_num = (enc->out_state_num + 1) % (enc->num_encoder_states);
   }
@@ -322,9 +542,25 @@ static int uvg266_field_encoding_adapter(uvg_encoder *enc,
                                           uvg_picture **src_out,
                                           uvg_frame_info *info_out)
 {
+  // Pictures of external planes, which have no buffer of their own, are
+  // copied if the encoder cannot read them directly. In lossless mode the
+  // source is also used as the reconstruction, so it must be writable.
+  uvg_picture *padded_in = NULL;
+  if (pic_in != NULL && pic_in->fulldata_buf == NULL &&
+      (!uvg_image_is_encodable(pic_in, enc->control->in.width, enc->control->in.height) ||
+       enc->control->cfg.lossless))
+  {
+    padded_in = uvg_image_copy_padded(enc->control->picture_pool, pic_in,
+                                      enc->control->in.width, enc->control->in.height);
+    if (padded_in == NULL) return 0;
+    pic_in = padded_in;
+  }
+
   if (enc->control->cfg.source_scan_type == UVG_INTERLACING_NONE) {
     // For progressive, simply call the normal encoding function.
-    return uvg266_encode(enc, pic_in, data_out, len_out, pic_out, src_out, info_out);
+    const int ret = uvg266_encode(enc, pic_in, data_out, len_out, pic_out, src_out, info_out);
+    uvg_image_free(padded_in);
+    return ret;
   }
 
   // For interlaced, make two fields out of the input frame and call encode on them separately.
@@ -336,11 +572,13 @@ static int uvg266_field_encoding_adapter(uvg_encoder *enc,
   } first = { 0, 0 }, second = { 0, 0 };
 
   if (pic_in != NULL) {
-    first_field = uvg_image_alloc(state->encoder_control->chroma_format, state->encoder_control->in.width, state->encoder_control->in.height);
+    first_field = uvg_image_pool_get(state->encoder_control->picture_pool, state->encoder_control->chroma_format,
+                                    state->encoder_control->in.width, state->encoder_control->in.height);
     if (first_field == NULL) {
       goto uvg266_field_encoding_adapter_failure;
     }
-    second_field = uvg_image_alloc(state->encoder_control->chroma_format, state->encoder_control->in.width, state->encoder_control->in.height);
+    second_field = uvg_image_pool_get(state->encoder_control->picture_pool, state->encoder_control->chroma_format,
+                                    state->encoder_control->in.width, state->encoder_control->in.height);
     if (second_field == NULL) {
       goto uvg266_field_encoding_adapter_failure;
     }
@@ -357,6 +595,8 @@ static int uvg266_field_encoding_adapter(uvg_encoder *enc,
     second_field->dts = pic_in->dts;
     second_field->interlacing = pic_in->interlacing;
   }
+  uvg_image_free(padded_in);
+  padded_in = NULL;
 
   if (!uvg266_encode(enc, first_field, &first.data_out, &first.len_out, pic_out, NULL, info_out)) {
     goto uvg266_field_encoding_adapter_failure;
@@ -390,6 +630,7 @@ static int uvg266_field_encoding_adapter(uvg_encoder *enc,
   return 1;
 
 uvg266_field_encoding_adapter_failure:
+  uvg_image_free(padded_in);
   uvg_image_free(first_field);
   uvg_image_free(second_field);
   uvg_bitstream_free_chunks(first.data_out);
@@ -398,6 +639,274 @@ uvg266_field_encoding_adapter_failure:
 }
 
 
+/**
+ * \brief Make the file descriptor readable. Must be called with the lock.
+ */
+static void async_set_fd(uvg_async_t *async)
+{
+#ifndef _WIN32
+  if (async->write_fd < 0 || async->fd_set) return;
+#ifdef __linux__
+  const uint64_t value = 1;
+  while (write(async->write_fd, &value, sizeof(value)) < 0 && errno == EINTR);
+#else
+  const char value = 1;
+  while (write(async->write_fd, &value, sizeof(value)) < 0 && errno == EINTR);
+#endif
+  async->fd_set = true;
+#endif
+}
+
+/**
+ * \brief Make the file descriptor unreadable. Must be called with the lock.
+ */
+static void async_clear_fd(uvg_async_t *async)
+{
+#ifndef _WIN32
+  if (async->read_fd < 0 || !async->fd_set) return;
+#ifdef __linux__
+  uint64_t value;
+#else
+  char value;
+#endif
+  while (read(async->read_fd, &value, sizeof(value)) < 0 && errno == EINTR);
+  async->fd_set = false;
+#endif
+}
+
+/**
+ * \brief Encode the submitted pictures until the end of input.
+ */
+static void * async_encode_thread(void *arg)
+{
+  uvg_encoder *const enc = arg;
+  uvg_async_t *const async = enc->async;
+
+  for (;;) {
+    pthread_mutex_lock(&async->lock);
+    while (!async->stop && !async->input_first && !async->input_end) {
+      pthread_cond_wait(&async->input_cond, &async->lock);
+    }
+    if (async->stop) {
+      pthread_mutex_unlock(&async->lock);
+      break;
+    }
+    uvg_picture *pic_in = NULL;
+    if (async->input_first) {
+      async_input_t *input = async->input_first;
+      async->input_first = input->next;
+      if (!async->input_first) async->input_last = NULL;
+      pic_in = input->pic;
+      free(input);
+    }
+    pthread_mutex_unlock(&async->lock);
+
+    async_output_t *output = calloc(1, sizeof(async_output_t));
+    bool ok = output != NULL &&
+              uvg266_field_encoding_adapter(enc, pic_in,
+                                            &output->data, &output->len,
+                                            &output->pic, &output->src,
+                                            &output->info);
+    const bool input_end = pic_in == NULL;
+    uvg_image_free(pic_in);
+
+    bool done = false;
+    pthread_mutex_lock(&async->lock);
+    if (!ok) {
+      async->failed = true;
+      done = true;
+    } else if (output->data) {
+      if (async->output_last) {
+        async->output_last->next = output;
+      } else {
+        async->output_first = output;
+      }
+      async->output_last = output;
+      output = NULL;
+    } else if (input_end) {
+      // There is no more input and output left.
+      async->finished = true;
+      done = true;
+    }
+    const bool notify = output == NULL || done;
+    if (notify) async_set_fd(async);
+    void (*const callback)(void *opaque) = async->callback;
+    void *const opaque = async->opaque;
+    pthread_mutex_unlock(&async->lock);
+
+    if (output) {
+      uvg_bitstream_free_chunks(output->data);
+      uvg_image_free(output->pic);
+      uvg_image_free(output->src);
+      free(output);
+    }
+    if (notify && callback) {
+      callback(opaque);
+    }
+    if (done) break;
+  }
+
+  return NULL;
+}
+
+static int uvg266_submit(uvg_encoder *enc, uvg_picture *pic_in)
+{
+  uvg_async_t *const async = enc->async;
+
+  async_input_t *input = NULL;
+  if (pic_in) {
+    input = calloc(1, sizeof(async_input_t));
+    if (!input) return 0;
+    input->pic = uvg_image_copy_ref(pic_in);
+  }
+
+  pthread_mutex_lock(&async->lock);
+  if (async->input_end || async->failed) {
+    pthread_mutex_unlock(&async->lock);
+    if (input) {
+      uvg_image_free(input->pic);
+      free(input);
+    }
+    return 0;
+  }
+
+  if (input) {
+    if (async->input_last) {
+      async->input_last->next = input;
+    } else {
+      async->input_first = input;
+    }
+    async->input_last = input;
+  } else {
+    async->input_end = true;
+  }
+
+  if (!async->thread_started) {
+    if (pthread_create(&async->thread, NULL, async_encode_thread, enc) != 0) {
+      fprintf(stderr, "pthread_create failed!\n");
+      async->failed = true;
+      pthread_mutex_unlock(&async->lock);
+      return 0;
+    }
+    async->thread_started = true;
+  }
+  pthread_cond_signal(&async->input_cond);
+  pthread_mutex_unlock(&async->lock);
+
+  return 1;
+}
+
+static int uvg266_poll(uvg_encoder *enc,
+                       uvg_data_chunk **data_out,
+                       uint32_t *len_out,
+                       uvg_picture **pic_out,
+                       uvg_picture **src_out,
+                       uvg_frame_info *info_out)
+{
+  if (data_out) *data_out = NULL;
+  if (len_out) *len_out = 0;
+  if (pic_out) *pic_out = NULL;
+  if (src_out) *src_out = NULL;
+
+  uvg_async_t *const async = enc->async;
+
+  pthread_mutex_lock(&async->lock);
+  async_output_t *output = async->output_first;
+  int status;
+  if (output) {
+    async->output_first = output->next;
+    if (!async->output_first) async->output_last = NULL;
+    status = UVG_ASYNC_FRAME;
+  } else if (async->failed) {
+    status = UVG_ASYNC_ERROR;
+  } else if (async->finished) {
+    status = UVG_ASYNC_END;
+  } else {
+    status = UVG_ASYNC_PENDING;
+  }
+  // Keep the descriptor readable while there is something to return.
+  if (status == UVG_ASYNC_PENDING ||
+      (status == UVG_ASYNC_FRAME && !async->output_first &&
+       !async->failed && !async->finished)) {
+    async_clear_fd(async);
+  }
+  pthread_mutex_unlock(&async->lock);
+
+  if (!output) return status;
+
+  if (data_out) {
+    *data_out = output->data;
+  } else {
+    uvg_bitstream_free_chunks(output->data);
+  }
+  if (len_out) *len_out = output->len;
+  if (pic_out) {
+    *pic_out = output->pic;
+  } else {
+    uvg_image_free(output->pic);
+  }
+  if (src_out) {
+    *src_out = output->src;
+  } else {
+    uvg_image_free(output->src);
+  }
+  if (info_out) *info_out = output->info;
+  free(output);
+
+  return status;
+}
+
+static void uvg266_set_callback(uvg_encoder *enc,
+                                void (*callback)(void *opaque), void *opaque)
+{
+  uvg_async_t *const async = enc->async;
+
+  pthread_mutex_lock(&async->lock);
+  async->callback = callback;
+  async->opaque = opaque;
+  pthread_mutex_unlock(&async->lock);
+}
+
+static int uvg266_get_fd(uvg_encoder *enc)
+{
+  return enc->async->read_fd;
+}
+
+
+/**
+ * \brief Get the queue to convert input frames on.
+ *
+ * Without worker threads, a submitted job would run on the calling thread
+ * while holding the lock of the queue, so the frame is converted directly.
+ */
+static threadqueue_queue_t *input_threadqueue(const uvg_encoder *enc)
+{
+  return enc->control->cfg.threads > 0 ? enc->control->threadqueue : NULL;
+}
+
+static int uvg266_load_planar(uvg_encoder *enc, uvg_picture *pic,
+                              const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                              int32_t luma_stride, int32_t chroma_stride,
+                              int32_t width, int32_t height)
+{
+  return uvg_image_load_planar(input_threadqueue(enc), pic,
+                               enc->control->cfg.input_bitdepth,
+                               y, u, v, luma_stride, chroma_stride,
+                               width, height);
+}
+
+static int uvg266_load_semiplanar(uvg_encoder *enc, uvg_picture *pic,
+                                  const uint8_t *luma, int32_t luma_stride,
+                                  const uint8_t *chroma, int32_t chroma_stride,
+                                  int32_t width, int32_t height)
+{
+  const uvg_config *const cfg = &enc->control->cfg;
+  return uvg_image_load_semiplanar(input_threadqueue(enc), pic,
+                                   cfg->input_format, cfg->input_bitdepth,
+                                   luma, luma_stride, chroma, chroma_stride,
+                                   width, height);
+}
+
 static const uvg_api uvg_8bit_api = {
   .config_alloc = uvg_config_alloc,
   .config_init = uvg_config_init,
@@ -415,6 +924,20 @@ static const uvg_api uvg_8bit_api = {
   .encoder_encode = uvg266_field_encoding_adapter,
 
   .picture_alloc_csp = uvg_image_alloc,
+
+  .picture_pool_alloc = uvg_image_pool_alloc,
+  .picture_pool_get = uvg_image_pool_get,
+  .picture_pool_free = uvg_image_pool_free,
+
+  .picture_wrap = uvg_image_wrap,
+
+  .picture_load_semiplanar = uvg266_load_semiplanar,
+  .picture_load_planar = uvg266_load_planar,
+
+  .encoder_submit = uvg266_submit,
+  .encoder_poll = uvg266_poll,
+  .encoder_set_callback = uvg266_set_callback,
+  .encoder_get_fd = uvg266_get_fd,
 };
 
 
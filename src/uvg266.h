@@ -103,6 +103,11 @@ typedef int16_t uvg_pixel_im;  // For intermediate precision (interpolation/bipr
  */
 typedef struct uvg_encoder uvg_encoder;
 
+/**
+ * \brief Opaque data structure of a pool of reusable pictures.
+ */
+typedef struct uvg_picture_pool uvg_picture_pool;
+
 /**
  * \brief Integer motion estimation algorithms.
  */
@@ -176,8 +181,8 @@ enum uvg_me_early_termination
 
 /**
  * \brief Format the pixels are read in.
- * This is separate from chroma subsampling, because we might want to read
- * interleaved formats in the future.
+ * This is separate from chroma subsampling, because the semi-planar formats
+ * interleave the chroma samples.
  * \since 3.12.0
  */
 enum uvg_input_format {
@@ -185,6 +190,9 @@ enum uvg_input_format {
   UVG_FORMAT_P420 = 1,
   UVG_FORMAT_P422 = 2,
   UVG_FORMAT_P444 = 3,
+  UVG_FORMAT_NV12 = 4, //!< 4:2:0, luma plane and an interleaved UV plane
+  UVG_FORMAT_NV21 = 5, //!< 4:2:0, luma plane and an interleaved VU plane
+  UVG_FORMAT_P010 = 6, //!< NV12 with 16-bit samples, MSB-aligned
 };
 
 /**
@@ -259,6 +267,13 @@ enum uvg_file_format
   UVG_FORMAT_YUV = 2
 };
 
+enum uvg_thread_affinity
+{
+  UVG_THREAD_AFFINITY_NONE = 0,
+  UVG_THREAD_AFFINITY_CORES = 1,  // Pin each worker to a single CPU.
+  UVG_THREAD_AFFINITY_NODES = 2,  // Pin each worker to the CPUs of a NUMA node.
+};
+
 enum uvg_amvr_resolution
 {
   UVG_IMV_OFF     = 0,
@@ -274,7 +289,11 @@ enum uvg_roi_format
 };
 
 // Map from input format to chroma format.
-#define UVG_FORMAT2CSP(format) ((enum uvg_chroma_format)format)
+#define UVG_FORMAT2CSP(format) \
+  ((format) >= UVG_FORMAT_NV12 ? UVG_CSP_420 : (enum uvg_chroma_format)(format))
+
+// True for the input formats with interleaved chroma.
+#define UVG_FORMAT_IS_SEMIPLANAR(format) ((format) >= UVG_FORMAT_NV12)
 
 /**
  * \brief GoP picture configuration.
@@ -556,6 +575,39 @@ typedef struct uvg_config
 
   uint8_t ref_wraparound; /* \brief MV reference wraparound */
 
+  /** \brief Skip MTT split directions ruled out by the gradients and
+   *         sub-block variances of the source block */
+  uint8_t mtt_split_pruning;
+
+  /** \brief Adapt the fast residual cost weights to the content by fitting
+   *         them against sampled CABAC costs during encoding */
+  uint8_t fastrd_online;
+
+  /** \brief Number of top CU depths whose split types are searched in
+   *         separate jobs, 0 to search them one after another */
+  uint8_t split_jobs;
+
+  /** \brief Search the reference pictures of large PUs in separate jobs */
+  int8_t ref_jobs;
+
+  /** \brief Adapt the number of frames encoded at the same time, up to
+   *         owf + 1, to the idle time of the worker threads */
+  int8_t adaptive_owf;
+
+  /** \brief File for a Chrome trace of the threadqueue jobs, NULL to not trace */
+  char *trace_file_name;
+
+  /** \brief Maximum number of times an idle worker thread checks for new
+   *         jobs before sleeping, 0 to sleep right away */
+  int32_t thread_spin;
+
+  /** \brief Pin the worker threads to CPUs or NUMA nodes and encode each
+   *         frame mostly on one node */
+  enum uvg_thread_affinity thread_affinity;
+
+  /** \brief Back frame sized buffers with huge pages while this encoder is open */
+  int8_t hugepages;
+
 } uvg_config;
 
 /**
@@ -595,6 +647,13 @@ typedef struct uvg_picture {
     int8_t *roi_array;
   } roi;
 
+  struct uvg_picture_pool *pool; //!< \brief Pool the picture is returned to when freed, or NULL
+
+  int32_t chroma_stride;   //!< \brief Chroma pixel array stride. Equal to stride / 2 except for pictures made with picture_wrap.
+
+  void (*release)(void *opaque); //!< \brief Called with release_opaque when a picture made with picture_wrap is freed, or NULL
+  void *release_opaque;
+
 } uvg_picture;
 
 /**
@@ -704,6 +763,16 @@ typedef struct uvg_data_chunk {
   struct uvg_data_chunk *next;
 } uvg_data_chunk;
 
+/**
+ * \brief Return values of encoder_poll.
+ */
+enum uvg_async_status {
+  UVG_ASYNC_ERROR = -1,  //!< \brief Encoding has failed.
+  UVG_ASYNC_PENDING = 0, //!< \brief No frame is ready yet.
+  UVG_ASYNC_FRAME = 1,   //!< \brief A frame was returned.
+  UVG_ASYNC_END = 2,     //!< \brief All frames have been returned.
+};
+
 typedef struct uvg_api {
 
   /**
@@ -866,6 +935,203 @@ typedef struct uvg_api {
    * \return        allocated picture, or NULL if allocation failed.
    */
   uvg_picture * (*picture_alloc_csp)(enum uvg_chroma_format chroma_fomat, int32_t width, int32_t height);
+
+  /**
+   * \brief Allocate a pool of reusable pictures.
+   *
+   * Pictures taken from the pool with picture_pool_get are returned to it
+   * by picture_free instead of being deallocated, so that feeding frames
+   * to the encoder does not allocate a new picture for every frame.
+   *
+   * The returned pool should be deallocated by calling picture_pool_free.
+   *
+   * \return        allocated pool, or NULL if allocation failed.
+   */
+  uvg_picture_pool * (*picture_pool_alloc)(void);
+
+  /**
+   * \brief Get a picture from a pool.
+   *
+   * Reuses a returned picture of the same chroma format and size, or
+   * allocates a new one. The pixels of a reused picture are not cleared.
+   * The returned uvg_picture should be deallocated by calling picture_free.
+   *
+   * \param pool          pool to get the picture from
+   * \param chroma_format Chroma subsampling to use.
+   * \param width         width of luma pixel array
+   * \param height        height of luma pixel array
+   * \return              picture, or NULL if allocation failed.
+   */
+  uvg_picture * (*picture_pool_get)(uvg_picture_pool *pool,
+                                    enum uvg_chroma_format chroma_format,
+                                    int32_t width, int32_t height);
+
+  /**
+   * \brief Deallocate a picture pool.
+   *
+   * If pool is NULL, do nothing. Pictures of the pool that are still in
+   * use stay valid and are deallocated by picture_free.
+   */
+  void          (*picture_pool_free)(uvg_picture_pool *pool);
+
+  /**
+   * \brief Make a uvg_picture of pixel planes owned by the caller.
+   *
+   * The planes are not copied. The encoder only reads them, and it does
+   * so until the last reference to the picture is freed, at which point
+   * release is called with opaque. The pixels must not be changed before
+   * that.
+   *
+   * The planes are encoded directly if the size is the padded size of
+   * the encoder (width and height multiples of 8) and chroma_stride is
+   * half of luma_stride. Otherwise the encoder copies the picture and pads
+   * it when it is passed to encoder_encode, and releases it right away.
+   *
+   * The returned uvg_picture should be deallocated by calling picture_free.
+   *
+   * \param chroma_format Chroma subsampling of the planes, UVG_CSP_400 or
+   *                      UVG_CSP_420.
+   * \param width         width of the luma plane
+   * \param height        height of the luma plane
+   * \param y             luma plane
+   * \param u             U plane, or NULL for UVG_CSP_400
+   * \param v             V plane, or NULL for UVG_CSP_400
+   * \param luma_stride   distance between luma rows in pixels
+   * \param chroma_stride distance between chroma rows in pixels
+   * \param release       function called when the picture is freed, or NULL
+   * \param opaque        argument of release
+   * \return              picture, or NULL if allocation failed or the
+   *                      arguments are not valid.
+   */
+  uvg_picture * (*picture_wrap)(enum uvg_chroma_format chroma_format,
+                                int32_t width, int32_t height,
+                                uvg_pixel *y, uvg_pixel *u, uvg_pixel *v,
+                                int32_t luma_stride, int32_t chroma_stride,
+                                void (*release)(void *opaque), void *opaque);
+
+  /**
+   * \brief Copy a frame of semi-planar input to a picture.
+   *
+   * Converts a frame in the input_format of the encoder, which must be
+   * UVG_FORMAT_NV12, UVG_FORMAT_NV21 or UVG_FORMAT_P010, to the planar
+   * layout of the encoder. P010 samples are little endian 16-bit words with
+   * the input_bitdepth significant bits in the most significant end.
+   *
+   * Pixels of the picture past the width and height of the frame are
+   * filled with the last column and row of the frame.
+   *
+   * \param encoder       encoder whose input_format and input_bitdepth to use
+   * \param pic           UVG_CSP_420 picture at least the size of the frame
+   * \param luma          luma plane
+   * \param luma_stride   distance between luma rows in bytes
+   * \param chroma        interleaved chroma plane
+   * \param chroma_stride distance between chroma rows in bytes
+   * \param width         width of the frame
+   * \param height        height of the frame
+   * \return              1 on success, 0 if the arguments are not valid.
+   */
+  int (*picture_load_semiplanar)(uvg_encoder *encoder, uvg_picture *pic,
+                                 const uint8_t *luma, int32_t luma_stride,
+                                 const uint8_t *chroma, int32_t chroma_stride,
+                                 int32_t width, int32_t height);
+
+  /**
+   * \brief Copy a frame of planar input to a picture.
+   *
+   * Converts a frame of the input_bitdepth of the encoder to the bit depth
+   * of the encoder. Samples of input_bitdepth 8 are bytes, and samples of
+   * higher bit depths are little endian 16-bit words.
+   *
+   * Pixels of the picture past the width and height of the frame are
+   * filled with the last column and row of the frame. Large frames are
+   * converted by the worker threads of the encoder.
+   *
+   * \param encoder       encoder whose input_bitdepth to use
+   * \param pic           UVG_CSP_400 or UVG_CSP_420 picture at least the size
+   *                      of the frame
+   * \param y             luma plane
+   * \param u             U plane, or NULL for UVG_CSP_400
+   * \param v             V plane, or NULL for UVG_CSP_400
+   * \param luma_stride   distance between luma rows in bytes
+   * \param chroma_stride distance between chroma rows in bytes
+   * \param width         width of the frame
+   * \param height        height of the frame
+   * \return              1 on success, 0 if the arguments are not valid.
+   */
+  int (*picture_load_planar)(uvg_encoder *encoder, uvg_picture *pic,
+                             const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                             int32_t luma_stride, int32_t chroma_stride,
+                             int32_t width, int32_t height);
+
+  /**
+   * \brief Queue a picture for encoding without waiting.
+   *
+   * The first call starts a thread that feeds the queued pictures to
+   * encoder_encode, which keeps up to owf frames in flight. Encoded frames
+   * are taken with encoder_poll. encoder_encode must not be called on an
+   * encoder that this function has been called on.
+   *
+   * The encoder takes a reference to pic_in, so the caller may free it right
+   * away, but must not modify it. Pictures are queued without a limit, so
+   * the caller should stop submitting when too many frames are waiting.
+   *
+   * \param encoder   encoder
+   * \param pic_in    input frame, or NULL after the last frame
+   * \return          1 on success, 0 on error.
+   */
+  int (*encoder_submit)(uvg_encoder *encoder, uvg_picture *pic_in);
+
+  /**
+   * \brief Take an encoded frame without waiting.
+   *
+   * Returns the same outputs as encoder_encode in coding order. The caller
+   * is responsible for calling chunk_free and picture_free on them.
+   *
+   * \param encoder   encoder
+   * \param data_out  Returns the encoded data.
+   * \param len_out   Returns number of bytes in the encoded data.
+   * \param pic_out   Returns the reconstructed picture.
+   * \param src_out   Returns the original picture.
+   * \param info_out  Returns information about the encoded picture.
+   * \return          UVG_ASYNC_FRAME if a frame was returned,
+   *                  UVG_ASYNC_PENDING if no frame is ready yet,
+   *                  UVG_ASYNC_END if all frames have been returned after
+   *                  the end of input, or UVG_ASYNC_ERROR on error.
+   */
+  int (*encoder_poll)(uvg_encoder *encoder,
+                      uvg_data_chunk **data_out,
+                      uint32_t *len_out,
+                      uvg_picture **pic_out,
+                      uvg_picture **src_out,
+                      uvg_frame_info *info_out);
+
+  /**
+   * \brief Set a function to call when encoder_poll has something to return.
+   *
+   * The callback is called from the encoding thread, so it should only wake
+   * up the thread of the caller or call encoder_poll. Must be set before the
+   * first call to encoder_submit.
+   *
+   * \param encoder   encoder
+   * \param callback  function to call, or NULL
+   * \param opaque    argument of the callback
+   */
+  void (*encoder_set_callback)(uvg_encoder *encoder,
+                               void (*callback)(void *opaque), void *opaque);
+
+  /**
+   * \brief Get a file descriptor for waiting for encoder_poll.
+   *
+   * The descriptor is readable when encoder_poll has something to return,
+   * so it can be waited for with poll, select or epoll. It is an eventfd on
+   * Linux and a pipe on other POSIX systems. The encoder clears it, so the
+   * caller must not read from it.
+   *
+   * \param encoder   encoder
+   * \return          file descriptor owned by the encoder, or -1 if not
+   *                  supported on this platform.
+   */
+  int (*encoder_get_fd)(uvg_encoder *encoder);
 } uvg_api;
 
 
@@ -42,11 +42,14 @@
 
 #include "uvg266.h"
 #include "input_frame_buffer.h"
+#include "threadqueue.h"
+#include "threads.h"
 
 
 // Forward declarations.
 struct encoder_state_t;
 struct encoder_control_t;
+struct uvg_async_t;
 
 struct uvg_encoder {
   const struct encoder_control_t* control;
@@ -73,6 +76,27 @@ struct uvg_encoder {
 
   unsigned frames_started;
   unsigned frames_done;
+
+  /**
+   * \brief Number of frames that are encoded at the same time.
+   *
+   * At most num_encoder_states. Changed at runtime with --adaptive-owf.
+   */
+  unsigned owf_active;
+
+  //! Number of frames in a row without idle worker time.
+  unsigned owf_busy_frames;
+  //! Worker statistics and time when the previous frame was output.
+  threadqueue_stats_t owf_stats;
+  UVG_CLOCK_T owf_time;
+
+  /**
+   * \brief State of encoder_submit and encoder_poll.
+   *
+   * Created when the encoder is opened, so it is never NULL on an open
+   * encoder.
+   */
+  struct uvg_async_t *async;
 };
 
 #endif // UVG266_INTERNAL_H_
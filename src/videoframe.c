@@ -34,6 +34,7 @@
 
 #include <stdlib.h>
 
+#include "hugepages.h"
 #include "image.h"
 #include "sao.h"
 #include "alf.h"
@@ -61,7 +62,7 @@ videoframe_t * uvg_videoframe_alloc(int32_t width,
     frame->sao_chroma = MALLOC(sao_info_t, frame->width_in_lcu * frame->height_in_lcu);
     if (cclm) {
       assert(chroma_format == UVG_CSP_420);
-      frame->cclm_luma_rec = MALLOC(uvg_pixel, (((width + 7) & ~7) + FRAME_PADDING_LUMA) * (((height + 15) & ~7) + FRAME_PADDING_LUMA) / 4);
+      frame->cclm_luma_rec = uvg_hugepage_alloc(sizeof(uvg_pixel) * (((width + 7) & ~7) + FRAME_PADDING_LUMA) * (((height + 15) & ~7) + FRAME_PADDING_LUMA) / 4);
       frame->cclm_luma_rec_top_line = MALLOC(uvg_pixel, (((width + 7) & ~7) + FRAME_PADDING_LUMA) / 2 * CEILDIV(height, 64));
     }
   }
@@ -82,7 +83,8 @@ int uvg_videoframe_free(videoframe_t * const frame)
     frame->source_lmcs_mapped = false;
   }
   if(frame->cclm_luma_rec) {
-    FREE_POINTER(frame->cclm_luma_rec);
+    uvg_hugepage_free(frame->cclm_luma_rec);
+    frame->cclm_luma_rec = NULL;
   }
   if(frame->cclm_luma_rec_top_line) {
     FREE_POINTER(frame->cclm_luma_rec_top_line);
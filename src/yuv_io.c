@@ -34,9 +34,16 @@
  * \file
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "yuv_io.h"
 
 static void fill_after_frame(unsigned height, unsigned array_width,
@@ -47,7 +54,7 @@ static void fill_after_frame(unsigned height, unsigned array_width,
 
   while (p < end) {
     // Fill the line by copying the line above.
-    memcpy(p, p - array_width, array_width);
+    memcpy(p, p - array_width, array_width * sizeof(uvg_pixel));
     p += array_width;
   }
 }
@@ -56,99 +63,27 @@ static void fill_after_frame(unsigned height, unsigned array_width,
 static int read_and_fill_frame_data(FILE*      file,
                                     unsigned   width,
                                     unsigned   height,
-                                    unsigned   bytes_per_sample,
                                     unsigned   array_width,
                                     uvg_pixel* data)
 {
-
+  uvg_pixel* p   = data;
+  uvg_pixel* end = data + array_width * height;
+  uvg_pixel  fill_char;
   unsigned   i;
-  // Handle separately the case where we use UVG_BIT_DEPTH 10+ but the input is 8-bit.
-  if (bytes_per_sample != sizeof(uvg_pixel)) {
-    uint8_t* p   = (uint8_t*)data;
-    uint8_t*  end = (uint8_t*)data + array_width * height;
-    uint8_t  fill_char;
-    while (p < end) {
-      // Read the beginning of the line from input.
-      if (width != fread(p, bytes_per_sample, width, file)) return 0;
-      // Fill the rest with the last pixel value.
-      fill_char = p[width - 1];
-
-      for (i = width; i < array_width; ++i) {
-        p[i] = fill_char;
-      }
 
-      p += array_width;
-    }
-  } else {
-    uvg_pixel* p   = data;
-    uvg_pixel* end = data + array_width * height;
-    uvg_pixel  fill_char;
-    while (p < end) {
-      // Read the beginning of the line from input.
-      if (width != fread(p, bytes_per_sample, width, file)) return 0;
-      // Fill the rest with the last pixel value.
-      fill_char = p[width - 1];
-
-      for (i = width; i < array_width; ++i) {
-        p[i] = fill_char;
-      }
+  while (p < end) {
+    // Read the beginning of the line from input.
+    if (width != fread(p, sizeof(uvg_pixel), width, file)) return 0;
+    // Fill the rest with the last pixel value.
+    fill_char = p[width - 1];
 
-      p += array_width;
+    for (i = width; i < array_width; ++i) {
+      p[i] = fill_char;
     }
-  }
-  return 1;
-}
 
-
-static void swap_16b_buffer_bytes(uvg_pixel* input, int size)
-{
-  for (int i = 0; i < size; ++i) {
-    input[i] = ((input[i] & 0xff) << 8) + ((input[i] & 0xff00) >> 8);
-  }
-}
-
-
-static void shift_to_bitdepth(uvg_pixel* input, int size, int from_bitdepth, int to_bitdepth)
-{
-  int shift = to_bitdepth - from_bitdepth;
-  uvg_pixel bitdepth_mask = (1 << from_bitdepth) - 1;
-
-  for (int i = 0; i < size; ++i) {
-    // Shifting by a negative number is undefined.
-    if (shift > 0) {
-      input[i] = (input[i] & bitdepth_mask) << shift;
-    } else {
-      input[i] = (input[i] & bitdepth_mask) >> shift;
-    }
-  }
-}
-
-
-// Shift and copy 1-byte aligned samples to 2-byte aligned array
-static void shift_to_bitdepth_and_spread(uvg_pixel *input,
-                                         int size,
-                                         int from_bitdepth,
-                                         int to_bitdepth)
-{
-  assert(sizeof(uvg_pixel) > 1);
-  int shift = to_bitdepth - from_bitdepth;
-  unsigned char *byte_buf = (unsigned char *)input;
-  uvg_pixel bitdepth_mask = (1 << from_bitdepth) - 1;
-  
-  // Starting from the back of the 1-byte samples, copy each sample to it's
-  // place in the 2-byte per sample array, overwriting the bytes that have
-  // already been copied in the process.
-  // Even though the two pointers are aliased, this should work because the
-  // future values read through byte_buf poiner never change as a result of
-  // writing through input pointer.
-  for (int i = size - 1; i >= 0; --i) {
-    // Shifting by a negative number is undefined.
-    if (shift > 0) {
-      input[i] = (byte_buf[i] & bitdepth_mask) << shift;
-    } else {
-      input[i] = (byte_buf[i] & bitdepth_mask) >> shift;
-    }
+    p += array_width;
   }
+  return 1;
 }
 
 
@@ -165,32 +100,19 @@ static bool machine_is_big_endian()
 }
 
 
-static void mask_to_bitdepth(uvg_pixel *buf, unsigned length, unsigned bitdepth)
-{
-  uvg_pixel bitdepth_mask = (1 << bitdepth) - 1;
-  for (uint32_t i = 0; i < length; ++i) {
-    buf[i] = buf[i] & bitdepth_mask;
-  }
-}
-
-
 static int yuv_io_read_plane(
     FILE* file,
-    unsigned in_width, unsigned in_height, unsigned in_bitdepth,
-    unsigned out_width, unsigned out_height, unsigned out_bitdepth,
+    unsigned in_width, unsigned in_height,
+    unsigned out_width, unsigned out_height,
     uvg_pixel *out_buf)
 {
-  unsigned bytes_per_sample = in_bitdepth > 8 ? 2 : 1;
-  unsigned buf_bytes = in_width * in_height * bytes_per_sample;
-  unsigned out_length = out_width * out_height;
-
   if (in_width == out_width) {
     // No need to extend pixels.
-    const size_t pixel_size = sizeof(unsigned char);
-    if (fread(out_buf, pixel_size, buf_bytes, file) != buf_bytes)  return 0;
+    const size_t buf_bytes = in_width * in_height * sizeof(uvg_pixel);
+    if (fread(out_buf, sizeof(unsigned char), buf_bytes, file) != buf_bytes)  return 0;
   } else {
     // Need to copy pixels to fill the image in horizontal direction.
-    if (!read_and_fill_frame_data(file, in_width, in_height, bytes_per_sample, out_width, out_buf)) return 0;
+    if (!read_and_fill_frame_data(file, in_width, in_height, out_width, out_buf)) return 0;
   }
 
   if (in_height != out_height) {
@@ -198,24 +120,6 @@ static int yuv_io_read_plane(
     fill_after_frame(in_height, out_width, out_height, out_buf);
   }
 
-  if (in_bitdepth > 8) {
-    // Assume little endian input.
-    if (machine_is_big_endian()) {
-      swap_16b_buffer_bytes(out_buf, out_length);
-    }
-  }
-
-  // Shift the data to the correct bitdepth.
-  // Ignore any bits larger than in_bitdepth to guarantee ouput data will be
-  // in the correct range.
-  if (in_bitdepth <= 8 && out_bitdepth > 8) {
-    shift_to_bitdepth_and_spread(out_buf, out_length, in_bitdepth, out_bitdepth);
-  } else if (in_bitdepth != out_bitdepth) {
-    shift_to_bitdepth(out_buf, out_length, in_bitdepth, out_bitdepth);
-  } else if (in_bitdepth % 8 != 0) {
-    mask_to_bitdepth(out_buf, out_length, out_bitdepth);
-  }
-
   return 1;
 }
 
@@ -239,11 +143,28 @@ static int read_frame_header(FILE* input) {
   return 1;
 }
 
+/**
+ * \brief Check if input samples must be converted for the encoder.
+ *
+ * Frames that need conversion are read with yuv_io_read_raw and converted
+ * by the encoder. Others are read straight to the picture with yuv_io_read.
+ */
+bool yuv_io_needs_conversion(unsigned in_bitdepth, unsigned out_bitdepth,
+                             unsigned input_format)
+{
+  return UVG_FORMAT_IS_SEMIPLANAR(input_format) ||
+         in_bitdepth != out_bitdepth ||
+         in_bitdepth % 8 != 0 ||
+         (in_bitdepth > 8 && machine_is_big_endian());
+}
+
+
 /**
  * \brief Read a single frame from a file.
  *
  * Read luma and chroma values from file. Extend pixels if the image buffer
- * is larger than the input image.
+ * is larger than the input image. The samples must not need conversion,
+ * see yuv_io_needs_conversion.
  *
  * \param file          input file
  * \param input_width   width of the input video in pixels
@@ -269,10 +190,12 @@ int yuv_io_read(FILE* file,
 
   
 
+  assert(!yuv_io_needs_conversion(in_bitdepth, out_bitdepth, UVG_FORMAT_P420));
+
   ok = yuv_io_read_plane(
       file, 
-      in_width, out_width, in_bitdepth,
-      img_out->stride, img_out->height, out_bitdepth,
+      in_width, out_width,
+      img_out->stride, img_out->height,
       img_out->y);
   if (!ok) return 0;
 
@@ -284,15 +207,15 @@ int yuv_io_read(FILE* file,
 
     ok = yuv_io_read_plane(
         file,
-        uv_width_in, uv_height_in, in_bitdepth,
-        uv_width_out, uv_height_out, out_bitdepth,
+        uv_width_in, uv_height_in,
+        uv_width_out, uv_height_out,
         img_out->u);
     if (!ok) return 0;
 
     ok = yuv_io_read_plane(
         file, 
-        uv_width_in, uv_height_in, in_bitdepth,
-        uv_width_out, uv_height_out, out_bitdepth,
+        uv_width_in, uv_height_in,
+        uv_width_out, uv_height_out,
         img_out->v);
     if (!ok) return 0;
   }
@@ -301,60 +224,305 @@ int yuv_io_read(FILE* file,
 }
 
 
+/**
+ * \brief Read a single frame from a file without converting it.
+ *
+ * Reads the planes of the frame to buf as they are in the file, for the
+ * encoder to convert.
+ *
+ * \param file          input file
+ * \param input_width   width of the input video in pixels
+ * \param input_height  height of the input video in pixels
+ * \param in_bitdepth   bit depth of planar input
+ * \param input_format  format of the input
+ * \param buf           buffer of yuv_io_frame_bytes bytes
+ *
+ * \return              1 on success, 0 on failure
+ */
+int yuv_io_read_raw(FILE* file,
+                    unsigned input_width, unsigned input_height,
+                    unsigned in_bitdepth, unsigned input_format,
+                    uint8_t *buf, unsigned file_format)
+{
+  if (file_format == UVG_FORMAT_Y4M) {
+    if (!read_frame_header(file)) return 0;
+  }
+
+  const size_t frame_bytes = yuv_io_frame_bytes(input_width, input_height, in_bitdepth, input_format);
+  return fread(buf, 1, frame_bytes, file) == frame_bytes;
+}
+
+
+/**
+ * \brief Get the number of bytes in a frame of input.
+ *
+ * \param input_width   width of the input video in pixels
+ * \param input_height  height of the input video in pixels
+ * \param in_bitdepth   bit depth of planar input
+ * \param input_format  format of the input
+ */
+size_t yuv_io_frame_bytes(unsigned input_width, unsigned input_height,
+                          unsigned in_bitdepth, unsigned input_format)
+{
+  unsigned bytes_per_sample = in_bitdepth > 8 ? 2 : 1;
+  if (UVG_FORMAT_IS_SEMIPLANAR(input_format)) {
+    bytes_per_sample = input_format == UVG_FORMAT_P010 ? 2 : 1;
+  }
+  const unsigned chroma_samples = input_format == UVG_FORMAT_P400 ? 0 : input_width * input_height / 2;
+  return (size_t)bytes_per_sample * (input_width * input_height + chroma_samples);
+}
+
+
+/**
+ * \brief Skip bytes forward in a file.
+ *
+ * Pipes cannot seek, so their data is skipped by reading.
+ *
+ * \return 1 on success, 0 if the end of the file was reached
+ */
+static int skip_bytes(FILE *file, uint64_t bytes)
+{
+  //fseek only supports offsets of sizeof(long) bits. Seek in steps if bytes is larger.
+  const uint64_t max_long = (1ULL << (8 * sizeof(long) - 1)) - 1; //long is signed so only sizeof(long)-1 bits can be used to seek forward
+
+  while (bytes > 0) {
+    const long step = (long)MIN(bytes, max_long);
+    if (fseek(file, step, SEEK_CUR)) break;
+    bytes -= step;
+  }
+
+  unsigned char tmp[4096];
+  while (bytes > 0) {
+    const size_t skip = (size_t)MIN(sizeof(tmp), bytes);
+    if (fread(tmp, 1, skip, file) != skip) return 0;
+    bytes -= skip;
+  }
+  return 1;
+}
+
+
 /**
  * \brief Seek forward in a YUV file.
  *
+ * Memory mapped input is seeked with yuv_io_map_seek.
+ *
  * \param file          the input file
  * \param frames        number of frames to seek
  * \param input_width   width of the input video in pixels
  * \param input_height  height of the input video in pixels
+ * \param in_bitdepth   bit depth of planar input
+ * \param input_format  format of the input
  *
  * \return              1 on success, 0 on failure
  */
 int yuv_io_seek(FILE* file, unsigned frames,
                 unsigned input_width, unsigned input_height,
-                unsigned in_bitdepth, unsigned file_format)
+                unsigned in_bitdepth, unsigned input_format,
+                unsigned file_format)
 {
-  const unsigned bytes_per_sample = in_bitdepth > 8 ? 2 : 1;
-  const size_t frame_bytes = (size_t)(bytes_per_sample * input_width * input_height * 3 / 2);
+  const size_t frame_bytes = yuv_io_frame_bytes(input_width, input_height, in_bitdepth, input_format);
 
   if (file_format == UVG_FORMAT_Y4M) {
     for (unsigned i = 0; i < frames; i++) {
       if (!read_frame_header(file)) return 0;
-      if (fseek(file, (long)frame_bytes, SEEK_CUR)) return 0; //Doesn't seek correctly if frame_bytes larger than max_long
+      if (!skip_bytes(file, frame_bytes)) return 0;
     }
     return 1;
   }
 
-  const size_t skip_bytes = (size_t)(frames * frame_bytes);
+  // Seeking past the end is not an error. The first read fails instead.
+  return skip_bytes(file, (uint64_t)frames * frame_bytes) || feof(file);
+}
 
-  //fseek only supports offsets of sizeof(long) bits. Use other methods if frame_bytes would be too big.
-  const size_t max_long = (1ULL << (8 * sizeof(long) - 1)) - 1; //long is signed so only sizeof(long)-1 bits can be used to seek forward
 
-  if (skip_bytes <= max_long) {
-    // Attempt to seek normally.
-    if (!fseek(file, (long)skip_bytes, SEEK_CUR)) return 1;
-  } else if (frame_bytes <= max_long) {
-    int seek_error = 0;
-    for (unsigned i = 0; i < frames; i++) {
-      seek_error = fseek(file, (long)frame_bytes, SEEK_CUR);
-      if (seek_error) break;
+struct yuv_io_map {
+  const uint8_t *data;
+  size_t size;
+  size_t start;         //!< offset of the first frame
+  size_t pos;           //!< offset of the next frame
+  size_t dropped;       //!< pages before this offset have been dropped
+  size_t frame_bytes;
+  size_t page_size;
+  unsigned file_format;
+  bool eof;
+};
+
+
+#ifndef _WIN32
+static void map_advise(const yuv_io_map_t *map, size_t begin, size_t end, int advice)
+{
+  begin -= begin % map->page_size;
+  end = MIN(end, map->size);
+  if (begin < end) {
+    madvise((void*)(map->data + begin), end - begin, advice);
+  }
+}
+#endif
+
+
+/**
+ * \brief Get the length of the y4m frame header at offset.
+ *
+ * \return length including the newline, or 0 if there is no header
+ */
+static size_t map_frame_header(const yuv_io_map_t *map, size_t offset)
+{
+  const uint8_t *newline = memchr(map->data + offset, 0x0A, map->size - offset);
+  return newline ? newline - (map->data + offset) + 1 : 0;
+}
+
+
+/**
+ * \brief Map the rest of a regular file to memory.
+ *
+ * Frames start from the current position of the file, so any y4m stream
+ * header must have been read. The file must stay open while it is mapped.
+ *
+ * \param file          the input file
+ * \param frame_bytes   number of bytes in a frame, see yuv_io_frame_bytes
+ * \param file_format   format of the file
+ *
+ * \return the mapping, or NULL if the file cannot be mapped
+ */
+yuv_io_map_t *yuv_io_map_open(FILE *file, size_t frame_bytes, unsigned file_format)
+{
+#ifdef _WIN32
+  return NULL;
+#else
+  struct stat st;
+  if (fstat(fileno(file), &st) || !S_ISREG(st.st_mode)) return NULL;
+
+  const off_t start = ftello(file);
+  if (start < 0 || st.st_size <= start || (uint64_t)st.st_size > SIZE_MAX) return NULL;
+
+  const size_t size = (size_t)st.st_size;
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+  if (data == MAP_FAILED) return NULL;
+
+  yuv_io_map_t *map = calloc(1, sizeof(yuv_io_map_t));
+  if (!map) {
+    munmap(data, size);
+    return NULL;
+  }
+  map->data = data;
+  map->size = size;
+  map->start = (size_t)start;
+  map->pos = map->start;
+  map->frame_bytes = frame_bytes;
+  map->page_size = (size_t)sysconf(_SC_PAGESIZE);
+  map->file_format = file_format;
+
+  madvise(data, size, MADV_SEQUENTIAL);
+  map_advise(map, map->pos, map->pos + frame_bytes, MADV_WILLNEED);
+  return map;
+#endif
+}
+
+
+/**
+ * \brief Get the next frame from a mapped file.
+ *
+ * The returned data is valid until the next call. Pages of the frames
+ * before it are dropped and the kernel is asked to read the next one.
+ *
+ * \return pointer to the frame, or NULL at the end of the file
+ */
+const uint8_t *yuv_io_map_frame(yuv_io_map_t *map)
+{
+  size_t offset = map->pos;
+  if (map->file_format == UVG_FORMAT_Y4M) {
+    const size_t header_bytes = offset < map->size ? map_frame_header(map, offset) : 0;
+    if (!header_bytes) {
+      map->eof = true;
+      return NULL;
     }
-    if (!seek_error) return 1;
+    offset += header_bytes;
+  }
+  if (map->size - offset < map->frame_bytes) {
+    map->eof = true;
+    return NULL;
+  }
+
+#ifndef _WIN32
+  const size_t keep = offset - offset % map->page_size;
+  if (map->dropped < keep) {
+    map_advise(map, map->dropped, keep, MADV_DONTNEED);
+    map->dropped = keep;
+  }
+  map_advise(map, offset + map->frame_bytes, offset + 2 * map->frame_bytes, MADV_WILLNEED);
+#endif
+
+  map->pos = offset + map->frame_bytes;
+  return map->data + offset;
+}
+
+
+/**
+ * \brief Seek forward in a mapped file.
+ *
+ * Raw frames have a fixed size. Y4M frame headers usually have the same
+ * length too, so the offset is computed from the first header and only
+ * checked at the last skipped frame. Headers are walked if the check fails.
+ *
+ * \return 1 on success, 0 on failure
+ */
+int yuv_io_map_seek(yuv_io_map_t *map, unsigned frames)
+{
+  if (map->file_format != UVG_FORMAT_Y4M) {
+    // Seeking past the end is not an error. The first read fails instead.
+    const uint64_t offset = map->pos + (uint64_t)frames * map->frame_bytes;
+    map->pos = (size_t)MIN(offset, map->size);
+    return 1;
+  }
+
+  if (frames == 0) return 1;
+
+  const size_t header_bytes = map->pos < map->size ? map_frame_header(map, map->pos) : 0;
+  if (!header_bytes) return 0;
+
+  const uint64_t stride = header_bytes + map->frame_bytes;
+  const uint64_t last = map->pos + (frames - 1) * stride;
+  if (last + stride <= map->size &&
+      !memcmp(map->data + last, "FRAME", MIN(5, header_bytes)) &&
+      map_frame_header(map, (size_t)last) == header_bytes) {
+    map->pos = (size_t)(last + stride);
+    return 1;
   }
 
-  // Seek failed. Skip data by reading.
-  rewind(file);
-  size_t error = 0;
-  unsigned char* tmp[4096];
-  size_t bytes_left = skip_bytes;
-  while (bytes_left > 0 && !error) {
-    const size_t skip = MIN(4096, bytes_left);
-    error = fread(tmp, sizeof(unsigned char), skip, file) != skip;
-    bytes_left -= skip;
+  for (unsigned i = 0; i < frames; i++) {
+    if (!yuv_io_map_frame(map)) return 0;
   }
+  return 1;
+}
 
-  return !error || feof(file);
+
+/**
+ * \brief Check if the end of a mapped file has been reached.
+ */
+bool yuv_io_map_eof(const yuv_io_map_t *map)
+{
+  return map->eof;
+}
+
+
+/**
+ * \brief Start again from the first frame of a mapped file.
+ */
+void yuv_io_map_rewind(yuv_io_map_t *map)
+{
+  map->pos = map->start;
+  map->dropped = 0;
+  map->eof = false;
+}
+
+
+void yuv_io_map_close(yuv_io_map_t *map)
+{
+  if (!map) return;
+#ifndef _WIN32
+  munmap((void*)map->data, map->size);
+#endif
+  free(map);
 }
 
 
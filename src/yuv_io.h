@@ -48,9 +48,35 @@ int yuv_io_read(FILE* file,
                 unsigned from_bitdepth, unsigned to_bitdepth,
                 uvg_picture *img_out, unsigned file_format);
 
+bool yuv_io_needs_conversion(unsigned in_bitdepth, unsigned out_bitdepth,
+                             unsigned input_format);
+
+int yuv_io_read_raw(FILE* file,
+                    unsigned input_width, unsigned input_height,
+                    unsigned in_bitdepth, unsigned input_format,
+                    uint8_t *buf, unsigned file_format);
+
+size_t yuv_io_frame_bytes(unsigned input_width, unsigned input_height,
+                          unsigned in_bitdepth, unsigned input_format);
+
 int yuv_io_seek(FILE* file, unsigned frames,
                 unsigned input_width, unsigned input_height,
-                unsigned in_bitdepth, unsigned file_format);
+                unsigned in_bitdepth, unsigned input_format,
+                unsigned file_format);
+
+typedef struct yuv_io_map yuv_io_map_t;
+
+yuv_io_map_t *yuv_io_map_open(FILE *file, size_t frame_bytes, unsigned file_format);
+
+const uint8_t *yuv_io_map_frame(yuv_io_map_t *map);
+
+int yuv_io_map_seek(yuv_io_map_t *map, unsigned frames);
+
+bool yuv_io_map_eof(const yuv_io_map_t *map);
+
+void yuv_io_map_rewind(yuv_io_map_t *map);
+
+void yuv_io_map_close(yuv_io_map_t *map);
 
 int yuv_io_write(FILE* file,
                 const uvg_picture *img,
@@ -0,0 +1,201 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+
+#include "greatest/greatest.h"
+
+#include "src/uvg266.h"
+#include "src/threads.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+#define ASYNC_FRAMES 6
+#define ASYNC_SIZE 64
+
+static const uvg_api *api;
+static uvg_config *cfg;
+
+static int32_t callback_count;
+
+static void count_callback(void *opaque)
+{
+  UVG_ATOMIC_INC(opaque);
+}
+
+static uvg_picture *test_frame(int frame)
+{
+  uvg_picture *pic = api->picture_alloc(ASYNC_SIZE, ASYNC_SIZE);
+  for (int y = 0; y < ASYNC_SIZE; y++) {
+    for (int x = 0; x < ASYNC_SIZE; x++) {
+      pic->y[y * pic->stride + x] = (uvg_pixel)((x + 3 * frame) * (y + 1) / 4);
+    }
+  }
+  const int chroma_bytes = (ASYNC_SIZE / 2) * (pic->stride / 2);
+  memset(pic->u, 100 + frame, chroma_bytes * sizeof(uvg_pixel));
+  memset(pic->v, 150 - frame, chroma_bytes * sizeof(uvg_pixel));
+  return pic;
+}
+
+static void append_chunks(uint8_t **out, size_t *len, uvg_data_chunk *chunks, uint32_t chunks_len)
+{
+  *out = realloc(*out, *len + chunks_len);
+  for (uvg_data_chunk *chunk = chunks; chunk; chunk = chunk->next) {
+    memcpy(*out + *len, chunk->data, chunk->len);
+    *len += chunk->len;
+  }
+  api->chunk_free(chunks);
+}
+
+static uint8_t *encode_sync(size_t *len)
+{
+  uvg_encoder *enc = api->encoder_open(cfg);
+  if (!enc) return NULL;
+
+  uint8_t *out = NULL;
+  *len = 0;
+  for (int frame = 0; ; frame++) {
+    uvg_picture *pic = frame < ASYNC_FRAMES ? test_frame(frame) : NULL;
+    uvg_data_chunk *chunks = NULL;
+    uint32_t chunks_len = 0;
+    if (!api->encoder_encode(enc, pic, &chunks, &chunks_len, NULL, NULL, NULL)) break;
+    api->picture_free(pic);
+    if (!chunks && frame >= ASYNC_FRAMES) break;
+    append_chunks(&out, len, chunks, chunks_len);
+  }
+
+  api->encoder_close(enc);
+  return out;
+}
+
+static void setup(void)
+{
+  api = uvg_api_get(UVG_BIT_DEPTH);
+  cfg = api->config_alloc();
+  api->config_init(cfg);
+  api->config_parse(cfg, "preset", "ultrafast");
+  cfg->width = ASYNC_SIZE;
+  cfg->height = ASYNC_SIZE;
+  cfg->threads = 2;
+  cfg->owf = 2;
+  cfg->add_encoder_info = 0;
+}
+
+static void teardown(void)
+{
+  api->config_destroy(cfg);
+  cfg = NULL;
+}
+
+TEST test_async_matches_sync()
+{
+  size_t sync_len = 0;
+  uint8_t *sync_out = encode_sync(&sync_len);
+  ASSERT(sync_out);
+
+  uvg_encoder *enc = api->encoder_open(cfg);
+  ASSERT(enc);
+  callback_count = 0;
+  api->encoder_set_callback(enc, count_callback, &callback_count);
+  const int fd = api->encoder_get_fd(enc);
+#ifndef _WIN32
+  ASSERT(fd >= 0);
+#endif
+
+  // Submitting never waits for the encoder.
+  for (int frame = 0; frame < ASYNC_FRAMES; frame++) {
+    uvg_picture *pic = test_frame(frame);
+    ASSERT(api->encoder_submit(enc, pic));
+    api->picture_free(pic);
+  }
+  ASSERT(api->encoder_submit(enc, NULL));
+  ASSERT_EQ(0, api->encoder_submit(enc, NULL));
+
+  uint8_t *out = NULL;
+  size_t len = 0;
+  int frames = 0;
+  int status;
+  for (;;) {
+    uvg_data_chunk *chunks = NULL;
+    uint32_t chunks_len = 0;
+    uvg_frame_info info;
+    status = api->encoder_poll(enc, &chunks, &chunks_len, NULL, NULL, &info);
+    if (status == UVG_ASYNC_FRAME) {
+      append_chunks(&out, &len, chunks, chunks_len);
+      frames++;
+    } else if (status == UVG_ASYNC_PENDING) {
+#ifndef _WIN32
+      struct pollfd pfd = { .fd = fd, .events = POLLIN };
+      ASSERT_EQ(1, poll(&pfd, 1, 10000));
+#endif
+    } else {
+      break;
+    }
+  }
+  ASSERT_EQ(UVG_ASYNC_END, status);
+  ASSERT_EQ(UVG_ASYNC_END, api->encoder_poll(enc, NULL, NULL, NULL, NULL, NULL));
+  ASSERT_EQ(ASYNC_FRAMES, frames);
+  ASSERT(callback_count >= 1);
+  ASSERT_EQ(sync_len, len);
+  ASSERT(memcmp(sync_out, out, len) == 0);
+
+  api->encoder_close(enc);
+  free(sync_out);
+  free(out);
+  PASS();
+}
+
+TEST test_async_close_while_encoding()
+{
+  // Closing the encoder without ending the input drops the queued frames.
+  uvg_encoder *enc = api->encoder_open(cfg);
+  ASSERT(enc);
+  for (int frame = 0; frame < ASYNC_FRAMES; frame++) {
+    uvg_picture *pic = test_frame(frame);
+    ASSERT(api->encoder_submit(enc, pic));
+    api->picture_free(pic);
+  }
+  api->encoder_close(enc);
+  PASS();
+}
+
+SUITE(async_encode_tests)
+{
+  setup();
+  RUN_TEST(test_async_matches_sync);
+  RUN_TEST(test_async_close_while_encoding);
+  teardown();
+}
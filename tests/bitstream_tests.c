@@ -0,0 +1,174 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+
+#include "greatest/greatest.h"
+
+#include <pthread.h>
+
+#include "src/bitstream.h"
+
+TEST test_freed_chunk_is_reused()
+{
+  // Chunks are kept for reuse only while an encoder holds the pool.
+  uvg_bitstream_pool_acquire();
+  uvg_data_chunk *chunk = uvg_bitstream_alloc_chunk();
+  ASSERT(chunk);
+  chunk->len = 10;
+  uvg_bitstream_free_chunks(chunk);
+
+  uvg_data_chunk *again = uvg_bitstream_alloc_chunk();
+  ASSERT_EQ(chunk, again);
+  ASSERT_EQ(0, again->len);
+  ASSERT_EQ(NULL, again->next);
+
+  uvg_bitstream_free_chunks(again);
+  uvg_bitstream_pool_release();
+  PASS();
+}
+
+#define NUM_BYTES (3 * UVG_DATA_CHUNK_SIZE + 5)
+
+static void *write_stream(void *arg)
+{
+  bitstream_t *stream = arg;
+  for (int i = 0; i < NUM_BYTES; i++) {
+    uvg_bitstream_writebyte(stream, (uint8_t)i);
+  }
+  return NULL;
+}
+
+TEST test_chunks_freed_by_another_thread()
+{
+  uvg_bitstream_pool_acquire();
+  for (int round = 0; round < 2; round++) {
+    // Chunks are allocated by a worker and freed by this thread, like the
+    // output of the encoder.
+    bitstream_t stream;
+    uvg_bitstream_init(&stream);
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, write_stream, &stream));
+    pthread_join(thread, NULL);
+
+    ASSERT_EQ(NUM_BYTES, stream.len);
+    uvg_data_chunk *chunks = uvg_bitstream_take_chunks(&stream);
+    int num_chunks = 0;
+    int pos = 0;
+    for (uvg_data_chunk *chunk = chunks; chunk != NULL; chunk = chunk->next) {
+      for (uint32_t i = 0; i < chunk->len; i++, pos++) {
+        ASSERT_EQ((uint8_t)pos, chunk->data[i]);
+      }
+      num_chunks++;
+    }
+    ASSERT_EQ(NUM_BYTES, pos);
+    ASSERT_EQ(4, num_chunks);
+
+    uvg_bitstream_free_chunks(chunks);
+    uvg_bitstream_finalize(&stream);
+  }
+  uvg_bitstream_pool_release();
+  PASS();
+}
+
+/**
+ * \brief Write bits one at a time with emulation prevention.
+ *
+ * \return number of bytes written to out
+ */
+static int reference_put(uint8_t *out, int len, int *zerocount,
+                         uint32_t *byte, int *num_bits,
+                         uint32_t data, int bits)
+{
+  for (int i = bits - 1; i >= 0; i--) {
+    *byte = (*byte << 1) | ((data >> i) & 1);
+    if (++*num_bits == 8) {
+      if (*zerocount == 2 && *byte < 4) {
+        out[len++] = 3;
+        *zerocount = 0;
+      }
+      *zerocount = *byte == 0 ? *zerocount + 1 : 0;
+      out[len++] = (uint8_t)*byte;
+      *byte = 0;
+      *num_bits = 0;
+    }
+  }
+  return len;
+}
+
+TEST test_put_inserts_emulation_prevention()
+{
+  static uint8_t expected[3 * UVG_DATA_CHUNK_SIZE];
+  int expected_len = 0;
+  int zerocount = 0;
+  uint32_t byte = 0;
+  int num_bits = 0;
+
+  bitstream_t stream;
+  uvg_bitstream_init(&stream);
+
+  // Zeros, small values and ones, so that start code emulations occur at
+  // all bit offsets and across chunks.
+  uint32_t seed = 12345;
+  while (expected_len < 2 * UVG_DATA_CHUNK_SIZE) {
+    seed = seed * 1103515245 + 12345;
+    const int bits = 1 + (seed >> 16) % 32;
+    const uint32_t kind = (seed >> 8) % 4;
+    const uint32_t data = kind == 0 ? (seed >> 12) & 3 : kind == 1 ? 0xffffffff : 0;
+    uvg_bitstream_put(&stream, data, bits);
+    expected_len = reference_put(expected, expected_len, &zerocount,
+                                 &byte, &num_bits, data, bits);
+    ASSERT_EQ(num_bits, stream.cur_bit);
+  }
+  uvg_bitstream_align_zero(&stream);
+  expected_len = reference_put(expected, expected_len, &zerocount,
+                               &byte, &num_bits, 0, (8 - num_bits) & 7);
+
+  ASSERT_EQ(expected_len, stream.len);
+  int pos = 0;
+  for (uvg_data_chunk *chunk = stream.first; chunk != NULL; chunk = chunk->next) {
+    ASSERT(pos + chunk->len <= expected_len);
+    for (uint32_t i = 0; i < chunk->len; i++, pos++) {
+      ASSERT_EQ(expected[pos], chunk->data[i]);
+    }
+  }
+  ASSERT_EQ(expected_len, pos);
+
+  uvg_bitstream_finalize(&stream);
+  PASS();
+}
+
+SUITE(bitstream_tests)
+{
+  RUN_TEST(test_freed_chunk_is_reused);
+  RUN_TEST(test_chunks_freed_by_another_thread);
+  RUN_TEST(test_put_inserts_emulation_prevention);
+}
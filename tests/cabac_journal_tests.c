@@ -0,0 +1,315 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+
+#include "greatest/greatest.h"
+
+#include "src/cabac.h"
+#include "src/cfg.h"
+#include "src/context.h"
+#include "src/cu.h"
+#include "src/encoder.h"
+#include "src/encoderstate.h"
+#include "src/rdo.h"
+#include "src/threads.h"
+#include "src/transform.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cabac_data_t cabac;
+static cabac_journal_t *journal;
+
+static void setup_cabac(void)
+{
+  memset(&cabac, 0, sizeof(cabac));
+  uvg_cabac_start(&cabac);
+  cabac.only_count = 1;
+  cabac.update = 1;
+
+  cabac_ctx_t *ctx = (cabac_ctx_t *)&cabac.ctx;
+  for (unsigned i = 0; i < CABAC_NUM_CTX; i++) {
+    const int state = 256 * (i % 200 + 28);
+    CTX_SET_STATE(&ctx[i], state);
+    CTX_SET_LOG2_WIN(&ctx[i], 5 + i % 7);
+  }
+
+  journal = uvg_cabac_journal_alloc();
+  cabac.journal = journal;
+}
+
+static void teardown_cabac(void)
+{
+  uvg_cabac_journal_free(journal);
+  journal = NULL;
+}
+
+static void encode_random_bins(int num_bins)
+{
+  cabac_ctx_t *ctx = (cabac_ctx_t *)&cabac.ctx;
+  for (int i = 0; i < num_bins; i++) {
+    cabac.cur_ctx = &ctx[rand() % 64];
+    uvg_cabac_encode_bin(&cabac, rand() & 1);
+  }
+}
+
+TEST test_rollback_restores_contexts()
+{
+  srand(3);
+  encode_random_bins(100);
+
+  cabac_data_t expected = cabac;
+  cabac_mark_t mark;
+  uvg_cabac_journal_mark(&cabac, &mark);
+
+  // More than the initial size of the journal.
+  encode_random_bins(10000);
+  ASSERT(memcmp(&expected.ctx, &cabac.ctx, sizeof(cabac.ctx)) != 0);
+
+  uvg_cabac_journal_rollback(&cabac, &mark);
+  ASSERT(memcmp(&expected.ctx, &cabac.ctx, sizeof(cabac.ctx)) == 0);
+  ASSERT_EQ(expected.low, cabac.low);
+  ASSERT_EQ(expected.range, cabac.range);
+  ASSERT_EQ(mark.pos, journal->size);
+  PASS();
+}
+
+TEST test_restore_snapshot()
+{
+  srand(5);
+  cabac_data_t before = cabac;
+  cabac_mark_t base;
+  uvg_cabac_journal_mark(&cabac, &base);
+
+  encode_random_bins(50);
+  cabac_data_t expected = cabac;
+  cabac_snapshot_t snapshot;
+  uvg_cabac_journal_save(&cabac, &base, &snapshot);
+  ASSERT(snapshot.num_ctx <= 64);
+
+  // Try something else and come back to the snapshot.
+  uvg_cabac_journal_rollback(&cabac, &base);
+  encode_random_bins(80);
+  uvg_cabac_journal_restore(&cabac, &base, &snapshot);
+  ASSERT(memcmp(&expected.ctx, &cabac.ctx, sizeof(cabac.ctx)) == 0);
+  ASSERT_EQ(expected.low, cabac.low);
+
+  // The restored state can still be rolled back.
+  uvg_cabac_journal_rollback(&cabac, &base);
+  ASSERT(memcmp(&before.ctx, &cabac.ctx, sizeof(cabac.ctx)) == 0);
+  PASS();
+}
+
+TEST test_count_bin_matches_writer()
+{
+  srand(7);
+  cabac_data_t writer = cabac;
+  writer.journal = NULL;
+  cabac_mark_t mark;
+  uvg_cabac_journal_mark(&cabac, &mark);
+  cabac_data_t before = cabac;
+  cabac_estimator_t est = { &cabac.ctx, cabac.journal };
+
+  double writer_bits = 0;
+  double count_bits = 0;
+  cabac_ctx_t *writer_ctx = (cabac_ctx_t *)&writer.ctx;
+  cabac_ctx_t *count_ctx = (cabac_ctx_t *)&cabac.ctx;
+  for (int i = 0; i < 1000; i++) {
+    const int idx = rand() % 64;
+    const uint32_t bin = rand() & 1;
+    CABAC_FBITS_UPDATE(&writer, &writer_ctx[idx], bin, writer_bits, "bin");
+    CABAC_COUNT_BIN(&est, &count_ctx[idx], bin, count_bits);
+  }
+  ASSERT_EQ(writer_bits, count_bits);
+  ASSERT(memcmp(&writer.ctx, &cabac.ctx, sizeof(cabac.ctx)) == 0);
+  // The arithmetic coder is not touched.
+  ASSERT_EQ(before.low, cabac.low);
+  ASSERT_EQ(before.range, cabac.range);
+
+  uvg_cabac_journal_rollback(&cabac, &mark);
+  ASSERT(memcmp(&before.ctx, &cabac.ctx, sizeof(cabac.ctx)) == 0);
+  PASS();
+}
+
+// Coefficient blocks costed by the coefficient estimator tests
+#define NUM_COEFF_BLOCKS 64
+// Calls of uvg_get_coeff_cost per block size in the speed test
+#define SPEED_COEFF_COSTS 200000
+
+static const int coeff_block_sizes[][2] = {
+  { 4, 4 }, { 8, 8 }, { 16, 16 }, { 32, 32 }, { 4, 16 }, { 32, 8 },
+};
+
+static encoder_control_t coeff_encoder;
+static encoder_state_t coeff_state;
+static coeff_t coeff_blocks[NUM_COEFF_BLOCKS][TR_MAX_WIDTH * TR_MAX_WIDTH];
+static int coeff_width;
+static int coeff_height;
+static char coeff_msg[256];
+
+/**
+ * \brief Set up a state whose search CABAC has the contexts of a slice
+ * and fill the blocks with quantized coefficients that decay away from DC.
+ */
+static void setup_coeff_cost(const int width, const int height)
+{
+  memset(&coeff_encoder, 0, sizeof(coeff_encoder));
+  memset(&coeff_state, 0, sizeof(coeff_state));
+  uvg_config_init(&coeff_encoder.cfg);
+  coeff_encoder.bitdepth = UVG_BIT_DEPTH;
+  coeff_encoder.chroma_format = UVG_CSP_420;
+  coeff_state.encoder_control = &coeff_encoder;
+  coeff_state.qp = 32;
+  uvg_init_contexts(&coeff_state, coeff_state.qp, UVG_SLICE_I);
+  coeff_state.search_cabac.ctx = coeff_state.cabac.ctx;
+  coeff_state.search_cabac.only_count = 1;
+  coeff_state.search_cabac.journal = uvg_cabac_journal_alloc();
+
+  coeff_width = width;
+  coeff_height = height;
+  srand(width * 64 + height);
+  for (int b = 0; b < NUM_COEFF_BLOCKS; b++) {
+    const double decay = 0.5 + (b % 8) * 0.4;
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        const double scale = 12.0 * exp(-(x + y) / decay);
+        const int level = (int)(scale * (rand() % 1000) / 1000.0);
+        coeff_blocks[b][y * width + x] = (coeff_t)(rand() & 1 ? level : -level);
+      }
+    }
+    coeff_blocks[b][0] |= 1;
+  }
+}
+
+static void teardown_coeff_cost(void)
+{
+  uvg_cabac_journal_free(coeff_state.search_cabac.journal);
+  coeff_state.search_cabac.journal = NULL;
+}
+
+/**
+ * \brief Cost a block with the coefficient writer on a copy of the search
+ * CABAC, or with the count-only walk on the journaled search CABAC.
+ */
+static double coeff_cost(const int block, const bool estimator)
+{
+  cabac_journal_t *const journal = coeff_state.search_cabac.journal;
+  if (!estimator) coeff_state.search_cabac.journal = NULL;
+  cu_loc_t loc;
+  uvg_cu_loc_ctor(&loc, 0, 0, coeff_width, coeff_height);
+  cu_info_t tu;
+  memset(&tu, 0, sizeof(tu));
+  const double bits = uvg_get_coeff_cost(&coeff_state, coeff_blocks[block], &tu, &loc,
+                                         COLOR_Y, SCAN_DIAG, 0, COEFF_ORDER_LINEAR);
+  coeff_state.search_cabac.journal = journal;
+  return bits;
+}
+
+TEST test_coeff_estimator_matches_writer()
+{
+  cabac_journal_t *const journal = coeff_state.search_cabac.journal;
+  for (int update = 0; update < 2; update++) {
+    coeff_state.search_cabac.update = update;
+    cabac_data_t writer_cabac = coeff_state.search_cabac;
+    writer_cabac.journal = NULL;
+    cabac_data_t estimator_cabac = coeff_state.search_cabac;
+    for (int b = 0; b < NUM_COEFF_BLOCKS; b++) {
+      coeff_state.search_cabac = writer_cabac;
+      const double writer_bits = coeff_cost(b, false);
+      writer_cabac = coeff_state.search_cabac;
+
+      coeff_state.search_cabac = estimator_cabac;
+      const double estimator_bits = coeff_cost(b, true);
+      estimator_cabac = coeff_state.search_cabac;
+
+      ASSERT_EQ(writer_bits, estimator_bits);
+      // The contexts are kept exactly when the search CABAC is updated.
+      ASSERT(memcmp(&writer_cabac.ctx, &estimator_cabac.ctx, sizeof(writer_cabac.ctx)) == 0);
+      ASSERT_EQ(journal, estimator_cabac.journal);
+    }
+    coeff_state.search_cabac = estimator_cabac;
+  }
+  PASS();
+}
+
+/**
+ * \brief Measure the time of costing the coefficients with the writer and
+ * with the count-only estimator.
+ */
+TEST test_coeff_cost_speed(const int estimator)
+{
+  double sum = 0;
+  UVG_CLOCK_T start, stop;
+  UVG_GET_TIME(&start);
+  for (int i = 0; i < SPEED_COEFF_COSTS; ++i) {
+    sum += coeff_cost(i % NUM_COEFF_BLOCKS, estimator);
+  }
+  UVG_GET_TIME(&stop);
+
+  sprintf(coeff_msg, "%dx%d %s: %.1f ns per block (%.0f bits)", coeff_width, coeff_height,
+          estimator ? "estimator" : "writer",
+          UVG_CLOCK_T_DIFF(start, stop) * 1e9 / SPEED_COEFF_COSTS, sum / SPEED_COEFF_COSTS);
+  PASSm(coeff_msg);
+}
+
+SUITE(cabac_journal_tests)
+{
+  setup_cabac();
+  RUN_TEST(test_rollback_restores_contexts);
+  teardown_cabac();
+
+  setup_cabac();
+  RUN_TEST(test_restore_snapshot);
+  teardown_cabac();
+
+  setup_cabac();
+  RUN_TEST(test_count_bin_matches_writer);
+  teardown_cabac();
+
+  for (int i = 0; i < (int)(sizeof(coeff_block_sizes) / sizeof(coeff_block_sizes[0])); i++) {
+    setup_coeff_cost(coeff_block_sizes[i][0], coeff_block_sizes[i][1]);
+    RUN_TEST(test_coeff_estimator_matches_writer);
+    teardown_coeff_cost();
+  }
+}
+
+SUITE(cabac_journal_speed_tests)
+{
+  for (int i = 0; i < (int)(sizeof(coeff_block_sizes) / sizeof(coeff_block_sizes[0])); i++) {
+    setup_coeff_cost(coeff_block_sizes[i][0], coeff_block_sizes[i][1]);
+    RUN_TEST1(test_coeff_cost_speed, 0);
+    RUN_TEST1(test_coeff_cost_speed, 1);
+    teardown_coeff_cost();
+  }
+}
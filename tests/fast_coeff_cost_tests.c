@@ -0,0 +1,84 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+
+#include "greatest/greatest.h"
+
+#include "src/fast_coeff_cost.h"
+
+#include <stdlib.h>
+
+#define TEST_QP 32
+
+static const double target_wts[4] = { 0.25, 4.5, 6.0, 9.0 };
+
+static double weight_of(uint64_t packed, int bucket)
+{
+  return (double)((packed >> (16 * bucket)) & 0xffff) / 256.0;
+}
+
+TEST test_online_weights_converge()
+{
+  fast_coeff_table_t table;
+  uvg_fast_coeff_use_default_table(&table);
+
+  fast_coeff_online_t *online = uvg_fast_coeff_online_alloc(&table);
+  ASSERT(online != NULL);
+
+  // Feed blocks whose cost is exactly linear in the bucket counts.
+  coeff_t coeff[16 * 16];
+  srand(1);
+  for (int block = 0; block < 40 * FASTRD_ONLINE_UPDATE_SAMPLES; block++) {
+    const int size = 4 << (block % 3);
+    double bits = 0;
+    for (int i = 0; i < size * size; i++) {
+      const int r = rand() % 8;
+      coeff[i] = r < 4 ? 0 : (coeff_t)(r - 3) * (rand() % 2 ? 1 : -1);
+      bits += target_wts[MIN(abs(coeff[i]), 3)];
+    }
+    uvg_fast_coeff_online_update(online, TEST_QP, coeff, size, size, bits);
+  }
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_IN_RANGE(target_wts[i], weight_of(online->wts_by_qp[TEST_QP], i), 0.1);
+  }
+  // Other QPs are not touched.
+  ASSERT_EQ(table.wts_by_qp[TEST_QP + 1], online->wts_by_qp[TEST_QP + 1]);
+
+  uvg_fast_coeff_online_free(online);
+  PASS();
+}
+
+SUITE(fast_coeff_cost_tests)
+{
+  RUN_TEST(test_online_weights_converge);
+}
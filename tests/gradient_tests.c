@@ -0,0 +1,123 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+
+#include "greatest/greatest.h"
+
+#include "test_strategies.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_STRIDE 80
+
+static uvg_pixel test_block[TEST_STRIDE * 64];
+
+static void setup()
+{
+  // Fill test data with a pattern that has different gradients in each
+  // direction and covers the full pixel range.
+  for (int y = 0; y < 64; y++) {
+    for (int x = 0; x < TEST_STRIDE; x++) {
+      test_block[x + y * TEST_STRIDE] = (uvg_pixel)((x * 7 + y * y * 3 + ((x * y) % 13) * 17) % (PIXEL_MAX + 1));
+    }
+  }
+}
+
+static void reference_gradients(const uvg_pixel *buf, int width, int height, uint32_t *hor, uint32_t *ver)
+{
+  *hor = 0;
+  *ver = 0;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      if (x + 1 < width) *hor += abs(buf[x + 1 + y * TEST_STRIDE] - buf[x + y * TEST_STRIDE]);
+      if (y + 1 < height) *ver += abs(buf[x + (y + 1) * TEST_STRIDE] - buf[x + y * TEST_STRIDE]);
+    }
+  }
+}
+
+TEST test_directional_gradients()
+{
+  for (int log2_w = 2; log2_w <= 6; log2_w++) {
+    for (int log2_h = 2; log2_h <= 6; log2_h++) {
+      const int width = 1 << log2_w;
+      const int height = 1 << log2_h;
+      uint32_t expected_hor, expected_ver, hor, ver;
+      reference_gradients(test_block, width, height, &expected_hor, &expected_ver);
+      uvg_directional_gradients(test_block, TEST_STRIDE, width, height, &hor, &ver);
+      ASSERT_EQ(expected_hor, hor);
+      ASSERT_EQ(expected_ver, ver);
+    }
+  }
+  PASS();
+}
+
+TEST test_block_sum_sq()
+{
+  for (int log2_w = 2; log2_w <= 6; log2_w++) {
+    for (int log2_h = 2; log2_h <= 6; log2_h++) {
+      const int width = 1 << log2_w;
+      const int height = 1 << log2_h;
+      uint32_t expected_sum = 0;
+      uint64_t expected_sum_sq = 0;
+      for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+          const uint32_t val = test_block[x + y * TEST_STRIDE];
+          expected_sum += val;
+          expected_sum_sq += val * val;
+        }
+      }
+      uint32_t sum;
+      uint64_t sum_sq;
+      uvg_block_sum_sq(test_block, TEST_STRIDE, width, height, &sum, &sum_sq);
+      ASSERT_EQ(expected_sum, sum);
+      ASSERT_EQ(expected_sum_sq, sum_sq);
+    }
+  }
+  PASS();
+}
+
+SUITE(gradient_tests)
+{
+  setup();
+
+  for (volatile int i = 0; i < strategies.count; ++i) {
+    if (strcmp(strategies.strategies[i].type, "directional_gradients") == 0) {
+      uvg_directional_gradients = strategies.strategies[i].fptr;
+      RUN_TEST(test_directional_gradients);
+    }
+    else if (strcmp(strategies.strategies[i].type, "block_sum_sq") == 0) {
+      uvg_block_sum_sq = strategies.strategies[i].fptr;
+      RUN_TEST(test_block_sum_sq);
+    }
+  }
+}
@@ -0,0 +1,247 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#ifdef __linux__
+#define _GNU_SOURCE // syscall
+#endif
+
+#include "greatest/greatest.h"
+
+#include "src/hugepages.h"
+#include "src/image.h"
+#include "src/threads.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+TEST test_calloc_is_zeroed(const int enable)
+{
+  if (enable) uvg_hugepages_acquire();
+  const size_t size = 3 * HUGEPAGE_SIZE + 100;
+  uint8_t *buf = uvg_hugepage_calloc(size);
+  uint8_t *small = uvg_hugepage_calloc(100);
+  if (enable) uvg_hugepages_release();
+  ASSERT(buf);
+  ASSERT(small);
+
+  for (size_t i = 0; i < size; i++) {
+    if (buf[i]) FAILm("buffer not zeroed");
+  }
+  for (size_t i = 0; i < 100; i++) {
+    if (small[i]) FAILm("buffer not zeroed");
+  }
+  ASSERT_EQ(0, (uintptr_t)buf % 16);
+  memset(buf, 0xff, size);
+
+  // Freeing does not depend on the setting at the time of the free.
+  uvg_hugepage_free(buf);
+  uvg_hugepage_free(small);
+  uvg_hugepage_free(NULL);
+  PASS();
+}
+
+TEST test_picture_with_hugepages()
+{
+  uvg_hugepages_acquire();
+  uvg_picture *pic = uvg_image_alloc(UVG_CSP_420, 1920, 1080);
+  uvg_hugepages_release();
+  ASSERT(pic);
+
+  memset(pic->y, 1, pic->stride * pic->height);
+  pic->v[(pic->height / 2 - 1) * (pic->stride / 2) + pic->width / 2 - 1] = 2;
+  uvg_image_free(pic);
+  PASS();
+}
+
+TEST test_encoder_releases_hugepages()
+{
+  const uvg_api *const api = uvg_api_get(UVG_BIT_DEPTH);
+  uvg_config *cfg = api->config_alloc();
+  ASSERT(cfg);
+  api->config_init(cfg);
+  api->config_parse(cfg, "preset", "ultrafast");
+  api->config_parse(cfg, "input-res", "64x64");
+  api->config_parse(cfg, "threads", "0");
+  api->config_parse(cfg, "hugepages", "1");
+
+  uvg_encoder *first = api->encoder_open(cfg);
+  uvg_encoder *second = api->encoder_open(cfg);
+  ASSERT(first);
+  ASSERT(second);
+  ASSERT(uvg_hugepages_enabled());
+  api->encoder_close(first);
+  ASSERT(uvg_hugepages_enabled());
+  api->encoder_close(second);
+  ASSERT(!uvg_hugepages_enabled());
+
+  // Encoders without the option do not use huge pages.
+  api->config_parse(cfg, "hugepages", "0");
+  uvg_encoder *plain = api->encoder_open(cfg);
+  ASSERT(plain);
+  ASSERT(!uvg_hugepages_enabled());
+  api->encoder_close(plain);
+  api->config_destroy(cfg);
+  PASS();
+}
+
+SUITE(hugepages_tests)
+{
+  RUN_TEST1(test_calloc_is_zeroed, 0);
+  RUN_TEST1(test_calloc_is_zeroed, 1);
+  RUN_TEST(test_picture_with_hugepages);
+  RUN_TEST(test_encoder_releases_hugepages);
+}
+
+// Size of the frames of the motion search benchmark
+#define ME_WIDTH 3840
+#define ME_HEIGHT 2160
+#define ME_BLOCK 64
+// Motion vectors are searched within +-ME_RANGE pixels.
+#define ME_RANGE 64
+#define ME_CANDIDATES 16
+
+static char me_msg[128];
+
+#ifdef __linux__
+/**
+ * \brief Open a counter of data TLB read misses of this thread.
+ * \return file descriptor or -1 if not available
+ */
+static int open_dtlb_counter(void)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/**
+ * \brief Measure SADs of blocks at scattered positions of a reference
+ * frame, like motion search of the CTUs of a 4K frame does.
+ *
+ * Each row of a block is on a different 4 KB page, so with small pages most
+ * block reads miss the TLB.
+ */
+TEST test_motion_search_access(const int enable)
+{
+  if (enable) uvg_hugepages_acquire();
+  uvg_picture *cur = uvg_image_alloc(UVG_CSP_420, ME_WIDTH, ME_HEIGHT);
+  uvg_picture *ref = uvg_image_alloc(UVG_CSP_420, ME_WIDTH, ME_HEIGHT);
+  if (enable) uvg_hugepages_release();
+  ASSERT(cur);
+  ASSERT(ref);
+
+  // Touch the pictures so that page faults are not measured.
+  for (int y = 0; y < ME_HEIGHT; y++) {
+    for (int x = 0; x < ME_WIDTH; x++) {
+      cur->y[y * cur->stride + x] = (uvg_pixel)(x * 3 + y);
+      ref->y[y * ref->stride + x] = (uvg_pixel)(x + y * 5);
+    }
+  }
+
+  int counter = -1;
+#ifdef __linux__
+  counter = open_dtlb_counter();
+  if (counter >= 0) ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+
+  uint32_t rand_state = 1;
+  uint64_t total_sad = 0;
+  UVG_CLOCK_T start, stop;
+  UVG_GET_TIME(&start);
+  for (int by = 0; by + ME_BLOCK <= ME_HEIGHT; by += ME_BLOCK) {
+    for (int bx = 0; bx + ME_BLOCK <= ME_WIDTH; bx += ME_BLOCK) {
+      const uvg_pixel *const block = &cur->y[by * cur->stride + bx];
+      for (int cand = 0; cand < ME_CANDIDATES; cand++) {
+        rand_state = rand_state * 1103515245 + 12345;
+        int x = bx + (int)((rand_state >> 8) % (2 * ME_RANGE + 1)) - ME_RANGE;
+        int y = by + (int)((rand_state >> 20) % (2 * ME_RANGE + 1)) - ME_RANGE;
+        x = CLIP(0, ME_WIDTH - ME_BLOCK, x);
+        y = CLIP(0, ME_HEIGHT - ME_BLOCK, y);
+        const uvg_pixel *const pos = &ref->y[y * ref->stride + x];
+
+        uint32_t sad = 0;
+        for (int row = 0; row < ME_BLOCK; row++) {
+          for (int col = 0; col < ME_BLOCK; col++) {
+            sad += abs(block[row * cur->stride + col] - pos[row * ref->stride + col]);
+          }
+        }
+        total_sad += sad;
+      }
+    }
+  }
+  UVG_GET_TIME(&stop);
+
+  long long misses = -1;
+#ifdef __linux__
+  if (counter >= 0) {
+    ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(counter, &misses, sizeof(misses)) != sizeof(misses)) misses = -1;
+    close(counter);
+  }
+#endif
+
+  uvg_image_free(cur);
+  uvg_image_free(ref);
+  ASSERT(total_sad > 0);
+
+  if (misses >= 0) {
+    sprintf(me_msg, "%.1f ms, %lld dTLB misses, hugepages %d",
+            UVG_CLOCK_T_DIFF(start, stop) * 1e3, misses, enable);
+  } else {
+    sprintf(me_msg, "%.1f ms, dTLB misses not available, hugepages %d",
+            UVG_CLOCK_T_DIFF(start, stop) * 1e3, enable);
+  }
+  PASSm(me_msg);
+}
+
+SUITE(hugepages_speed_tests)
+{
+  RUN_TEST1(test_motion_search_access, 0);
+  RUN_TEST1(test_motion_search_access, 1);
+}
@@ -0,0 +1,88 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "greatest/greatest.h"
+
+#include "src/image.h"
+
+TEST test_returned_picture_is_reused()
+{
+  uvg_picture_pool *pool = uvg_image_pool_alloc();
+  ASSERT(pool);
+
+  uvg_picture *pic = uvg_image_pool_get(pool, UVG_CSP_420, 64, 32);
+  ASSERT(pic);
+  uvg_pixel *const buf = pic->fulldata_buf;
+  pic->pts = 5;
+  uvg_image_free(pic);
+
+  // A picture of another size or format is allocated.
+  uvg_picture *other = uvg_image_pool_get(pool, UVG_CSP_422, 64, 32);
+  ASSERT(other);
+  ASSERT(other->fulldata_buf != buf);
+
+  pic = uvg_image_pool_get(pool, UVG_CSP_420, 64, 32);
+  ASSERT(pic);
+  ASSERT_EQ(buf, pic->fulldata_buf);
+  ASSERT_EQ(1, pic->refcount);
+  ASSERT_EQ(0, pic->pts);
+  ASSERT_EQ(64, pic->width);
+  ASSERT_EQ(32, pic->height);
+
+  uvg_image_free(other);
+  uvg_image_free(pic);
+  uvg_image_pool_free(pool);
+  PASS();
+}
+
+TEST test_picture_outlives_pool()
+{
+  uvg_picture_pool *pool = uvg_image_pool_alloc();
+  ASSERT(pool);
+
+  uvg_picture *pic = uvg_image_pool_get(pool, UVG_CSP_420, 16, 16);
+  ASSERT(pic);
+  uvg_picture *ref = uvg_image_copy_ref(pic);
+  uvg_image_pool_free(pool);
+
+  // The pool is freed with the last picture.
+  uvg_image_free(pic);
+  ref->y[0] = 1;
+  uvg_image_free(ref);
+  PASS();
+}
+
+SUITE(image_pool_tests)
+{
+  RUN_TEST(test_returned_picture_is_reused);
+  RUN_TEST(test_picture_outlives_pool);
+}
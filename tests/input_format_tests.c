@@ -0,0 +1,282 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+
+#include "greatest/greatest.h"
+
+#include "test_strategies.h"
+
+#include "src/image.h"
+#include "src/strategies/strategies-input.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Enough pairs to go through the SIMD loops and the scalar tail.
+#define NUM_PAIRS 203
+
+static uint8_t src_8bit[2 * NUM_PAIRS];
+static uint16_t src_16bit[2 * NUM_PAIRS];
+
+static convert_8bit_func *convert_8bit;
+static convert_16bit_func *convert_16bit;
+static deinterleave_8bit_func *deinterleave_8bit;
+static deinterleave_16bit_func *deinterleave_16bit;
+static swap_16bit_func *swap_16bit;
+
+static void setup()
+{
+  srand(44);
+  for (int i = 0; i < 2 * NUM_PAIRS; i++) {
+    src_8bit[i] = (uint8_t)rand();
+    src_16bit[i] = (uint16_t)(rand() ^ (rand() << 8));
+  }
+}
+
+// Shifts for taking MSB-aligned samples of an input bit depth to the
+// bit depth of the build.
+static int shift_right(int input_bitdepth)
+{
+  return 16 - MIN(input_bitdepth, UVG_BIT_DEPTH);
+}
+
+static int shift_left(int input_bitdepth)
+{
+  return MAX(UVG_BIT_DEPTH - input_bitdepth, 0);
+}
+
+TEST test_deinterleave_8bit()
+{
+  uvg_pixel a[NUM_PAIRS];
+  uvg_pixel b[NUM_PAIRS];
+  deinterleave_8bit(src_8bit, a, b, NUM_PAIRS, UVG_BIT_DEPTH - 8);
+
+  for (int i = 0; i < NUM_PAIRS; i++) {
+    ASSERT_EQ(src_8bit[2 * i] << (UVG_BIT_DEPTH - 8), a[i]);
+    ASSERT_EQ(src_8bit[2 * i + 1] << (UVG_BIT_DEPTH - 8), b[i]);
+  }
+  PASS();
+}
+
+TEST test_deinterleave_16bit()
+{
+  static const int bitdepths[] = { 8, 10, 16 };
+  for (int d = 0; d < sizeof(bitdepths) / sizeof(bitdepths[0]); d++) {
+    const int right = shift_right(bitdepths[d]);
+    const int left = shift_left(bitdepths[d]);
+    uvg_pixel a[NUM_PAIRS];
+    uvg_pixel b[NUM_PAIRS];
+    deinterleave_16bit(src_16bit, a, b, NUM_PAIRS, right, left);
+
+    for (int i = 0; i < NUM_PAIRS; i++) {
+      ASSERT_EQ((uvg_pixel)((src_16bit[2 * i] >> right) << left), a[i]);
+      ASSERT_EQ((uvg_pixel)((src_16bit[2 * i + 1] >> right) << left), b[i]);
+    }
+  }
+  PASS();
+}
+
+TEST test_convert_8bit()
+{
+  uvg_pixel dst[2 * NUM_PAIRS];
+  convert_8bit(src_8bit, dst, 2 * NUM_PAIRS, UVG_BIT_DEPTH - 8);
+
+  for (int i = 0; i < 2 * NUM_PAIRS; i++) {
+    ASSERT_EQ(src_8bit[i] << (UVG_BIT_DEPTH - 8), dst[i]);
+  }
+  PASS();
+}
+
+TEST test_convert_16bit()
+{
+  static const int bitdepths[] = { 8, 10, 16 };
+  for (int d = 0; d < sizeof(bitdepths) / sizeof(bitdepths[0]); d++) {
+    uvg_pixel dst[2 * NUM_PAIRS];
+
+    // MSB-aligned samples
+    int right = shift_right(bitdepths[d]);
+    int left = shift_left(bitdepths[d]);
+    convert_16bit(src_16bit, dst, 2 * NUM_PAIRS, 0xffff, right, left);
+    for (int i = 0; i < 2 * NUM_PAIRS; i++) {
+      ASSERT_EQ((uvg_pixel)((src_16bit[i] >> right) << left), dst[i]);
+    }
+
+    // Samples in the low bits with garbage above them
+    const uint16_t mask = (uint16_t)((1 << bitdepths[d]) - 1);
+    right = MAX(bitdepths[d] - UVG_BIT_DEPTH, 0);
+    convert_16bit(src_16bit, dst, 2 * NUM_PAIRS, mask, right, left);
+    for (int i = 0; i < 2 * NUM_PAIRS; i++) {
+      ASSERT_EQ((uvg_pixel)(((src_16bit[i] & mask) >> right) << left), dst[i]);
+    }
+  }
+  PASS();
+}
+
+TEST test_swap_16bit()
+{
+  uint16_t dst[2 * NUM_PAIRS];
+  swap_16bit(src_16bit, dst, 2 * NUM_PAIRS);
+
+  for (int i = 0; i < 2 * NUM_PAIRS; i++) {
+    ASSERT_EQ((uint16_t)((src_16bit[i] >> 8) | (src_16bit[i] << 8)), dst[i]);
+  }
+  PASS();
+}
+
+TEST test_load_semiplanar_matches_planar()
+{
+  // NV21 frame of 70x38 with strides wider than the rows, loaded to a
+  // picture of the padded size.
+  const int width = 70;
+  const int height = 38;
+  const int stride = 80;
+  uint8_t *luma = malloc(stride * height);
+  uint8_t *chroma = malloc(stride * height / 2);
+  for (int i = 0; i < stride * height; i++) luma[i] = (uint8_t)rand();
+  for (int i = 0; i < stride * height / 2; i++) chroma[i] = (uint8_t)rand();
+
+  uvg_picture *pic = uvg_image_alloc(UVG_CSP_420, 72, 40);
+  ASSERT(pic);
+  ASSERT(uvg_image_load_semiplanar(NULL, pic, UVG_FORMAT_NV21, 8, luma, stride,
+                                   chroma, stride, width, height));
+
+  const int shift = UVG_BIT_DEPTH - 8;
+  for (int y = 0; y < pic->height; y++) {
+    for (int x = 0; x < pic->width; x++) {
+      const int sy = MIN(y, height - 1);
+      const int sx = MIN(x, width - 1);
+      ASSERT_EQ(luma[sy * stride + sx] << shift, pic->y[y * pic->stride + x]);
+    }
+  }
+  for (int y = 0; y < pic->height / 2; y++) {
+    for (int x = 0; x < pic->width / 2; x++) {
+      const int sy = MIN(y, height / 2 - 1);
+      const int sx = MIN(x, width / 2 - 1);
+      ASSERT_EQ(chroma[sy * stride + 2 * sx] << shift, pic->v[y * pic->chroma_stride + x]);
+      ASSERT_EQ(chroma[sy * stride + 2 * sx + 1] << shift, pic->u[y * pic->chroma_stride + x]);
+    }
+  }
+
+  // Frames larger than the picture and planar formats are rejected.
+  ASSERT(!uvg_image_load_semiplanar(NULL, pic, UVG_FORMAT_NV12, 8, luma, stride,
+                                    chroma, stride, 74, height));
+  ASSERT(!uvg_image_load_semiplanar(NULL, pic, UVG_FORMAT_P420, 8, luma, stride,
+                                    chroma, stride, width, height));
+
+  uvg_image_free(pic);
+  free(luma);
+  free(chroma);
+  PASS();
+}
+
+TEST test_load_planar_in_stripes()
+{
+  // 10-bit frame tall enough to be split to stripes, converted on worker
+  // threads and on the calling thread.
+  const int width = 100;
+  const int height = 150;
+  const int bitdepth = 10;
+  uint16_t *frame = malloc(width * height * 3 / 2 * sizeof(uint16_t));
+  for (int i = 0; i < width * height * 3 / 2; i++) {
+    // Little endian samples with garbage above the 10 bits.
+    const uint16_t sample = (uint16_t)rand();
+    ((uint8_t *)&frame[i])[0] = sample & 0xff;
+    ((uint8_t *)&frame[i])[1] = sample >> 8;
+  }
+  const uint16_t *planes[3] = {
+    frame, frame + width * height, frame + width * height * 5 / 4
+  };
+
+  threadqueue_queue_t *queues[2] = { NULL, uvg_threadqueue_init(2) };
+  ASSERT(queues[1]);
+  uvg_picture *pics[2];
+  for (int q = 0; q < 2; q++) {
+    pics[q] = uvg_image_alloc(UVG_CSP_420, 104, 152);
+    ASSERT(pics[q]);
+    ASSERT(uvg_image_load_planar(queues[q], pics[q], bitdepth,
+                                 (const uint8_t *)planes[0],
+                                 (const uint8_t *)planes[1],
+                                 (const uint8_t *)planes[2],
+                                 width * 2, width, width, height));
+  }
+  uvg_threadqueue_free(queues[1]);
+
+  for (int c = 0; c < 3; c++) {
+    const int w = c ? width / 2 : width;
+    const int h = c ? height / 2 : height;
+    const int pic_stride = c ? pics[0]->chroma_stride : pics[0]->stride;
+    const int pic_height = c ? pics[0]->height / 2 : pics[0]->height;
+    for (int y = 0; y < pic_height; y++) {
+      for (int x = 0; x < pic_stride; x++) {
+        const uint8_t *sample = (const uint8_t *)&planes[c][MIN(y, h - 1) * w + MIN(x, w - 1)];
+        const int value = (sample[0] | sample[1] << 8) & 0x3ff;
+        const int expected = UVG_BIT_DEPTH >= bitdepth
+                             ? value << (UVG_BIT_DEPTH - bitdepth)
+                             : value >> (bitdepth - UVG_BIT_DEPTH);
+        ASSERT_EQ(expected, pics[0]->data[c][y * pic_stride + x]);
+        ASSERT_EQ(expected, pics[1]->data[c][y * pic_stride + x]);
+      }
+    }
+  }
+
+  uvg_image_free(pics[0]);
+  uvg_image_free(pics[1]);
+  free(frame);
+  PASS();
+}
+
+SUITE(input_format_tests)
+{
+  setup();
+
+  for (volatile int i = 0; i < strategies.count; ++i) {
+    if (strcmp(strategies.strategies[i].type, "convert_8bit") == 0) {
+      convert_8bit = strategies.strategies[i].fptr;
+      RUN_TEST(test_convert_8bit);
+    } else if (strcmp(strategies.strategies[i].type, "convert_16bit") == 0) {
+      convert_16bit = strategies.strategies[i].fptr;
+      RUN_TEST(test_convert_16bit);
+    } else if (strcmp(strategies.strategies[i].type, "deinterleave_8bit") == 0) {
+      deinterleave_8bit = strategies.strategies[i].fptr;
+      RUN_TEST(test_deinterleave_8bit);
+    } else if (strcmp(strategies.strategies[i].type, "deinterleave_16bit") == 0) {
+      deinterleave_16bit = strategies.strategies[i].fptr;
+      RUN_TEST(test_deinterleave_16bit);
+    } else if (strcmp(strategies.strategies[i].type, "swap_16bit") == 0) {
+      swap_16bit = strategies.strategies[i].fptr;
+      RUN_TEST(test_swap_16bit);
+    }
+  }
+
+  RUN_TEST(test_load_semiplanar_matches_planar);
+  RUN_TEST(test_load_planar_in_stripes);
+}
@@ -0,0 +1,394 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+/**
+ * \file
+ * Compare the modes selected by the fixed point rough intra search with the
+ * same search done with floating point costs.
+ */
+
+#include "greatest/greatest.h"
+
+#include "src/cabac.h"
+#include "src/cfg.h"
+#include "src/context.h"
+#include "src/encoder.h"
+#include "src/encoderstate.h"
+#include "src/intra.h"
+#include "src/rdo.h"
+#include "src/search_intra.h"
+#include "src/strategies/strategies-picture.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Blocks searched per block size, context initialization and content
+#define NUM_BLOCKS 8
+// Largest number of modes selected by the rough search
+#define MAX_ROUGH_MODES 6
+
+typedef struct {
+  int8_t mip;
+  int8_t mrl;
+  int8_t isp;
+  int8_t levels;
+} rough_config_t;
+
+static const rough_config_t rough_configs[] = {
+  { 0, 0, 0, 2 },
+  { 1, 1, 1, 2 },
+  { 0, 0, 0, 0 },
+  { 0, 1, 0, 1 },
+  { 1, 0, 1, 4 },
+};
+
+static const int block_sizes[][2] = {
+  { 4, 4 }, { 8, 8 }, { 16, 16 }, { 32, 32 },
+  { 4, 8 }, { 8, 4 }, { 4, 16 }, { 16, 4 },
+  { 8, 32 }, { 32, 8 }, { 16, 32 }, { 32, 16 },
+};
+
+static const int8_t test_qps[] = { 22, 27, 32, 37 };
+
+static encoder_control_t rough_encoder;
+static encoder_state_t rough_state;
+static encoder_state_config_tile_t rough_tile;
+static videoframe_t rough_frame;
+static uint32_t rand_state;
+static char rough_msg[256];
+
+static uint32_t next_rand(void)
+{
+  rand_state = rand_state * 1103515245 + 12345;
+  return rand_state >> 16;
+}
+
+static void setup(const rough_config_t *config)
+{
+  memset(&rough_encoder, 0, sizeof(rough_encoder));
+  memset(&rough_state, 0, sizeof(rough_state));
+  memset(&rough_tile, 0, sizeof(rough_tile));
+  memset(&rough_frame, 0, sizeof(rough_frame));
+  uvg_config_init(&rough_encoder.cfg);
+  rough_encoder.cfg.mip = config->mip;
+  rough_encoder.cfg.mrl = config->mrl;
+  rough_encoder.cfg.isp = config->isp;
+  rough_encoder.cfg.intra_rough_search_levels = config->levels;
+  rough_encoder.bitdepth = UVG_BIT_DEPTH;
+  rough_encoder.chroma_format = UVG_CSP_420;
+  rough_frame.width = 128;
+  rough_frame.height = 128;
+  rough_tile.frame = &rough_frame;
+  rough_state.encoder_control = &rough_encoder;
+  rough_state.tile = &rough_tile;
+}
+
+/**
+ * \brief Parameters of a block of smooth content with an edge and noise.
+ */
+typedef struct {
+  double freq_x;
+  double freq_y;
+  double amp;
+  double edge_cos;
+  double edge_sin;
+  double edge_pos;
+  double edge_amp;
+  int noise;
+} natural_t;
+
+static uvg_pixel block_sample(const natural_t *n, int x, int y)
+{
+  if (!n) return next_rand() & 255;
+  const double edge = x * n->edge_cos + y * n->edge_sin > n->edge_pos ? n->edge_amp : -n->edge_amp;
+  const int noise = n->noise ? (int)(next_rand() % (2 * n->noise + 1)) - n->noise : 0;
+  const int v = (int)(128 + n->amp * sin(x * n->freq_x + y * n->freq_y) + edge) + noise;
+  return (uvg_pixel)CLIP(0, 255, v);
+}
+
+/**
+ * \brief Fill a block and its reference samples with random or natural
+ * looking content.
+ */
+static void fill_block(bool natural, int width, int height,
+                       uvg_pixel *orig, uvg_intra_references *refs)
+{
+  natural_t n;
+  const double angle = (next_rand() % 360) * M_PI / 180;
+  n.freq_x = (next_rand() % 100) / 400.0;
+  n.freq_y = (next_rand() % 100) / 400.0;
+  n.amp = next_rand() % 60;
+  n.edge_cos = cos(angle);
+  n.edge_sin = sin(angle);
+  n.edge_pos = (next_rand() % 48) - 8;
+  n.edge_amp = next_rand() % 50;
+  n.noise = next_rand() % 4;
+  const natural_t *const content = natural ? &n : NULL;
+
+  // The reference samples are the column left of and the row above the
+  // block, continuing its content.
+  memset(refs, 0, sizeof(*refs));
+  for (int i = 0; i < INTRA_REF_LENGTH; ++i) {
+    refs->ref.left[i] = block_sample(content, -1, i - 1);
+    refs->ref.top[i] = block_sample(content, i - 1, -1);
+  }
+  refs->ref.top[0] = refs->ref.left[0];
+
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      orig[y * width + x] = block_sample(content, x, y);
+    }
+  }
+}
+
+/**
+ * \brief Rough distortion of a mode, like get_cost_dual in search_intra.c.
+ */
+static unsigned rough_dist(uvg_intra_references *refs, const cu_loc_t *loc,
+                           const uvg_pixel *orig, const cu_info_t *pred_cu, int8_t mode)
+{
+  const int width = loc->width;
+  const int height = loc->height;
+  ALIGNED(64) uvg_pixel preds[2][32 * 32];
+  intra_search_data_t data;
+  memset(&data, 0, sizeof(data));
+  data.pred_cu = *pred_cu;
+  data.pred_cu.intra.mode = mode;
+  uvg_intra_predict(&rough_state, refs, loc, loc, COLOR_Y, preds[0], &data, NULL);
+  memcpy(preds[1], preds[0], width * height * sizeof(uvg_pixel));
+
+  cost_pixel_nxn_multi_func *const satd_dual_func = uvg_pixels_get_satd_dual_func(width, height);
+  cost_pixel_nxn_multi_func *const sad_dual_func = uvg_pixels_get_sad_dual_func(width, height);
+  unsigned satd[2] = { 0 };
+  unsigned sad[2] = { 0 };
+  if (satd_dual_func) {
+    satd_dual_func(preds, orig, 2, satd);
+  } else {
+    satd[0] = uvg_satd_any_size_vtm(width, height, orig, width, preds[0], width);
+  }
+  if (sad_dual_func) {
+    sad_dual_func(preds, orig, 2, sad);
+  } else {
+    sad[0] = uvg_reg_sad(preds[0], orig, width, height, width, width);
+  }
+  return MIN(satd[0], sad[0] * 2);
+}
+
+/**
+ * \brief Mode signaling bits, like count_bits in search_intra.c before it
+ * used fixed point.
+ */
+static double rough_bits(const int8_t *intra_preds, const double *flags, int8_t mode)
+{
+  enum { NOT_MRL, NOT_MIP, MPM, NOT_MPM, PLANAR, NOT_PLANAR, NOT_ISP };
+  int i = 0;
+  int smaller_than_pred = 0;
+  for (; i < INTRA_MPM_COUNT; i++) {
+    if (intra_preds[i] == mode) break;
+    if (mode > intra_preds[i]) smaller_than_pred += 1;
+  }
+  double bits;
+  if (i == 0) {
+    bits = flags[PLANAR] + flags[MPM];
+  } else if (i < INTRA_MPM_COUNT) {
+    bits = flags[NOT_PLANAR] + flags[MPM] + MIN(i, 4);
+  } else {
+    bits = flags[NOT_MPM] + 5 + (mode - smaller_than_pred > 2);
+  }
+  return bits + flags[NOT_MRL] + flags[NOT_MIP] + flags[NOT_ISP];
+}
+
+typedef struct {
+  int8_t mode;
+  double cost;
+} mode_cost_t;
+
+static void insert_mode(mode_cost_t *best, int size, int8_t mode, double cost)
+{
+  for (int j = 0; j < size; j++) {
+    if (cost < best[j].cost) {
+      for (int k = size - 1; k > j; k--) {
+        best[k] = best[k - 1];
+      }
+      best[j].cost = cost;
+      best[j].mode = mode;
+      return;
+    }
+  }
+}
+
+/**
+ * \brief The rough intra search with floating point costs.
+ *
+ * Tests the same modes in the same order as uvg_search_intra_rough did
+ * before its costs were changed to fixed point.
+ *
+ * \return number of modes in best
+ */
+static int rough_search_double(uvg_intra_references *refs, const cu_loc_t *loc,
+                               const uvg_pixel *orig, const int8_t *intra_preds,
+                               const cu_info_t *pred_cu, uint8_t mip_ctx,
+                               mode_cost_t *best)
+{
+  const uvg_config *const cfg = &rough_encoder.cfg;
+  const cabac_data_t *const cabac = &rough_state.search_cabac;
+  const double flags[] = {
+    cfg->mrl && (loc->y % LCU_WIDTH) ? CTX_ENTROPY_FBITS(&cabac->ctx.multi_ref_line[0], 0) : 0,
+    cfg->mip ? CTX_ENTROPY_FBITS(&cabac->ctx.mip_flag[mip_ctx], 0) : 0,
+    CTX_ENTROPY_FBITS(&cabac->ctx.intra_luma_mpm_flag_model, 1),
+    CTX_ENTROPY_FBITS(&cabac->ctx.intra_luma_mpm_flag_model, 0),
+    CTX_ENTROPY_FBITS(&cabac->ctx.luma_planar_model[1], 0),
+    CTX_ENTROPY_FBITS(&cabac->ctx.luma_planar_model[1], 1),
+    cfg->isp && uvg_can_use_isp(loc->width, loc->height) ?
+      CTX_ENTROPY_FBITS(&cabac->ctx.intra_subpart_model[0], 0) : 0,
+  };
+
+  double costs[UVG_NUM_INTRA_MODES];
+  for (int8_t mode = 0; mode < UVG_NUM_INTRA_MODES; mode++) {
+    costs[mode] = rough_dist(refs, loc, orig, pred_cu, mode) +
+                  rough_bits(intra_preds, flags, mode) * rough_state.lambda_sqrt;
+  }
+
+  const int size = cfg->mip ? 6 : 3;
+  bool mode_checked[UVG_NUM_INTRA_MODES] = { 0 };
+  mode_checked[0] = true;
+  mode_checked[1] = true;
+  const bool planar_first = costs[0] < costs[1];
+  best[0] = (mode_cost_t){ planar_first ? 0 : 1, planar_first ? costs[0] : costs[1] };
+  best[1] = (mode_cost_t){ planar_first ? 1 : 0, planar_first ? costs[1] : costs[0] };
+  for (int i = 2; i < MAX_ROUGH_MODES; i++) best[i].cost = MAX_DOUBLE;
+  double min_cost = best[0].cost;
+  double max_cost = best[1].cost;
+
+  int offset = 1 << cfg->intra_rough_search_levels;
+  for (int mode = 2 + offset / 2; mode <= 66; mode += 2 * offset) {
+    for (int i = 0; i < 2; ++i) {
+      const int8_t mode_i = mode + i * offset;
+      if (mode_i > 66) continue;
+      mode_checked[mode_i] = true;
+      min_cost = MIN(min_cost, costs[mode_i]);
+      max_cost = MAX(max_cost, costs[mode_i]);
+      insert_mode(best, size, mode_i, costs[mode_i]);
+    }
+  }
+  offset >>= 1;
+  if (min_cost != max_cost) {
+    for (; offset > 0; offset >>= 1) {
+      int8_t modes_to_check[12];
+      int num_modes_to_check = 0;
+      for (int i = 0; i < size; i++) {
+        const int8_t center = best[i].mode;
+        if (center < 3 || center > 65) continue;
+        const int8_t test_modes[] = { center - offset, center + offset };
+        for (int j = 0; j < 2; j++) {
+          if (test_modes[j] >= 2 && test_modes[j] <= 66 && !mode_checked[test_modes[j]]) {
+            modes_to_check[num_modes_to_check++] = test_modes[j];
+            mode_checked[test_modes[j]] = true;
+          }
+        }
+      }
+      for (int i = 0; i < num_modes_to_check; i++) {
+        insert_mode(best, size, modes_to_check[i], costs[modes_to_check[i]]);
+      }
+    }
+  }
+  return size;
+}
+
+TEST test_rough_search_matches_double(const int config_idx)
+{
+  setup(&rough_configs[config_idx]);
+  rand_state = 1 + config_idx;
+
+  for (int s = 0; s < (int)(sizeof(block_sizes) / sizeof(block_sizes[0])); s++) {
+    const int width = block_sizes[s][0];
+    const int height = block_sizes[s][1];
+    cu_loc_t loc;
+    uvg_cu_loc_ctor(&loc, 32, 32 + (s & 1) * 32, width, height);
+
+    for (int q = 0; q < (int)(sizeof(test_qps) / sizeof(test_qps[0])); q++) {
+      const int8_t qp = test_qps[q];
+      uvg_init_contexts(&rough_state, qp, q & 1 ? UVG_SLICE_B : UVG_SLICE_I);
+      rough_state.search_cabac.ctx = rough_state.cabac.ctx;
+      // Lambdas of the QP and in between them.
+      rough_state.lambda_sqrt = sqrt(0.57 * pow(2.0, (qp - 12 + (q & 1)) / 3.0));
+
+      for (int kind = 0; kind < 2; kind++) {
+        for (int b = 0; b < NUM_BLOCKS; b++) {
+          ALIGNED(64) uvg_pixel orig[32 * 32];
+          uvg_intra_references refs;
+          fill_block(kind, width, height, orig, &refs);
+
+          cu_info_t left;
+          cu_info_t above;
+          cu_info_t pred_cu;
+          memset(&left, 0, sizeof(left));
+          memset(&above, 0, sizeof(above));
+          memset(&pred_cu, 0, sizeof(pred_cu));
+          left.type = CU_INTRA;
+          left.intra.mode = next_rand() % UVG_NUM_INTRA_MODES;
+          above.type = CU_INTRA;
+          above.intra.mode = next_rand() % UVG_NUM_INTRA_MODES;
+          pred_cu.type = CU_INTRA;
+          int8_t intra_preds[INTRA_MPM_COUNT];
+          uvg_intra_get_dir_luma_predictor(loc.x, loc.y, intra_preds, &pred_cu, &left, &above);
+          const uint8_t mip_ctx = next_rand() % 3;
+
+          intra_search_data_t modes[MAX_ROUGH_MODES];
+          const int num_modes = uvg_search_intra_rough(&rough_state, &loc, orig, width, &refs, NULL,
+                                                       width, height, intra_preds, modes,
+                                                       &pred_cu, mip_ctx);
+          mode_cost_t expected[MAX_ROUGH_MODES];
+          const int num_expected = rough_search_double(&refs, &loc, orig, intra_preds,
+                                                       &pred_cu, mip_ctx, expected);
+
+          sprintf(rough_msg, "%dx%d qp %d %s block %d", width, height, qp,
+                  kind ? "natural" : "random", b);
+          ASSERT_EQm(rough_msg, num_expected, num_modes);
+          for (int i = 0; i < num_modes; i++) {
+            ASSERT_EQm(rough_msg, expected[i].mode, modes[i].pred_cu.intra.mode);
+            ASSERT_IN_RANGEm(rough_msg, expected[i].cost, modes[i].cost, 64.0 / (1 << RD_COST_FRAC_BITS));
+          }
+        }
+      }
+    }
+  }
+  PASS();
+}
+
+SUITE(intra_rough_tests)
+{
+  for (int i = 0; i < (int)(sizeof(rough_configs) / sizeof(rough_configs[0])); i++) {
+    RUN_TEST1(test_rough_search_matches_double, i);
+  }
+}
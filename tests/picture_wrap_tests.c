@@ -0,0 +1,245 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "greatest/greatest.h"
+
+#include "src/image.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+static int release_count;
+
+static void count_release(void *opaque)
+{
+  release_count += *(int *)opaque;
+}
+
+TEST test_wrap_release()
+{
+  uvg_pixel planes[64 * 16 + 2 * 40 * 8];
+  int weight = 1;
+  release_count = 0;
+
+  uvg_picture *pic = uvg_image_wrap(UVG_CSP_420, 32, 16,
+                                    planes, planes + 64 * 16, planes + 64 * 16 + 40 * 8,
+                                    64, 40, count_release, &weight);
+  ASSERT(pic);
+  ASSERT_EQ(planes, pic->y);
+  ASSERT_EQ(64, pic->stride);
+  ASSERT_EQ(40, pic->chroma_stride);
+  ASSERT_EQ(NULL, pic->fulldata_buf);
+  ASSERT(!uvg_image_is_encodable(pic, 32, 16));
+
+  uvg_picture *ref = uvg_image_copy_ref(pic);
+  uvg_image_free(pic);
+  ASSERT_EQ(0, release_count);
+  uvg_image_free(ref);
+  ASSERT_EQ(1, release_count);
+
+  // Strides smaller than the widths are rejected.
+  ASSERT_EQ(NULL, uvg_image_wrap(UVG_CSP_420, 32, 16, planes, planes, planes,
+                                 30, 16, NULL, NULL));
+  ASSERT_EQ(NULL, uvg_image_wrap(UVG_CSP_420, 32, 16, planes, planes, planes,
+                                 32, 15, NULL, NULL));
+  PASS();
+}
+
+#define ENC_FRAMES 3
+
+/**
+ * \brief Sample of a test frame, smooth enough to be predicted.
+ */
+static uvg_pixel test_sample(int frame, int c, int x, int y)
+{
+  return (uvg_pixel)(((x + 2 * frame) * (c + 3) + (y - frame) * (y + x) / 8 + c * 50) & 0xff);
+}
+
+/**
+ * \brief Fill a plane like a frame read from a file, extending the last
+ *        column to the stride and the last row to out_height.
+ */
+static void fill_padded(uvg_pixel *dst, int stride, int width, int height,
+                        int out_height, int frame, int c)
+{
+  for (int y = 0; y < out_height; y++) {
+    for (int x = 0; x < stride; x++) {
+      dst[y * stride + x] = test_sample(frame, c, MIN(x, width - 1), MIN(y, height - 1));
+    }
+  }
+}
+
+/**
+ * \brief Encode test frames and return the bitstream.
+ *
+ * \param wrap            0 to copy the frames to pictures of the encoder,
+ *                        otherwise the luma stride of wrapped planes
+ * \param chroma_stride   chroma stride of wrapped planes
+ */
+static uint8_t *encode_test_frames(const char *const *opts, int width, int height,
+                                   int wrap, int chroma_stride, size_t *len)
+{
+  const uvg_api *const api = uvg_api_get(UVG_BIT_DEPTH);
+  uvg_config *cfg = api->config_alloc();
+  api->config_init(cfg);
+  cfg->width = width;
+  cfg->height = height;
+  cfg->threads = 0;
+  cfg->owf = 0;
+  cfg->add_encoder_info = 0;
+  for (int i = 0; opts[i]; i += 2) {
+    if (!api->config_parse(cfg, opts[i], opts[i + 1])) return NULL;
+  }
+  uvg_encoder *enc = api->encoder_open(cfg);
+  if (!enc) return NULL;
+
+  // Wrapped planes are made read-only to check that they are not written.
+  const size_t plane_bytes =
+    ((size_t)wrap * height + (size_t)chroma_stride * height) * sizeof(uvg_pixel);
+  uvg_pixel *planes[ENC_FRAMES] = { NULL };
+
+  uint8_t *out = NULL;
+  *len = 0;
+  for (int frame = 0; ; frame++) {
+    uvg_picture *pic = NULL;
+    if (frame < ENC_FRAMES && wrap) {
+#ifdef __linux__
+      planes[frame] = mmap(NULL, plane_bytes, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#else
+      planes[frame] = malloc(plane_bytes);
+#endif
+      uvg_pixel *const y = planes[frame];
+      uvg_pixel *const u = y + wrap * height;
+      uvg_pixel *const v = u + chroma_stride * height / 2;
+      // The part of the rows past the width is not read by the encoder.
+      memset(y, 0xaa, plane_bytes);
+      for (int py = 0; py < height; py++) {
+        for (int px = 0; px < width; px++) {
+          y[py * wrap + px] = test_sample(frame, 0, px, py);
+          if (px < width / 2 && py < height / 2) {
+            u[py * chroma_stride + px] = test_sample(frame, 1, px, py);
+            v[py * chroma_stride + px] = test_sample(frame, 2, px, py);
+          }
+        }
+      }
+#ifdef __linux__
+      mprotect(y, plane_bytes, PROT_READ);
+#endif
+      pic = api->picture_wrap(UVG_CSP_420, width, height, y, u, v, wrap, chroma_stride, NULL, NULL);
+    } else if (frame < ENC_FRAMES) {
+      const int padded_width = CEILDIV(width, 8) * 8;
+      const int padded_height = CEILDIV(height, 8) * 8;
+      pic = api->picture_alloc(padded_width, padded_height);
+      fill_padded(pic->y, pic->stride, width, height, padded_height, frame, 0);
+      fill_padded(pic->u, pic->stride / 2, width / 2, height / 2, padded_height / 2, frame, 1);
+      fill_padded(pic->v, pic->stride / 2, width / 2, height / 2, padded_height / 2, frame, 2);
+    }
+
+    uvg_data_chunk *chunks = NULL;
+    uint32_t chunks_len = 0;
+    if (!api->encoder_encode(enc, pic, &chunks, &chunks_len, NULL, NULL, NULL)) break;
+    api->picture_free(pic);
+    if (!chunks && frame >= ENC_FRAMES) break;
+
+    out = realloc(out, *len + chunks_len);
+    for (uvg_data_chunk *chunk = chunks; chunk; chunk = chunk->next) {
+      memcpy(out + *len, chunk->data, chunk->len);
+      *len += chunk->len;
+    }
+    api->chunk_free(chunks);
+  }
+
+  api->encoder_close(enc);
+  api->config_destroy(cfg);
+  for (int i = 0; i < ENC_FRAMES; i++) {
+#ifdef __linux__
+    if (planes[i]) munmap(planes[i], plane_bytes);
+#else
+    free(planes[i]);
+#endif
+  }
+  return out;
+}
+
+static const char *const wrap_opts[][9] = {
+  { "preset", "ultrafast", NULL },
+  { "preset", "medium", "alf", "full", NULL },
+  { "preset", "ultrafast", "lmcs", "1", "vaq", "5", NULL },
+  { "preset", "ultrafast", "tiles", "2x1", "sao", "full", NULL },
+  { "preset", "ultrafast", "lossless", "1", NULL },
+};
+
+static bool encodes_same(const char *const *opts, int width, int height,
+                         int luma_stride, int chroma_stride)
+{
+  size_t ref_len = 0, wrap_len = 0;
+  uint8_t *ref = encode_test_frames(opts, width, height, 0, 0, &ref_len);
+  uint8_t *wrapped = encode_test_frames(opts, width, height, luma_stride, chroma_stride, &wrap_len);
+  const bool same = ref && wrapped && ref_len == wrap_len && !memcmp(ref, wrapped, ref_len);
+  free(ref);
+  free(wrapped);
+  return same;
+}
+
+/**
+ * \brief Check that wrapped planes give the same bitstream as frames copied
+ *        to pictures of the encoder.
+ */
+TEST test_wrapped_input_encodes_same(const int opts_idx)
+{
+  // Encoded directly from the planes.
+  ASSERT(encodes_same(wrap_opts[opts_idx], 128, 64, 160, 80));
+  // Copied because the chroma stride is not half of the luma stride.
+  ASSERT(encodes_same(wrap_opts[opts_idx], 128, 64, 150, 72));
+  PASS();
+}
+
+TEST test_wrapped_input_is_padded()
+{
+  // Copied and padded to 128x72.
+  ASSERT(encodes_same(wrap_opts[0], 128, 66, 160, 80));
+  PASS();
+}
+
+SUITE(picture_wrap_tests)
+{
+  RUN_TEST(test_wrap_release);
+  for (int i = 0; i < sizeof(wrap_opts) / sizeof(wrap_opts[0]); i++) {
+    RUN_TEST1(test_wrapped_input_encodes_same, i);
+  }
+  RUN_TEST(test_wrapped_input_is_padded);
+}
@@ -0,0 +1,125 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+
+#include "greatest/greatest.h"
+
+#include "src/rdo.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+static const double test_lambdas[] = { 0.5, 4.7, 13.1, 57.9, 240.3 };
+
+static double rd_cost_double(unsigned dist, uint32_t bits, double lambda)
+{
+  return dist + (double)bits / CTX_FRAC_ONE_BIT * lambda;
+}
+
+TEST test_rd_cost_fx_matches_double()
+{
+  srand(7);
+  for (int l = 0; l < (int)(sizeof(test_lambdas) / sizeof(test_lambdas[0])); l++) {
+    const double lambda = test_lambdas[l];
+    const int64_t lambda_fx = uvg_lambda_to_fx(lambda);
+    for (int i = 0; i < 10000; i++) {
+      const unsigned dist = rand() % (64 * 64 * 255);
+      const uint32_t bits = rand() % (64 << CTX_FRAC_BITS);
+      const double expected = rd_cost_double(dist, bits, lambda);
+      const double actual = uvg_rd_cost_fx_to_double(uvg_rd_cost_fx(dist, bits, lambda_fx));
+      // Error comes from rounding lambda and the product to RD_COST_FRAC_BITS.
+      ASSERT_IN_RANGE(expected, actual, 64.0 / (1 << RD_COST_FRAC_BITS));
+    }
+  }
+  PASS();
+}
+
+TEST test_rd_cost_fx_preserves_order()
+{
+  srand(11);
+  for (int l = 0; l < (int)(sizeof(test_lambdas) / sizeof(test_lambdas[0])); l++) {
+    const double lambda = test_lambdas[l];
+    const int64_t lambda_fx = uvg_lambda_to_fx(lambda);
+    for (int i = 0; i < 10000; i++) {
+      const unsigned dist[2] = { rand() % 4096, rand() % 4096 };
+      const uint32_t bits[2] = { rand() % (16 << CTX_FRAC_BITS), rand() % (16 << CTX_FRAC_BITS) };
+      const double a = rd_cost_double(dist[0], bits[0], lambda);
+      const double b = rd_cost_double(dist[1], bits[1], lambda);
+      // Costs closer than the fixed point precision may go either way.
+      if (fabs(a - b) < 64.0 / (1 << RD_COST_FRAC_BITS)) continue;
+      const rd_cost_fx_t a_fx = uvg_rd_cost_fx(dist[0], bits[0], lambda_fx);
+      const rd_cost_fx_t b_fx = uvg_rd_cost_fx(dist[1], bits[1], lambda_fx);
+      ASSERT_EQ(a < b, a_fx < b_fx);
+    }
+  }
+  PASS();
+}
+
+TEST test_rd_cost_fx_exact_bits()
+{
+  // The integer entropy table must give exactly the floating point bits
+  // so that fixed point search makes the same decisions.
+  for (int i = 0; i < 512; i++) {
+    ASSERT_EQ((double)uvg_f_entropy_bits[i] * CTX_FRAC_ONE_BIT, (double)uvg_entropy_bits[i]);
+  }
+  PASS();
+}
+
+TEST test_rd_cost_fx_range()
+{
+  // The rough intra search passes an unsigned SATD or SAD and at most a few
+  // tens of bits. The cost must stay non-negative and grow with both terms
+  // up to the largest inputs, or the comparisons of the search would flip.
+  const unsigned dists[] = { 0, 1, 64 * 64 * 1023, UINT32_MAX - 1 };
+  const uint32_t bits[] = { 0, 1, 64 << CTX_FRAC_BITS, (1 << 24) - 1 };
+  const double lambdas[] = { 0.0, 0.5, 300.0, 10000.0 };
+  for (int l = 0; l < (int)(sizeof(lambdas) / sizeof(lambdas[0])); l++) {
+    const int64_t lambda_fx = uvg_lambda_to_fx(lambdas[l]);
+    for (int d = 0; d < (int)(sizeof(dists) / sizeof(dists[0])); d++) {
+      for (int b = 0; b < (int)(sizeof(bits) / sizeof(bits[0])); b++) {
+        const rd_cost_fx_t cost = uvg_rd_cost_fx(dists[d], bits[b], lambda_fx);
+        ASSERT(cost >= 0);
+        ASSERT(uvg_rd_cost_fx(dists[d] + 1, bits[b], lambda_fx) > cost);
+        ASSERT(uvg_rd_cost_fx(dists[d], bits[b] + 1, lambda_fx) >= cost);
+      }
+    }
+  }
+  PASS();
+}
+
+SUITE(rd_cost_tests)
+{
+  RUN_TEST(test_rd_cost_fx_matches_double);
+  RUN_TEST(test_rd_cost_fx_preserves_order);
+  RUN_TEST(test_rd_cost_fx_exact_bits);
+  RUN_TEST(test_rd_cost_fx_range);
+}
@@ -0,0 +1,44 @@
+#!/bin/sh
+
+# Test searching the split types of a CU in separate jobs.
+
+set -eu
+. "${0%/*}/util.sh"
+
+serialfile="$(mktemp)"
+jobsfile="$(mktemp)"
+trap 'cleanup; rm -rf "${serialfile}" "${jobsfile}"' EXIT
+
+common_args='264x130 10 yuv420p --preset=ultrafast --no-cpuid --no-wpp --owf=1 --no-cclm'
+
+valgrind_test $common_args --threads=0 --split-jobs=1
+valgrind_test $common_args --threads=2 --split-jobs=2 --mtt-depth-intra 1
+valgrind_test $common_args --threads=2 --split-jobs=3 --rd=3 --mtt-depth-inter 2 --pu-depth-inter 0-3
+
+# The results of the jobs are merged so that the output is the same as with
+# the serial search for any number of threads.
+compare_split_jobs() {
+    dimensions="$1"
+    shift
+    frames="$1"
+    shift
+
+    prepare "${dimensions}" "${frames}" yuv420p
+
+    print_and_run \
+        ../bin/uvg266 -i "${yuvfile}" "--input-res=${dimensions}" -o "${serialfile}" "$@" \
+            --threads=0 --split-jobs=0
+    for split_jobs in 1 3; do
+        for threads in 0 3; do
+            print_and_run \
+                ../bin/uvg266 -i "${yuvfile}" "--input-res=${dimensions}" -o "${jobsfile}" "$@" \
+                    "--threads=${threads}" "--split-jobs=${split_jobs}"
+            print_and_run cmp "${serialfile}" "${jobsfile}"
+        done
+    done
+}
+
+compare_args='--no-cpuid --no-wpp --owf=1 --no-cclm --no-info'
+compare_split_jobs 264x130 8 --preset=ultrafast $compare_args --mtt-depth-intra 2
+compare_split_jobs 264x130 8 --preset=ultrafast $compare_args --rd=3 --gop=8 --mtt-depth-inter 2 --pu-depth-inter 0-3
+compare_split_jobs 264x130 8 --preset=veryfast $compare_args --mtt-depth-intra 3 --pu-depth-intra 0-8 --lfnst --jccr --dual-tree
@@ -11,6 +11,12 @@ valgrind_test $common_args --no-rdoq --no-deblock --no-sao --no-signhide --subme
 valgrind_test $common_args --no-rdoq --no-signhide --subme=0 --bipred
 valgrind_test $common_args --rdoq --no-deblock --no-sao --subme=0
 valgrind_test $common_args --gop=8 --subme=4 --bipred --tmvp
+valgrind_test $common_args --gop=8 --ref=4 --bipred --ref-jobs
+valgrind_test $common_args --gop=8 --owf=3 --adaptive-owf
+valgrind_test $common_args --gop=8 --owf=3 --trace-file=/dev/null
+valgrind_test $common_args --gop=8 --owf=3 --thread-spin=1000
+valgrind_test $common_args --gop=8 --owf=3 --thread-affinity=nodes
+valgrind_test $common_args --gop=8 --owf=3 --hugepages
 valgrind_test $common_args --transform-skip --tr-skip-max-size=5
 valgrind_test $common_args --vaq=8
 valgrind_test $common_args --vaq=8 --bitrate 350000
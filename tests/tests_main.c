@@ -45,6 +45,23 @@ extern SUITE(mts_tests);
 #endif //UVG_BIT_DEPTH == 8
 
 extern SUITE(coeff_sum_tests);
+extern SUITE(input_format_tests);
+extern SUITE(gradient_tests);
+extern SUITE(fast_coeff_cost_tests);
+extern SUITE(rd_cost_tests);
+extern SUITE(intra_rough_tests);
+extern SUITE(cabac_journal_tests);
+extern SUITE(cabac_journal_speed_tests);
+extern SUITE(threadqueue_tests);
+extern SUITE(image_pool_tests);
+extern SUITE(bitstream_tests);
+extern SUITE(picture_wrap_tests);
+extern SUITE(transform_cache_tests);
+extern SUITE(transform_cache_speed_tests);
+extern SUITE(async_encode_tests);
+extern SUITE(threadqueue_speed_tests);
+extern SUITE(hugepages_tests);
+extern SUITE(hugepages_speed_tests);
 extern SUITE(mv_cand_tests);
 extern SUITE(inter_recon_bipred_tests);
 
@@ -70,6 +87,41 @@ int main(int argc, char **argv)
 #endif //UVG_BIT_DEPTH == 8
 
   RUN_SUITE(coeff_sum_tests);
+  RUN_SUITE(input_format_tests);
+
+  RUN_SUITE(gradient_tests);
+
+  RUN_SUITE(fast_coeff_cost_tests);
+  RUN_SUITE(rd_cost_tests);
+  RUN_SUITE(intra_rough_tests);
+  RUN_SUITE(cabac_journal_tests);
+  if (greatest_info.suite_filter &&
+      greatest_name_match("speed", greatest_info.suite_filter))
+  {
+    RUN_SUITE(cabac_journal_speed_tests);
+  }
+  RUN_SUITE(threadqueue_tests);
+  RUN_SUITE(image_pool_tests);
+  RUN_SUITE(bitstream_tests);
+  RUN_SUITE(picture_wrap_tests);
+  RUN_SUITE(transform_cache_tests);
+  if (greatest_info.suite_filter &&
+      greatest_name_match("speed", greatest_info.suite_filter))
+  {
+    RUN_SUITE(transform_cache_speed_tests);
+  }
+  RUN_SUITE(async_encode_tests);
+  if (greatest_info.suite_filter &&
+      greatest_name_match("speed", greatest_info.suite_filter))
+  {
+    RUN_SUITE(threadqueue_speed_tests);
+  }
+  RUN_SUITE(hugepages_tests);
+  if (greatest_info.suite_filter &&
+      greatest_name_match("speed", greatest_info.suite_filter))
+  {
+    RUN_SUITE(hugepages_speed_tests);
+  }
 
   RUN_SUITE(mv_cand_tests);
 
@@ -0,0 +1,281 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+#include "greatest/greatest.h"
+
+#include "src/threadqueue.h"
+#include "src/threads.h"
+
+#include <stdlib.h>
+
+#define NUM_JOBS 8
+
+static uvg_sem_t gate;
+static int run_order[NUM_JOBS];
+static int32_t num_run;
+
+static void gate_job(void *arg)
+{
+  uvg_sem_wait(&gate);
+}
+
+static void record_job(void *arg)
+{
+  const int32_t pos = UVG_ATOMIC_INC(&num_run) - 1;
+  run_order[pos] = (int)(intptr_t)arg;
+}
+
+/**
+ * \brief Submit jobs while the only worker is blocked and record the order
+ * in which they are run.
+ */
+static void run_jobs(const int64_t *priorities)
+{
+  threadqueue_queue_t *queue = uvg_threadqueue_init(1);
+  threadqueue_job_t *jobs[NUM_JOBS];
+  uvg_sem_init(&gate, 0);
+  num_run = 0;
+
+  threadqueue_job_t *blocker = uvg_threadqueue_job_create(gate_job, NULL);
+  uvg_threadqueue_job_set_priority(blocker, INT64_MAX);
+  uvg_threadqueue_submit(queue, blocker);
+
+  for (int i = 0; i < NUM_JOBS; i++) {
+    jobs[i] = uvg_threadqueue_job_create(record_job, (void *)(intptr_t)i);
+    uvg_threadqueue_job_set_priority(jobs[i], priorities[i]);
+    uvg_threadqueue_submit(queue, jobs[i]);
+  }
+
+  uvg_sem_post(&gate);
+  for (int i = 0; i < NUM_JOBS; i++) {
+    uvg_threadqueue_waitfor(queue, jobs[i]);
+    uvg_threadqueue_free_job(&jobs[i]);
+  }
+  uvg_threadqueue_waitfor(queue, blocker);
+  uvg_threadqueue_free_job(&blocker);
+  uvg_threadqueue_free(queue);
+  uvg_sem_destroy(&gate);
+}
+
+TEST test_highest_priority_first()
+{
+  const int64_t priorities[NUM_JOBS] = { -5, 3, -1, 7, 0, -(INT64_C(1) << 40), 2, 1 };
+  const int expected[NUM_JOBS] = { 3, 1, 6, 7, 4, 2, 0, 5 };
+  run_jobs(priorities);
+
+  ASSERT_EQ(NUM_JOBS, num_run);
+  for (int i = 0; i < NUM_JOBS; i++) {
+    ASSERT_EQ(expected[i], run_order[i]);
+  }
+  PASS();
+}
+
+TEST test_same_priority_in_submit_order()
+{
+  const int64_t priorities[NUM_JOBS] = { 0, -1, 0, -1, 0, -1, 0, -1 };
+  const int expected[NUM_JOBS] = { 0, 2, 4, 6, 1, 3, 5, 7 };
+  run_jobs(priorities);
+
+  ASSERT_EQ(NUM_JOBS, num_run);
+  for (int i = 0; i < NUM_JOBS; i++) {
+    ASSERT_EQ(expected[i], run_order[i]);
+  }
+  PASS();
+}
+
+#define NUM_DEPENDENTS 50
+
+static int32_t num_run_before_last;
+
+static void count_job(void *arg)
+{
+  UVG_ATOMIC_INC(&num_run);
+}
+
+static void last_job(void *arg)
+{
+  num_run_before_last = num_run;
+}
+
+/**
+ * \brief Run more jobs depending on a single job than fit in the job, and
+ * a job depending on all of them.
+ */
+TEST test_many_dependents()
+{
+  threadqueue_queue_t *queue = uvg_threadqueue_init(2);
+  threadqueue_job_t *jobs[NUM_DEPENDENTS];
+  uvg_sem_init(&gate, 0);
+  num_run = 0;
+  num_run_before_last = -1;
+
+  threadqueue_job_t *first = uvg_threadqueue_job_create(gate_job, NULL);
+  threadqueue_job_t *last = uvg_threadqueue_job_create(last_job, NULL);
+  for (int i = 0; i < NUM_DEPENDENTS; i++) {
+    jobs[i] = uvg_threadqueue_job_create(count_job, NULL);
+    uvg_threadqueue_job_dep_add(jobs[i], first);
+    uvg_threadqueue_job_dep_add(last, jobs[i]);
+    uvg_threadqueue_submit(queue, jobs[i]);
+  }
+  uvg_threadqueue_submit(queue, last);
+  uvg_threadqueue_submit(queue, first);
+
+  ASSERT_EQ(0, num_run);
+  uvg_sem_post(&gate);
+  uvg_threadqueue_waitfor(queue, last);
+  ASSERT_EQ(NUM_DEPENDENTS, num_run_before_last);
+
+  for (int i = 0; i < NUM_DEPENDENTS; i++) {
+    uvg_threadqueue_free_job(&jobs[i]);
+  }
+  uvg_threadqueue_free_job(&first);
+  uvg_threadqueue_free_job(&last);
+  uvg_threadqueue_free(queue);
+  uvg_sem_destroy(&gate);
+  PASS();
+}
+
+SUITE(threadqueue_tests)
+{
+  RUN_TEST(test_highest_priority_first);
+  RUN_TEST(test_same_priority_in_submit_order);
+  RUN_TEST(test_many_dependents);
+}
+
+
+#define WAKE_STAGES 10000
+#define WAKE_WORKERS 4
+
+static char chain_msg[256];
+
+static void empty_job(void *arg)
+{
+}
+
+/**
+ * \brief Measure the time it takes for an idle worker to start a new job.
+ *
+ * Both jobs of a stage depend on both jobs of the previous stage. The
+ * worker that finishes a stage runs one of the new jobs itself, so the
+ * other one has to be started by a worker that is spinning or sleeping.
+ */
+TEST test_wake_latency(const int max_spin)
+{
+  threadqueue_queue_t *queue = uvg_threadqueue_init(WAKE_WORKERS);
+  ASSERT(queue);
+  ASSERT(uvg_threadqueue_set_spin(queue, max_spin));
+
+  threadqueue_job_t **jobs = malloc(WAKE_STAGES * 2 * sizeof(*jobs));
+  ASSERT(jobs);
+  for (int i = 0; i < WAKE_STAGES * 2; i++) {
+    jobs[i] = uvg_threadqueue_job_create(empty_job, NULL);
+    if (i >= 2) {
+      const int prev_stage = (i / 2 - 1) * 2;
+      uvg_threadqueue_job_dep_add(jobs[i], jobs[prev_stage]);
+      uvg_threadqueue_job_dep_add(jobs[i], jobs[prev_stage + 1]);
+    }
+  }
+  // Submit the waiting jobs first so that the stages run without the
+  // submitting thread.
+  for (int i = WAKE_STAGES * 2 - 1; i >= 2; i--) {
+    uvg_threadqueue_submit(queue, jobs[i]);
+  }
+
+  UVG_CLOCK_T start, stop;
+  UVG_GET_TIME(&start);
+  uvg_threadqueue_submit(queue, jobs[0]);
+  uvg_threadqueue_submit(queue, jobs[1]);
+  uvg_threadqueue_waitfor(queue, jobs[WAKE_STAGES * 2 - 2]);
+  uvg_threadqueue_waitfor(queue, jobs[WAKE_STAGES * 2 - 1]);
+  UVG_GET_TIME(&stop);
+
+  for (int i = 0; i < WAKE_STAGES * 2; i++) {
+    uvg_threadqueue_free_job(&jobs[i]);
+  }
+  free(jobs);
+  uvg_threadqueue_free(queue);
+
+  sprintf(chain_msg, "%.2f us per stage, spin %d",
+          UVG_CLOCK_T_DIFF(start, stop) * 1e6 / WAKE_STAGES, max_spin);
+  PASSm(chain_msg);
+}
+
+// Number of 64x64 CTUs in a 3840x2160 frame
+#define FRAME_CTUS (60 * 34)
+
+/**
+ * \brief Measure creating the jobs of the CTUs of a frame with the
+ * dependencies of wavefront search and freeing them.
+ *
+ * A queue exists during the measurement like in an encoder, so the job
+ * pool keeps its slabs between the frames.
+ */
+TEST test_job_setup_time()
+{
+  threadqueue_job_t **jobs = malloc(FRAME_CTUS * sizeof(*jobs));
+  ASSERT(jobs);
+  threadqueue_queue_t *queue = uvg_threadqueue_init(0);
+  ASSERT(queue);
+  const int width = 60;
+  const int frames = 100;
+
+  UVG_CLOCK_T start, stop;
+  UVG_GET_TIME(&start);
+  for (int frame = 0; frame < frames; frame++) {
+    for (int i = 0; i < FRAME_CTUS; i++) {
+      jobs[i] = uvg_threadqueue_job_create(empty_job, NULL);
+      if (i % width > 0) uvg_threadqueue_job_dep_add(jobs[i], jobs[i - 1]);
+      if (i >= width) uvg_threadqueue_job_dep_add(jobs[i], jobs[i - width]);
+      if (i >= width && i % width < width - 1) {
+        uvg_threadqueue_job_dep_add(jobs[i], jobs[i - width + 1]);
+      }
+    }
+    for (int i = 0; i < FRAME_CTUS; i++) {
+      uvg_threadqueue_free_job(&jobs[i]);
+    }
+  }
+  UVG_GET_TIME(&stop);
+  free(jobs);
+  uvg_threadqueue_free(queue);
+
+  sprintf(chain_msg, "%.1f us per frame of %d jobs",
+          UVG_CLOCK_T_DIFF(start, stop) * 1e6 / frames, FRAME_CTUS);
+  PASSm(chain_msg);
+}
+
+SUITE(threadqueue_speed_tests)
+{
+  RUN_TEST(test_job_setup_time);
+  RUN_TEST1(test_wake_latency, 0);
+  RUN_TEST1(test_wake_latency, 1000);
+  RUN_TEST1(test_wake_latency, 100000);
+}
@@ -0,0 +1,171 @@
+/*****************************************************************************
+ * This file is part of uvg266 VVC encoder.
+ *
+ * Copyright (c) 2021, Tampere University, ITU/ISO/IEC, project contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * * Neither the name of the Tampere University or ITU/ISO/IEC nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ ****************************************************************************/
+
+
+#include "greatest/greatest.h"
+
+#include "src/encoder.h"
+#include "src/encoderstate.h"
+#include "src/threads.h"
+#include "src/transform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Number of different residuals transformed by the tests
+#define NUM_RESIDUALS 64
+
+static encoder_control_t tc_encoder;
+static encoder_state_t tc_state;
+static ALIGNED(64) int16_t residuals[NUM_RESIDUALS][TR_MAX_WIDTH * TR_MAX_WIDTH];
+static char tc_msg[256];
+
+static void setup(void)
+{
+  memset(&tc_encoder, 0, sizeof(tc_encoder));
+  memset(&tc_state, 0, sizeof(tc_state));
+  tc_encoder.bitdepth = UVG_BIT_DEPTH;
+  tc_state.encoder_control = &tc_encoder;
+  tc_state.transform_cache = uvg_transform_cache_alloc();
+  uvg_transform_cache_start_ctu(tc_state.transform_cache);
+
+  uint32_t rand_state = 1;
+  for (int i = 0; i < NUM_RESIDUALS; ++i) {
+    for (int j = 0; j < TR_MAX_WIDTH * TR_MAX_WIDTH; ++j) {
+      rand_state = rand_state * 1103515245 + 12345;
+      residuals[i][j] = (int16_t)((rand_state >> 16) % 128) - 64;
+    }
+  }
+}
+
+static void teardown(void)
+{
+  uvg_transform_cache_free(tc_state.transform_cache);
+  tc_state.transform_cache = NULL;
+}
+
+static cu_info_t test_tu(int lfnst_idx)
+{
+  cu_info_t tu;
+  memset(&tu, 0, sizeof(tu));
+  tu.type = CU_INTRA;
+  tu.lfnst_idx = lfnst_idx;
+  return tu;
+}
+
+TEST test_cached_transform_is_equal(const int width)
+{
+  ALIGNED(64) coeff_t expected[TR_MAX_WIDTH * TR_MAX_WIDTH];
+  ALIGNED(64) coeff_t actual[TR_MAX_WIDTH * TR_MAX_WIDTH];
+  const cu_info_t tu = test_tu(1);
+  const int num_samples = width * width;
+
+  for (int round = 0; round < 2; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      uvg_transform2d(&tc_encoder, residuals[i], expected, width, width, COLOR_Y, &tu);
+      uvg_transform2d_cached(&tc_state, residuals[i], actual, width, width, COLOR_Y, &tu);
+      ASSERT(memcmp(expected, actual, num_samples * sizeof(coeff_t)) == 0);
+    }
+  }
+
+  // A residual differing in one sample is not found.
+  ALIGNED(64) int16_t changed[TR_MAX_WIDTH * TR_MAX_WIDTH];
+  memcpy(changed, residuals[0], sizeof(changed));
+  changed[num_samples - 1] += 1;
+  uvg_transform2d(&tc_encoder, changed, expected, width, width, COLOR_Y, &tu);
+  uvg_transform2d_cached(&tc_state, changed, actual, width, width, COLOR_Y, &tu);
+  ASSERT(memcmp(expected, actual, num_samples * sizeof(coeff_t)) == 0);
+  PASS();
+}
+
+SUITE(transform_cache_tests)
+{
+  setup();
+  for (int width = 4; width <= TR_MAX_WIDTH; width *= 2) {
+    RUN_TEST1(test_cached_transform_is_equal, width);
+  }
+  teardown();
+}
+
+
+// Transforms per measurement
+#define SPEED_TRANSFORMS 200000
+
+static int speed_width;
+
+enum cache_speed_mode {
+  CACHE_NONE,
+  CACHE_MISS,
+  CACHE_HIT,
+};
+
+/**
+ * \brief Measure the time of a transform with LFNST without the cache and
+ * with the cache when every lookup misses or hits.
+ */
+TEST test_transform_cache_speed(const int mode)
+{
+  const int width = speed_width;
+  ALIGNED(64) coeff_t coeff[TR_MAX_WIDTH * TR_MAX_WIDTH];
+  const cu_info_t tu = test_tu(1);
+  int32_t sum = 0;
+
+  UVG_CLOCK_T start, stop;
+  UVG_GET_TIME(&start);
+  for (int i = 0; i < SPEED_TRANSFORMS; ++i) {
+    // More residuals than entries, so that cycling through them misses.
+    int16_t *const residual = residuals[mode == CACHE_HIT ? i % 2 : i % NUM_RESIDUALS];
+    if (mode == CACHE_NONE) {
+      uvg_transform2d(&tc_encoder, residual, coeff, width, width, COLOR_Y, &tu);
+    } else {
+      uvg_transform2d_cached(&tc_state, residual, coeff, width, width, COLOR_Y, &tu);
+    }
+    sum += coeff[0];
+  }
+  UVG_GET_TIME(&stop);
+
+  static const char *const mode_names[] = { "no cache", "miss", "hit" };
+  sprintf(tc_msg, "%dx%d %s: %.1f ns per transform (%d)", width, width, mode_names[mode],
+          UVG_CLOCK_T_DIFF(start, stop) * 1e9 / SPEED_TRANSFORMS, sum & 1);
+  PASSm(tc_msg);
+}
+
+SUITE(transform_cache_speed_tests)
+{
+  setup();
+  for (speed_width = 4; speed_width <= TR_MAX_WIDTH; speed_width *= 2) {
+    RUN_TEST1(test_transform_cache_speed, CACHE_NONE);
+    RUN_TEST1(test_transform_cache_speed, CACHE_MISS);
+    RUN_TEST1(test_transform_cache_speed, CACHE_HIT);
+  }
+  teardown();
+}